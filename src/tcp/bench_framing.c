@@ -0,0 +1,174 @@
+// Benchmark de los parsers del stream TCP, sin sockets.
+//
+// Arma en memoria un stream de N PDUs (v1 y v2) y se lo pasa a cada parser en
+// pedazos de C bytes, como lo entregaría recv(). Compara el parser original
+// (búsqueda byte a byte de '|' + memmove del resto tras cada PDU) con el ring
+// de framing.c en v1 (memchr) y v2 (header con longitud). Verifica además que
+// todos extraigan los mismos timestamps.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <time.h>
+
+#include "common.h"
+#include "framing.h"
+
+#define PAYLOAD_SIZE 800
+#define LEGACY_BUF_SIZE 16384
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Stream de n PDUs con timestamps 1, 2, ... en el framing pedido
+static uint8_t *build_stream(int version, unsigned long n, size_t *len) {
+  size_t pdu_size = (version == 2) ? V2_HDR_SIZE + 8 + PAYLOAD_SIZE
+                                   : 8 + PAYLOAD_SIZE + 1;
+  uint8_t *buf = malloc(pdu_size * n);
+  if (!buf) {
+    perror("malloc");
+    exit(1);
+  }
+  for (unsigned long i = 0; i < n; i++) {
+    uint8_t *pdu = buf + i * pdu_size;
+    size_t off = 0;
+    if (version == 2) {
+      frame_v2_header(pdu, 8 + PAYLOAD_SIZE, (uint32_t)i, 0);
+      off = V2_HDR_SIZE;
+    }
+    uint64_t ts = hton64(i + 1);
+    memcpy(pdu + off, &ts, sizeof(ts));
+    memset(pdu + off + 8, 0x20, PAYLOAD_SIZE);
+    if (version == 1) {
+      pdu[8 + PAYLOAD_SIZE] = V1_DELIMITER;
+    }
+  }
+  *len = pdu_size * n;
+  return buf;
+}
+
+// Parser original de server.c: recv_buf lineal, búsqueda byte a byte y
+// memmove del resto después de cada PDU
+static uint64_t run_legacy(const uint8_t *stream, size_t len, size_t chunk,
+                           unsigned long *count) {
+  static uint8_t buf[LEGACY_BUF_SIZE];
+  size_t buf_len = 0;
+  uint64_t sum = 0;
+  for (size_t off = 0; off < len;) {
+    size_t n = len - off < chunk ? len - off : chunk;
+    if (n > sizeof(buf) - buf_len) {
+      n = sizeof(buf) - buf_len;
+    }
+    memcpy(buf + buf_len, stream + off, n);
+    buf_len += n;
+    off += n;
+
+    while (buf_len >= V1_MIN_PDU_SIZE) {
+      size_t delim_pos;
+      int found = 0;
+      for (delim_pos = V1_MIN_PDU_SIZE - 1; delim_pos < buf_len; delim_pos++) {
+        if (buf[delim_pos] == V1_DELIMITER) {
+          found = 1;
+          break;
+        }
+      }
+      if (!found) {
+        break;
+      }
+      uint64_t ts;
+      memcpy(&ts, buf, sizeof(ts));
+      sum += ntoh64(ts);
+      (*count)++;
+      size_t pdu_len = delim_pos + 1;
+      memmove(buf, buf + pdu_len, buf_len - pdu_len);
+      buf_len -= pdu_len;
+    }
+  }
+  return sum;
+}
+
+static uint64_t run_ring(const uint8_t *stream, size_t len, size_t chunk,
+                         unsigned long *count) {
+  static FrameParser p;
+  frame_parser_init(&p);
+  uint64_t sum = 0;
+  for (size_t off = 0; off < len;) {
+    // Copiar como lo haría readv() en los iovec del ring
+    struct iovec iov[2];
+    int iovcnt = frame_parser_iov(&p, iov);
+    size_t want = len - off < chunk ? len - off : chunk;
+    size_t got = 0;
+    for (int i = 0; i < iovcnt && got < want; i++) {
+      size_t n = iov[i].iov_len < want - got ? iov[i].iov_len : want - got;
+      memcpy(iov[i].iov_base, stream + off + got, n);
+      got += n;
+    }
+    frame_parser_commit(&p, got);
+    off += got;
+
+    ProbePdu pdu;
+    FrameResult r;
+    while ((r = frame_parser_next(&p, &pdu)) != FRAME_NEED_MORE) {
+      if (r != FRAME_OK) {
+        fprintf(stderr, "PDU inválida en el offset %zu\n", off);
+        exit(1);
+      }
+      sum += pdu.origin_ts;
+      (*count)++;
+    }
+  }
+  return sum;
+}
+
+typedef uint64_t (*ParserFn)(const uint8_t *, size_t, size_t,
+                             unsigned long *);
+
+static int bench(const char *name, ParserFn fn, const uint8_t *stream,
+                 size_t len, size_t chunk, unsigned long n) {
+  unsigned long count = 0;
+  double t0 = now_sec();
+  uint64_t sum = fn(stream, len, chunk, &count);
+  double secs = now_sec() - t0;
+
+  uint64_t expected = (uint64_t)n * (n + 1) / 2;
+  int ok = count == n && sum == expected;
+  printf("  %-18s %8.1f ns/PDU  %8.1f MB/s  %s\n", name, secs * 1e9 / n,
+         len / secs / 1e6, ok ? "(OK)" : "(ERROR)");
+  return ok ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned long n = 200000;
+  if (argc >= 2) {
+    n = strtoul(argv[1], NULL, 10);
+  }
+  if (n == 0) {
+    fprintf(stderr, "Uso: %s [PDUs]\n", argv[0]);
+    return 1;
+  }
+
+  size_t len_v1, len_v2;
+  uint8_t *v1 = build_stream(1, n, &len_v1);
+  uint8_t *v2 = build_stream(2, n, &len_v2);
+
+  printf("=== Benchmark de framing TCP ===\n");
+  printf("%lu PDUs de %d bytes de payload\n", n, PAYLOAD_SIZE);
+
+  static const size_t chunks[] = {64, 1448, 16384};
+  int err = 0;
+  for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+    printf("\nrecv() de %zu bytes:\n", chunks[i]);
+    err |= bench("v1 original", run_legacy, v1, len_v1, chunks[i], n);
+    err |= bench("v1 ring + memchr", run_ring, v1, len_v1, chunks[i], n);
+    err |= bench("v2 ring", run_ring, v2, len_v2, chunks[i], n);
+  }
+
+  free(v1);
+  free(v2);
+  return err ? 1 : 0;
+}
@@ -1,6 +1,8 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -11,13 +13,23 @@
 #include <unistd.h>
 
 #include "common.h"
+#include "echo.h"
+#include "framing.h"
+#include "load.h"
+#include "pacer.h"
+#include "schedule.h"
+#include "sockstat.h"
+#include "tstamp.h"
 
 #define SERVER_PORT 20252
 
-#define MIN_PAYLOAD_SIZE 500
-#define MAX_PAYLOAD_SIZE 1000
 #define DEFAULT_PAYLOAD_SIZE 800
 
+// Al terminar en modo eco, cuánto esperar los ecos pendientes, y con -k los
+// timestamps de ACK que falten
+#define ECHO_DRAIN_NS 2000000000ULL
+#define TX_DRAIN_NS 1000000000ULL
+
 // Flag para shutdown graceful
 static volatile sig_atomic_t g_running = 1;
 
@@ -62,45 +74,201 @@ static int send_all(int sockfd, const uint8_t *buf, size_t len) {
   return 0;
 }
 
-// Dormir por un tiempo especificado en milisegundos, manejando interrupciones
-static void sleep_ms(int ms) {
-  struct timespec req, rem;
-  req.tv_sec = ms / 1000;
-  req.tv_nsec = (long)(ms % 1000) * 1000000L;
-
-  while (nanosleep(&req, &rem) < 0) {
+// UDP: un send() por PDU. Los errores (ICMP de puerto cerrado, buffer
+// lleno) se cuentan pero no cortan la corrida: la PDU cuenta como perdida.
+// Devuelve -1 solo si lo interrumpió Ctrl+C.
+static int send_datagram(int sockfd, const uint8_t *buf, size_t len,
+                         unsigned long *errors) {
+  while (send(sockfd, buf, len, 0) < 0) {
     if (errno == EINTR) {
       if (!g_running) {
-        return; // Salir si recibimos señal de terminación
+        return -1;
       }
-      req = rem; // Continuar con el tiempo restante
-    } else {
-      perror("nanosleep");
-      return;
+      continue;
     }
+    if (*errors == 0) {
+      perror("send");
+    }
+    (*errors)++;
+    break;
   }
+  return 0;
+}
+
+// Opciones de línea de comandos
+typedef struct {
+  const char *server_ip;
+  ScheduleConfig sched; // -d, -p, -z, -r: intervalos y tamaños
+  int seed_set;          // -r dado: si no, una semilla nueva por corrida
+  uint64_t spin_ns;      // -s: espera activa antes de cada envío
+  int N_seconds;        // Duración total en segundos
+  int version;          // Framing de las PDUs
+  const char *echo_log; // -e: modo eco y CSV de offset / RTT (NULL = no)
+  const char *tx_log;   // -k: timestamps de transmisión del kernel (CSV)
+  const char *sock_log; // -i: send(), cola de envío y TCP_INFO por PDU (CSV)
+  int udp;              // -u: una PDU v2 por datagrama UDP
+  int connections;      // -c: conexiones en paralelo, cada una con su agenda
+  int threads;          // -t: hilos que se reparten las conexiones
+} ClientOptions;
+
+// Atender el socket hasta deadline_ns (CLOCK_MONOTONIC): en modo eco leer
+// los ecos que lleguen, con -k los timestamps de la cola de errores (poll
+// avisa POLLERR aunque no se pida). El timeout de poll se redondea para
+// abajo: el último tramo (menos de 1 ms) lo espera el pacer con precisión,
+// después de una última pasada sin bloquear. Devuelve -1 si el servidor
+// cerró la conexión.
+static int wait_socket(int sockfd, EchoState *echo, TxTracker *tx,
+                       uint64_t deadline_ns) {
+  while (g_running) {
+    uint64_t now_ns = pacer_now_ns();
+    if (now_ns >= deadline_ns) {
+      return 0;
+    }
+    struct pollfd pfd = {.fd = sockfd, .events = echo ? POLLIN : 0};
+    int timeout_ms = (int)((deadline_ns - now_ns) / 1000000);
+    int n = poll(&pfd, 1, timeout_ms);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("poll");
+      return -1;
+    }
+    if (tx && (pfd.revents & POLLERR) && tx_tracker_poll(tx, sockfd) < 0) {
+      return -1;
+    }
+    if (echo && (pfd.revents & (POLLIN | POLLHUP)) &&
+        echo_read(echo, sockfd) < 0) {
+      return -1;
+    }
+    if (timeout_ms == 0) {
+      return 0;
+    }
+  }
+  return 0;
 }
 
 static void print_usage(const char *progname) {
   fprintf(stderr,
-          "Uso: %s <server_ip> -d <ms_entre_envios> -N <duracion_segundos>\n",
+          "Uso: %s <server_ip> -d <ms_entre_envios> -N <duracion_segundos> "
+          "[-p <perfil>] [-z <tamaño>] [-r <semilla>] [-s <us>] [-v 1|2] "
+          "[-u] [-e <archivo_csv>] [-k <archivo_csv>] [-i <archivo_csv>] "
+          "[-c <conexiones>] [-t <hilos>]\n",
           progname);
   fprintf(stderr, "Ejemplo: %s 192.168.0.10 -d 50 -N 10\n", progname);
   fprintf(stderr, "\nOpciones:\n");
-  fprintf(stderr, "  -d <ms>     Intervalo entre PDUs en milisegundos (>0)\n");
+  fprintf(stderr, "  -d <ms>     Intervalo entre PDUs en milisegundos, admite "
+                  "decimales (0.05 = 50 us)\n");
   fprintf(stderr, "  -N <seg>    Duración total del test en segundos (>0)\n");
+  fprintf(stderr,
+          "  -p <perfil> Intervalos entre envíos, con media -d: constante "
+          "(default),\n"
+          "              poisson, uniforme (entre d/2 y 3d/2) o "
+          "traza:<archivo>\n"
+          "              (un intervalo en ms por línea, repetidos)\n");
+  fprintf(stderr,
+          "  -z <tamaño> Bytes de payload: un número entre %d y %d "
+          "(default %d),\n"
+          "              barrido[:<paso>] de %d a %d, o aleatorio\n",
+          MIN_PAYLOAD_SIZE, MAX_PAYLOAD_SIZE, DEFAULT_PAYLOAD_SIZE,
+          MIN_PAYLOAD_SIZE, MAX_PAYLOAD_SIZE);
+  fprintf(stderr, "  -r <sem>    Semilla de los sorteos de -p y -z (default: "
+                  "una por corrida)\n");
+  fprintf(stderr, "  -s <us>     Espera activa de los últimos <us> antes de "
+                  "cada envío (default 0)\n");
+  fprintf(stderr, "  -v <1|2>    Framing: 1 = delimitador '|' (default), "
+                  "2 = header binario\n");
+  fprintf(stderr, "  -u          Sondas UDP: una PDU v2 por datagrama, sin "
+                  "retransmisiones\n");
+  fprintf(stderr, "  -e <csv>    Modo eco: el servidor devuelve sus "
+                  "timestamps y se estiman\n"
+                  "              RTT y offset de reloj por muestra (usa v2)\n");
+  fprintf(stderr, "  -k <csv>    Timestamps de transmisión del kernel "
+                  "(qdisc, driver y ACK) por PDU\n");
+  fprintf(stderr, "  -i <csv>    Duración de send(), cola de envío y TCP_INFO "
+                  "por PDU (solo TCP)\n");
+  fprintf(stderr, "  -c <n>      Modo carga: n conexiones TCP, cada una con "
+                  "la agenda de -d/-p/-z\n"
+                  "              (sin -u, -e, -k, -i ni -s)\n");
+  fprintf(stderr, "  -t <n>      Hilos del modo carga, cada uno con su epoll "
+                  "(default 1)\n");
 }
 
-// Parsear argumentos -d y -N
-static int parse_args(int argc, char *argv[], const char **server_ip, int *d_ms,
-                      int *N_seconds) {
+// -p: constante, poisson, uniforme o traza:<archivo>
+static int parse_profile(const char *arg, ScheduleConfig *sched) {
+  static const char *const names[] = {"constante", "poisson", "uniforme"};
+  for (int d = 0; d < 3; d++) {
+    if (strcmp(arg, names[d]) == 0) {
+      sched->dist = (SchedInterval)d;
+      return 0;
+    }
+  }
+  if (strncmp(arg, "traza:", 6) == 0 && arg[6] != '\0') {
+    sched->dist = SCHED_TRACE;
+    sched->trace_path = arg + 6;
+    return 0;
+  }
+  fprintf(stderr, "ERROR: -p debe ser constante, poisson, uniforme o "
+                  "traza:<archivo>\n");
+  return -1;
+}
+
+// -z: bytes fijos, barrido[:<paso>] o aleatorio
+static int parse_sizes(const char *arg, ScheduleConfig *sched) {
+  char *endptr;
+  if (strcmp(arg, "aleatorio") == 0) {
+    sched->size_mode = SCHED_SIZE_RANDOM;
+    return 0;
+  }
+  if (strncmp(arg, "barrido", 7) == 0) {
+    sched->size_mode = SCHED_SIZE_SWEEP;
+    sched->sweep_step = 1;
+    if (arg[7] == '\0') {
+      return 0;
+    }
+    long step = arg[7] == ':' ? strtol(arg + 8, &endptr, 10) : -1;
+    if (step >= 1 && step <= MAX_PAYLOAD_SIZE - MIN_PAYLOAD_SIZE &&
+        *endptr == '\0') {
+      sched->sweep_step = (uint32_t)step;
+      return 0;
+    }
+    fprintf(stderr, "ERROR: el paso del barrido debe estar entre 1 y %d\n",
+            MAX_PAYLOAD_SIZE - MIN_PAYLOAD_SIZE);
+    return -1;
+  }
+  long val = strtol(arg, &endptr, 10);
+  if (*endptr != '\0' || val < MIN_PAYLOAD_SIZE || val > MAX_PAYLOAD_SIZE) {
+    fprintf(stderr, "ERROR: -z debe ser un número entre %d y %d, "
+                    "barrido[:<paso>] o aleatorio\n",
+            MIN_PAYLOAD_SIZE, MAX_PAYLOAD_SIZE);
+    return -1;
+  }
+  sched->size_mode = SCHED_SIZE_FIXED;
+  sched->payload = (uint32_t)val;
+  return 0;
+}
+
+// Parsear argumentos -d, -N, -p, -z, -r, -s, -v, -u, -e, -k e -i
+static int parse_args(int argc, char *argv[], ClientOptions *opts) {
   if (argc < 6) {
     return -1;
   }
 
-  *server_ip = argv[1];
-  *d_ms = -1;
-  *N_seconds = -1;
+  opts->server_ip = argv[1];
+  memset(&opts->sched, 0, sizeof(opts->sched));
+  opts->sched.dist = SCHED_CONSTANT;
+  opts->sched.size_mode = SCHED_SIZE_FIXED;
+  opts->sched.payload = DEFAULT_PAYLOAD_SIZE;
+  opts->seed_set = 0;
+  opts->spin_ns = 0;
+  opts->N_seconds = -1;
+  opts->version = 0;
+  opts->echo_log = NULL;
+  opts->tx_log = NULL;
+  opts->sock_log = NULL;
+  opts->udp = 0;
+  opts->connections = 1;
+  opts->threads = 1;
 
   int i = 2;
   while (i < argc) {
@@ -110,12 +278,51 @@ static int parse_args(int argc, char *argv[], const char **server_ip, int *d_ms,
         return -1;
       }
       char *endptr;
+      double val = strtod(argv[i + 1], &endptr);
+      if (*endptr != '\0' || !(val >= 0.001 && val <= 60000)) {
+        fprintf(stderr, "ERROR: -d debe estar entre 0.001 y 60000 ms\n");
+        return -1;
+      }
+      opts->sched.interval_ns = (uint64_t)(val * 1000.0 + 0.5) * 1000;
+      i += 2;
+    } else if (strcmp(argv[i], "-p") == 0 || strcmp(argv[i], "-z") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: %s requiere un valor\n", argv[i]);
+        return -1;
+      }
+      int err = argv[i][1] == 'p' ? parse_profile(argv[i + 1], &opts->sched)
+                                  : parse_sizes(argv[i + 1], &opts->sched);
+      if (err < 0) {
+        return -1;
+      }
+      i += 2;
+    } else if (strcmp(argv[i], "-r") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: -r requiere un valor\n");
+        return -1;
+      }
+      char *endptr;
+      errno = 0;
+      unsigned long long val = strtoull(argv[i + 1], &endptr, 10);
+      if (*endptr != '\0' || errno != 0 || argv[i + 1][0] == '-') {
+        fprintf(stderr, "ERROR: -r debe ser un entero >= 0\n");
+        return -1;
+      }
+      opts->sched.seed = val;
+      opts->seed_set = 1;
+      i += 2;
+    } else if (strcmp(argv[i], "-s") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: -s requiere un valor\n");
+        return -1;
+      }
+      char *endptr;
       long val = strtol(argv[i + 1], &endptr, 10);
-      if (*endptr != '\0' || val <= 0 || val > 60000) {
-        fprintf(stderr, "ERROR: -d debe ser un entero entre 1 y 60000\n");
+      if (*endptr != '\0' || val < 0 || val > 1000000) {
+        fprintf(stderr, "ERROR: -s debe ser un entero entre 0 y 1000000\n");
         return -1;
       }
-      *d_ms = (int)val;
+      opts->spin_ns = (uint64_t)val * 1000;
       i += 2;
     } else if (strcmp(argv[i], "-N") == 0) {
       if (i + 1 >= argc) {
@@ -128,7 +335,58 @@ static int parse_args(int argc, char *argv[], const char **server_ip, int *d_ms,
         fprintf(stderr, "ERROR: -N debe ser un entero entre 1 y 86400\n");
         return -1;
       }
-      *N_seconds = (int)val;
+      opts->N_seconds = (int)val;
+      i += 2;
+    } else if (strcmp(argv[i], "-v") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: -v requiere un valor\n");
+        return -1;
+      }
+      if (strcmp(argv[i + 1], "1") != 0 && strcmp(argv[i + 1], "2") != 0) {
+        fprintf(stderr, "ERROR: -v debe ser 1 o 2\n");
+        return -1;
+      }
+      opts->version = argv[i + 1][0] - '0';
+      i += 2;
+    } else if (strcmp(argv[i], "-e") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: -e requiere un archivo\n");
+        return -1;
+      }
+      opts->echo_log = argv[i + 1];
+      i += 2;
+    } else if (strcmp(argv[i], "-u") == 0) {
+      opts->udp = 1;
+      i++;
+    } else if (strcmp(argv[i], "-k") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: -k requiere un archivo\n");
+        return -1;
+      }
+      opts->tx_log = argv[i + 1];
+      i += 2;
+    } else if (strcmp(argv[i], "-i") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: -i requiere un archivo\n");
+        return -1;
+      }
+      opts->sock_log = argv[i + 1];
+      i += 2;
+    } else if (strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "-t") == 0) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: %s requiere un valor\n", argv[i]);
+        return -1;
+      }
+      int conns = argv[i][1] == 'c';
+      long max = conns ? 100000 : 256;
+      char *endptr;
+      long val = strtol(argv[i + 1], &endptr, 10);
+      if (*endptr != '\0' || val < 1 || val > max) {
+        fprintf(stderr, "ERROR: %s debe ser un entero entre 1 y %ld\n",
+                argv[i], max);
+        return -1;
+      }
+      *(conns ? &opts->connections : &opts->threads) = (int)val;
       i += 2;
     } else {
       fprintf(stderr, "ERROR: Parámetro desconocido: %s\n", argv[i]);
@@ -136,38 +394,108 @@ static int parse_args(int argc, char *argv[], const char **server_ip, int *d_ms,
     }
   }
 
-  if (*d_ms <= 0) {
+  if (opts->sched.interval_ns == 0 && opts->sched.dist != SCHED_TRACE) {
     fprintf(stderr, "ERROR: Falta el parámetro -d\n");
     return -1;
   }
-  if (*N_seconds <= 0) {
+  if (opts->N_seconds <= 0) {
     fprintf(stderr, "ERROR: Falta el parámetro -N\n");
     return -1;
   }
+  if (opts->sock_log && opts->udp) {
+    fprintf(stderr, "ERROR: -i no se puede usar con -u\n");
+    return -1;
+  }
+  if ((opts->connections > 1 || opts->threads > 1) &&
+      (opts->udp || opts->echo_log || opts->tx_log || opts->sock_log ||
+       opts->spin_ns)) {
+    fprintf(stderr, "ERROR: -c y -t no se pueden usar con -u, -e, -k, -i "
+                    "ni -s\n");
+    return -1;
+  }
+  if (opts->threads > opts->connections) {
+    opts->threads = opts->connections;
+  }
+  if ((opts->echo_log || opts->udp) && opts->version == 1) {
+    fprintf(stderr, "ERROR: -e y -u requieren framing v2\n");
+    return -1;
+  }
+  if (opts->version == 0) {
+    opts->version = (opts->echo_log || opts->udp) ? 2 : 1;
+  }
+  if (!opts->seed_set) {
+    opts->sched.seed = current_time_micros() ^ ((uint64_t)getpid() << 32);
+  }
 
   return 0;
 }
 
 int main(int argc, char *argv[]) {
-  const char *server_ip = NULL;
-  int d_ms = 0;      // Milisegundos entre PDUs
-  int N_seconds = 0; // Duración total en segundos
-
-  if (parse_args(argc, argv, &server_ip, &d_ms, &N_seconds) < 0) {
+  ClientOptions opts;
+  if (parse_args(argc, argv, &opts) < 0) {
     print_usage(argv[0]);
     return EXIT_FAILURE;
   }
 
   setup_signal_handlers();
 
-  printf("=== Cliente TCP ===\n");
-  printf("Servidor: %s:%d\n", server_ip, SERVER_PORT);
-  printf("Intervalo entre envíos: %d ms\n", d_ms);
-  printf("Duración total: %d s\n", N_seconds);
-  printf("Tamaño de payload: %d bytes\n\n", DEFAULT_PAYLOAD_SIZE);
+  // Agenda completa de intervalos y tamaños, generada por adelantado
+  static Schedule sched;
+  if (schedule_init(&sched, &opts.sched) < 0) {
+    perror(opts.sched.trace_path);
+    return EXIT_FAILURE;
+  }
+
+  printf("=== Cliente %s ===\n", opts.udp ? "UDP" : "TCP");
+  printf("Servidor: %s:%d\n", opts.server_ip, SERVER_PORT);
+  printf("Intervalo entre envíos: %.3f ms (%s)%s\n", sched.mean_ns / 1e6,
+         schedule_interval_name(opts.sched.dist),
+         opts.spin_ns ? " (con espera activa)" : "");
+  printf("Duración total: %d s\n", opts.N_seconds);
+  if (opts.sched.size_mode == SCHED_SIZE_FIXED) {
+    printf("Tamaño de payload: %u bytes\n", opts.sched.payload);
+  } else if (opts.sched.size_mode == SCHED_SIZE_SWEEP) {
+    printf("Tamaño de payload: barrido de %d a %d bytes de a %u\n",
+           MIN_PAYLOAD_SIZE, MAX_PAYLOAD_SIZE, opts.sched.sweep_step);
+  } else {
+    printf("Tamaño de payload: aleatorio entre %d y %d bytes\n",
+           MIN_PAYLOAD_SIZE, MAX_PAYLOAD_SIZE);
+  }
+  if (opts.sched.dist == SCHED_POISSON || opts.sched.dist == SCHED_UNIFORM ||
+      opts.sched.size_mode == SCHED_SIZE_RANDOM) {
+    printf("Semilla: %llu\n", (unsigned long long)opts.sched.seed);
+  }
+  printf("Framing: v%d%s\n", opts.version,
+         opts.echo_log ? " (modo eco)" : "");
+  if (opts.connections > 1 || opts.threads > 1) {
+    printf("Conexiones: %d en %d hilos (intervalo por conexión)\n",
+           opts.connections, opts.threads);
+  }
+  printf("\n");
+
+  // Modo carga: las conexiones y el reporte quedan a cargo de load.c
+  if (opts.connections > 1 || opts.threads > 1) {
+    LoadConfig load;
+    memset(&load, 0, sizeof(load));
+    load.server.sin_family = AF_INET;
+    load.server.sin_port = htons(SERVER_PORT);
+    if (inet_pton(AF_INET, opts.server_ip, &load.server.sin_addr) <= 0) {
+      fprintf(stderr, "ERROR: Dirección IP inválida: %s\n", opts.server_ip);
+      schedule_free(&sched);
+      return EXIT_FAILURE;
+    }
+    load.connections = opts.connections;
+    load.threads = opts.threads;
+    load.version = opts.version;
+    load.duration_ns = (uint64_t)opts.N_seconds * 1000000000ULL;
+    load.model = &sched;
+    int result = load_run(&load, &g_running);
+    schedule_free(&sched);
+    return result < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
 
-  // Crear socket TCP
-  int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+  // Crear socket TCP, o UDP con -u
+  int sockfd = socket(AF_INET, opts.udp ? SOCK_DGRAM : SOCK_STREAM, 0);
   if (sockfd < 0) {
     perror("socket");
     return EXIT_FAILURE;
@@ -179,13 +507,13 @@ int main(int argc, char *argv[]) {
   server_addr.sin_family = AF_INET;
   server_addr.sin_port = htons(SERVER_PORT);
 
-  if (inet_pton(AF_INET, server_ip, &server_addr.sin_addr) <= 0) {
-    fprintf(stderr, "ERROR: Dirección IP inválida: %s\n", server_ip);
+  if (inet_pton(AF_INET, opts.server_ip, &server_addr.sin_addr) <= 0) {
+    fprintf(stderr, "ERROR: Dirección IP inválida: %s\n", opts.server_ip);
     close(sockfd);
     return EXIT_FAILURE;
   }
 
-  // Conectar al servidor
+  // Conectar al servidor (en UDP solo fija el destino de los send())
   printf("Conectando al servidor...\n");
   if (connect(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) <
       0) {
@@ -194,13 +522,61 @@ int main(int argc, char *argv[]) {
     return EXIT_FAILURE;
   }
 
-  printf("Conectado al servidor TCP.\n");
+  printf("Conectado al servidor %s.\n", opts.udp ? "UDP" : "TCP");
 
-  // Preparar buffer de PDU (8 bytes timestamp + payload + 1 delimitador)
-  const size_t payload_size = DEFAULT_PAYLOAD_SIZE;
-  const size_t pdu_size = 8 + payload_size + 1;
+  static EchoState echo;
+  if (opts.echo_log && echo_init(&echo, opts.echo_log) < 0) {
+    perror(opts.echo_log);
+    close(sockfd);
+    return EXIT_FAILURE;
+  }
+  echo.datagrams = opts.udp;
+  // v2 informa el intervalo programado: el servidor separa los envíos
+  // demorados de las llegadas demoradas
+  const uint8_t flags = V2_FLAG_INTERVAL | (opts.echo_log ? V2_FLAG_ECHO : 0);
+  if (opts.echo_log && !opts.udp) {
+    // Con Nagle una PDU puede esperar el ACK de la anterior y t1 ya no
+    // coincidiría con la salida real
+    int nodelay = 1;
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+  }
 
-  uint8_t *pdu = malloc(pdu_size);
+  // -k: habilitar antes del primer envío, los offsets cuentan desde acá. En
+  // UDP la clave del kernel cuenta datagramas, no bytes: cada PDU se
+  // registra como de largo 1 y el mismo mapeo sirve.
+  static TxTracker tx;
+  TxTracker *txp = NULL;
+  if (opts.tx_log) {
+    if (tx_tracker_init(&tx, opts.tx_log) < 0) {
+      perror(opts.tx_log);
+      close(sockfd);
+      return EXIT_FAILURE;
+    }
+    if (tstamp_enable_tx(sockfd) < 0) {
+      perror("setsockopt SO_TIMESTAMPING");
+      close(sockfd);
+      return EXIT_FAILURE;
+    }
+    txp = &tx;
+  }
+  EchoState *echop = opts.echo_log ? &echo : NULL;
+
+  static SockStats sock;
+  SockStats *sockp = NULL;
+  if (opts.sock_log) {
+    if (sockstat_init(&sock, opts.sock_log) < 0) {
+      perror(opts.sock_log);
+      close(sockfd);
+      return EXIT_FAILURE;
+    }
+    sockp = &sock;
+  }
+
+  // Preparar buffer de PDU para el payload más grande. v1: 8 bytes
+  // timestamp + payload + delimitador; v2: header + 8 bytes timestamp +
+  // payload
+  const size_t ts_offset = (opts.version == 2) ? V2_HDR_SIZE : 0;
+  uint8_t *pdu = malloc(ts_offset + 8 + MAX_PAYLOAD_SIZE + 1);
   if (!pdu) {
     perror("malloc");
     close(sockfd);
@@ -208,67 +584,153 @@ int main(int argc, char *argv[]) {
   }
 
   // Rellenar el payload con datos (pattern fijo)
-  memset(pdu + 8, 0x20, payload_size);
-  pdu[8 + payload_size] = '|'; // Delimitador final
+  memset(pdu + ts_offset + 8, 0x20, MAX_PAYLOAD_SIZE + 1);
 
-  // Usar CLOCK_REALTIME para medir duración (en microsegundos)
-  uint64_t start_us = current_time_micros();
-  uint64_t duration_us = (uint64_t)N_seconds * 1000000ULL;
+  // Agenda de envíos con deadlines absolutos en CLOCK_MONOTONIC. La duración
+  // también se mide con el reloj monotónico: se envían los slots de la
+  // agenda que caen dentro de los N segundos.
+  static Pacer pacer;
+  uint64_t duration_ns = (uint64_t)opts.N_seconds * 1000000000ULL;
   int pdus_sent = 0;
+  unsigned long send_errors = 0; // UDP: PDUs que el kernel no aceptó
+  uint64_t next_progress_ns = 0;
 
   printf("Comenzando a enviar PDUs...\n");
   printf("Presione Ctrl+C para terminar anticipadamente.\n\n");
+  pacer_init(&pacer, opts.spin_ns);
+  ScheduleSlot slot = schedule_next(&sched);
+  pacer_set_next(&pacer, slot.offset_ns, (uint64_t)slot.interval_us * 1000);
 
   while (g_running) {
-    // Verificar tiempo transcurrido
-    uint64_t now_us = current_time_micros();
-    uint64_t elapsed_us = now_us - start_us;
-
-    if (elapsed_us >= duration_us) {
+    if (slot.offset_ns >= duration_ns) {
       printf("\nDuración total alcanzada (%.2f s), finalizando.\n",
-             elapsed_us / 1000000.0);
+             (pacer_now_ns() - pacer.start_ns) / 1e9);
+      break;
+    }
+
+    // Esperar el próximo envío (leyendo ecos y timestamps mientras tanto)
+    if ((echop || txp) && wait_socket(sockfd, echop, txp, pacer.next_ns) < 0) {
+      fprintf(stderr, "El servidor cerró la conexión, abortando.\n");
       break;
     }
+    if (pacer_wait(&pacer) < 0) {
+      continue; // Señal: g_running decide
+    }
 
     // Origin Timestamp: se toma justo antes de enviar la PDU (en microsegundos)
     // Se envía en network byte order para portabilidad
     uint64_t origin_ts = (uint64_t)current_time_micros();
     uint64_t origin_ts_net = hton64(origin_ts);
-    memcpy(pdu, &origin_ts_net, sizeof(origin_ts_net));
+    size_t pdu_size;
+    if (opts.version == 2) {
+      pdu_size = V2_HDR_SIZE + 8 + slot.payload;
+      frame_v2_header(pdu, 8 + slot.payload, (uint32_t)pdus_sent, flags);
+      frame_v2_interval(pdu + ts_offset + 8, slot.interval_us);
+    } else {
+      pdu_size = 8 + slot.payload + 1;
+      pdu[8 + slot.payload] = V1_DELIMITER; // Delimitador final
+    }
+    memcpy(pdu + ts_offset, &origin_ts_net, sizeof(origin_ts_net));
 
     // Enviar la PDU completa
-    if (send_all(sockfd, pdu, pdu_size) < 0) {
-      if (g_running) {
-        fprintf(stderr, "Error enviando PDU, abortando.\n");
+    if (opts.udp) {
+      if (send_datagram(sockfd, pdu, pdu_size, &send_errors) < 0) {
+        break;
+      }
+    } else {
+      if (sockp) {
+        sockstat_before_send(sockp, sockfd);
+      }
+      if (send_all(sockfd, pdu, pdu_size) < 0) {
+        if (g_running) {
+          fprintf(stderr, "Error enviando PDU, abortando.\n");
+        }
+        break;
+      }
+      if (sockp) {
+        sockstat_after_send(sockp, sockfd, (uint32_t)pdus_sent, origin_ts,
+                            pdu_size);
       }
-      break;
     }
 
     pdus_sent++;
+    if (txp) {
+      tx_tracker_sent(txp, origin_ts, opts.udp ? 1 : pdu_size);
+    }
+    if (opts.version == 1) {
+      pdu[8 + slot.payload] = 0x20; // El próximo puede ser más largo
+    }
+
+    // Próximo envío, y reponer la agenda mientras falta para su deadline
+    slot = schedule_next(&sched);
+    pacer_set_next(&pacer, slot.offset_ns, (uint64_t)slot.interval_us * 1000);
+    schedule_fill(&sched, SCHEDULE_REFILL);
 
-    // Mostrar progreso cada 100 PDUs o cada segundo
-    if (pdus_sent % 100 == 0 || pdus_sent == 1) {
+    // Mostrar progreso una vez por segundo (fuera de la agenda: si tarda,
+    // solo se nota como retraso del envío siguiente)
+    uint64_t elapsed_ns = pacer_now_ns() - pacer.start_ns;
+    if (elapsed_ns >= next_progress_ns) {
       printf("PDUs enviadas: %d (tiempo: %.1f s)\n", pdus_sent,
-             elapsed_us / 1000000.0);
+             elapsed_ns / 1e9);
+      next_progress_ns += 1000000000ULL;
     }
+  }
 
-    // Esperar antes de enviar la próxima PDU
-    sleep_ms(d_ms);
+  // Modo eco: cerrar la escritura y esperar los ecos que falten hasta que el
+  // servidor cierre. En UDP no hay cierre: hasta tener todos o el timeout.
+  if (opts.echo_log && opts.udp) {
+    uint64_t deadline_ns = pacer_now_ns() + ECHO_DRAIN_NS;
+    g_running = 1;
+    while (echo.received < (unsigned long)pdus_sent &&
+           pacer_now_ns() < deadline_ns) {
+      wait_socket(sockfd, echop, txp, pacer_now_ns() + 10000000);
+    }
+  } else if (opts.echo_log) {
+    shutdown(sockfd, SHUT_WR);
+    g_running = 1; // Ctrl+C corta el envío, no la espera de los ecos
+    wait_socket(sockfd, echop, txp, pacer_now_ns() + ECHO_DRAIN_NS);
+  } else if (txp && !opts.udp) {
+    // Sin ecos: esperar solo los timestamps de ACK de las últimas PDUs
+    uint64_t deadline_ns = pacer_now_ns() + TX_DRAIN_NS;
+    g_running = 1;
+    while (tx.acked < tx.bytes && pacer_now_ns() < deadline_ns) {
+      wait_socket(sockfd, NULL, txp, pacer_now_ns() + 10000000);
+    }
   }
 
   // Estadísticas finales
-  uint64_t end_us = current_time_micros();
-  double total_time_s = (end_us - start_us) / 1000000.0;
+  double total_time_s = (pacer_now_ns() - pacer.start_ns) / 1e9;
 
   printf("\n=== Estadísticas del cliente ===\n");
   printf("PDUs enviadas: %d\n", pdus_sent);
+  if (send_errors) {
+    printf("Errores de envío UDP: %lu\n", send_errors);
+  }
   printf("Tiempo total: %.2f s\n", total_time_s);
   if (total_time_s > 0) {
-    printf("Tasa promedio: %.2f PDUs/s\n", pdus_sent / total_time_s);
+    printf("Tasa promedio: %.2f PDUs/s (objetivo %.2f)\n",
+           pdus_sent / total_time_s, 1e9 / sched.mean_ns);
+  }
+  delay_stats_print(&pacer.lateness, stdout, "Retraso sobre la agenda: ");
+  printf("Envíos con más de un intervalo de retraso: %lu\n",
+         pacer.late_slots);
+
+  if (opts.echo_log) {
+    echo_print(&echo, (unsigned long)pdus_sent);
+    echo_close(&echo);
+  }
+  if (txp) {
+    tx_tracker_print(txp);
+    tx_tracker_close(txp);
+  }
+  if (sockp) {
+    sockstat_print(sockp);
+    sockstat_close(sockp);
   }
 
   free(pdu);
+  schedule_free(&sched);
   close(sockfd);
-  printf("Cliente TCP finalizado.\n");
+  printf("Cliente %s finalizado.\n", opts.udp ? "UDP" : "TCP");
   return EXIT_SUCCESS;
 }
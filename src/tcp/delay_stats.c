@@ -0,0 +1,169 @@
+#include "delay_stats.h"
+
+#include <math.h>
+#include <string.h>
+
+static int bucket_index(uint64_t v) {
+  if (v < DELAY_LINEAR) {
+    return (int)v;
+  }
+  int msb = 63 - __builtin_clzll(v);
+  int sub = (int)(v >> (msb - DELAY_SUB_BITS)) & ((1 << DELAY_SUB_BITS) - 1);
+  return DELAY_LINEAR + (msb - DELAY_SUB_BITS - 1) * (1 << DELAY_SUB_BITS) +
+         sub;
+}
+
+// Rango [lower, upper] de los valores absolutos que caen en el bucket
+static uint64_t bucket_lower(int b) {
+  if (b < DELAY_LINEAR) {
+    return (uint64_t)b;
+  }
+  int rel = b - DELAY_LINEAR;
+  int msb = rel / (1 << DELAY_SUB_BITS) + DELAY_SUB_BITS + 1;
+  uint64_t sub = (uint64_t)(rel % (1 << DELAY_SUB_BITS));
+  return ((1ULL << DELAY_SUB_BITS) + sub) << (msb - DELAY_SUB_BITS);
+}
+
+static uint64_t bucket_upper(int b) {
+  if (b < DELAY_LINEAR) {
+    return (uint64_t)b;
+  }
+  int rel = b - DELAY_LINEAR;
+  int msb = rel / (1 << DELAY_SUB_BITS) + DELAY_SUB_BITS + 1;
+  return bucket_lower(b) + (1ULL << (msb - DELAY_SUB_BITS)) - 1;
+}
+
+void delay_stats_init(DelayStats *s) {
+  memset(s, 0, sizeof(*s));
+  s->min_us = INT64_MAX;
+  s->max_us = INT64_MIN;
+}
+
+void delay_stats_init_base(DelayStats *s, int64_t base_us) {
+  delay_stats_init(s);
+  s->base_us = base_us;
+  s->has_base = 1;
+}
+
+void delay_stats_reset(DelayStats *s) {
+  int64_t base_us = s->base_us;
+  int has_base = s->has_base;
+  delay_stats_init(s);
+  s->base_us = base_us;
+  s->has_base = has_base;
+}
+
+void delay_stats_record(DelayStats *s, int64_t delay_us) {
+  s->count++;
+  double d = (double)delay_us - s->mean;
+  s->mean += d / (double)s->count;
+  s->m2 += d * ((double)delay_us - s->mean);
+
+  if (delay_us < s->min_us) {
+    s->min_us = delay_us;
+  }
+  if (delay_us > s->max_us) {
+    s->max_us = delay_us;
+  }
+  if (!s->has_base) {
+    s->base_us = delay_us;
+    s->has_base = 1;
+  }
+  int64_t rel = delay_us - s->base_us;
+  if (rel >= 0) {
+    s->pos[bucket_index((uint64_t)rel)]++;
+  } else {
+    s->neg[bucket_index((uint64_t)0 - (uint64_t)rel)]++;
+  }
+}
+
+void delay_stats_merge(DelayStats *dst, const DelayStats *src) {
+  if (src->count == 0) {
+    return;
+  }
+  if (!dst->has_base) {
+    dst->base_us = src->base_us;
+    dst->has_base = 1;
+  }
+  uint64_t n = dst->count + src->count;
+  double d = src->mean - dst->mean;
+  dst->m2 += src->m2 +
+             d * d * (double)dst->count * (double)src->count / (double)n;
+  dst->mean += d * (double)src->count / (double)n;
+  dst->count = n;
+
+  if (src->min_us < dst->min_us) {
+    dst->min_us = src->min_us;
+  }
+  if (src->max_us > dst->max_us) {
+    dst->max_us = src->max_us;
+  }
+  for (int b = 0; b < DELAY_BUCKETS; b++) {
+    dst->pos[b] += src->pos[b];
+    dst->neg[b] += src->neg[b];
+  }
+}
+
+double delay_stats_stddev(const DelayStats *s) {
+  return s->count > 1 ? sqrt(s->m2 / (double)(s->count - 1)) : 0.0;
+}
+
+static int64_t clamp(const DelayStats *s, int64_t v) {
+  if (v < s->min_us) {
+    return s->min_us;
+  }
+  return v > s->max_us ? s->max_us : v;
+}
+
+int64_t delay_stats_percentile(const DelayStats *s, double q) {
+  if (s->count == 0) {
+    return 0;
+  }
+  uint64_t target = (uint64_t)(q * (double)s->count);
+  if (target >= s->count) {
+    target = s->count - 1;
+  }
+
+  // Orden ascendente: negativos del más grande en módulo al más chico,
+  // después los positivos
+  uint64_t seen = 0;
+  for (int b = DELAY_BUCKETS - 1; b >= 0; b--) {
+    seen += s->neg[b];
+    if (seen > target) {
+      return clamp(s, s->base_us - (int64_t)bucket_lower(b));
+    }
+  }
+  for (int b = 0; b < DELAY_BUCKETS; b++) {
+    seen += s->pos[b];
+    if (seen > target) {
+      return clamp(s, s->base_us + (int64_t)bucket_upper(b));
+    }
+  }
+  return s->max_us;
+}
+
+void delay_stats_bucket_range(const DelayStats *s, int b, int neg,
+                              int64_t *lo_us, int64_t *hi_us) {
+  if (neg) {
+    *lo_us = s->base_us - (int64_t)bucket_upper(b);
+    *hi_us = s->base_us - (int64_t)bucket_lower(b);
+  } else {
+    *lo_us = s->base_us + (int64_t)bucket_lower(b);
+    *hi_us = s->base_us + (int64_t)bucket_upper(b);
+  }
+}
+
+void delay_stats_print(const DelayStats *s, FILE *out, const char *prefix) {
+  if (s->count == 0) {
+    fprintf(out, "%sSin mediciones\n", prefix);
+    return;
+  }
+  fprintf(out,
+          "%sn=%llu media=%.1f us desv=%.1f us mín=%lld p50=%lld p90=%lld "
+          "p99=%lld p99.9=%lld máx=%lld us\n",
+          prefix, (unsigned long long)s->count, s->mean, delay_stats_stddev(s),
+          (long long)s->min_us, (long long)delay_stats_percentile(s, 0.50),
+          (long long)delay_stats_percentile(s, 0.90),
+          (long long)delay_stats_percentile(s, 0.99),
+          (long long)delay_stats_percentile(s, 0.999), (long long)s->max_us);
+}
@@ -0,0 +1,60 @@
+#ifndef TCP_DELAY_STATS_H
+#define TCP_DELAY_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Estadísticas de delay en streaming, con memoria fija sin importar la
+// duración de la corrida: media y varianza con Welford, mín / máx, e
+// histograma log-lineal estilo HDR con 32 sub-buckets por potencia de 2
+// (error relativo < 3.2%). El delay one-way crudo está dominado por el
+// offset entre relojes (puede ser negativo y de cientos de ms), así que el
+// histograma guarda la diferencia con la primera muestra, con un lado para
+// cada signo: la resolución depende de la variación y no del offset.
+
+#define DELAY_SUB_BITS 5
+#define DELAY_LINEAR (2 << DELAY_SUB_BITS) // Valores chicos: exactos
+#define DELAY_BUCKETS                                                          \
+  (DELAY_LINEAR + (64 - DELAY_SUB_BITS - 1) * (1 << DELAY_SUB_BITS))
+
+typedef struct {
+  uint64_t count;
+  double mean; // Microsegundos
+  double m2;   // Suma de cuadrados de las desviaciones (Welford)
+  int64_t min_us;
+  int64_t max_us;
+  int64_t base_us; // Primera muestra registrada: origen del histograma
+  int has_base;
+  uint64_t pos[DELAY_BUCKETS]; // delay - base >= 0, por |delay - base|
+  uint64_t neg[DELAY_BUCKETS]; // delay - base < 0, por |delay - base|
+} DelayStats;
+
+void delay_stats_init(DelayStats *s);
+
+// Vacía con una base dada: estadísticas que se llenan por separado (un hilo
+// por parte de un archivo) y después se combinan
+void delay_stats_init_base(DelayStats *s, int64_t base_us);
+
+// Vaciar conservando la base (estadísticas por intervalo que se suman a un
+// total: ambos tienen que compartir la base)
+void delay_stats_reset(DelayStats *s);
+
+void delay_stats_record(DelayStats *s, int64_t delay_us);
+
+// Acumular src en dst (combinación de Chan para media y varianza). dst toma
+// la base de src si está vacío; si no, tienen que tener la misma base.
+void delay_stats_merge(DelayStats *dst, const DelayStats *src);
+
+double delay_stats_stddev(const DelayStats *s);
+
+// Valor más alto equivalente al bucket en el que cae la fracción q
+int64_t delay_stats_percentile(const DelayStats *s, double q);
+
+// Rango [lo, hi] de delays del bucket b de pos (neg = 0) o de neg
+void delay_stats_bucket_range(const DelayStats *s, int b, int neg,
+                              int64_t *lo_us, int64_t *hi_us);
+
+// Una línea: n, media, desvío, mín, p50 / p90 / p99 / p99.9, máx
+void delay_stats_print(const DelayStats *s, FILE *out, const char *prefix);
+
+#endif
@@ -0,0 +1,163 @@
+#include "echo.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "common.h"
+
+int echo_init(EchoState *es, const char *path) {
+  memset(es, 0, sizeof(*es));
+  frame_parser_init(&es->parser);
+  delay_stats_init(&es->rtt);
+  delay_stats_init(&es->offset);
+  delay_stats_init(&es->forward);
+  delay_stats_init(&es->reverse);
+  if (path) {
+    es->log = fopen(path, "w");
+    if (!es->log) {
+      return -1;
+    }
+    fprintf(es->log, "seq,t1_us,t2_us,t3_us,t4_us,rtt_us,offset_us,"
+                     "filtered_offset_us,forward_us,reverse_us\n");
+  }
+  return 0;
+}
+
+static void handle_echo(EchoState *es, const ProbePdu *pdu, uint64_t t4) {
+  int64_t t1 = (int64_t)pdu->origin_ts;
+  int64_t t2 = (int64_t)pdu->echo_rx_ts;
+  int64_t t3 = (int64_t)pdu->echo_tx_ts;
+  int64_t rtt = ((int64_t)t4 - t1) - (t3 - t2);
+  int64_t offset = ((t2 - t1) + (t3 - (int64_t)t4)) / 2;
+
+  // Filtro de reloj: offset de la muestra de menor RTT de la ventana
+  EchoSample *slot = &es->filter[es->received % ECHO_FILTER_SIZE];
+  slot->rtt_us = rtt;
+  slot->offset_us = offset;
+  es->received++;
+  size_t n = es->received < ECHO_FILTER_SIZE ? es->received : ECHO_FILTER_SIZE;
+  const EchoSample *best = &es->filter[0];
+  for (size_t i = 1; i < n; i++) {
+    if (es->filter[i].rtt_us < best->rtt_us) {
+      best = &es->filter[i];
+    }
+  }
+  es->best_offset_us = best->offset_us;
+
+  int64_t forward = (t2 - t1) - es->best_offset_us;
+  int64_t reverse = ((int64_t)t4 - t3) + es->best_offset_us;
+  delay_stats_record(&es->rtt, rtt);
+  delay_stats_record(&es->offset, offset);
+  delay_stats_record(&es->forward, forward);
+  delay_stats_record(&es->reverse, reverse);
+
+  if (es->log) {
+    fprintf(es->log,
+            "%u,%lld,%lld,%lld,%llu,%lld,%lld,%lld,%lld,%lld\n", pdu->seq,
+            (long long)t1, (long long)t2, (long long)t3,
+            (unsigned long long)t4, (long long)rtt, (long long)offset,
+            (long long)es->best_offset_us, (long long)forward,
+            (long long)reverse);
+  }
+}
+
+// UDP: un eco por datagrama; los inválidos se cuentan y se siguen leyendo
+static int read_datagrams(EchoState *es, int sockfd) {
+  while (1) {
+    uint8_t buf[V2_ECHO_SIZE + 1]; // +1: detectar datagramas de más
+    ssize_t n = recv(sockfd, buf, sizeof(buf), MSG_DONTWAIT);
+    uint64_t t4 = current_time_micros();
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return 0;
+      }
+      // Con UDP conectado, un ICMP de puerto cerrado aparece acá: no es
+      // motivo para abandonar la corrida
+      if (errno == ECONNREFUSED) {
+        continue;
+      }
+      perror("recv");
+      return -1;
+    }
+    ProbePdu pdu;
+    if (frame_v2_datagram(buf, (size_t)n, &pdu) == FRAME_OK &&
+        (pdu.flags & V2_FLAG_ECHO_REPLY)) {
+      handle_echo(es, &pdu, t4);
+    } else {
+      es->invalid++;
+    }
+  }
+}
+
+int echo_read(EchoState *es, int sockfd) {
+  if (es->datagrams) {
+    return read_datagrams(es, sockfd);
+  }
+  while (1) {
+    struct iovec iov[2];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = (size_t)frame_parser_iov(&es->parser, iov);
+    ssize_t n = recvmsg(sockfd, &msg, MSG_DONTWAIT);
+    uint64_t t4 = current_time_micros();
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return 0;
+      }
+      perror("recvmsg");
+      return -1;
+    }
+    if (n == 0) {
+      return -1;
+    }
+    frame_parser_commit(&es->parser, (size_t)n);
+
+    ProbePdu pdu;
+    FrameResult r;
+    while ((r = frame_parser_next(&es->parser, &pdu)) != FRAME_NEED_MORE) {
+      if (r == FRAME_FATAL) {
+        fprintf(stderr, "ERROR: Respuesta de eco inválida del servidor\n");
+        return -1;
+      }
+      if (r == FRAME_OK && (pdu.flags & V2_FLAG_ECHO_REPLY)) {
+        handle_echo(es, &pdu, t4);
+      } else {
+        es->invalid++;
+      }
+    }
+  }
+}
+
+void echo_print(const EchoState *es, unsigned long sent) {
+  printf("\n=== Eco (offset de reloj) ===\n");
+  printf("Ecos recibidos: %lu de %lu", es->received, sent);
+  if (es->invalid) {
+    printf(" (%lu respuestas inválidas)", es->invalid);
+  }
+  printf("\n");
+  if (es->received == 0) {
+    return;
+  }
+  printf("Offset filtrado final (servidor - cliente): %lld us\n",
+         (long long)es->best_offset_us);
+  delay_stats_print(&es->rtt, stdout, "RTT:         ");
+  delay_stats_print(&es->offset, stdout, "Offset:      ");
+  delay_stats_print(&es->forward, stdout, "Ida (corr.): ");
+  delay_stats_print(&es->reverse, stdout, "Vuelta (c.): ");
+}
+
+void echo_close(EchoState *es) {
+  if (es->log) {
+    fclose(es->log);
+    es->log = NULL;
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef TCP_ECHO_H
+#define TCP_ECHO_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "delay_stats.h"
+#include "framing.h"
+
+// Estimación del offset de reloj con los ecos del servidor (modo -e).
+//
+// Por cada eco: t1 envío del cliente, t2 recepción en el servidor, t3 envío
+// del eco, t4 recepción del eco (t1 y t4 con el reloj del cliente, t2 y t3
+// con el del servidor). Como en NTP:
+//   rtt    = (t4 - t1) - (t3 - t2)
+//   offset = ((t2 - t1) + (t3 - t4)) / 2     (servidor - cliente)
+// El offset de una muestra sola supone caminos simétricos. Se usa el de la
+// muestra de menor RTT entre las últimas ECHO_FILTER_SIZE (el filtro de
+// reloj de NTP): es la que menos cola tuvo, así que su offset es el más
+// confiable, y con él se corrigen los delays de ida y vuelta de cada muestra.
+
+#define ECHO_FILTER_SIZE 8
+
+typedef struct {
+  int64_t rtt_us;
+  int64_t offset_us;
+} EchoSample;
+
+typedef struct {
+  FrameParser parser;
+  int datagrams; // UDP: cada eco llega en su propio datagrama
+  FILE *log;     // CSV por muestra (NULL = sin log)
+  EchoSample filter[ECHO_FILTER_SIZE];
+  unsigned long received;
+  unsigned long invalid;
+  int64_t best_offset_us; // Offset filtrado vigente
+  DelayStats rtt;
+  DelayStats offset;
+  DelayStats forward; // t2 - t1 corregido por el offset filtrado
+  DelayStats reverse; // t4 - t3 corregido por el offset filtrado
+} EchoState;
+
+// Abrir el log (path puede ser NULL). Devuelve -1 con errno.
+int echo_init(EchoState *es, const char *path);
+
+// Leer sin bloquear todos los ecos disponibles en el socket (stream, o
+// datagramas si es->datagrams). Devuelve 0, o -1 si el servidor cerró la
+// conexión o hubo un error.
+int echo_read(EchoState *es, int sockfd);
+
+void echo_print(const EchoState *es, unsigned long sent);
+
+void echo_close(EchoState *es);
+
+#endif
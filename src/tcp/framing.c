@@ -0,0 +1,228 @@
+#include "framing.h"
+
+#include <arpa/inet.h>
+#include <string.h>
+
+#include "common.h"
+
+#define RING_MASK (RING_SIZE - 1)
+
+static uint32_t ring_used(const Ring *r) { return r->tail - r->head; }
+
+// Copiar n bytes desde head + off, resolviendo la vuelta del ring
+static void ring_copy(const Ring *r, uint32_t off, void *dst, uint32_t n) {
+  uint32_t pos = (r->head + off) & RING_MASK;
+  uint32_t first = RING_SIZE - pos;
+  if (first >= n) {
+    memcpy(dst, r->buf + pos, n);
+  } else {
+    memcpy(dst, r->buf + pos, first);
+    memcpy((uint8_t *)dst + first, r->buf, n - first);
+  }
+}
+
+// Buscar byte en [head + from, head + to) con memchr (vectorizado en libc)
+// sobre a lo sumo dos tramos contiguos. Devuelve el offset desde head o -1.
+static int64_t ring_find(const Ring *r, uint32_t from, uint32_t to,
+                         uint8_t byte) {
+  while (from < to) {
+    uint32_t pos = (r->head + from) & RING_MASK;
+    uint32_t n = to - from;
+    if (n > RING_SIZE - pos) {
+      n = RING_SIZE - pos;
+    }
+    const uint8_t *hit = memchr(r->buf + pos, byte, n);
+    if (hit) {
+      return from + (uint32_t)(hit - (r->buf + pos));
+    }
+    from += n;
+  }
+  return -1;
+}
+
+void frame_parser_init(FrameParser *p) {
+  p->ring.head = 0;
+  p->ring.tail = 0;
+  p->version = FRAMING_UNKNOWN;
+  p->scanned = 0;
+  p->v1_seq = 0;
+}
+
+int frame_parser_iov(FrameParser *p, struct iovec iov[2]) {
+  Ring *r = &p->ring;
+  uint32_t free_bytes = RING_SIZE - ring_used(r);
+  if (free_bytes == 0) {
+    return 0;
+  }
+  uint32_t pos = r->tail & RING_MASK;
+  uint32_t first = RING_SIZE - pos;
+  if (first >= free_bytes) {
+    iov[0].iov_base = r->buf + pos;
+    iov[0].iov_len = free_bytes;
+    return 1;
+  }
+  iov[0].iov_base = r->buf + pos;
+  iov[0].iov_len = first;
+  iov[1].iov_base = r->buf;
+  iov[1].iov_len = free_bytes - first;
+  return 2;
+}
+
+void frame_parser_commit(FrameParser *p, size_t n) {
+  p->ring.tail += (uint32_t)n;
+}
+
+static void consume(FrameParser *p, uint32_t n) {
+  p->ring.head += n;
+  p->scanned = 0;
+}
+
+static FrameResult next_v1(FrameParser *p, ProbePdu *pdu) {
+  const Ring *r = &p->ring;
+  uint32_t used = ring_used(r);
+
+  // El delimitador válido está entre MIN y MAX: un '|' antes de
+  // V1_MIN_PDU_SIZE es un byte del timestamp o del payload mínimo
+  uint32_t from = V1_MIN_PDU_SIZE - 1;
+  if (p->scanned > from) {
+    from = p->scanned;
+  }
+  uint32_t to = used < V1_MAX_PDU_SIZE ? used : V1_MAX_PDU_SIZE;
+  int64_t delim = ring_find(r, from, to, V1_DELIMITER);
+  if (delim >= 0) {
+    uint64_t ts_net;
+    ring_copy(r, 0, &ts_net, sizeof(ts_net));
+    pdu->origin_ts = ntoh64(ts_net);
+    pdu->seq = p->v1_seq++;
+    pdu->len = (uint32_t)delim + 1;
+    pdu->flags = 0;
+    pdu->send_interval_us = 0;
+    consume(p, pdu->len);
+    return FRAME_OK;
+  }
+  if (used < V1_MAX_PDU_SIZE) {
+    p->scanned = to; // La próxima vez seguir desde acá
+    return FRAME_NEED_MORE;
+  }
+
+  // PDU demasiado larga: descartar hasta el próximo '|' para resincronizar
+  delim = ring_find(r, V1_MAX_PDU_SIZE, used, V1_DELIMITER);
+  pdu->len = delim >= 0 ? (uint32_t)delim + 1 : used;
+  consume(p, pdu->len);
+  return FRAME_INVALID;
+}
+
+// Validar un header v2; devuelve la longitud del body o -1
+static int64_t v2_header(const uint8_t hdr[V2_HDR_SIZE]) {
+  uint16_t magic = (uint16_t)(hdr[0] << 8 | hdr[1]);
+  uint32_t length;
+  memcpy(&length, hdr + 4, sizeof(length));
+  length = ntohl(length);
+  int echo_reply = (hdr[3] & V2_FLAG_ECHO_REPLY) != 0;
+  if (magic != V2_MAGIC || hdr[2] != V2_VERSION ||
+      (echo_reply ? length != V2_ECHO_BODY
+                  : length < V2_MIN_BODY || length > V2_MAX_BODY)) {
+    return -1;
+  }
+  return length;
+}
+
+// Bytes del principio del body que hacen falta para llenar la ProbePdu
+#define V2_BODY_PREFIX 24
+
+// Completar pdu con el header y los primeros V2_BODY_PREFIX bytes del body
+static void v2_fill(ProbePdu *pdu, const uint8_t hdr[V2_HDR_SIZE],
+                    const uint8_t body[V2_BODY_PREFIX], uint32_t length) {
+  uint8_t flags = hdr[3];
+  uint32_t seq;
+  memcpy(&seq, hdr + 8, sizeof(seq));
+  uint64_t ts_net[3];
+  memcpy(ts_net, body, sizeof(ts_net));
+  int echo_reply = (flags & V2_FLAG_ECHO_REPLY) != 0;
+  pdu->origin_ts = ntoh64(ts_net[0]);
+  pdu->echo_rx_ts = echo_reply ? ntoh64(ts_net[1]) : 0;
+  pdu->echo_tx_ts = echo_reply ? ntoh64(ts_net[2]) : 0;
+  pdu->send_interval_us = 0;
+  if (!echo_reply && (flags & V2_FLAG_INTERVAL)) {
+    uint32_t interval_net;
+    memcpy(&interval_net, body + 8, sizeof(interval_net));
+    pdu->send_interval_us = ntohl(interval_net);
+  }
+  pdu->flags = flags;
+  pdu->seq = ntohl(seq);
+  pdu->len = V2_HDR_SIZE + length;
+}
+
+static FrameResult next_v2(FrameParser *p, ProbePdu *pdu) {
+  const Ring *r = &p->ring;
+  uint32_t used = ring_used(r);
+  if (used < V2_HDR_SIZE) {
+    return FRAME_NEED_MORE;
+  }
+
+  uint8_t hdr[V2_HDR_SIZE];
+  ring_copy(r, 0, hdr, sizeof(hdr));
+  int64_t length = v2_header(hdr);
+  if (length < 0) {
+    return FRAME_FATAL;
+  }
+  if (used < V2_HDR_SIZE + length) {
+    return FRAME_NEED_MORE;
+  }
+
+  // Todo body válido tiene al menos V2_BODY_PREFIX bytes (el de eco justo)
+  uint8_t body[V2_BODY_PREFIX];
+  ring_copy(r, V2_HDR_SIZE, body, sizeof(body));
+  v2_fill(pdu, hdr, body, (uint32_t)length);
+  consume(p, pdu->len);
+  return FRAME_OK;
+}
+
+FrameResult frame_v2_datagram(const uint8_t *buf, size_t len, ProbePdu *pdu) {
+  if (len < V2_HDR_SIZE) {
+    return FRAME_INVALID;
+  }
+  int64_t length = v2_header(buf);
+  if (length < 0 || len != V2_HDR_SIZE + (size_t)length) {
+    return FRAME_INVALID;
+  }
+  v2_fill(pdu, buf, buf + V2_HDR_SIZE, (uint32_t)length);
+  return FRAME_OK;
+}
+
+FrameResult frame_parser_next(FrameParser *p, ProbePdu *pdu) {
+  if (p->version == FRAMING_UNKNOWN) {
+    if (ring_used(&p->ring) < 2) {
+      return FRAME_NEED_MORE;
+    }
+    uint8_t magic[2];
+    ring_copy(&p->ring, 0, magic, sizeof(magic));
+    p->version = ((magic[0] << 8 | magic[1]) == V2_MAGIC) ? FRAMING_V2
+                                                          : FRAMING_V1;
+  }
+  return p->version == FRAMING_V2 ? next_v2(p, pdu) : next_v1(p, pdu);
+}
+
+void frame_v2_header(uint8_t out[V2_HDR_SIZE], uint32_t body_len, uint32_t seq,
+                     uint8_t flags) {
+  uint32_t length_net = htonl(body_len);
+  uint32_t seq_net = htonl(seq);
+  out[0] = V2_MAGIC >> 8;
+  out[1] = V2_MAGIC & 0xFF;
+  out[2] = V2_VERSION;
+  out[3] = flags;
+  memcpy(out + 4, &length_net, sizeof(length_net));
+  memcpy(out + 8, &seq_net, sizeof(seq_net));
+}
+
+void frame_v2_interval(uint8_t *payload, uint32_t interval_us) {
+  uint32_t interval_net = htonl(interval_us);
+  memcpy(payload, &interval_net, sizeof(interval_net));
+}
+
+void frame_v2_echo(uint8_t out[V2_ECHO_SIZE], uint32_t seq, uint64_t t1,
+                   uint64_t t2, uint64_t t3) {
+  frame_v2_header(out, V2_ECHO_BODY, seq, V2_FLAG_ECHO_REPLY);
+  uint64_t ts_net[3] = {hton64(t1), hton64(t2), hton64(t3)};
+  memcpy(out + V2_HDR_SIZE, ts_net, sizeof(ts_net));
+}
@@ -0,0 +1,110 @@
+#ifndef TCP_FRAMING_H
+#define TCP_FRAMING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#define MIN_PAYLOAD_SIZE 500
+#define MAX_PAYLOAD_SIZE 1000
+
+// v1: [timestamp 8][payload][delimitador '|']
+#define V1_DELIMITER '|'
+#define V1_MIN_PDU_SIZE (8 + MIN_PAYLOAD_SIZE + 1)
+#define V1_MAX_PDU_SIZE (8 + MAX_PAYLOAD_SIZE + 1)
+
+// v2: [header 12][timestamp 8][payload], enteros en network byte order
+//   magic   u16  "TP"
+//   version u8   2
+//   flags   u8   V2_FLAG_*
+//   length  u32  bytes después del header (timestamp + payload)
+//   seq     u32  número de PDU en la conexión, empieza en 0
+// El primer byte de un stream v1 es el byte alto del timestamp (0x00 para
+// cualquier fecha razonable), así que el servidor distingue la versión
+// mirando los dos primeros bytes de cada conexión: no hace falta handshake.
+#define V2_MAGIC 0x5450
+#define V2_VERSION 2
+#define V2_HDR_SIZE 12
+#define V2_MIN_BODY (8 + MIN_PAYLOAD_SIZE)
+#define V2_MAX_BODY (8 + MAX_PAYLOAD_SIZE)
+#define V2_MAX_PDU_SIZE (V2_HDR_SIZE + V2_MAX_BODY)
+
+// Modo eco (estilo NTP): el cliente marca la PDU con V2_FLAG_ECHO y el
+// servidor responde por la misma conexión con un header con
+// V2_FLAG_ECHO_REPLY y el mismo seq, seguido de tres timestamps:
+//   t1 origen del cliente, t2 recepción en el servidor, t3 envío del eco
+#define V2_FLAG_ECHO 0x01
+#define V2_FLAG_ECHO_REPLY 0x02
+#define V2_ECHO_BODY 24
+#define V2_ECHO_SIZE (V2_HDR_SIZE + V2_ECHO_BODY)
+
+// Los primeros 4 bytes del payload (u32) son el intervalo de envío que el
+// cliente tenía programado, en microsegundos. Con él el servidor distingue
+// un envío demorado de una llegada demorada. Un servidor que no conoce el
+// flag los toma como payload.
+#define V2_FLAG_INTERVAL 0x04
+
+// Ring de recepción por conexión (potencia de 2, entran varias PDUs máximas)
+#define RING_SIZE 4096
+
+typedef struct {
+  uint8_t buf[RING_SIZE];
+  uint32_t head; // Contadores libres: ocupado = tail - head, índice = & mask
+  uint32_t tail;
+} Ring;
+
+typedef enum { FRAMING_UNKNOWN, FRAMING_V1, FRAMING_V2 } FramingVersion;
+
+typedef enum {
+  FRAME_NEED_MORE, // No hay PDU completa en el ring
+  FRAME_OK,        // *pdu válida, ya consumida
+  FRAME_INVALID,   // PDU descartada; el parser sigue sincronizado
+  FRAME_FATAL      // Header v2 inválido: se perdió el framing
+} FrameResult;
+
+typedef struct {
+  uint64_t origin_ts;  // Microsegundos, tal como lo puso el cliente
+  uint32_t seq;        // v2: del header; v1: contador local de la conexión
+  uint32_t len;        // Bytes de la PDU en el stream
+  uint8_t flags;       // v2: flags del header
+  uint32_t send_interval_us; // V2_FLAG_INTERVAL (0 = no informado)
+  uint64_t echo_rx_ts; // Eco: t2 (origin_ts es t1)
+  uint64_t echo_tx_ts; // Eco: t3
+} ProbePdu;
+
+typedef struct {
+  Ring ring;
+  FramingVersion version;
+  uint32_t scanned; // v1: bytes desde head ya revisados buscando '|'
+  uint32_t v1_seq;
+} FrameParser;
+
+void frame_parser_init(FrameParser *p);
+
+// Espacio libre del ring como (hasta) dos iovec para readv(); devuelve
+// cuántos se usaron (0 = ring lleno)
+int frame_parser_iov(FrameParser *p, struct iovec iov[2]);
+
+// Registrar n bytes recibidos en el espacio devuelto por frame_parser_iov
+void frame_parser_commit(FrameParser *p, size_t n);
+
+// Extraer la siguiente PDU. Se parsea en el lugar: solo se copian el header y
+// el timestamp, el payload se saltea avanzando head.
+FrameResult frame_parser_next(FrameParser *p, ProbePdu *pdu);
+
+// Validar y extraer una PDU v2 que ocupa exactamente un datagrama UDP de len
+// bytes (FRAME_OK o FRAME_INVALID)
+FrameResult frame_v2_datagram(const uint8_t *buf, size_t len, ProbePdu *pdu);
+
+// Escribir el header v2 de una PDU con body_len bytes de timestamp + payload
+void frame_v2_header(uint8_t out[V2_HDR_SIZE], uint32_t body_len, uint32_t seq,
+                     uint8_t flags);
+
+// Escribir el intervalo de V2_FLAG_INTERVAL al principio del payload
+void frame_v2_interval(uint8_t *payload, uint32_t interval_us);
+
+// Armar la respuesta de eco completa (V2_ECHO_SIZE bytes)
+void frame_v2_echo(uint8_t out[V2_ECHO_SIZE], uint32_t seq, uint64_t t1,
+                   uint64_t t2, uint64_t t3);
+
+#endif
@@ -0,0 +1,652 @@
+#include "load.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "delay_stats.h"
+#include "framing.h"
+#include "pacer.h"
+
+#define EPOLL_BATCH 256
+#define TIMER_TAG UINT32_MAX      // data.u32 del timerfd en epoll
+#define STOP_TAG (UINT32_MAX - 1) // data.u32 del eventfd de Ctrl+C
+
+// Lo que cambia en cada PDU (header v2, timestamp e intervalo) se arma
+// aparte; el resto del payload sale siempre del mismo buffer
+#define LOAD_HEAD_SIZE (V2_HDR_SIZE + 8 + 4)
+
+// Slots de la agenda de cada conexión: cada una envía a 1/c de la tasa
+// agregada, y con SCHEDULE_REFILL por envío alcanza de sobra. Con el ring
+// de una conexión sola serían 16 KiB por conexión.
+#define LOAD_SCHEDULE_SIZE 32
+
+typedef struct {
+  int fd; // -1 una vez cerrada
+  uint32_t id;
+  uint16_t local_port; // Para encontrarla en la salida del servidor
+  int sched_done;      // Ya salió el último slot dentro de la duración
+  int failed;
+  int want_write; // Registrada con EPOLLOUT
+  uint64_t phase_ns;
+  uint64_t next_ns; // Deadline del próximo slot
+  ScheduleSlot slot;
+  uint32_t seq;
+  // Lo que un writev() no llegó a escribir; hasta vaciarlo no se arman más
+  // PDUs (salen tarde y el retraso lo registra)
+  uint8_t *pending;
+  size_t pending_len;
+  size_t pending_off;
+  unsigned long sent;
+  unsigned long late_slots;
+  double lateness_sum_us;
+  int64_t lateness_max_us;
+  Schedule sched;
+} LoadConn;
+
+// Próximo deadline de una conexión, en un min-heap por hilo. Cada conexión
+// que espera su próximo slot tiene una sola entrada; las que esperan
+// EPOLLOUT o ya se cerraron no tienen ninguna, así que el hilo solo visita
+// las vencidas y las que tienen eventos.
+typedef struct {
+  uint64_t deadline_ns;
+  uint32_t conn;
+} TimerEntry;
+
+typedef struct {
+  pthread_t thread;
+  LoadConn *conns;
+  uint32_t count;
+  uint32_t active;
+  int epfd;
+  int timerfd;
+  uint64_t armed_ns; // Deadline programado en el timerfd (0 = desarmado)
+  TimerEntry *timers; // Min-heap por deadline_ns, capacidad count
+  uint32_t ntimers;
+  uint8_t heads[LOAD_MAX_BATCH][LOAD_HEAD_SIZE];
+  struct iovec iov[2 * LOAD_MAX_BATCH];
+  unsigned long sent; // Lo lee el hilo principal para el progreso
+  unsigned long writes;
+  unsigned long partial_writes;
+  unsigned long late_slots;
+  DelayStats lateness; // Base 0 en todos los hilos: se pueden combinar
+  int finished;
+} LoadWorker;
+
+static const LoadConfig *cfg;
+static volatile sig_atomic_t *running;
+static uint64_t start_ns;
+static int stop_fd = -1;
+// Payload sintético, solo lectura: espacios y el delimitador v1 al final
+static uint8_t pad[MAX_PAYLOAD_SIZE + 1];
+
+// Un descriptor por conexión: subir el límite blando hasta el duro
+static void raise_fd_limit(void) {
+  struct rlimit rl;
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+    rl.rlim_cur = rl.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &rl) < 0) {
+      perror("setrlimit");
+    }
+  }
+}
+
+static void set_want_write(LoadWorker *w, LoadConn *c, int want) {
+  if (c->want_write == want) {
+    return;
+  }
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = want ? EPOLLOUT : 0; // EPOLLERR / EPOLLHUP llegan siempre
+  ev.data.u32 = (uint32_t)(c - w->conns);
+  if (epoll_ctl(w->epfd, EPOLL_CTL_MOD, c->fd, &ev) == 0) {
+    c->want_write = want;
+  }
+}
+
+static void close_conn(LoadWorker *w, LoadConn *c, int failed) {
+  free(c->pending);
+  c->pending = NULL;
+  c->pending_len = 0;
+  epoll_ctl(w->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+  close(c->fd);
+  c->fd = -1;
+  c->failed = failed;
+  w->active--;
+}
+
+// Guardar lo que quedó sin escribir de los iovec a partir de written
+static int save_pending(LoadConn *c, const struct iovec *iov, int iovcnt,
+                        size_t written, size_t total) {
+  c->pending = malloc(total - written);
+  if (!c->pending) {
+    return -1;
+  }
+  c->pending_len = total - written;
+  c->pending_off = 0;
+  size_t out = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    size_t len = iov[i].iov_len;
+    if (written >= len) {
+      written -= len;
+      continue;
+    }
+    memcpy(c->pending + out, (uint8_t *)iov[i].iov_base + written,
+           len - written);
+    out += len - written;
+    written = 0;
+  }
+  return 0;
+}
+
+// Escribir lo pendiente sin bloquear. -1 si la conexión falló.
+static int flush_pending(LoadWorker *w, LoadConn *c) {
+  while (c->pending_off < c->pending_len) {
+    ssize_t n = send(c->fd, c->pending + c->pending_off,
+                     c->pending_len - c->pending_off, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        set_want_write(w, c, 1);
+        return 0;
+      }
+      return -1;
+    }
+    c->pending_off += (size_t)n;
+  }
+  free(c->pending);
+  c->pending = NULL;
+  c->pending_len = 0;
+  set_want_write(w, c, 0);
+  return 0;
+}
+
+static void next_slot(LoadConn *c) {
+  c->slot = schedule_next(&c->sched);
+  c->next_ns = start_ns + c->phase_ns + c->slot.offset_ns;
+  if (c->slot.offset_ns >= cfg->duration_ns) {
+    c->sched_done = 1;
+  }
+}
+
+// Armar las PDUs ya vencidas de la conexión y mandarlas en un writev(). El
+// origin timestamp es el mismo para todas: salen juntas.
+static void send_due(LoadWorker *w, LoadConn *c) {
+  uint64_t now = pacer_now_ns();
+  uint64_t origin_net = hton64(current_time_micros());
+  int n = 0;
+  size_t total = 0;
+  while (n < LOAD_MAX_BATCH && !c->sched_done && c->next_ns <= now) {
+    uint8_t *head = w->heads[n];
+    uint32_t payload = c->slot.payload;
+    struct iovec *iov = &w->iov[2 * n];
+    if (cfg->version == 2) {
+      frame_v2_header(head, 8 + payload, c->seq, V2_FLAG_INTERVAL);
+      memcpy(head + V2_HDR_SIZE, &origin_net, 8);
+      frame_v2_interval(head + V2_HDR_SIZE + 8, c->slot.interval_us);
+      iov[0].iov_len = LOAD_HEAD_SIZE;
+      iov[1].iov_base = pad;
+      iov[1].iov_len = payload - 4;
+    } else {
+      memcpy(head, &origin_net, 8);
+      iov[0].iov_len = 8;
+      iov[1].iov_base = pad + MAX_PAYLOAD_SIZE - payload;
+      iov[1].iov_len = payload + 1;
+    }
+    iov[0].iov_base = head;
+    total += iov[0].iov_len + iov[1].iov_len;
+
+    int64_t late_us = (int64_t)(now - c->next_ns) / 1000;
+    delay_stats_record(&w->lateness, late_us);
+    c->lateness_sum_us += (double)late_us;
+    if (late_us > c->lateness_max_us) {
+      c->lateness_max_us = late_us;
+    }
+    if ((uint64_t)late_us > c->slot.interval_us) {
+      c->late_slots++;
+      w->late_slots++;
+    }
+    c->seq++;
+    c->sent++;
+    n++;
+    next_slot(c);
+  }
+  if (n == 0) {
+    return;
+  }
+  __atomic_store_n(&w->sent, w->sent + (unsigned long)n, __ATOMIC_RELAXED);
+
+  w->writes++;
+  ssize_t written = writev(c->fd, w->iov, 2 * n);
+  if (written < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      fprintf(stderr, "Conexión %u: writev: %s\n", c->id, strerror(errno));
+      close_conn(w, c, 1);
+      return;
+    }
+    written = 0;
+  }
+  if ((size_t)written < total) {
+    w->partial_writes++;
+    if (save_pending(c, w->iov, 2 * n, (size_t)written, total) < 0) {
+      perror("malloc");
+      close_conn(w, c, 1);
+      return;
+    }
+    set_want_write(w, c, 1);
+  }
+  schedule_fill(&c->sched, SCHEDULE_REFILL);
+}
+
+static void timer_push(LoadWorker *w, uint64_t deadline_ns, uint32_t conn) {
+  TimerEntry *h = w->timers;
+  uint32_t i = w->ntimers++;
+  while (i > 0 && h[(i - 1) / 2].deadline_ns > deadline_ns) {
+    h[i] = h[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  h[i].deadline_ns = deadline_ns;
+  h[i].conn = conn;
+}
+
+static TimerEntry timer_pop(LoadWorker *w) {
+  TimerEntry *h = w->timers;
+  TimerEntry top = h[0];
+  TimerEntry last = h[--w->ntimers];
+  uint32_t i = 0;
+  while (2 * i + 1 < w->ntimers) {
+    uint32_t child = 2 * i + 1;
+    if (child + 1 < w->ntimers &&
+        h[child + 1].deadline_ns < h[child].deadline_ns) {
+      child++;
+    }
+    if (last.deadline_ns <= h[child].deadline_ns) {
+      break;
+    }
+    h[i] = h[child];
+    i = child;
+  }
+  h[i] = last;
+  return top;
+}
+
+// Mandar lo vencido de la conexión y, si no quedó esperando EPOLLOUT,
+// cerrarla al terminar su agenda o volver a agendarla
+static void serve_conn(LoadWorker *w, LoadConn *c) {
+  send_due(w, c);
+  if (c->fd < 0 || c->pending) {
+    return;
+  }
+  if (c->sched_done) {
+    close_conn(w, c, 0);
+  } else {
+    timer_push(w, c->next_ns, (uint32_t)(c - w->conns));
+  }
+}
+
+// Programar el timerfd para el deadline más próximo del heap
+static void arm_timer(LoadWorker *w) {
+  uint64_t next = w->ntimers ? w->timers[0].deadline_ns : 0;
+  if (next == w->armed_ns) {
+    return;
+  }
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = (time_t)(next / 1000000000ULL);
+  its.it_value.tv_nsec = (long)(next % 1000000000ULL);
+  if (timerfd_settime(w->timerfd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+    perror("timerfd_settime");
+  }
+  w->armed_ns = next;
+}
+
+static void *worker_main(void *arg) {
+  LoadWorker *w = arg;
+  struct epoll_event events[EPOLL_BATCH];
+  for (uint32_t i = 0; i < w->count; i++) {
+    timer_push(w, w->conns[i].next_ns, i);
+  }
+  while (w->active > 0 && *running) {
+    // Atender solo las conexiones vencidas
+    uint64_t now = pacer_now_ns();
+    while (w->ntimers > 0 && w->timers[0].deadline_ns <= now) {
+      LoadConn *c = &w->conns[timer_pop(w).conn];
+      if (c->fd >= 0) {
+        serve_conn(w, c);
+      }
+    }
+    if (w->active == 0) {
+      break;
+    }
+    arm_timer(w);
+
+    int n = epoll_wait(w->epfd, events, EPOLL_BATCH, -1);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("epoll_wait");
+      break;
+    }
+    for (int k = 0; k < n; k++) {
+      uint32_t tag = events[k].data.u32;
+      if (tag == TIMER_TAG) {
+        uint64_t expirations;
+        if (read(w->timerfd, &expirations, sizeof(expirations)) < 0) {
+          // Nada: EAGAIN si ya se leyó
+        }
+        w->armed_ns = 0;
+        continue;
+      }
+      if (tag == STOP_TAG) {
+        continue; // *running ya está en 0
+      }
+      LoadConn *c = &w->conns[tag];
+      if (c->fd < 0) {
+        continue;
+      }
+      if (events[k].events & (EPOLLERR | EPOLLHUP)) {
+        fprintf(stderr, "Conexión %u cerrada por el servidor\n", c->id);
+        close_conn(w, c, 1);
+      } else if ((events[k].events & EPOLLOUT) && c->pending) {
+        if (flush_pending(w, c) < 0) {
+          fprintf(stderr, "Conexión %u: send: %s\n", c->id, strerror(errno));
+          close_conn(w, c, 1);
+        } else if (!c->pending) {
+          serve_conn(w, c); // Se vació: lo atrasado sale ahora
+        }
+      }
+    }
+  }
+  __atomic_store_n(&w->finished, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+// Conectar la conexión id y registrarla en el epoll de su hilo
+static int open_conn(LoadWorker *w, LoadConn *c, uint32_t id) {
+  c->id = id;
+  c->fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (c->fd < 0) {
+    perror("socket");
+    return -1;
+  }
+  if (connect(c->fd, (const struct sockaddr *)&cfg->server,
+              sizeof(cfg->server)) < 0) {
+    fprintf(stderr, "Conexión %u: connect: %s\n", id, strerror(errno));
+    close(c->fd);
+    c->fd = -1;
+    return -1;
+  }
+  // Las PDUs se juntan en writev() a propósito: que Nagle no las demore
+  int nodelay = 1;
+  setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+  int flags = fcntl(c->fd, F_GETFL, 0);
+  fcntl(c->fd, F_SETFL, flags | O_NONBLOCK);
+  struct sockaddr_in local;
+  socklen_t local_len = sizeof(local);
+  if (getsockname(c->fd, (struct sockaddr *)&local, &local_len) == 0) {
+    c->local_port = ntohs(local.sin_port);
+  }
+
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = 0;
+  ev.data.u32 = (uint32_t)(c - w->conns);
+  if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, c->fd, &ev) < 0) {
+    perror("epoll_ctl");
+    close(c->fd);
+    c->fd = -1;
+    return -1;
+  }
+  w->active++;
+
+  // Misma configuración, otra semilla, y desfasada 1/c del intervalo medio
+  // de la anterior: la carga agregada sale pareja
+  if (schedule_init_like(&c->sched, cfg->model, cfg->model->cfg.seed + id,
+                         LOAD_SCHEDULE_SIZE) < 0) {
+    perror("malloc");
+    return -1;
+  }
+  c->phase_ns = cfg->model->mean_ns * id / (uint64_t)cfg->connections;
+  c->lateness_max_us = 0;
+  return 0;
+}
+
+static int worker_init(LoadWorker *w, uint32_t count) {
+  memset(w, 0, sizeof(*w));
+  w->count = count;
+  delay_stats_init_base(&w->lateness, 0);
+  w->conns = calloc(count, sizeof(LoadConn));
+  w->timers = malloc(count * sizeof(TimerEntry));
+  w->epfd = epoll_create1(0);
+  w->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  if (!w->conns || (count > 0 && !w->timers) || w->epfd < 0 ||
+      w->timerfd < 0) {
+    perror("worker_init");
+    return -1;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    w->conns[i].fd = -1;
+  }
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.u32 = TIMER_TAG;
+  if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->timerfd, &ev) < 0) {
+    perror("epoll_ctl timerfd");
+    return -1;
+  }
+  ev.data.u32 = STOP_TAG;
+  if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, stop_fd, &ev) < 0) {
+    perror("epoll_ctl eventfd");
+    return -1;
+  }
+  return 0;
+}
+
+static void worker_free(LoadWorker *w) {
+  for (uint32_t i = 0; w->conns && i < w->count; i++) {
+    LoadConn *c = &w->conns[i];
+    if (c->fd >= 0) {
+      close(c->fd);
+    }
+    free(c->pending);
+    schedule_free(&c->sched);
+  }
+  free(w->conns);
+  free(w->timers);
+  if (w->epfd >= 0) {
+    close(w->epfd);
+  }
+  if (w->timerfd >= 0) {
+    close(w->timerfd);
+  }
+}
+
+static unsigned long total_sent(LoadWorker *workers, int n) {
+  unsigned long sent = 0;
+  for (int t = 0; t < n; t++) {
+    sent += __atomic_load_n(&workers[t].sent, __ATOMIC_RELAXED);
+  }
+  return sent;
+}
+
+static int all_finished(LoadWorker *workers, int n) {
+  for (int t = 0; t < n; t++) {
+    if (!__atomic_load_n(&workers[t].finished, __ATOMIC_ACQUIRE)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void print_report(LoadWorker *workers, double total_time_s) {
+  static DelayStats lateness; // Grande para la pila
+  delay_stats_init_base(&lateness, 0);
+  unsigned long sent = 0, writes = 0, partial = 0, late = 0;
+  int failed = 0;
+
+  printf("\n=== Conexiones ===\n");
+  for (int t = 0; t < cfg->threads; t++) {
+    LoadWorker *w = &workers[t];
+    for (uint32_t i = 0; i < w->count; i++) {
+      const LoadConn *c = &w->conns[i];
+      printf("Conexión %u (puerto local %u): %lu PDUs, %.1f PDUs/s, retraso "
+             "medio %.1f us, máx %lld us, %lu con más de un intervalo de "
+             "retraso%s\n",
+             c->id, c->local_port, c->sent,
+             total_time_s > 0 ? c->sent / total_time_s : 0.0,
+             c->sent ? c->lateness_sum_us / (double)c->sent : 0.0,
+             (long long)c->lateness_max_us, c->late_slots,
+             c->failed ? " CON ERROR" : "");
+      failed += c->failed;
+    }
+    delay_stats_merge(&lateness, &w->lateness);
+    sent += w->sent;
+    writes += w->writes;
+    partial += w->partial_writes;
+    late += w->late_slots;
+  }
+
+  printf("\n=== Estadísticas del cliente ===\n");
+  printf("Conexiones: %d en %d hilos (%d con error)\n", cfg->connections,
+         cfg->threads, failed);
+  printf("PDUs enviadas: %lu\n", sent);
+  printf("Tiempo total: %.2f s\n", total_time_s);
+  if (total_time_s > 0) {
+    printf("Tasa agregada: %.2f PDUs/s (objetivo %.2f)\n",
+           sent / total_time_s,
+           1e9 * cfg->connections / (double)cfg->model->mean_ns);
+  }
+  printf("writev(): %lu llamadas, %.2f PDUs por llamada, %lu parciales\n",
+         writes, writes ? (double)sent / (double)writes : 0.0, partial);
+  delay_stats_print(&lateness, stdout, "Retraso sobre la agenda: ");
+  printf("Envíos con más de un intervalo de retraso: %lu\n", late);
+}
+
+int load_run(const LoadConfig *config, volatile sig_atomic_t *run) {
+  cfg = config;
+  running = run;
+  memset(pad, 0x20, MAX_PAYLOAD_SIZE);
+  pad[MAX_PAYLOAD_SIZE] = V1_DELIMITER;
+  raise_fd_limit();
+  // Un servidor que se cae no tiene que matar las demás conexiones: writev()
+  // devuelve EPIPE y se cierra solo esa
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = SIG_IGN;
+  sigaction(SIGPIPE, &sa, NULL);
+
+  stop_fd = eventfd(0, EFD_NONBLOCK);
+  LoadWorker *workers = calloc((size_t)cfg->threads, sizeof(LoadWorker));
+  if (stop_fd < 0 || !workers) {
+    perror("load_run");
+    return -1;
+  }
+
+  // Repartir las conexiones en partes iguales y conectarlas todas antes de
+  // empezar, así la agenda no incluye el handshake
+  printf("Conectando %d conexiones...\n", cfg->connections);
+  uint32_t id = 0;
+  int result = 0;
+  for (int t = 0; t < cfg->threads && result == 0; t++) {
+    uint32_t count =
+        (uint32_t)(cfg->connections / cfg->threads +
+                   (t < cfg->connections % cfg->threads));
+    if (worker_init(&workers[t], count) < 0) {
+      result = -1;
+      break;
+    }
+    for (uint32_t i = 0; i < count && *running; i++) {
+      if (open_conn(&workers[t], &workers[t].conns[i], id++) < 0) {
+        result = -1;
+        break;
+      }
+    }
+  }
+  if (result < 0 || !*running) {
+    for (int t = 0; t < cfg->threads; t++) {
+      worker_free(&workers[t]);
+    }
+    free(workers);
+    close(stop_fd);
+    return -1;
+  }
+
+  printf("Comenzando a enviar PDUs...\n");
+  printf("Presione Ctrl+C para terminar anticipadamente.\n\n");
+  // Las señales las atiende este hilo
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  start_ns = pacer_now_ns();
+  int started = 0;
+  for (int t = 0; t < cfg->threads; t++) {
+    LoadWorker *w = &workers[t];
+    for (uint32_t i = 0; i < w->count; i++) {
+      next_slot(&w->conns[i]);
+    }
+    if (pthread_create(&w->thread, NULL, worker_main, w) != 0) {
+      perror("pthread_create");
+      *running = 0;
+      result = -1;
+      break;
+    }
+    started++;
+  }
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  // Progreso una vez por segundo, hasta que terminen todos los hilos
+  uint64_t next_progress_ns = start_ns + 1000000000ULL;
+  unsigned long last_sent = 0;
+  while (!all_finished(workers, started)) {
+    if (!*running) {
+      // Despertar a los hilos que estén esperando un deadline lejano
+      uint64_t one = 1;
+      if (write(stop_fd, &one, sizeof(one)) < 0) {
+        perror("eventfd");
+      }
+      break;
+    }
+    struct timespec ts = {0, 50000000};
+    nanosleep(&ts, NULL);
+    uint64_t now = pacer_now_ns();
+    if (now >= next_progress_ns) {
+      unsigned long sent = total_sent(workers, started);
+      printf("PDUs enviadas: %lu (tiempo: %.1f s, %lu PDUs/s)\n", sent,
+             (now - start_ns) / 1e9, sent - last_sent);
+      last_sent = sent;
+      next_progress_ns += 1000000000ULL;
+    }
+  }
+  for (int t = 0; t < started; t++) {
+    pthread_join(workers[t].thread, NULL);
+  }
+  double total_time_s = (pacer_now_ns() - start_ns) / 1e9;
+
+  print_report(workers, total_time_s);
+  for (int t = 0; t < cfg->threads; t++) {
+    for (uint32_t i = 0; i < workers[t].count; i++) {
+      result |= -workers[t].conns[i].failed;
+    }
+    worker_free(&workers[t]);
+  }
+  free(workers);
+  close(stop_fd);
+  return result < 0 ? -1 : 0;
+}
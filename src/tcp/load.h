@@ -0,0 +1,36 @@
+#ifndef TCP_LOAD_H
+#define TCP_LOAD_H
+
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdint.h>
+
+#include "schedule.h"
+
+// Modo de carga de tcp_client (-c / -t): muchas conexiones en paralelo
+// repartidas en unos pocos hilos, cada hilo con su epoll y un timerfd con el
+// deadline más próximo de sus conexiones (la cima de un min-heap, así que al
+// despertar no se recorren todas). Cada conexión sigue su propia
+// agenda (la de -d / -p / -z, con otra semilla y desfasada para que las
+// conexiones no salgan todas juntas), así que la tasa agregada es
+// conexiones / d. Las PDUs de una conexión que ya están vencidas al
+// despertar salen juntas en un solo writev().
+
+// PDUs por writev() como mucho (dos iovec por PDU)
+#define LOAD_MAX_BATCH 64
+
+typedef struct {
+  struct sockaddr_in server;
+  int connections;
+  int threads;
+  int version;
+  uint64_t duration_ns;
+  const Schedule *model; // Agenda base; cada conexión usa una parecida
+} LoadConfig;
+
+// Conectar, generar la carga hasta duration_ns o hasta que *running quede
+// en 0, e imprimir el reporte por conexión y agregado. Devuelve -1 si no se
+// pudo arrancar o alguna conexión terminó con error.
+int load_run(const LoadConfig *cfg, volatile sig_atomic_t *running);
+
+#endif
@@ -0,0 +1,74 @@
+#include "measlog.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Escribir todo el bloque (maneja escrituras parciales)
+static int write_all(int fd, const uint8_t *buf, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(fd, buf, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    buf += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+int measlog_open(MeasLog *log, const char *path) {
+  memset(log, 0, sizeof(*log));
+  log->buf = malloc(MEASLOG_BUF_SIZE);
+  if (!log->buf) {
+    return -1;
+  }
+  log->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (log->fd < 0) {
+    free(log->buf);
+    return -1;
+  }
+
+  MeasLogHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, MEASLOG_MAGIC, sizeof(hdr.magic));
+  hdr.version = MEASLOG_VERSION;
+  hdr.record_size = sizeof(MeasRecord);
+  memcpy(log->buf, &hdr, sizeof(hdr));
+  log->len = sizeof(hdr);
+  return 0;
+}
+
+void measlog_flush(MeasLog *log) {
+  if (log->len == 0) {
+    return;
+  }
+  if (write_all(log->fd, log->buf, log->len) < 0) {
+    // Se pierde el bloque; el error queda contado para el resumen final
+    perror("write log");
+    log->write_errors++;
+  }
+  log->len = 0;
+}
+
+void measlog_append(MeasLog *log, const MeasRecord *rec) {
+  if (log->len + sizeof(*rec) > MEASLOG_BUF_SIZE) {
+    measlog_flush(log);
+  }
+  memcpy(log->buf + log->len, rec, sizeof(*rec));
+  log->len += sizeof(*rec);
+  log->records++;
+}
+
+void measlog_close(MeasLog *log) {
+  measlog_flush(log);
+  close(log->fd);
+  free(log->buf);
+  log->buf = NULL;
+}
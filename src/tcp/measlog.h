@@ -0,0 +1,67 @@
+#ifndef TCP_MEASLOG_H
+#define TCP_MEASLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Log binario de mediciones: un header y registros de tamaño fijo, en el byte
+// order del host que lo escribió (el exportador detecta si no coincide).
+#define MEASLOG_MAGIC "OWDLOG\0"
+// Los campos nuevos se agregan al final del registro: v1 (skew_corr_us
+// siempre 0) y v2 tienen 32 bytes, v3 40 (hasta kernel_rx_ts).
+#define MEASLOG_VERSION 4
+
+// Buffer de escritura: con registros de 48 bytes son ~21k mediciones por
+// write()
+#define MEASLOG_BUF_SIZE (1 << 20)
+
+// Flags de MeasRecord
+#define MEASREC_CONN 0x01 // Alta de conexión: seq = IPv4, size = puerto
+// Eventos detectados al recibir la PDU (ver seqtrack.h)
+#define MEASREC_SEQ_GAP 0x02    // Faltan PDUs antes de esta
+#define MEASREC_REORDER 0x04    // seq menor que una ya recibida
+#define MEASREC_SEND_STALL 0x08 // Salió más de 2 intervalos después
+#define MEASREC_RECV_STALL 0x10 // Su delay creció más de un intervalo
+#define MEASREC_BURST 0x20      // Llegó pegada a la anterior
+#define MEASREC_DUP 0x40        // seq ya recibida (UDP)
+#define MEASREC_UDP 0x80        // Con MEASREC_CONN: flujo UDP, no conexión
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+} MeasLogHeader;
+
+typedef struct {
+  uint64_t origin_ts;   // Microsegundos, reloj del cliente
+  uint64_t dest_ts;     // Microsegundos, reloj del servidor
+  uint32_t seq;         // Número de PDU en la conexión
+  uint32_t conn;        // Id de conexión del servidor
+  uint16_t size;        // Bytes de la PDU en el stream
+  uint16_t flags;
+  int32_t skew_corr_us; // Skew estimado al registrar (deskewed = delay - esto)
+  uint64_t kernel_rx_ts; // Microsegundos, recepción según el kernel (0 = no)
+  uint32_t send_interval_us; // Intervalo programado por el cliente (0 = no)
+  uint32_t jitter_us;        // Jitter RFC 3550 de la conexión hasta acá
+} MeasRecord;
+
+typedef struct {
+  int fd;
+  uint8_t *buf;
+  size_t len;
+  unsigned long records;
+  unsigned long write_errors;
+} MeasLog;
+
+// Crear (truncar) el log y escribir el header. Devuelve -1 con errno.
+int measlog_open(MeasLog *log, const char *path);
+
+// Agregar un registro al buffer; se escribe al llenarse o en measlog_flush
+void measlog_append(MeasLog *log, const MeasRecord *rec);
+
+// Escribir lo que haya en el buffer
+void measlog_flush(MeasLog *log);
+
+void measlog_close(MeasLog *log);
+
+#endif
@@ -0,0 +1,111 @@
+#include "measring.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MEAS_RING_MASK (MEAS_RING_SIZE - 1)
+#define MEAS_MSG_MASK (MEAS_MSG_RING_SIZE - 1)
+#define MEAS_CLOSED_MASK (MEAS_CLOSED_RING_SIZE - 1)
+
+void meas_ring_init(MeasRing *r) {
+  r->tail = 0;
+  r->head = 0;
+  r->overruns = 0;
+  r->msg_tail = 0;
+  r->msg_head = 0;
+  r->msg_overruns = 0;
+  r->closed_tail = 0;
+  r->closed_head = 0;
+}
+
+int meas_ring_push(MeasRing *r, const MeasRecord *rec) {
+  uint32_t tail = r->tail; // Solo lo escribe este hilo
+  uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+  if (tail - head == MEAS_RING_SIZE) {
+    r->overruns++;
+    return -1;
+  }
+  r->recs[tail & MEAS_RING_MASK] = *rec;
+  __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+size_t meas_ring_pop(MeasRing *r, MeasRecord *out, size_t max) {
+  uint32_t head = r->head;
+  uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+  size_t n = tail - head;
+  if (n > max) {
+    n = max;
+  }
+  // A lo sumo dos tramos contiguos
+  uint32_t pos = head & MEAS_RING_MASK;
+  size_t first = MEAS_RING_SIZE - pos;
+  if (first > n) {
+    first = n;
+  }
+  memcpy(out, r->recs + pos, first * sizeof(MeasRecord));
+  memcpy(out + first, r->recs, (n - first) * sizeof(MeasRecord));
+  __atomic_store_n(&r->head, head + (uint32_t)n, __ATOMIC_RELEASE);
+  return n;
+}
+
+void meas_ring_printf(MeasRing *r, uint32_t conn, uint16_t flags,
+                      const char *fmt, ...) {
+  MeasRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  rec.conn = conn;
+  rec.flags = MEASREC_MSG | flags;
+
+  uint32_t tail = r->msg_tail;
+  uint32_t head = __atomic_load_n(&r->msg_head, __ATOMIC_ACQUIRE);
+  if (tail - head == MEAS_MSG_RING_SIZE) {
+    r->msg_overruns++;
+    return;
+  }
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(r->msgs[tail & MEAS_MSG_MASK], MEAS_MSG_LEN, fmt, ap);
+  va_end(ap);
+  rec.seq = tail;
+  __atomic_store_n(&r->msg_tail, tail + 1, __ATOMIC_RELEASE);
+  meas_ring_push(r, &rec);
+}
+
+int meas_ring_pop_msg(MeasRing *r, uint32_t upto, char out[MEAS_MSG_LEN]) {
+  uint32_t head = r->msg_head;
+  uint32_t tail = __atomic_load_n(&r->msg_tail, __ATOMIC_ACQUIRE);
+  if (head == tail || (int32_t)(upto - head) < 0) {
+    return 0;
+  }
+  memcpy(out, r->msgs[head & MEAS_MSG_MASK], MEAS_MSG_LEN);
+  __atomic_store_n(&r->msg_head, head + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+int meas_ring_push_closed(MeasRing *r, uint32_t conn) {
+  uint32_t tail = r->closed_tail;
+  uint32_t head = __atomic_load_n(&r->closed_head, __ATOMIC_ACQUIRE);
+  if (tail - head == MEAS_CLOSED_RING_SIZE) {
+    return -1;
+  }
+  r->closed[tail & MEAS_CLOSED_MASK].conn = conn;
+  r->closed[tail & MEAS_CLOSED_MASK].after = r->tail;
+  __atomic_store_n(&r->closed_tail, tail + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+int meas_ring_pop_closed(MeasRing *r, uint32_t *conn) {
+  uint32_t head = r->closed_head;
+  uint32_t tail = __atomic_load_n(&r->closed_tail, __ATOMIC_ACQUIRE);
+  if (head == tail) {
+    return 0;
+  }
+  const MeasClosed *e = &r->closed[head & MEAS_CLOSED_MASK];
+  if ((int32_t)(r->head - e->after) < 0) {
+    return 0; // Faltan registros anteriores a la baja
+  }
+  *conn = e->conn;
+  __atomic_store_n(&r->closed_head, head + 1, __ATOMIC_RELEASE);
+  return 1;
+}
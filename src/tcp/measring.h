@@ -0,0 +1,87 @@
+#ifndef TCP_MEASRING_H
+#define TCP_MEASRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "measlog.h"
+
+// Ring SPSC sin locks de registros del log, del hilo de recepción
+// (productor) al de persistencia (consumidor). Cada lado escribe solo su
+// contador y lee el del otro con acquire: los registros copiados antes de
+// publicar tail (release) ya son visibles para el consumidor, y los lugares
+// liberados antes de publicar head, para el productor. Con el ring lleno el
+// productor descarta el registro y lo cuenta: recibir nunca espera al disco.
+
+// Potencia de 2. Con registros de 48 bytes son 3 MiB: ~6 s a 10k PDUs/s
+#define MEAS_RING_SIZE (1 << 16)
+
+// Mensajes para la terminal (altas, bajas, avisos): el hilo de recepción los
+// formatea en una cola aparte y encola un registro MEASREC_MSG, así los
+// imprime el hilo de persistencia en orden con las mediciones. Estos flags
+// solo viajan por el ring, nunca llegan al log.
+#define MEAS_MSG_RING_SIZE 1024 // Potencia de 2
+#define MEAS_MSG_LEN 320        // Con '\n', a veces dos líneas
+#define MEASREC_MSG 0x8000      // seq = número de mensaje
+#define MEASREC_STDERR 0x4000   // Con MEASREC_MSG: a stderr
+
+// Bajas de conexiones, para que el hilo de persistencia libere su estado.
+// Van en una cola propia: no se pueden perder con el ring de registros
+// lleno. after es el tail del ring de registros al cerrar, así la baja se
+// entrega recién cuando ya se consumieron los registros anteriores.
+#define MEAS_CLOSED_RING_SIZE 4096 // Potencia de 2
+
+typedef struct {
+  uint32_t conn;
+  uint32_t after;
+} MeasClosed;
+
+typedef struct {
+  uint32_t tail; // Contadores libres, como Ring de framing.h
+  char pad_tail[60]; // Cada contador en su línea de cache
+  uint32_t head;
+  char pad_head[60];
+  unsigned long overruns; // Registros descartados (solo el productor)
+  MeasRecord recs[MEAS_RING_SIZE];
+  // Cola de mensajes, con el mismo esquema
+  uint32_t msg_tail;
+  char pad_msg_tail[60];
+  uint32_t msg_head;
+  char pad_msg_head[60];
+  unsigned long msg_overruns; // Mensajes sin lugar, descartados
+  char msgs[MEAS_MSG_RING_SIZE][MEAS_MSG_LEN];
+  // Cola de bajas, con el mismo esquema
+  uint32_t closed_tail;
+  char pad_closed_tail[60];
+  uint32_t closed_head;
+  char pad_closed_head[60];
+  MeasClosed closed[MEAS_CLOSED_RING_SIZE];
+} MeasRing;
+
+void meas_ring_init(MeasRing *r);
+
+// Productor: encolar una copia de rec. -1 si está lleno (cuenta un overrun).
+int meas_ring_push(MeasRing *r, const MeasRecord *rec);
+
+// Consumidor: sacar hasta max registros en out; devuelve cuántos
+size_t meas_ring_pop(MeasRing *r, MeasRecord *out, size_t max);
+
+// Productor: formatear un mensaje y encolar su registro MEASREC_MSG de la
+// conexión conn, con flags extra (MEASREC_STDERR)
+void meas_ring_printf(MeasRing *r, uint32_t conn, uint16_t flags,
+                      const char *fmt, ...);
+
+// Consumidor: copiar en out el próximo mensaje si su número es a lo sumo
+// upto (los que quedaron sin registro por un overrun salen con el
+// siguiente). Devuelve 0 si no hay.
+int meas_ring_pop_msg(MeasRing *r, uint32_t upto, char out[MEAS_MSG_LEN]);
+
+// Productor: avisar que se cerró la conexión conn. -1 si la cola está llena
+// (el productor reintenta después).
+int meas_ring_push_closed(MeasRing *r, uint32_t conn);
+
+// Consumidor: la próxima baja en *conn, si ya se consumieron los registros
+// encolados antes de ella. Devuelve 0 si no hay.
+int meas_ring_pop_closed(MeasRing *r, uint32_t *conn);
+
+#endif
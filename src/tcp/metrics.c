@@ -0,0 +1,293 @@
+#include "metrics.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// Triple buffer: el escritor es dueño de back, el lector de front, y middle
+// se intercambia con __atomic_exchange. METRICS_FRESH marca que middle tiene
+// una foto que el lector todavía no tomó.
+#define METRICS_FRESH 4u
+
+typedef struct {
+  unsigned back;
+  unsigned middle; // Compartido
+  unsigned front;
+} TripleIndex;
+
+static MetricsSnapshot snapshots[3];
+static TripleIndex snapshot_idx = {0, 1, 2};
+static MetricsPersist persists[3];
+static TripleIndex persist_idx = {0, 1, 2};
+
+static int listen_fd = -1;
+static pthread_t thread;
+
+static void triple_publish(TripleIndex *t) {
+  unsigned prev = __atomic_exchange_n(&t->middle, t->back | METRICS_FRESH,
+                                      __ATOMIC_ACQ_REL);
+  t->back = prev & ~METRICS_FRESH;
+}
+
+// Índice de la foto más nueva (solo desde el thread HTTP)
+static unsigned triple_latest(TripleIndex *t) {
+  if (__atomic_load_n(&t->middle, __ATOMIC_ACQUIRE) & METRICS_FRESH) {
+    unsigned prev = __atomic_exchange_n(&t->middle, t->front, __ATOMIC_ACQ_REL);
+    t->front = prev & ~METRICS_FRESH;
+  }
+  return t->front;
+}
+
+MetricsSnapshot *metrics_begin(void) { return &snapshots[snapshot_idx.back]; }
+
+void metrics_publish(void) { triple_publish(&snapshot_idx); }
+
+MetricsPersist *metrics_persist_begin(void) {
+  return &persists[persist_idx.back];
+}
+
+void metrics_persist_publish(void) { triple_publish(&persist_idx); }
+
+void metrics_fill_delay(MetricsDelay *d, const DelayStats *s) {
+  d->count = s->count;
+  d->mean_us = s->mean;
+  d->min_us = s->count ? s->min_us : 0;
+  d->max_us = s->count ? s->max_us : 0;
+  d->p50_us = delay_stats_percentile(s, 0.50);
+  d->p90_us = delay_stats_percentile(s, 0.90);
+  d->p99_us = delay_stats_percentile(s, 0.99);
+  d->p999_us = delay_stats_percentile(s, 0.999);
+}
+
+static void write_counter(FILE *out, const char *name, const char *help,
+                          const char *type, unsigned long long value) {
+  fprintf(out, "# HELP %s %s\n# TYPE %s %s\n%s %llu\n", name, help, name, type,
+          name, value);
+}
+
+static void write_metrics(FILE *out, const MetricsSnapshot *m,
+                          const MetricsPersist *p) {
+  static const char *const windows[METRICS_WINDOWS] = {"1s", "10s", "total"};
+
+  write_counter(out, "owd_pdus_valid_total", "PDUs válidas recibidas.",
+                "counter", m->pdus_valid);
+  write_counter(out, "owd_pdus_invalid_total",
+                "PDUs inválidas o descartadas.", "counter", m->pdus_invalid);
+  write_counter(out, "owd_received_bytes_total",
+                "Bytes de PDUs válidas recibidas.", "counter", m->bytes);
+  write_counter(out, "owd_udp_datagrams_total", "Datagramas UDP recibidos.",
+                "counter", m->udp_datagrams);
+  write_counter(out, "owd_udp_flow_drops_total",
+                "Datagramas UDP descartados por el tope de flujos.",
+                "counter", m->udp_flow_drops);
+  write_counter(out, "owd_echoes_sent_total", "Ecos enviados.", "counter",
+                m->echoes_sent);
+  write_counter(out, "owd_echoes_dropped_total",
+                "Ecos descartados por cola llena.", "counter",
+                m->echoes_dropped);
+  write_counter(out, "owd_connections_total",
+                "Conexiones TCP y flujos UDP aceptados.", "counter",
+                m->conns_accepted);
+  write_counter(out, "owd_connections_open",
+                "Conexiones TCP y flujos UDP abiertos.", "gauge",
+                m->conns_open);
+  write_counter(out, "owd_ring_overruns_total",
+                "Mediciones descartadas con el ring de persistencia lleno.",
+                "counter", m->ring_overruns);
+  write_counter(out, "owd_log_records_total",
+                "Registros escritos en el log binario.", "counter",
+                p->log_records);
+  write_counter(out, "owd_log_write_errors_total",
+                "Errores de escritura del log binario.", "counter",
+                p->log_write_errors);
+  write_counter(out, "owd_probes_missing_total",
+                "PDUs salteadas por la secuencia.", "counter", m->missing);
+  write_counter(out, "owd_probes_reordered_total",
+                "PDUs recibidas fuera de orden.", "counter", m->reordered);
+  write_counter(out, "owd_probes_duplicate_total", "PDUs duplicadas.",
+                "counter", m->duplicates);
+
+  fprintf(out, "# HELP owd_delay_us Delay one-way crudo (incluye el offset "
+               "entre relojes) por ventana.\n"
+               "# TYPE owd_delay_us summary\n");
+  for (int w = 0; w < METRICS_WINDOWS; w++) {
+    const MetricsDelay *d = &p->delay[w];
+    if (d->count > 0) {
+      static const double q[] = {0.5, 0.9, 0.99, 0.999};
+      const int64_t v[] = {d->p50_us, d->p90_us, d->p99_us, d->p999_us};
+      for (size_t i = 0; i < sizeof(q) / sizeof(q[0]); i++) {
+        fprintf(out, "owd_delay_us{window=\"%s\",quantile=\"%g\"} %lld\n",
+                windows[w], q[i], (long long)v[i]);
+      }
+    }
+    fprintf(out, "owd_delay_us_sum{window=\"%s\"} %.0f\n", windows[w],
+            d->mean_us * (double)d->count);
+    fprintf(out, "owd_delay_us_count{window=\"%s\"} %llu\n", windows[w],
+            (unsigned long long)d->count);
+  }
+  fprintf(out, "# HELP owd_delay_min_us Delay mínimo por ventana.\n"
+               "# TYPE owd_delay_min_us gauge\n");
+  for (int w = 0; w < METRICS_WINDOWS; w++) {
+    fprintf(out, "owd_delay_min_us{window=\"%s\"} %lld\n", windows[w],
+            (long long)p->delay[w].min_us);
+  }
+  fprintf(out, "# HELP owd_delay_max_us Delay máximo por ventana.\n"
+               "# TYPE owd_delay_max_us gauge\n");
+  for (int w = 0; w < METRICS_WINDOWS; w++) {
+    fprintf(out, "owd_delay_max_us{window=\"%s\"} %lld\n", windows[w],
+            (long long)p->delay[w].max_us);
+  }
+
+  // Una familia por métrica de conexión, con las conexiones como series
+  static const char *const conn_metrics[][3] = {
+      {"owd_conn_measurements_total", "counter", "Mediciones de la conexión."},
+      {"owd_conn_jitter_us", "gauge", "Jitter RFC 3550 de la conexión."},
+      {"owd_conn_skew_ppm", "gauge", "Skew de reloj estimado."},
+      {"owd_conn_missing_total", "counter", "PDUs faltantes."},
+      {"owd_conn_reordered_total", "counter", "PDUs fuera de orden."},
+      {"owd_conn_duplicate_total", "counter", "PDUs duplicadas."}};
+  for (size_t k = 0; k < sizeof(conn_metrics) / sizeof(conn_metrics[0]);
+       k++) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", conn_metrics[k][0],
+            conn_metrics[k][2], conn_metrics[k][0], conn_metrics[k][1]);
+    for (uint32_t i = 0; i < m->nconns; i++) {
+      const MetricsConn *c = &m->conns[i];
+      double values[] = {(double)c->measurements, c->jitter_us, c->skew_ppm,
+                         (double)c->missing,      (double)c->reordered,
+                         (double)c->duplicates};
+      fprintf(out, "%s{conn=\"%u\",peer=\"%s\",proto=\"%s\"} %.6g\n",
+              conn_metrics[k][0], c->id, c->peer, c->udp ? "udp" : "tcp",
+              values[k]);
+    }
+  }
+  fprintf(out, "# HELP owd_snapshot_timestamp_ms Hora de la foto.\n"
+               "# TYPE owd_snapshot_timestamp_ms gauge\n"
+               "owd_snapshot_timestamp_ms %llu\n",
+          (unsigned long long)m->timestamp_ms);
+}
+
+static void write_all(int fd, const char *buf, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    buf += n;
+    len -= (size_t)n;
+  }
+}
+
+// Atender un pedido: alcanza con la primera línea
+static void serve(int fd) {
+  char req[1024];
+  ssize_t n = recv(fd, req, sizeof(req) - 1, 0);
+  if (n <= 0) {
+    return;
+  }
+  req[n] = '\0';
+
+  char *body = NULL;
+  size_t body_len = 0;
+  const char *status = "200 OK";
+  FILE *out = open_memstream(&body, &body_len);
+  if (!out) {
+    return;
+  }
+  if (strncmp(req, "GET /metrics ", 13) == 0 ||
+      strncmp(req, "GET / ", 6) == 0) {
+    write_metrics(out, &snapshots[triple_latest(&snapshot_idx)],
+                  &persists[triple_latest(&persist_idx)]);
+  } else {
+    status = "404 Not Found";
+    fprintf(out, "Solo GET /metrics\n");
+  }
+  fclose(out);
+
+  char hdr[256];
+  int hdr_len = snprintf(hdr, sizeof(hdr),
+                         "HTTP/1.0 %s\r\n"
+                         "Content-Type: text/plain; version=0.0.4\r\n"
+                         "Content-Length: %zu\r\n"
+                         "Connection: close\r\n\r\n",
+                         status, body_len);
+  write_all(fd, hdr, (size_t)hdr_len);
+  write_all(fd, body, body_len);
+  free(body);
+}
+
+static void *metrics_thread(void *arg) {
+  (void)arg;
+  while (1) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      return NULL; // metrics_stop() cerró el socket
+    }
+    // Que un cliente colgado no trabe el thread para siempre
+    struct timeval tv = {.tv_sec = 2, .tv_usec = 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    serve(fd);
+    close(fd);
+  }
+}
+
+int metrics_start(int port) {
+  listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    return -1;
+  }
+  int optval = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons((uint16_t)port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(listen_fd, 16) < 0) {
+    int err = errno;
+    close(listen_fd);
+    listen_fd = -1;
+    errno = err;
+    return -1;
+  }
+
+  // Las señales las atiende el loop principal
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  int err = pthread_create(&thread, NULL, metrics_thread, NULL);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (err != 0) {
+    close(listen_fd);
+    listen_fd = -1;
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
+
+void metrics_stop(void) {
+  if (listen_fd < 0) {
+    return;
+  }
+  // shutdown despierta al accept() bloqueado
+  shutdown(listen_fd, SHUT_RDWR);
+  pthread_join(thread, NULL);
+  close(listen_fd);
+  listen_fd = -1;
+}
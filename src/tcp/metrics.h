@@ -0,0 +1,94 @@
+#ifndef TCP_METRICS_H
+#define TCP_METRICS_H
+
+#include <stdint.h>
+
+#include "delay_stats.h"
+
+// Métricas del servidor en formato de texto de Prometheus, servidas por HTTP
+// en 127.0.0.1 desde un thread aparte (-m).
+//
+// Una vez por segundo el loop de recepción arma una foto de sus contadores y
+// el hilo de persistencia otra del delay y el log. Cada una se publica en su
+// triple buffer: se escribe siempre en el buffer de atrás y se lo
+// intercambia atómicamente con el del medio; el thread HTTP toma el del
+// medio solo si hay uno nuevo. Nadie espera a nadie, así que un scrape lento
+// no demora la recepción.
+
+// Conexiones que se exportan con su detalle (el resto solo suma en los
+// totales)
+#define METRICS_MAX_CONNS 256
+
+// Ventanas de percentiles de delay
+enum { METRICS_WINDOW_1S, METRICS_WINDOW_10S, METRICS_WINDOW_TOTAL,
+       METRICS_WINDOWS };
+
+typedef struct {
+  uint64_t count;
+  double mean_us;
+  int64_t min_us;
+  int64_t p50_us;
+  int64_t p90_us;
+  int64_t p99_us;
+  int64_t p999_us;
+  int64_t max_us;
+} MetricsDelay;
+
+typedef struct {
+  uint32_t id;
+  char peer[32];
+  int udp;
+  unsigned long measurements;
+  double jitter_us;
+  double skew_ppm;
+  unsigned long missing;
+  unsigned long reordered;
+  unsigned long duplicates;
+} MetricsConn;
+
+typedef struct {
+  uint64_t timestamp_ms; // Cuándo se armó (CLOCK_REALTIME)
+  unsigned long pdus_valid;
+  unsigned long pdus_invalid;
+  unsigned long long bytes;
+  unsigned long udp_datagrams;
+  unsigned long udp_flow_drops;
+  unsigned long echoes_sent;
+  unsigned long echoes_dropped;
+  unsigned long conns_accepted;
+  unsigned long conns_open;
+  unsigned long ring_overruns;
+  unsigned long missing;
+  unsigned long reordered;
+  unsigned long duplicates;
+  uint32_t nconns; // Detalle de las primeras METRICS_MAX_CONNS
+  MetricsConn conns[METRICS_MAX_CONNS];
+} MetricsSnapshot;
+
+// La parte del hilo de persistencia
+typedef struct {
+  MetricsDelay delay[METRICS_WINDOWS];
+  unsigned long log_records;
+  unsigned long log_write_errors;
+} MetricsPersist;
+
+// Abrir 127.0.0.1:port y lanzar el thread HTTP. Devuelve -1 con errno.
+int metrics_start(int port);
+
+// Buffer donde armar la próxima foto (solo desde el loop de recepción)
+MetricsSnapshot *metrics_begin(void);
+
+// Publicar la foto armada en metrics_begin
+void metrics_publish(void);
+
+// Lo mismo para la foto del hilo de persistencia
+MetricsPersist *metrics_persist_begin(void);
+void metrics_persist_publish(void);
+
+// Resumir una DelayStats para la foto
+void metrics_fill_delay(MetricsDelay *d, const DelayStats *s);
+
+// Cerrar el socket y esperar al thread
+void metrics_stop(void);
+
+#endif
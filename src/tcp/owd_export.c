@@ -0,0 +1,218 @@
+// Exportar un log binario de tcp_server (.owd) al CSV de siempre.
+//
+// Las dos primeras columnas son las que usa plot_delay.py
+// (measurement,one_way_delay_us, con el delay en segundos como escribía el
+// servidor); el resto agrega la conexión, la secuencia, el tamaño, los dos
+// timestamps crudos en microsegundos, el delay sin el drift estimado por el
+// servidor (en segundos, como one_way_delay_us) y, si el servidor corrió con
+// -k, el timestamp de recepción del kernel y cuánto después lo vio el
+// servidor (vacíos si no). Al final van el intervalo programado por el
+// cliente, el jitter RFC 3550, los gaps con la medición anterior de la
+// misma conexión y los eventos que marcó el servidor.
+
+#include <arpa/inet.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "measlog.h"
+
+#define READ_BATCH 4096
+
+// Por conexión: de dónde vino y la medición anterior (para los gaps)
+typedef struct {
+  uint32_t ip; // Host byte order
+  uint16_t port;
+  int udp;
+  int has_prev;
+  uint64_t prev_origin_ts;
+  uint64_t prev_dest_ts;
+} Peer;
+
+static Peer *peers = NULL;
+static size_t peers_cap = 0;
+
+static int grow_peers(uint32_t conn) {
+  if (conn >= peers_cap) {
+    size_t cap = peers_cap ? peers_cap : 64;
+    while (cap <= conn) {
+      cap *= 2;
+    }
+    Peer *p = realloc(peers, cap * sizeof(Peer));
+    if (!p) {
+      perror("realloc");
+      return -1;
+    }
+    memset(p + peers_cap, 0, (cap - peers_cap) * sizeof(Peer));
+    peers = p;
+    peers_cap = cap;
+  }
+  return 0;
+}
+
+static int remember_peer(const MeasRecord *rec) {
+  if (grow_peers(rec->conn) < 0) {
+    return -1;
+  }
+  peers[rec->conn].ip = rec->seq;
+  peers[rec->conn].port = rec->size;
+  peers[rec->conn].udp = (rec->flags & MEASREC_UDP) != 0;
+  return 0;
+}
+
+static void format_peer(uint32_t conn, char *out, size_t len) {
+  if (conn >= peers_cap || peers[conn].port == 0) {
+    snprintf(out, len, "?");
+    return;
+  }
+  struct in_addr addr;
+  addr.s_addr = htonl(peers[conn].ip);
+  char ip[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &addr, ip, sizeof(ip));
+  snprintf(out, len, "%s:%u%s", ip, peers[conn].port,
+           peers[conn].udp ? "/udp" : "");
+}
+
+// Nombres de los eventos del campo flags, separados por '+'
+static void format_events(uint16_t flags, char *out, size_t len) {
+  static const struct {
+    uint16_t flag;
+    const char *name;
+  } names[] = {{MEASREC_SEQ_GAP, "faltantes"},
+               {MEASREC_REORDER, "fuera_de_orden"},
+               {MEASREC_SEND_STALL, "envio_demorado"},
+               {MEASREC_RECV_STALL, "llegada_demorada"},
+               {MEASREC_BURST, "rafaga"},
+               {MEASREC_DUP, "duplicada"}};
+  size_t pos = 0;
+  out[0] = '\0';
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if ((flags & names[i].flag) && pos < len) {
+      pos += (size_t)snprintf(out + pos, len - pos, "%s%s", pos ? "+" : "",
+                              names[i].name);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "Uso: %s <log.owd> [salida.csv]\n", argv[0]);
+    fprintf(stderr, "Sin salida.csv escribe en stdout.\n");
+    return 1;
+  }
+
+  FILE *in = fopen(argv[1], "rb");
+  if (!in) {
+    perror(argv[1]);
+    return 1;
+  }
+  FILE *out = stdout;
+  if (argc == 3) {
+    out = fopen(argv[2], "w");
+    if (!out) {
+      perror(argv[2]);
+      fclose(in);
+      return 1;
+    }
+  }
+  static char out_buf[1 << 16];
+  setvbuf(out, out_buf, _IOFBF, sizeof(out_buf));
+
+  MeasLogHeader hdr;
+  if (fread(&hdr, sizeof(hdr), 1, in) != 1 ||
+      memcmp(hdr.magic, MEASLOG_MAGIC, sizeof(hdr.magic)) != 0) {
+    fprintf(stderr, "ERROR: %s no es un log de tcp_server\n", argv[1]);
+    return 1;
+  }
+  // Versiones anteriores: el mismo registro sin los campos del final (v1
+  // además con la corrección de skew en 0)
+  size_t min_size = sizeof(MeasRecord);
+  if (hdr.version < 3) {
+    min_size = offsetof(MeasRecord, kernel_rx_ts);
+  } else if (hdr.version < 4) {
+    min_size = offsetof(MeasRecord, send_interval_us);
+  }
+  if (hdr.version < 1 || hdr.version > MEASLOG_VERSION ||
+      hdr.record_size != min_size) {
+    fprintf(stderr,
+            "ERROR: log versión %" PRIu32 " con registros de %" PRIu32
+            " bytes (se espera versión <= %d, %zu bytes; "
+            "¿otra arquitectura?)\n",
+            hdr.version, hdr.record_size, MEASLOG_VERSION, min_size);
+    return 1;
+  }
+
+  fprintf(out, "measurement,one_way_delay_us,conn,peer,seq,size,origin_ts_us,"
+               "dest_ts_us,deskewed_delay_us,kernel_rx_ts_us,rx_lag_us,"
+               "send_interval_us,jitter_us,inter_send_us,inter_arrival_us,"
+               "events\n");
+
+  static uint8_t raw[READ_BATCH * sizeof(MeasRecord)];
+  unsigned long measurement = 0;
+  size_t n;
+  while ((n = fread(raw, hdr.record_size, READ_BATCH, in)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      MeasRecord r;
+      memset(&r, 0, sizeof(r));
+      memcpy(&r, raw + i * hdr.record_size, hdr.record_size);
+      const MeasRecord *rec = &r;
+      if (rec->flags & MEASREC_CONN) {
+        if (remember_peer(rec) < 0) {
+          return 1;
+        }
+        continue;
+      }
+
+      char peer[INET_ADDRSTRLEN + 10];
+      format_peer(rec->conn, peer, sizeof(peer));
+      int64_t delay_us = (int64_t)rec->dest_ts - (int64_t)rec->origin_ts;
+      fprintf(out,
+              "%lu,%.6f,%" PRIu32 ",%s,%" PRIu32 ",%u,%" PRIu64 ",%" PRIu64
+              ",%.6f,",
+              ++measurement, delay_us / 1000000.0, rec->conn, peer, rec->seq,
+              rec->size, rec->origin_ts, rec->dest_ts,
+              (delay_us - rec->skew_corr_us) / 1000000.0);
+      if (rec->kernel_rx_ts) {
+        fprintf(out, "%" PRIu64 ",%" PRId64 ",", rec->kernel_rx_ts,
+                (int64_t)rec->dest_ts - (int64_t)rec->kernel_rx_ts);
+      } else {
+        fprintf(out, ",,");
+      }
+
+      if (grow_peers(rec->conn) < 0) {
+        return 1;
+      }
+      Peer *prev = &peers[rec->conn];
+      char events[96];
+      format_events(rec->flags, events, sizeof(events));
+      fprintf(out, "%" PRIu32 ",%" PRIu32 ",", rec->send_interval_us,
+              rec->jitter_us);
+      if (prev->has_prev) {
+        fprintf(out, "%" PRId64 ",%" PRId64 ",%s\n",
+                (int64_t)(rec->origin_ts - prev->prev_origin_ts),
+                (int64_t)(rec->dest_ts - prev->prev_dest_ts), events);
+      } else {
+        fprintf(out, ",,%s\n", events);
+      }
+      prev->has_prev = 1;
+      prev->prev_origin_ts = rec->origin_ts;
+      prev->prev_dest_ts = rec->dest_ts;
+    }
+  }
+  if (ferror(in)) {
+    perror("fread");
+    return 1;
+  }
+
+  fclose(in);
+  if (fclose(out) != 0) {
+    perror("fclose");
+    return 1;
+  }
+  fprintf(stderr, "%lu mediciones exportadas\n", measurement);
+  free(peers);
+  return 0;
+}
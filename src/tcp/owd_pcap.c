@@ -0,0 +1,864 @@
+// Análisis de capturas (.pcap) sin Wireshark ni libpcap: una sola pasada
+// sobre el archivo mapeado con mmap, con memoria acotada por flujo.
+//
+// - Sondas TCP: se rearma el stream cliente → servidor de cada conexión
+//   (desde el SYN) y se pasa por el mismo FrameParser que usa el servidor,
+//   así que cada PDU v1 / v2 sale con su timestamp de origen y la hora de
+//   captura del paquete que trajo su último byte. Sondas UDP: un datagrama,
+//   una PDU.
+// - Sesiones UDP Stop & Wait (udp_client / udp_server): por cada PDU del
+//   cliente (DATA y el resto de los pedidos) se mide el RTT hasta su ACK,
+//   las retransmisiones y el tiempo ocioso entre el ACK anterior y el
+//   pedido siguiente.
+//
+// Las capturas hechas en un router ven cada paquete dos veces (al entrar y
+// al salir). Las copias se reconocen por el IP id y el largo, que el
+// forwarding no cambia (el checksum de transporte no sirve: con offload, el
+// paquete que sale del host capturador tiene uno parcial). Se usa la copia
+// más cercana al cliente: la primera de los pedidos, la última de las
+// respuestas.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../udp/protocol.h"
+#include "delay_stats.h"
+#include "framing.h"
+
+// Formato de archivo pcap (no pcapng)
+#define PCAP_MAGIC_US 0xa1b2c3d4
+#define PCAP_MAGIC_NS 0xa1b23c4d
+#define PCAP_HDR_SIZE 24
+#define PCAP_REC_SIZE 16
+
+// Tipos de enlace soportados
+#define LINKTYPE_NULL 0
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_RAW 101
+#define LINKTYPE_LINUX_SLL 113
+#define LINKTYPE_IPV4 228
+
+#define FLOW_BUCKETS 4096
+// Segmentos fuera de orden guardados por conexión hasta que llegue el hueco;
+// si se pasa, la conexión se da por perdida en vez de crecer sin límite
+#define OOO_MAX_SEGMENTS 64
+#define OOO_MAX_BYTES (256 * 1024)
+// Soltar las páginas ya leídas cada tanto: el RSS no crece con la captura
+#define RELEASE_CHUNK (64u << 20)
+
+// Pedido Stop & Wait en curso de una sesión
+typedef struct {
+  int active;
+  uint8_t type;
+  uint8_t seq;
+  uint16_t len;
+  uint64_t first_tx_us;
+  uint64_t last_tx_us;
+  uint32_t transmissions;
+  int answered;
+  int rejected; // ACK con mensaje de error
+  uint64_t reply_us;
+  int64_t idle_before_us; // -1: sin respuesta anterior
+} Exchange;
+
+typedef struct {
+  uint32_t seq; // Relativo al ISN
+  uint32_t len;
+  uint8_t *data;
+} Segment;
+
+// Stream cliente → servidor de una conexión TCP de sonda
+typedef struct {
+  FrameParser parser;
+  uint32_t isn;
+  uint32_t next; // Próximo byte esperado, relativo al ISN
+  int broken;    // Hueco que no se llenó: el resto no se puede parsear
+  Segment ooo[OOO_MAX_SEGMENTS];
+  int nooo;
+  size_t ooo_bytes;
+} TcpStream;
+
+typedef struct Flow {
+  uint32_t cli_ip; // Host byte order
+  uint32_t srv_ip;
+  uint16_t cli_port;
+  uint16_t srv_port;
+  uint8_t proto;
+  uint32_t id; // Orden de aparición
+  struct Flow *hnext;
+  struct Flow *next; // Orden de aparición, para el resumen
+  // Último paquete de cada sentido (0 = hacia el servidor), para las copias
+  int has_last[2];
+  uint16_t last_ip_id[2];
+  uint16_t last_len[2];
+  // TCP
+  TcpStream *tcp; // Desde el SYN hasta el FIN / RST
+  int no_syn;
+  unsigned long retrans_bytes;
+  unsigned long ooo_segments;
+  // Sondas (TCP o UDP)
+  unsigned long pdus;
+  unsigned long invalid;
+  // Stop & Wait
+  int stopwait;
+  Exchange cur;
+  unsigned long requests;
+  unsigned long data_pdus;
+  unsigned long long data_bytes;
+  unsigned long retransmissions;
+  unsigned long unanswered;
+  unsigned long dup_replies;
+  unsigned long rejects;
+  double rtt_sum_us;
+  unsigned long rtt_count;
+  uint64_t idle_us;
+  uint64_t first_us;
+  uint64_t last_us;
+} Flow;
+
+typedef struct {
+  const char *path;
+  const char *pdu_csv;
+  const char *sw_csv;
+  uint16_t port;
+} PcapOptions;
+
+static PcapOptions opts;
+static Flow *flows[FLOW_BUCKETS];
+static Flow *flow_list = NULL, *flow_tail = NULL;
+static uint32_t next_flow_id = 0;
+static FILE *pdu_out = NULL;
+static FILE *sw_out = NULL;
+
+// Contadores globales
+static unsigned long packets = 0;
+static unsigned long long capture_bytes = 0;
+static unsigned long not_ipv4 = 0;
+static unsigned long fragments = 0;
+static unsigned long truncated = 0;
+static unsigned long copies = 0;
+static unsigned long other_traffic = 0;
+static unsigned long measurement = 0;
+static DelayStats probe_delay;
+static DelayStats rtt_stats;  // Solo pedidos sin retransmitir (Karn)
+static DelayStats idle_stats;
+
+static const char *const type_names[] = {
+    "?", "HELLO", "WRQ", "DATA", "ACK", "FIN", "MANIFEST", "HAVE"};
+
+static uint16_t rd16(const uint8_t *p) { return (uint16_t)(p[0] << 8 | p[1]); }
+
+static uint32_t rd32(const uint8_t *p) {
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 |
+         p[3];
+}
+
+static void format_flow(const Flow *f, char *out, size_t len) {
+  struct in_addr addr;
+  addr.s_addr = htonl(f->cli_ip);
+  char ip[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &addr, ip, sizeof(ip));
+  snprintf(out, len, "%s:%u%s", ip, f->cli_port,
+           f->proto == IPPROTO_UDP ? "/udp" : "");
+}
+
+static Flow *lookup_flow(uint32_t cli_ip, uint16_t cli_port, uint32_t srv_ip,
+                         uint16_t srv_port, uint8_t proto) {
+  uint32_t h = (cli_ip * 2654435761u) ^ ((uint32_t)cli_port * 40503u) ^ proto;
+  Flow **slot = &flows[h % FLOW_BUCKETS];
+  for (Flow *f = *slot; f; f = f->hnext) {
+    if (f->cli_ip == cli_ip && f->cli_port == cli_port &&
+        f->srv_ip == srv_ip && f->srv_port == srv_port && f->proto == proto) {
+      return f;
+    }
+  }
+  Flow *f = calloc(1, sizeof(Flow));
+  if (!f) {
+    perror("calloc");
+    exit(1);
+  }
+  f->cli_ip = cli_ip;
+  f->cli_port = cli_port;
+  f->srv_ip = srv_ip;
+  f->srv_port = srv_port;
+  f->proto = proto;
+  f->id = next_flow_id++;
+  f->hnext = *slot;
+  *slot = f;
+  if (flow_tail) {
+    flow_tail->next = f;
+  } else {
+    flow_list = f;
+  }
+  flow_tail = f;
+  return f;
+}
+
+// ¿Es la otra copia del último paquete de este sentido?
+static int is_copy(Flow *f, int dir, uint16_t ip_id, uint16_t len) {
+  int copy = f->has_last[dir] && f->last_ip_id[dir] == ip_id &&
+             f->last_len[dir] == len;
+  f->has_last[dir] = 1;
+  f->last_ip_id[dir] = ip_id;
+  f->last_len[dir] = len;
+  return copy;
+}
+
+static void record_probe(Flow *f, const ProbePdu *pdu, uint64_t ts_us) {
+  f->pdus++;
+  int64_t delay_us = (int64_t)ts_us - (int64_t)pdu->origin_ts;
+  delay_stats_record(&probe_delay, delay_us);
+  measurement++;
+  if (pdu_out) {
+    char peer[INET_ADDRSTRLEN + 16];
+    format_flow(f, peer, sizeof(peer));
+    fprintf(pdu_out,
+            "%lu,%.6f,%" PRIu32 ",%s,%" PRIu32 ",%" PRIu32 ",%" PRIu64
+            ",%" PRIu64 "\n",
+            measurement, delay_us / 1000000.0, f->id, peer, pdu->seq,
+            pdu->len, pdu->origin_ts, ts_us);
+  }
+}
+
+// --- TCP ---
+
+static void tcp_close(Flow *f) {
+  if (!f->tcp) {
+    return;
+  }
+  for (int i = 0; i < f->tcp->nooo; i++) {
+    free(f->tcp->ooo[i].data);
+  }
+  free(f->tcp);
+  f->tcp = NULL;
+}
+
+// Pasar bytes en orden al parser y sacar las PDUs que se completen
+static void tcp_feed(Flow *f, const uint8_t *data, size_t len,
+                     uint64_t ts_us) {
+  TcpStream *s = f->tcp;
+  s->next += (uint32_t)len;
+  while (1) {
+    struct iovec iov[2];
+    int n = frame_parser_iov(&s->parser, iov);
+    size_t copied = 0;
+    for (int i = 0; i < n && copied < len; i++) {
+      size_t chunk = len - copied < iov[i].iov_len ? len - copied
+                                                   : iov[i].iov_len;
+      memcpy(iov[i].iov_base, data + copied, chunk);
+      copied += chunk;
+    }
+    frame_parser_commit(&s->parser, copied);
+    data += copied;
+    len -= copied;
+
+    int extracted = 0;
+    ProbePdu pdu;
+    FrameResult r;
+    while ((r = frame_parser_next(&s->parser, &pdu)) != FRAME_NEED_MORE) {
+      extracted = 1;
+      if (r == FRAME_OK) {
+        record_probe(f, &pdu, ts_us);
+      } else if (r == FRAME_INVALID) {
+        f->invalid++;
+      } else {
+        // No es un stream de sondas (o se perdió el framing)
+        f->invalid++;
+        s->broken = 1;
+        return;
+      }
+    }
+    if (len == 0) {
+      return;
+    }
+    if (copied == 0 && !extracted) {
+      s->broken = 1; // Ring lleno sin PDU: no es un stream de sondas
+      return;
+    }
+  }
+}
+
+// Segmentos guardados que ya se pueden pasar
+static void tcp_drain(Flow *f, uint64_t ts_us) {
+  TcpStream *s = f->tcp;
+  int progress = 1;
+  while (progress && !s->broken && s->nooo > 0) {
+    progress = 0;
+    for (int i = 0; i < s->nooo; i++) {
+      Segment *seg = &s->ooo[i];
+      int32_t ahead = (int32_t)(seg->seq - s->next);
+      if (ahead > 0) {
+        continue;
+      }
+      uint32_t skip = (uint32_t)-ahead;
+      if (skip < seg->len) {
+        tcp_feed(f, seg->data + skip, seg->len - skip, ts_us);
+      }
+      s->ooo_bytes -= seg->len;
+      free(seg->data);
+      *seg = s->ooo[--s->nooo];
+      progress = 1;
+      break;
+    }
+  }
+}
+
+static void handle_tcp(Flow *f, const uint8_t *tcp, size_t avail,
+                       size_t seg_len, uint64_t ts_us) {
+  uint32_t seq = rd32(tcp + 4);
+  uint8_t flags = tcp[13];
+  size_t hdr_len = (size_t)(tcp[12] >> 4) * 4;
+  int syn = flags & 0x02, fin = flags & 0x01, rst = flags & 0x04;
+
+  if (syn) {
+    tcp_close(f);
+    f->tcp = calloc(1, sizeof(TcpStream));
+    if (!f->tcp) {
+      perror("calloc");
+      exit(1);
+    }
+    frame_parser_init(&f->tcp->parser);
+    f->tcp->isn = seq;
+    f->tcp->next = 1;
+    return;
+  }
+  if (!f->tcp) {
+    // Conexión empezada antes de la captura: no se sabe dónde arranca cada
+    // PDU. Se cuenta una vez.
+    if (!f->no_syn && seg_len > hdr_len) {
+      f->no_syn = 1;
+    }
+    return;
+  }
+  TcpStream *s = f->tcp;
+  size_t payload = seg_len > hdr_len ? seg_len - hdr_len : 0;
+  uint32_t rel = seq - s->isn;
+  if (payload > 0 && !s->broken) {
+    if (avail < hdr_len + payload) {
+      // Cortado por el snaplen: faltan bytes del stream
+      truncated++;
+      s->broken = 1;
+    } else {
+      const uint8_t *data = tcp + hdr_len;
+      int32_t ahead = (int32_t)(rel - s->next);
+      if (ahead > 0) {
+        f->ooo_segments++;
+        if (s->nooo == OOO_MAX_SEGMENTS ||
+            s->ooo_bytes + payload > OOO_MAX_BYTES) {
+          s->broken = 1;
+        } else {
+          Segment *seg = &s->ooo[s->nooo];
+          seg->data = malloc(payload);
+          if (!seg->data) {
+            perror("malloc");
+            exit(1);
+          }
+          memcpy(seg->data, data, payload);
+          seg->seq = rel;
+          seg->len = (uint32_t)payload;
+          s->nooo++;
+          s->ooo_bytes += payload;
+        }
+      } else {
+        uint32_t skip = (uint32_t)-ahead;
+        f->retrans_bytes += skip < payload ? skip : payload;
+        if (skip < payload) {
+          tcp_feed(f, data + skip, payload - skip, ts_us);
+          tcp_drain(f, ts_us);
+        }
+      }
+    }
+  }
+  if (fin || rst) {
+    tcp_close(f);
+  }
+}
+
+// --- Stop & Wait ---
+
+static void finish_exchange(Flow *f) {
+  Exchange *e = &f->cur;
+  if (!e->active) {
+    return;
+  }
+  e->active = 0;
+  int64_t rtt_us = -1;
+  if (e->answered) {
+    rtt_us = (int64_t)(e->reply_us - e->last_tx_us);
+    f->rtt_sum_us += (double)rtt_us;
+    f->rtt_count++;
+    // Karn: con retransmisiones no se sabe a cuál responde el ACK
+    if (e->transmissions == 1) {
+      delay_stats_record(&rtt_stats, rtt_us);
+    }
+  } else {
+    f->unanswered++;
+  }
+  if (!sw_out) {
+    return;
+  }
+  char peer[INET_ADDRSTRLEN + 16];
+  format_flow(f, peer, sizeof(peer));
+  const char *type = e->type < sizeof(type_names) / sizeof(type_names[0])
+                         ? type_names[e->type]
+                         : "?";
+  fprintf(sw_out, "%" PRIu32 ",%s,%s,%u,%u,%" PRIu64 ",", f->id, peer, type,
+          e->seq, e->len, e->first_tx_us);
+  if (e->answered) {
+    fprintf(sw_out, "%" PRIu64 ",%" PRId64 ",", e->reply_us, rtt_us);
+  } else {
+    fprintf(sw_out, ",,");
+  }
+  fprintf(sw_out, "%" PRIu32 ",", e->transmissions);
+  if (e->idle_before_us >= 0) {
+    fprintf(sw_out, "%" PRId64, e->idle_before_us);
+  }
+  fprintf(sw_out, ",%s\n", e->rejected ? "rechazo" : "");
+}
+
+static void handle_request(Flow *f, const uint8_t *pdu, size_t len,
+                           uint64_t ts_us) {
+  Exchange *e = &f->cur;
+  uint8_t type = pdu[0], seq = pdu[1];
+  if (e->active && e->type == type && e->seq == seq && e->len == len) {
+    e->transmissions++;
+    e->last_tx_us = ts_us;
+    f->retransmissions++;
+    return;
+  }
+  int64_t idle_us = -1;
+  if (e->active && e->answered) {
+    idle_us = (int64_t)(ts_us - e->reply_us);
+    f->idle_us += (uint64_t)idle_us;
+    delay_stats_record(&idle_stats, idle_us);
+  }
+  finish_exchange(f);
+  f->requests++;
+  if (type == TYPE_DATA) {
+    f->data_pdus++;
+    f->data_bytes += len - 2;
+  }
+  e->active = 1;
+  e->type = type;
+  e->seq = seq;
+  e->len = (uint16_t)len;
+  e->first_tx_us = ts_us;
+  e->last_tx_us = ts_us;
+  e->transmissions = 1;
+  e->answered = 0;
+  e->rejected = 0;
+  e->idle_before_us = idle_us;
+}
+
+static void handle_reply(Flow *f, const uint8_t *pdu, size_t len,
+                         uint64_t ts_us, int copy) {
+  Exchange *e = &f->cur;
+  if (!e->active || pdu[1] != e->seq) {
+    f->dup_replies += !copy;
+    return;
+  }
+  if (e->answered) {
+    if (copy) {
+      e->reply_us = ts_us; // La copia que va hacia el cliente
+    } else {
+      f->dup_replies++;
+    }
+    return;
+  }
+  e->answered = 1;
+  e->reply_us = ts_us;
+  if (pdu[0] == TYPE_ACK && len > 2) {
+    e->rejected = 1;
+    f->rejects++;
+  }
+}
+
+static void handle_udp(Flow *f, int dir, const uint8_t *data, size_t len,
+                       uint64_t ts_us, int copy) {
+  if (dir == 0 && !copy && !f->stopwait) {
+    ProbePdu pdu;
+    if (frame_v2_datagram(data, len, &pdu) == FRAME_OK) {
+      record_probe(f, &pdu, ts_us);
+      return;
+    }
+  }
+  if (len < 2 || data[0] < TYPE_HELLO || data[0] > TYPE_HAVE) {
+    f->invalid += !copy;
+    return;
+  }
+  f->stopwait = 1;
+  int reply = data[0] == TYPE_ACK || data[0] == TYPE_HAVE;
+  if (reply && dir == 1) {
+    handle_reply(f, data, len, ts_us, copy);
+  } else if (!reply && dir == 0 && !copy) {
+    handle_request(f, data, len, ts_us);
+  }
+}
+
+// --- Paquetes ---
+
+static void handle_ipv4(const uint8_t *ip, size_t avail, uint64_t ts_us) {
+  if (avail < 20 || (ip[0] >> 4) != 4) {
+    not_ipv4++;
+    return;
+  }
+  size_t ihl = (size_t)(ip[0] & 0x0F) * 4;
+  size_t total = rd16(ip + 2);
+  if (ihl < 20 || total < ihl || avail < ihl) {
+    not_ipv4++;
+    return;
+  }
+  if (rd16(ip + 6) & 0x3FFF) {
+    fragments++; // MF o offset: no se rearman fragmentos
+    return;
+  }
+  uint8_t proto = ip[9];
+  uint32_t src = rd32(ip + 12), dst = rd32(ip + 16);
+  const uint8_t *l4 = ip + ihl;
+  size_t l4_avail = (total < avail ? total : avail) - ihl;
+  size_t l4_len = total - ihl;
+  if ((proto != IPPROTO_TCP && proto != IPPROTO_UDP) || l4_avail < 8) {
+    other_traffic++;
+    return;
+  }
+  uint16_t sport = rd16(l4), dport = rd16(l4 + 2);
+  int dir;
+  if (dport == opts.port) {
+    dir = 0;
+  } else if (sport == opts.port) {
+    dir = 1;
+  } else {
+    other_traffic++;
+    return;
+  }
+  Flow *f = dir == 0 ? lookup_flow(src, sport, dst, dport, proto)
+                     : lookup_flow(dst, dport, src, sport, proto);
+  if (f->first_us == 0) {
+    f->first_us = ts_us;
+  }
+  f->last_us = ts_us;
+
+  if (proto == IPPROTO_TCP) {
+    if (l4_avail < 20) {
+      truncated++;
+      return;
+    }
+    if (is_copy(f, dir, rd16(ip + 4), (uint16_t)total)) {
+      copies++;
+      return;
+    }
+    if (dir == 0) {
+      handle_tcp(f, l4, l4_avail, l4_len, ts_us);
+    }
+    return;
+  }
+
+  int copy = is_copy(f, dir, rd16(ip + 4), (uint16_t)total);
+  copies += (unsigned long)copy;
+  size_t udp_len = rd16(l4 + 4);
+  if (udp_len < 8 || udp_len > l4_len) {
+    f->invalid += !copy;
+    return;
+  }
+  if (l4_avail < udp_len) {
+    // Alcanza con el header de la PDU para Stop & Wait, no para las sondas
+    truncated += !copy;
+  }
+  size_t n = (l4_avail < udp_len ? l4_avail : udp_len) - 8;
+  handle_udp(f, dir, l4 + 8, n, ts_us, copy);
+}
+
+static void handle_frame(uint32_t linktype, int swapped, const uint8_t *pkt,
+                         size_t len, uint64_t ts_us) {
+  uint16_t ethertype;
+  size_t off;
+  switch (linktype) {
+  case LINKTYPE_ETHERNET:
+    if (len < 14) {
+      truncated++;
+      return;
+    }
+    ethertype = rd16(pkt + 12);
+    off = 14;
+    while ((ethertype == 0x8100 || ethertype == 0x88A8) && len >= off + 4) {
+      ethertype = rd16(pkt + off + 2); // VLAN
+      off += 4;
+    }
+    break;
+  case LINKTYPE_LINUX_SLL:
+    if (len < 16) {
+      truncated++;
+      return;
+    }
+    ethertype = rd16(pkt + 14);
+    off = 16;
+    break;
+  case LINKTYPE_NULL: {
+    if (len < 4) {
+      truncated++;
+      return;
+    }
+    // Familia en el byte order del que capturó
+    uint32_t family;
+    memcpy(&family, pkt, sizeof(family));
+    if (swapped) {
+      family = __builtin_bswap32(family);
+    }
+    ethertype = family == 2 ? 0x0800 : 0;
+    off = 4;
+    break;
+  }
+  default: // RAW / IPV4
+    ethertype = 0x0800;
+    off = 0;
+    break;
+  }
+  if (ethertype != 0x0800) {
+    not_ipv4++;
+    return;
+  }
+  handle_ipv4(pkt + off, len - off, ts_us);
+}
+
+static void print_summary(void) {
+  printf("\n=== Captura ===\n");
+  printf("Paquetes: %lu (%llu bytes), copias de reenvío: %lu\n", packets,
+         capture_bytes, copies);
+  printf("No IPv4: %lu, fragmentos: %lu, cortados por el snaplen: %lu, "
+         "otro tráfico: %lu\n",
+         not_ipv4, fragments, truncated, other_traffic);
+
+  unsigned long probe_flows = 0, sw_flows = 0;
+  unsigned long invalid = 0, no_syn = 0, ooo = 0, retrans_bytes = 0;
+  unsigned long requests = 0, data_pdus = 0, retx = 0, unanswered = 0;
+  unsigned long dup_replies = 0, rejects = 0;
+  for (Flow *f = flow_list; f; f = f->next) {
+    invalid += f->invalid;
+    if (f->stopwait) {
+      sw_flows++;
+      requests += f->requests;
+      data_pdus += f->data_pdus;
+      retx += f->retransmissions;
+      unanswered += f->unanswered;
+      dup_replies += f->dup_replies;
+      rejects += f->rejects;
+    } else if (f->pdus > 0 || f->proto == IPPROTO_TCP) {
+      probe_flows++;
+      no_syn += (unsigned long)f->no_syn;
+      ooo += f->ooo_segments;
+      retrans_bytes += f->retrans_bytes;
+    }
+  }
+
+  printf("\n=== Sondas (puerto %u) ===\n", opts.port);
+  printf("Flujos: %lu (%lu empezados antes de la captura, sin analizar)\n",
+         probe_flows, no_syn);
+  printf("PDUs: %lu, inválidas: %lu\n", measurement, invalid);
+  printf("TCP: segmentos fuera de orden: %lu, bytes retransmitidos: %lu\n",
+         ooo, retrans_bytes);
+  delay_stats_print(&probe_delay, stdout, "Captura - origen: ");
+
+  printf("\n=== Sesiones Stop & Wait ===\n");
+  printf("Sesiones: %lu, pedidos: %lu (DATA: %lu)\n", sw_flows, requests,
+         data_pdus);
+  printf("Retransmisiones: %lu, sin respuesta: %lu, respuestas duplicadas: "
+         "%lu, rechazos: %lu\n",
+         retx, unanswered, dup_replies, rejects);
+  delay_stats_print(&rtt_stats, stdout, "RTT (sin retransmitir): ");
+  delay_stats_print(&idle_stats, stdout, "Ocioso entre pedidos:   ");
+  for (Flow *f = flow_list; f; f = f->next) {
+    if (!f->stopwait) {
+      continue;
+    }
+    char peer[INET_ADDRSTRLEN + 16];
+    format_flow(f, peer, sizeof(peer));
+    printf("  [%u %s] %lu DATA (%llu bytes), %lu retransmisiones, RTT medio "
+           "%.1f us, ocioso %.3f s de %.3f s\n",
+           f->id, peer, f->data_pdus, f->data_bytes, f->retransmissions,
+           f->rtt_count ? f->rtt_sum_us / (double)f->rtt_count : 0.0,
+           f->idle_us / 1e6, (f->last_us - f->first_us) / 1e6);
+  }
+}
+
+static FILE *open_csv(const char *path, const char *header) {
+  if (!path) {
+    return NULL;
+  }
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    perror(path);
+    exit(1);
+  }
+  fputs(header, out);
+  return out;
+}
+
+static void print_usage(const char *progname) {
+  fprintf(stderr,
+          "Uso: %s <captura.pcap> [-p <puerto>] [-o <pdus.csv>] "
+          "[-s <stopwait.csv>]\n",
+          progname);
+  fprintf(stderr, "\nOpciones:\n");
+  fprintf(stderr, "  -p <puerto>  Puerto del servidor (default %d)\n",
+          SERVER_PORT);
+  fprintf(stderr, "  -o <arch>    PDUs de sonda: delay entre el timestamp de "
+                  "origen y la captura\n");
+  fprintf(stderr, "  -s <arch>    Pedidos Stop & Wait: RTT, transmisiones y "
+                  "tiempo ocioso\n");
+}
+
+int main(int argc, char *argv[]) {
+  opts.port = SERVER_PORT;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      opts.pdu_csv = argv[++i];
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      opts.sw_csv = argv[++i];
+    } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      char *endptr;
+      long port = strtol(argv[++i], &endptr, 10);
+      if (port < 1 || port > 65535 || *endptr != '\0') {
+        fprintf(stderr, "ERROR: -p debe ser un puerto entre 1 y 65535\n");
+        return 1;
+      }
+      opts.port = (uint16_t)port;
+    } else if (argv[i][0] == '-' || opts.path) {
+      fprintf(stderr, "ERROR: Parámetro desconocido: %s\n", argv[i]);
+      print_usage(argv[0]);
+      return 1;
+    } else {
+      opts.path = argv[i];
+    }
+  }
+  if (!opts.path) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  int fd = open(opts.path, O_RDONLY);
+  if (fd < 0) {
+    perror(opts.path);
+    return 1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    perror("fstat");
+    close(fd);
+    return 1;
+  }
+  size_t len = (size_t)st.st_size;
+  if (len < PCAP_HDR_SIZE) {
+    fprintf(stderr, "ERROR: %s no es una captura pcap\n", opts.path);
+    close(fd);
+    return 1;
+  }
+  uint8_t *data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  posix_madvise(data, len, POSIX_MADV_SEQUENTIAL);
+
+  // Header global: el magic dice el byte order y la resolución
+  uint32_t magic;
+  memcpy(&magic, data, sizeof(magic));
+  int swapped = 0, nanos = 0;
+  if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS) {
+    nanos = magic == PCAP_MAGIC_NS;
+  } else if (__builtin_bswap32(magic) == PCAP_MAGIC_US ||
+             __builtin_bswap32(magic) == PCAP_MAGIC_NS) {
+    swapped = 1;
+    nanos = __builtin_bswap32(magic) == PCAP_MAGIC_NS;
+  } else {
+    fprintf(stderr, "ERROR: %s no es una captura pcap (¿pcapng? "
+                    "convertir con editcap -F pcap)\n",
+            opts.path);
+    return 1;
+  }
+  uint32_t linktype;
+  memcpy(&linktype, data + 20, sizeof(linktype));
+  if (swapped) {
+    linktype = __builtin_bswap32(linktype);
+  }
+  linktype &= 0x0FFFFFFF; // Los bits altos son flags (FCS)
+  if (linktype != LINKTYPE_ETHERNET && linktype != LINKTYPE_LINUX_SLL &&
+      linktype != LINKTYPE_RAW && linktype != LINKTYPE_IPV4 &&
+      linktype != LINKTYPE_NULL) {
+    fprintf(stderr, "ERROR: tipo de enlace %" PRIu32 " no soportado\n",
+            linktype);
+    return 1;
+  }
+
+  pdu_out = open_csv(opts.pdu_csv,
+                     "measurement,one_way_delay_us,conn,peer,seq,size,"
+                     "origin_ts_us,capture_ts_us\n");
+  sw_out = open_csv(opts.sw_csv,
+                    "session,peer,type,seq,size,first_tx_us,reply_us,rtt_us,"
+                    "transmissions,idle_before_us,result\n");
+  delay_stats_init(&probe_delay);
+  delay_stats_init(&rtt_stats);
+  delay_stats_init(&idle_stats);
+
+  size_t off = PCAP_HDR_SIZE;
+  size_t released = 0;
+  while (off + PCAP_REC_SIZE <= len) {
+    uint32_t rec[4]; // ts_sec, ts_frac, caplen, len
+    memcpy(rec, data + off, sizeof(rec));
+    if (swapped) {
+      for (int i = 0; i < 4; i++) {
+        rec[i] = __builtin_bswap32(rec[i]);
+      }
+    }
+    off += PCAP_REC_SIZE;
+    if (rec[2] > len - off) {
+      fprintf(stderr, "Aviso: captura cortada en el paquete %lu\n",
+              packets + 1);
+      break;
+    }
+    uint64_t ts_us =
+        (uint64_t)rec[0] * 1000000 + (nanos ? rec[1] / 1000 : rec[1]);
+    packets++;
+    capture_bytes += rec[3];
+    handle_frame(linktype, swapped, data + off, rec[2], ts_us);
+    off += rec[2];
+
+    if (off - released >= RELEASE_CHUNK) {
+      size_t upto = off & ~(size_t)(RELEASE_CHUNK - 1);
+      posix_madvise(data + released, upto - released, POSIX_MADV_DONTNEED);
+      released = upto;
+    }
+  }
+
+  for (Flow *f = flow_list; f; f = f->next) {
+    finish_exchange(f);
+  }
+  print_summary();
+
+  int result = 0;
+  FILE *outs[2] = {pdu_out, sw_out};
+  for (int i = 0; i < 2; i++) {
+    if (outs[i] && fclose(outs[i]) != 0) {
+      perror("fclose");
+      result = 1;
+    }
+  }
+  while (flow_list) {
+    Flow *next = flow_list->next;
+    tcp_close(flow_list);
+    free(flow_list);
+    flow_list = next;
+  }
+  munmap(data, len);
+  return result;
+}
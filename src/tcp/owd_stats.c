@@ -0,0 +1,795 @@
+// Estadísticas offline de un CSV de mediciones (los de mediciones/ o el de
+// owd_export) o directamente de un log binario de tcp_server, para corridas
+// de millones de mediciones que plot_delay.py tarda minutos en leer fila por
+// fila.
+//
+// El archivo se mapea con mmap y se parte en un trozo por hilo, cortando en
+// fin de línea (o de registro). Cada hilo recorre el suyo sin copiar: los
+// delays del CSV están en segundos con 6 decimales, así que se leen como
+// microsegundos enteros con un parser a medida en vez de strtod. Cada uno
+// acumula su DelayStats y sus ventanas, y al final se combinan: todos los
+// DelayStats arrancan con la misma base (el primer delay del archivo), así
+// que se suman bucket a bucket.
+//
+// En stdout va el resumen; -j escribe un JSON y -c dos CSV (ventanas e
+// histograma) chicos, para graficar sin volver a leer las mediciones.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "delay_stats.h"
+#include "measlog.h"
+
+#define DEFAULT_WINDOW 1000
+#define MAX_THREADS 256
+// Trozo mínimo por hilo: en archivos chicos no vale la pena repartir
+#define MIN_CHUNK (1 << 20)
+// Una medición con un número disparatado no puede pedir memoria sin límite
+#define MAX_WINDOWS (1 << 24)
+
+// Ventana de mediciones consecutivas: Welford, combinable como DelayStats
+typedef struct {
+  uint64_t count;
+  double mean;
+  double m2;
+  int64_t min_us;
+  int64_t max_us;
+} Window;
+
+typedef struct {
+  pthread_t thread;
+  const char *begin; // CSV: líneas completas; log: registros completos
+  const char *end;
+  uint64_t first_measurement; // Log: número de la primera medición del trozo
+  uint64_t measurements;
+  unsigned long bad_rows;
+  unsigned long unordered; // Mediciones anteriores a la primera del trozo
+  DelayStats stats;
+  Window *win; // Ventanas win_first .. win_first + win_len - 1
+  uint64_t win_first;
+  size_t win_len;
+  size_t win_cap;
+} Worker;
+
+typedef struct {
+  const char *path;
+  const char *json_path;
+  const char *csv_prefix;
+  uint64_t window; // Mediciones por ventana
+  int threads;
+  int deskew; // -s: delay sin el drift estimado por el servidor
+} StatsOptions;
+
+static StatsOptions opts;
+
+// Formato del archivo
+static int binary = 0;
+static size_t record_size = 0;
+static int meas_col = -1;
+static int delay_col = -1;
+
+static uint64_t monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void window_record(Window *w, int64_t delay_us) {
+  if (w->count == 0) {
+    w->min_us = delay_us;
+    w->max_us = delay_us;
+  }
+  w->count++;
+  double d = (double)delay_us - w->mean;
+  w->mean += d / (double)w->count;
+  w->m2 += d * ((double)delay_us - w->mean);
+  if (delay_us < w->min_us) {
+    w->min_us = delay_us;
+  }
+  if (delay_us > w->max_us) {
+    w->max_us = delay_us;
+  }
+}
+
+static void window_merge(Window *dst, const Window *src) {
+  if (src->count == 0) {
+    return;
+  }
+  if (dst->count == 0) {
+    *dst = *src;
+    return;
+  }
+  uint64_t n = dst->count + src->count;
+  double d = src->mean - dst->mean;
+  dst->m2 += src->m2 +
+             d * d * (double)dst->count * (double)src->count / (double)n;
+  dst->mean += d * (double)src->count / (double)n;
+  dst->count = n;
+  if (src->min_us < dst->min_us) {
+    dst->min_us = src->min_us;
+  }
+  if (src->max_us > dst->max_us) {
+    dst->max_us = src->max_us;
+  }
+}
+
+static double window_stddev(const Window *w) {
+  return w->count > 1 ? sqrt(w->m2 / (double)(w->count - 1)) : 0.0;
+}
+
+// Registrar una medición (numeradas desde 1) en su ventana
+static void record(Worker *w, uint64_t measurement, int64_t delay_us) {
+  delay_stats_record(&w->stats, delay_us);
+  w->measurements++;
+
+  uint64_t idx = measurement ? (measurement - 1) / opts.window : 0;
+  if (w->win_len == 0) {
+    w->win_first = idx;
+  }
+  if (idx < w->win_first || idx - w->win_first >= MAX_WINDOWS) {
+    w->unordered++;
+    return;
+  }
+  size_t i = (size_t)(idx - w->win_first);
+  if (i >= w->win_cap) {
+    size_t cap = w->win_cap ? w->win_cap : 64;
+    while (cap <= i) {
+      cap *= 2;
+    }
+    Window *p = realloc(w->win, cap * sizeof(Window));
+    if (!p) {
+      w->unordered++; // Se cuenta en el total igual
+      return;
+    }
+    memset(p + w->win_cap, 0, (cap - w->win_cap) * sizeof(Window));
+    w->win = p;
+    w->win_cap = cap;
+  }
+  if (i >= w->win_len) {
+    w->win_len = i + 1;
+  }
+  window_record(&w->win[i], delay_us);
+}
+
+// Entero sin signo que ocupa todo el campo [p, end)
+static int parse_uint(const char *p, const char *end, uint64_t *out) {
+  uint64_t v = 0;
+  if (p < end && end[-1] == '\r') {
+    end--;
+  }
+  if (p == end || end - p > 19) {
+    return 0;
+  }
+  for (; p < end; p++) {
+    unsigned d = (unsigned)(*p - '0');
+    if (d > 9) {
+      return 0;
+    }
+    v = v * 10 + d;
+  }
+  *out = v;
+  return 1;
+}
+
+// Segundos con decimales ("-0.776530") a microsegundos, redondeando el
+// séptimo decimal. Sin exponente: owd_export y el servidor viejo usan %.6f.
+static int parse_seconds_us(const char *p, const char *end, int64_t *out) {
+  if (p < end && end[-1] == '\r') {
+    end--;
+  }
+  int neg = 0;
+  if (p < end && (*p == '-' || *p == '+')) {
+    neg = *p == '-';
+    p++;
+  }
+  int64_t whole = 0;
+  int digits = 0;
+  for (; p < end && (unsigned)(*p - '0') <= 9; p++, digits++) {
+    if (digits == 12) {
+      return 0; // Más de 11 días de delay: no es un delay
+    }
+    whole = whole * 10 + (*p - '0');
+  }
+  int64_t frac = 0;
+  int decimals = 0;
+  int round_up = 0;
+  if (p < end && *p == '.') {
+    for (p++; p < end && (unsigned)(*p - '0') <= 9; p++) {
+      if (decimals < 6) {
+        frac = frac * 10 + (*p - '0');
+      } else if (decimals == 6) {
+        round_up = *p >= '5';
+      }
+      decimals++;
+    }
+    digits += decimals;
+  }
+  if (digits == 0 || p != end) {
+    return 0;
+  }
+  for (int i = decimals; i < 6; i++) {
+    frac *= 10;
+  }
+  int64_t us = whole * 1000000 + frac + round_up;
+  *out = neg ? -us : us;
+  return 1;
+}
+
+// Medición y delay de una línea [p, eol) del CSV
+static int parse_row(const char *p, const char *eol, uint64_t *measurement,
+                     int64_t *delay_us) {
+  int found = 0;
+  for (int col = 0; p <= eol && found < 2; col++) {
+    const char *next = memchr(p, ',', (size_t)(eol - p));
+    if (!next) {
+      next = eol;
+    }
+    if (col == meas_col) {
+      if (!parse_uint(p, next, measurement)) {
+        return 0;
+      }
+      found++;
+    } else if (col == delay_col) {
+      if (!parse_seconds_us(p, next, delay_us)) {
+        return 0;
+      }
+      found++;
+    }
+    p = next + 1;
+  }
+  return found == 2;
+}
+
+// Delay de un registro del log; 0 si es un alta de conexión
+static int parse_record(const char *p, int64_t *delay_us) {
+  MeasRecord r;
+  memset(&r, 0, sizeof(r));
+  memcpy(&r, p, record_size);
+  if (r.flags & MEASREC_CONN) {
+    return 0;
+  }
+  *delay_us = (int64_t)r.dest_ts - (int64_t)r.origin_ts;
+  if (opts.deskew) {
+    *delay_us -= r.skew_corr_us;
+  }
+  return 1;
+}
+
+static void *count_main(void *arg) {
+  Worker *w = arg;
+  for (const char *p = w->begin; p < w->end; p += record_size) {
+    int64_t delay_us;
+    w->measurements += (uint64_t)parse_record(p, &delay_us);
+  }
+  return NULL;
+}
+
+static void *worker_main(void *arg) {
+  Worker *w = arg;
+  if (binary) {
+    uint64_t measurement = w->first_measurement;
+    for (const char *p = w->begin; p < w->end; p += record_size) {
+      int64_t delay_us;
+      if (parse_record(p, &delay_us)) {
+        record(w, measurement++, delay_us);
+      }
+    }
+    return NULL;
+  }
+
+  const char *p = w->begin;
+  while (p < w->end) {
+    const char *eol = memchr(p, '\n', (size_t)(w->end - p));
+    if (!eol) {
+      eol = w->end;
+    }
+    uint64_t measurement;
+    int64_t delay_us;
+    if (parse_row(p, eol, &measurement, &delay_us)) {
+      record(w, measurement, delay_us);
+    } else if (eol > p && !(eol - p == 1 && *p == '\r')) {
+      w->bad_rows++;
+    }
+    p = eol + 1;
+  }
+  return NULL;
+}
+
+static int run_workers(Worker *workers, int n, void *(*fn)(void *)) {
+  for (int t = 0; t < n; t++) {
+    int err = pthread_create(&workers[t].thread, NULL, fn, &workers[t]);
+    if (err != 0) {
+      errno = err;
+      perror("pthread_create");
+      return -1;
+    }
+  }
+  for (int t = 0; t < n; t++) {
+    pthread_join(workers[t].thread, NULL);
+  }
+  return 0;
+}
+
+// Header del CSV: en qué columnas están la medición y el delay
+static int parse_header(const char *p, const char *eol) {
+  const char *wanted = opts.deskew ? "deskewed_delay_us" : "one_way_delay_us";
+  for (int col = 0; p <= eol; col++) {
+    const char *next = memchr(p, ',', (size_t)(eol - p));
+    if (!next) {
+      next = eol;
+    }
+    size_t len = (size_t)(next - p);
+    if (len > 0 && p[len - 1] == '\r') {
+      len--;
+    }
+    if (len == strlen("measurement") && memcmp(p, "measurement", len) == 0) {
+      meas_col = col;
+    } else if (len == strlen(wanted) && memcmp(p, wanted, len) == 0) {
+      delay_col = col;
+    }
+    p = next + 1;
+  }
+  if (meas_col < 0 || delay_col < 0) {
+    fprintf(stderr, "ERROR: el CSV no tiene las columnas measurement y %s\n",
+            wanted);
+    return -1;
+  }
+  return 0;
+}
+
+// Validar el header del log; devuelve el inicio de los registros
+static const char *open_binary(const char *data, size_t len) {
+  MeasLogHeader hdr;
+  if (len < sizeof(hdr)) {
+    return NULL;
+  }
+  memcpy(&hdr, data, sizeof(hdr));
+  // Como en owd_export: las versiones anteriores tienen registros más cortos
+  size_t expected = sizeof(MeasRecord);
+  if (hdr.version < 3) {
+    expected = offsetof(MeasRecord, kernel_rx_ts);
+  } else if (hdr.version < 4) {
+    expected = offsetof(MeasRecord, send_interval_us);
+  }
+  if (hdr.version < 1 || hdr.version > MEASLOG_VERSION ||
+      hdr.record_size != expected) {
+    fprintf(stderr,
+            "ERROR: log versión %" PRIu32 " con registros de %" PRIu32
+            " bytes (se espera versión <= %d, %zu bytes)\n",
+            hdr.version, hdr.record_size, MEASLOG_VERSION, expected);
+    return NULL;
+  }
+  record_size = hdr.record_size;
+  return data + sizeof(hdr);
+}
+
+// Primer delay válido del archivo: base común de todos los DelayStats
+static int find_base(const char *p, const char *end, int64_t *base_us) {
+  while (p < end) {
+    if (binary) {
+      if (p + record_size <= end && parse_record(p, base_us)) {
+        return 1;
+      }
+      p += record_size;
+      continue;
+    }
+    const char *eol = memchr(p, '\n', (size_t)(end - p));
+    if (!eol) {
+      eol = end;
+    }
+    uint64_t measurement;
+    if (parse_row(p, eol, &measurement, base_us)) {
+      return 1;
+    }
+    p = eol + 1;
+  }
+  return 0;
+}
+
+// Repartir [begin, end) en n trozos que terminan en fin de línea o registro
+static void split(Worker *workers, int n, const char *begin, const char *end) {
+  size_t len = (size_t)(end - begin);
+  const char *p = begin;
+  for (int t = 0; t < n; t++) {
+    workers[t].begin = p;
+    const char *cut = begin + len / (size_t)n * (size_t)(t + 1);
+    if (t == n - 1) {
+      cut = end;
+    } else if (binary) {
+      cut = begin + (size_t)(cut - begin) / record_size * record_size;
+    } else {
+      const char *eol = memchr(cut, '\n', (size_t)(end - cut));
+      cut = eol ? eol + 1 : end;
+    }
+    if (cut < p) {
+      cut = p;
+    }
+    workers[t].end = cut;
+    p = cut;
+  }
+}
+
+static void write_json(FILE *out, const DelayStats *s, const Window *win,
+                       size_t nwin, uint64_t win_first,
+                       unsigned long bad_rows) {
+  fprintf(out, "{\n  \"source\": \"");
+  for (const char *c = opts.path; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      fputc('\\', out);
+    }
+    fputc(*c, out);
+  }
+  fprintf(out, "\",\n  \"delay\": \"%s\",\n",
+          opts.deskew ? "deskewed_delay_us" : "one_way_delay_us");
+  fprintf(out,
+          "  \"count\": %llu,\n  \"invalid_rows\": %lu,\n"
+          "  \"mean_us\": %.3f,\n  \"stddev_us\": %.3f,\n"
+          "  \"min_us\": %lld,\n  \"p50_us\": %lld,\n  \"p90_us\": %lld,\n"
+          "  \"p99_us\": %lld,\n  \"p999_us\": %lld,\n  \"max_us\": %lld,\n",
+          (unsigned long long)s->count, bad_rows, s->mean,
+          delay_stats_stddev(s), (long long)(s->count ? s->min_us : 0),
+          (long long)delay_stats_percentile(s, 0.50),
+          (long long)delay_stats_percentile(s, 0.90),
+          (long long)delay_stats_percentile(s, 0.99),
+          (long long)delay_stats_percentile(s, 0.999),
+          (long long)(s->count ? s->max_us : 0));
+
+  // Columnas como arrays: se grafican directo sin armar listas por fila
+  static const char *const win_keys[] = {"first_measurement", "count",
+                                         "mean_us", "stddev_us", "min_us",
+                                         "max_us"};
+  fprintf(out, "  \"window_size\": %llu,\n  \"windows\": {",
+          (unsigned long long)opts.window);
+  for (size_t k = 0; k < sizeof(win_keys) / sizeof(win_keys[0]); k++) {
+    fprintf(out, "%s\n    \"%s\": [", k ? "," : "", win_keys[k]);
+    int first = 1;
+    for (size_t i = 0; i < nwin; i++) {
+      const Window *w = &win[i];
+      if (w->count == 0) {
+        continue;
+      }
+      fputs(first ? "" : ", ", out);
+      first = 0;
+      switch (k) {
+      case 0:
+        fprintf(out, "%llu",
+                (unsigned long long)((win_first + i) * opts.window + 1));
+        break;
+      case 1:
+        fprintf(out, "%llu", (unsigned long long)w->count);
+        break;
+      case 2:
+        fprintf(out, "%.3f", w->mean);
+        break;
+      case 3:
+        fprintf(out, "%.3f", window_stddev(w));
+        break;
+      case 4:
+        fprintf(out, "%lld", (long long)w->min_us);
+        break;
+      default:
+        fprintf(out, "%lld", (long long)w->max_us);
+        break;
+      }
+    }
+    fputc(']', out);
+  }
+
+  // Buckets no vacíos del histograma, en orden ascendente de delay
+  static const char *const hist_keys[] = {"lo_us", "hi_us", "count"};
+  fprintf(out, "\n  },\n  \"histogram\": {");
+  for (size_t k = 0; k < sizeof(hist_keys) / sizeof(hist_keys[0]); k++) {
+    fprintf(out, "%s\n    \"%s\": [", k ? "," : "", hist_keys[k]);
+    int first = 1;
+    for (int i = 0; i < 2 * DELAY_BUCKETS; i++) {
+      int neg = i < DELAY_BUCKETS;
+      int b = neg ? DELAY_BUCKETS - 1 - i : i - DELAY_BUCKETS;
+      uint64_t count = neg ? s->neg[b] : s->pos[b];
+      if (count == 0) {
+        continue;
+      }
+      int64_t lo, hi;
+      delay_stats_bucket_range(s, b, neg, &lo, &hi);
+      fputs(first ? "" : ", ", out);
+      first = 0;
+      if (k == 0) {
+        fprintf(out, "%lld", (long long)lo);
+      } else if (k == 1) {
+        fprintf(out, "%lld", (long long)hi);
+      } else {
+        fprintf(out, "%llu", (unsigned long long)count);
+      }
+    }
+    fputc(']', out);
+  }
+  fprintf(out, "\n  }\n}\n");
+}
+
+static int write_csvs(const DelayStats *s, const Window *win, size_t nwin,
+                      uint64_t win_first) {
+  char path[4096];
+  snprintf(path, sizeof(path), "%s_ventanas.csv", opts.csv_prefix);
+  FILE *out = fopen(path, "w");
+  if (!out) {
+    perror(path);
+    return -1;
+  }
+  fprintf(out, "window,first_measurement,count,mean_us,stddev_us,min_us,"
+               "max_us\n");
+  for (size_t i = 0; i < nwin; i++) {
+    const Window *w = &win[i];
+    if (w->count > 0) {
+      fprintf(out, "%llu,%llu,%llu,%.3f,%.3f,%lld,%lld\n",
+              (unsigned long long)(win_first + i),
+              (unsigned long long)((win_first + i) * opts.window + 1),
+              (unsigned long long)w->count, w->mean, window_stddev(w),
+              (long long)w->min_us, (long long)w->max_us);
+    }
+  }
+  if (fclose(out) != 0) {
+    perror(path);
+    return -1;
+  }
+
+  snprintf(path, sizeof(path), "%s_histograma.csv", opts.csv_prefix);
+  out = fopen(path, "w");
+  if (!out) {
+    perror(path);
+    return -1;
+  }
+  fprintf(out, "lo_us,hi_us,count\n");
+  for (int i = 0; i < 2 * DELAY_BUCKETS; i++) {
+    int neg = i < DELAY_BUCKETS;
+    int b = neg ? DELAY_BUCKETS - 1 - i : i - DELAY_BUCKETS;
+    uint64_t count = neg ? s->neg[b] : s->pos[b];
+    if (count > 0) {
+      int64_t lo, hi;
+      delay_stats_bucket_range(s, b, neg, &lo, &hi);
+      fprintf(out, "%lld,%lld,%llu\n", (long long)lo, (long long)hi,
+              (unsigned long long)count);
+    }
+  }
+  if (fclose(out) != 0) {
+    perror(path);
+    return -1;
+  }
+  return 0;
+}
+
+static void print_usage(const char *progname) {
+  fprintf(stderr,
+          "Uso: %s <mediciones.csv|log.owd> [-w <mediciones>] [-t <hilos>] "
+          "[-s] [-j <salida.json>] [-c <prefijo>]\n",
+          progname);
+  fprintf(stderr, "\nOpciones:\n");
+  fprintf(stderr, "  -w <n>      Mediciones por ventana (default %d)\n",
+          DEFAULT_WINDOW);
+  fprintf(stderr, "  -t <n>      Hilos (default: uno por CPU)\n");
+  fprintf(stderr, "  -s          Usar el delay sin el drift estimado "
+                  "(deskewed_delay_us)\n");
+  fprintf(stderr, "  -j <arch>   Resumen, ventanas e histograma en JSON\n");
+  fprintf(stderr, "  -c <pref>   Ventanas en <pref>_ventanas.csv e histograma "
+                  "en <pref>_histograma.csv\n");
+}
+
+int main(int argc, char *argv[]) {
+  opts.window = DEFAULT_WINDOW;
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  opts.threads = cpus > 0 ? (int)(cpus < MAX_THREADS ? cpus : MAX_THREADS) : 1;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-s") == 0) {
+      opts.deskew = 1;
+    } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      opts.json_path = argv[++i];
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      opts.csv_prefix = argv[++i];
+    } else if ((strcmp(argv[i], "-w") == 0 || strcmp(argv[i], "-t") == 0) &&
+               i + 1 < argc) {
+      char *endptr;
+      long long val = strtoll(argv[i + 1], &endptr, 10);
+      if (*endptr != '\0' || val < 1 ||
+          (argv[i][1] == 't' && val > MAX_THREADS)) {
+        fprintf(stderr, "ERROR: Valor inválido para %s: %s\n", argv[i],
+                argv[i + 1]);
+        print_usage(argv[0]);
+        return 1;
+      }
+      if (argv[i][1] == 'w') {
+        opts.window = (uint64_t)val;
+      } else {
+        opts.threads = (int)val;
+      }
+      i++;
+    } else if (argv[i][0] == '-' || opts.path) {
+      fprintf(stderr, "ERROR: Parámetro desconocido: %s\n", argv[i]);
+      print_usage(argv[0]);
+      return 1;
+    } else {
+      opts.path = argv[i];
+    }
+  }
+  if (!opts.path) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  int fd = open(opts.path, O_RDONLY);
+  if (fd < 0) {
+    perror(opts.path);
+    return 1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    perror("fstat");
+    close(fd);
+    return 1;
+  }
+  size_t len = (size_t)st.st_size;
+  if (len == 0) {
+    fprintf(stderr, "ERROR: %s está vacío\n", opts.path);
+    close(fd);
+    return 1;
+  }
+  const char *data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  posix_madvise((void *)data, len, POSIX_MADV_SEQUENTIAL);
+  const char *end = data + len;
+
+  const char *body;
+  if (len >= sizeof(MEASLOG_MAGIC) &&
+      memcmp(data, MEASLOG_MAGIC, sizeof(MEASLOG_MAGIC)) == 0) {
+    binary = 1;
+    body = open_binary(data, len);
+    if (!body) {
+      return 1;
+    }
+    // Un registro cortado al final (corte del servidor) no se lee
+    end = body + (size_t)(end - body) / record_size * record_size;
+  } else {
+    const char *eol = memchr(data, '\n', len);
+    if (!eol || parse_header(data, eol) < 0) {
+      if (!eol) {
+        fprintf(stderr, "ERROR: %s no es un CSV de mediciones\n", opts.path);
+      }
+      return 1;
+    }
+    body = eol + 1;
+  }
+
+  int64_t base_us;
+  if (!find_base(body, end, &base_us)) {
+    fprintf(stderr, "ERROR: %s no tiene mediciones\n", opts.path);
+    return 1;
+  }
+
+  int nthreads = opts.threads;
+  size_t chunks = (size_t)(end - body) / MIN_CHUNK + 1;
+  if ((size_t)nthreads > chunks) {
+    nthreads = (int)chunks;
+  }
+  Worker *workers = calloc((size_t)nthreads, sizeof(Worker));
+  if (!workers) {
+    perror("calloc");
+    return 1;
+  }
+  split(workers, nthreads, body, end);
+
+  uint64_t t0 = monotonic_ns();
+  if (binary) {
+    // Las altas de conexión no son mediciones: contar primero las de cada
+    // trozo para saber con qué número arranca el siguiente
+    if (run_workers(workers, nthreads, count_main) < 0) {
+      return 1;
+    }
+    uint64_t next = 1;
+    for (int t = 0; t < nthreads; t++) {
+      workers[t].first_measurement = next;
+      next += workers[t].measurements;
+      workers[t].measurements = 0;
+    }
+  }
+  for (int t = 0; t < nthreads; t++) {
+    delay_stats_init_base(&workers[t].stats, base_us);
+  }
+  if (run_workers(workers, nthreads, worker_main) < 0) {
+    return 1;
+  }
+
+  // Combinar: stats, contadores y ventanas (una ventana puede quedar
+  // partida entre dos trozos)
+  static DelayStats total;
+  delay_stats_init_base(&total, base_us);
+  unsigned long bad_rows = 0, unordered = 0;
+  uint64_t win_first = UINT64_MAX, win_last = 0;
+  for (int t = 0; t < nthreads; t++) {
+    Worker *w = &workers[t];
+    delay_stats_merge(&total, &w->stats);
+    bad_rows += w->bad_rows;
+    unordered += w->unordered;
+    if (w->win_len > 0) {
+      if (w->win_first < win_first) {
+        win_first = w->win_first;
+      }
+      if (w->win_first + w->win_len > win_last) {
+        win_last = w->win_first + w->win_len;
+      }
+    }
+  }
+  size_t nwin = win_first < win_last ? (size_t)(win_last - win_first) : 0;
+  if (nwin > MAX_WINDOWS) {
+    nwin = MAX_WINDOWS; // Trozos con numeraciones sin relación entre sí
+  }
+  Window *win = calloc(nwin ? nwin : 1, sizeof(Window));
+  if (!win) {
+    perror("calloc");
+    return 1;
+  }
+  for (int t = 0; t < nthreads; t++) {
+    Worker *w = &workers[t];
+    for (size_t i = 0; i < w->win_len; i++) {
+      uint64_t idx = w->win_first + i - win_first;
+      if (idx < nwin) {
+        window_merge(&win[idx], &w->win[i]);
+      } else {
+        unordered += w->win[i].count;
+      }
+    }
+    free(w->win);
+  }
+  uint64_t elapsed_ns = monotonic_ns() - t0;
+
+  size_t nonempty = 0;
+  for (size_t i = 0; i < nwin; i++) {
+    nonempty += win[i].count > 0;
+  }
+  printf("Archivo: %s (%s)\n", opts.path,
+         binary ? "log binario de tcp_server" : "CSV");
+  printf("Hilos: %d, análisis en %.3f s (%.1f M mediciones/s)\n", nthreads,
+         elapsed_ns / 1e9,
+         elapsed_ns ? total.count * 1e3 / (double)elapsed_ns : 0.0);
+  delay_stats_print(&total, stdout,
+                    opts.deskew ? "Delay sin drift: " : "Delay one-way: ");
+  printf("Filas inválidas: %lu, fuera de orden (solo en el total): %lu\n",
+         bad_rows, unordered);
+  printf("Ventanas de %llu mediciones: %zu\n",
+         (unsigned long long)opts.window, nonempty);
+
+  int result = 0;
+  if (opts.json_path) {
+    FILE *out = fopen(opts.json_path, "w");
+    if (!out) {
+      perror(opts.json_path);
+      result = 1;
+    } else {
+      write_json(out, &total, win, nwin, win_first, bad_rows);
+      if (fclose(out) != 0) {
+        perror(opts.json_path);
+        result = 1;
+      }
+    }
+  }
+  if (opts.csv_prefix && write_csvs(&total, win, nwin, win_first) < 0) {
+    result = 1;
+  }
+
+  free(win);
+  free(workers);
+  munmap((void *)data, len);
+  return result;
+}
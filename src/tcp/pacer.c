@@ -0,0 +1,57 @@
+#include "pacer.h"
+
+#include <errno.h>
+#include <time.h>
+
+uint64_t pacer_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void pacer_init(Pacer *p, uint64_t spin_ns) {
+  p->start_ns = pacer_now_ns();
+  p->interval_ns = 0;
+  p->spin_ns = spin_ns;
+  p->next_ns = p->start_ns;
+  p->slots = 0;
+  p->late_slots = 0;
+  delay_stats_init(&p->lateness);
+}
+
+void pacer_set_next(Pacer *p, uint64_t offset_ns, uint64_t interval_ns) {
+  p->next_ns = p->start_ns + offset_ns;
+  p->interval_ns = interval_ns;
+}
+
+// Dormir hasta t_ns con un deadline absoluto. -1 si lo cortó una señal.
+static int sleep_until(uint64_t t_ns) {
+  struct timespec ts;
+  ts.tv_sec = (time_t)(t_ns / 1000000000ULL);
+  ts.tv_nsec = (long)(t_ns % 1000000000ULL);
+  int err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+  return (err == EINTR) ? -1 : 0;
+}
+
+int64_t pacer_wait(Pacer *p) {
+  uint64_t deadline = p->next_ns;
+  uint64_t now = pacer_now_ns();
+  if (now < deadline) {
+    if (deadline - now > p->spin_ns &&
+        sleep_until(deadline - p->spin_ns) < 0) {
+      return -1;
+    }
+    while ((now = pacer_now_ns()) < deadline) {
+      // Espera activa de los últimos spin_ns: evita la latencia de
+      // despertar del scheduler a costa de un core
+    }
+  }
+
+  int64_t late = (int64_t)(now - deadline);
+  delay_stats_record(&p->lateness, late / 1000);
+  if ((uint64_t)late > p->interval_ns) {
+    p->late_slots++;
+  }
+  p->slots++;
+  return late;
+}
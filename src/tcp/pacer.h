@@ -0,0 +1,38 @@
+#ifndef TCP_PACER_H
+#define TCP_PACER_H
+
+#include <stdint.h>
+
+#include "delay_stats.h"
+
+// Agenda de envíos con deadlines absolutos: el envío k está programado en
+// start + offset_k (CLOCK_MONOTONIC, offsets de schedule.h), así que ni el
+// tiempo de send() ni los printf ni el oversleep se acumulan en la tasa. Si
+// un envío sale tarde (send bloqueado, scheduler) el siguiente no se corre:
+// se manda enseguida y el retraso se mide contra la hora programada, no
+// contra el envío anterior (sin coordinated omission).
+
+typedef struct {
+  uint64_t start_ns;
+  uint64_t interval_ns; // Separación del próximo envío con el anterior
+  uint64_t spin_ns; // Últimos ns antes del deadline en espera activa
+  uint64_t next_ns; // Deadline del próximo envío
+  unsigned long slots;
+  unsigned long late_slots; // Envíos con más de un intervalo de retraso
+  DelayStats lateness;      // Microsegundos de retraso sobre la agenda
+} Pacer;
+
+uint64_t pacer_now_ns(void);
+
+void pacer_init(Pacer *p, uint64_t spin_ns);
+
+// Programar el próximo envío en start + offset_ns, a interval_ns del
+// anterior (para contar los que salen más de un intervalo tarde)
+void pacer_set_next(Pacer *p, uint64_t offset_ns, uint64_t interval_ns);
+
+// Esperar el deadline del próximo envío y registrar el retraso con el que se
+// despertó. Devuelve el retraso en ns, o -1 si la espera fue interrumpida
+// por una señal (el envío no se consume).
+int64_t pacer_wait(Pacer *p);
+
+#endif
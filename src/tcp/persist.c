@@ -0,0 +1,293 @@
+#include "persist.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "delay_stats.h"
+#include "measlog.h"
+#include "metrics.h"
+
+// Registros por vuelta y espera cuando el ring está vacío
+#define PERSIST_BATCH 1024
+#define PERSIST_IDLE_NS 1000000
+
+// Segundos de la ventana corta de percentiles de las métricas
+#define METRICS_WINDOW_SECONDS 10
+
+#define PEER_BUCKETS 4096
+
+// Por conexión abierta: para imprimir cada medición y calcular los gaps. Se
+// libera con su baja, de la cola de bajas del ring.
+typedef struct PeerState {
+  uint32_t conn;
+  struct PeerState *next; // Cadena del hash
+  char peer[INET_ADDRSTRLEN + 6];
+  unsigned long measurements;
+  int has_prev;
+  uint64_t prev_origin_ts;
+  uint64_t prev_dest_ts;
+} PeerState;
+
+static MeasLog mlog;
+static MeasRing *ring;
+static PersistOptions opts;
+static pthread_t thread;
+static int started = 0;
+static int stopping = 0; // El productor terminó: vaciar y salir
+
+static PeerState *peers[PEER_BUCKETS];
+
+// Delay del segundo en curso, del intervalo y acumulado de toda la corrida:
+// el segundo se suma al intervalo en cada tick y el intervalo al total al
+// reportarlo. Comparten la base del histograma, así que se pueden combinar.
+static DelayStats second_stats;
+static DelayStats interval_stats;
+static DelayStats total_stats;
+// -m: últimos METRICS_WINDOW_SECONDS segundos, para la ventana corta
+static DelayStats window_stats[METRICS_WINDOW_SECONDS];
+static unsigned window_next = 0;
+// -k: demora entre el timestamp del kernel y el de usuario
+static DelayStats rx_lag_stats;
+// Gaps entre PDUs consecutivas de cada conexión, de todas las conexiones
+static DelayStats send_gap_stats;
+static DelayStats arrival_gap_stats;
+
+// Estado de la conexión, creándolo si no existe
+static PeerState *peer_state(uint32_t conn) {
+  PeerState **bucket = &peers[conn % PEER_BUCKETS];
+  for (PeerState *p = *bucket; p; p = p->next) {
+    if (p->conn == conn) {
+      return p;
+    }
+  }
+  PeerState *p = calloc(1, sizeof(PeerState));
+  if (!p) {
+    return NULL;
+  }
+  p->conn = conn;
+  p->next = *bucket;
+  *bucket = p;
+  return p;
+}
+
+static void peer_forget(uint32_t conn) {
+  PeerState **pp = &peers[conn % PEER_BUCKETS];
+  while (*pp && (*pp)->conn != conn) {
+    pp = &(*pp)->next;
+  }
+  if (*pp) {
+    PeerState *p = *pp;
+    *pp = p->next;
+    free(p);
+  }
+}
+
+// Registro MEASREC_MSG: imprimir su mensaje (y los que quedaron sin
+// registro antes)
+static void persist_message(const MeasRecord *rec) {
+  char text[MEAS_MSG_LEN];
+  while (meas_ring_pop_msg(ring, rec->seq, text)) {
+    fputs(text, (rec->flags & MEASREC_STDERR) ? stderr : stdout);
+  }
+}
+
+static void persist_record(const MeasRecord *rec) {
+  if (rec->flags & MEASREC_MSG) {
+    persist_message(rec);
+    return;
+  }
+  measlog_append(&mlog, rec);
+  PeerState *p = peer_state(rec->conn);
+  if (rec->flags & MEASREC_CONN) {
+    if (p) {
+      struct in_addr addr;
+      addr.s_addr = htonl(rec->seq);
+      char ip[INET_ADDRSTRLEN];
+      inet_ntop(AF_INET, &addr, ip, sizeof(ip));
+      snprintf(p->peer, sizeof(p->peer), "%s:%u", ip, rec->size);
+    }
+    return;
+  }
+
+  int64_t raw_delay_us = (int64_t)rec->dest_ts - (int64_t)rec->origin_ts;
+  delay_stats_record(&second_stats, raw_delay_us);
+  if (rec->kernel_rx_ts) {
+    delay_stats_record(&rx_lag_stats,
+                       (int64_t)rec->dest_ts - (int64_t)rec->kernel_rx_ts);
+  }
+  if (!p) {
+    return;
+  }
+  p->measurements++;
+  // Como SeqTracker: las duplicadas no cuentan para los gaps
+  if (!(rec->flags & MEASREC_DUP)) {
+    if (p->has_prev) {
+      delay_stats_record(&send_gap_stats,
+                         (int64_t)(rec->origin_ts - p->prev_origin_ts));
+      delay_stats_record(&arrival_gap_stats,
+                         (int64_t)(rec->dest_ts - p->prev_dest_ts));
+    }
+    p->has_prev = 1;
+    p->prev_origin_ts = rec->origin_ts;
+    p->prev_dest_ts = rec->dest_ts;
+  }
+  if (!opts.quiet) {
+    printf("[%" PRIu32 " %s] Medición %lu: delay = %" PRId64 " us (%.3f ms)\n",
+           rec->conn, p->peer, p->measurements, raw_delay_us,
+           raw_delay_us / 1000.0);
+  }
+}
+
+// Foto de delay y log para las métricas, con el segundo que acaba de cerrar
+static void publish_metrics(void) {
+  static DelayStats merged; // Grande para la pila
+  MetricsPersist *m = metrics_persist_begin();
+  m->log_records = mlog.records;
+  m->log_write_errors = mlog.write_errors;
+
+  metrics_fill_delay(&m->delay[METRICS_WINDOW_1S], &second_stats);
+  merged = second_stats;
+  delay_stats_reset(&merged);
+  for (int i = 0; i < METRICS_WINDOW_SECONDS; i++) {
+    if (window_stats[i].count > 0) {
+      delay_stats_merge(&merged, &window_stats[i]);
+    }
+  }
+  metrics_fill_delay(&m->delay[METRICS_WINDOW_10S], &merged);
+  merged = total_stats;
+  delay_stats_merge(&merged, &interval_stats);
+  metrics_fill_delay(&m->delay[METRICS_WINDOW_TOTAL], &merged);
+  metrics_persist_publish();
+}
+
+// Una vez por segundo: el log se escribe cuando se llena el buffer o acá,
+// así un corte pierde a lo sumo el último segundo
+static void tick(void) {
+  measlog_flush(&mlog);
+  delay_stats_merge(&interval_stats, &second_stats);
+  if (opts.metrics) {
+    window_stats[window_next] = second_stats;
+    window_next = (window_next + 1) % METRICS_WINDOW_SECONDS;
+    publish_metrics();
+  }
+  delay_stats_reset(&second_stats);
+}
+
+static void *persist_main(void *arg) {
+  (void)arg;
+  static MeasRecord batch[PERSIST_BATCH];
+  time_t start = time(NULL);
+  time_t last_tick = start;
+  time_t next_report = start + opts.report_interval;
+  while (1) {
+    // Leer stopping antes de vaciar: lo encolado antes ya es visible
+    int done = __atomic_load_n(&stopping, __ATOMIC_ACQUIRE);
+    size_t n = meas_ring_pop(ring, batch, PERSIST_BATCH);
+    for (size_t i = 0; i < n; i++) {
+      persist_record(&batch[i]);
+    }
+    uint32_t closed;
+    while (meas_ring_pop_closed(ring, &closed)) {
+      peer_forget(closed);
+    }
+
+    time_t now = time(NULL);
+    if (now != last_tick) {
+      tick();
+      last_tick = now;
+    }
+    if (opts.report_interval > 0 && now >= next_report) {
+      char prefix[32];
+      snprintf(prefix, sizeof(prefix), "[%lds] ", (long)(now - start));
+      delay_stats_print(&interval_stats, stdout, prefix);
+      fflush(stdout);
+      delay_stats_merge(&total_stats, &interval_stats);
+      delay_stats_reset(&interval_stats);
+      next_report = now + opts.report_interval;
+    }
+
+    if (n == 0) {
+      if (done) {
+        break;
+      }
+      struct timespec ts = {0, PERSIST_IDLE_NS};
+      nanosleep(&ts, NULL);
+    }
+  }
+  // Mensajes que quedaron sin registro por un overrun
+  char text[MEAS_MSG_LEN];
+  while (meas_ring_pop_msg(ring, ring->msg_head, text)) {
+    fputs(text, stdout);
+  }
+  delay_stats_merge(&interval_stats, &second_stats);
+  delay_stats_merge(&total_stats, &interval_stats);
+  return NULL;
+}
+
+int persist_open(const char *log_path) {
+  delay_stats_init(&second_stats);
+  delay_stats_init(&interval_stats);
+  delay_stats_init(&total_stats);
+  for (int i = 0; i < METRICS_WINDOW_SECONDS; i++) {
+    delay_stats_init(&window_stats[i]);
+  }
+  delay_stats_init(&rx_lag_stats);
+  delay_stats_init(&send_gap_stats);
+  delay_stats_init(&arrival_gap_stats);
+  return measlog_open(&mlog, log_path);
+}
+
+int persist_start(MeasRing *r, const PersistOptions *o) {
+  ring = r;
+  opts = *o;
+  // Las señales las atiende el loop de recepción
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  int err = pthread_create(&thread, NULL, persist_main, NULL);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (err != 0) {
+    errno = err;
+    return -1;
+  }
+  started = 1;
+  return 0;
+}
+
+void persist_stop(void) {
+  if (started) {
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+    started = 0;
+  }
+  if (mlog.buf) {
+    measlog_close(&mlog);
+  }
+}
+
+void persist_print_summary(int kernel_ts) {
+  printf("Registros en el log: %lu (%lu bytes)%s\n", mlog.records,
+         sizeof(MeasLogHeader) + mlog.records * sizeof(MeasRecord),
+         mlog.write_errors ? " CON ERRORES DE ESCRITURA" : "");
+  delay_stats_print(&total_stats, stdout, "Delay one-way: ");
+  if (kernel_ts) {
+    delay_stats_print(&rx_lag_stats, stdout, "Kernel → usuario:  ");
+  }
+  delay_stats_print(&send_gap_stats, stdout, "Gap entre envíos:  ");
+  delay_stats_print(&arrival_gap_stats, stdout, "Gap entre llegadas: ");
+  for (int b = 0; b < PEER_BUCKETS; b++) {
+    while (peers[b]) {
+      PeerState *p = peers[b];
+      peers[b] = p->next;
+      free(p);
+    }
+  }
+}
@@ -0,0 +1,33 @@
+#ifndef TCP_PERSIST_H
+#define TCP_PERSIST_H
+
+#include "measring.h"
+
+// Hilo de persistencia y estadísticas del servidor. El loop de recepción
+// solo toma el timestamp, parsea y encola un MeasRecord por PDU en el ring;
+// este hilo los saca en tandas y hace todo lo que puede tardar: escribir el
+// log, imprimir cada medición y los mensajes de altas, bajas y avisos, las
+// estadísticas de delay y gaps, los reportes de -i y la parte de delay de
+// las métricas. Un disco o una
+// terminal lentos llenan el ring (y se cuentan los descartes) en vez de
+// demorar el próximo recvmsg.
+
+typedef struct {
+  int quiet;            // -q: no imprimir cada medición
+  long report_interval; // -i: segundos entre reportes (0 = solo al final)
+  int metrics;          // -m: publicar la foto de delay cada segundo
+} PersistOptions;
+
+// Abrir el log. Devuelve -1 con errno.
+int persist_open(const char *log_path);
+
+// Lanzar el hilo que consume ring
+int persist_start(MeasRing *ring, const PersistOptions *opts);
+
+// Vaciar el ring (el productor ya no encola), esperar al hilo y cerrar el log
+void persist_stop(void);
+
+// Estadísticas finales del log, el delay y los gaps (después de stop)
+void persist_print_summary(int kernel_ts);
+
+#endif
@@ -0,0 +1,219 @@
+#include "schedule.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "framing.h"
+
+// xorshift64*: rápido y de sobra para sortear intervalos y tamaños
+static uint64_t next_random(Schedule *s) {
+  s->rng ^= s->rng >> 12;
+  s->rng ^= s->rng << 25;
+  s->rng ^= s->rng >> 27;
+  return s->rng * 2685821657736338717ULL;
+}
+
+// Uniforme en [0, 1) con los 53 bits de un double
+static double next_uniform(Schedule *s) {
+  return (double)(next_random(s) >> 11) / 9007199254740992.0;
+}
+
+// Intervalo medio mínimo de una traza, el mismo piso que -d
+#define TRACE_MIN_MEAN_NS 1000
+
+// Un intervalo en ms por línea (como -d); las vacías y las que empiezan con
+// '#' se saltean. Un 0 es una ráfaga, pero en promedio la traza tiene que
+// avanzar: si no, la agenda no llega nunca a -N.
+static int load_trace(Schedule *s, const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return -1;
+  }
+  size_t cap = 0;
+  char *line = NULL;
+  size_t line_cap = 0;
+  uint64_t sum = 0;
+  while (getline(&line, &line_cap, f) > 0) {
+    char *p = line + strspn(line, " \t");
+    if (*p == '#' || *p == '\n' || *p == '\0') {
+      continue;
+    }
+    char *endptr;
+    double ms = strtod(p, &endptr);
+    if (endptr == p || !(ms >= 0 && ms <= 60000)) {
+      fprintf(stderr, "WARN: %s: intervalo inválido, salteando: %s", path,
+              line);
+      continue;
+    }
+    if (s->trace_len == cap) {
+      cap = cap ? cap * 2 : 1024;
+      uint64_t *t = realloc(s->trace_ns, cap * sizeof(uint64_t));
+      if (!t) {
+        free(line);
+        fclose(f);
+        return -1;
+      }
+      s->trace_ns = t;
+    }
+    s->trace_ns[s->trace_len] = (uint64_t)(ms * 1e6 + 0.5);
+    sum += s->trace_ns[s->trace_len];
+    s->trace_len++;
+  }
+  free(line);
+  fclose(f);
+  if (s->trace_len == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  s->mean_ns = sum / s->trace_len;
+  if (s->mean_ns < TRACE_MIN_MEAN_NS) {
+    fprintf(stderr,
+            "ERROR: %s: el intervalo medio de la traza es menor que "
+            "0.001 ms\n",
+            path);
+    errno = EINVAL;
+    return -1;
+  }
+  return 0;
+}
+
+static uint64_t next_interval(Schedule *s) {
+  switch (s->cfg.dist) {
+  case SCHED_POISSON:
+    return (uint64_t)(-(double)s->mean_ns * log(1.0 - next_uniform(s)));
+  case SCHED_UNIFORM:
+    return s->mean_ns / 2 + (uint64_t)(next_uniform(s) * (double)s->mean_ns);
+  case SCHED_TRACE: {
+    uint64_t v = s->trace_ns[s->trace_pos++];
+    if (s->trace_pos == s->trace_len) {
+      s->trace_pos = 0;
+    }
+    return v;
+  }
+  default:
+    return s->mean_ns;
+  }
+}
+
+static uint32_t next_payload(Schedule *s) {
+  switch (s->cfg.size_mode) {
+  case SCHED_SIZE_SWEEP: {
+    uint32_t v = s->next_payload;
+    s->next_payload += s->cfg.sweep_step;
+    if (s->next_payload > MAX_PAYLOAD_SIZE) {
+      s->next_payload = MIN_PAYLOAD_SIZE;
+    }
+    return v;
+  }
+  case SCHED_SIZE_RANDOM:
+    return MIN_PAYLOAD_SIZE +
+           (uint32_t)(next_random(s) %
+                      (MAX_PAYLOAD_SIZE - MIN_PAYLOAD_SIZE + 1));
+  default:
+    return s->cfg.payload;
+  }
+}
+
+// El primer envío sale al inicio; los demás, un intervalo después del
+// anterior. Los offsets se acumulan en ns, así que la agenda no deriva.
+static ScheduleSlot generate(Schedule *s) {
+  ScheduleSlot slot;
+  uint64_t interval_ns = s->mean_ns;
+  if (s->generated > 0) {
+    interval_ns = next_interval(s);
+    s->next_offset_ns += interval_ns;
+  }
+  s->generated++;
+  slot.offset_ns = s->next_offset_ns;
+  uint64_t interval_us = (interval_ns + 500) / 1000;
+  slot.interval_us = interval_us > UINT32_MAX ? UINT32_MAX
+                                              : (uint32_t)interval_us;
+  slot.payload = next_payload(s);
+  return slot;
+}
+
+// Estado inicial de la generación (sin tocar las trazas)
+static void schedule_reset(Schedule *s, uint64_t seed) {
+  s->cfg.seed = seed;
+  s->trace_pos = 0;
+  // splitmix64 de la semilla: semillas parecidas no dan secuencias
+  // parecidas, y el estado de xorshift nunca queda en 0
+  uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  s->rng = (z ^ (z >> 31)) | 1;
+  s->next_offset_ns = 0;
+  s->next_payload = MIN_PAYLOAD_SIZE;
+  s->generated = 0;
+  s->head = 0;
+  s->tail = 0;
+}
+
+int schedule_init(Schedule *s, const ScheduleConfig *cfg) {
+  s->cfg = *cfg;
+  s->trace_ns = NULL;
+  s->trace_len = 0;
+  s->owns_trace = 1;
+  s->mean_ns = cfg->interval_ns;
+  s->size = SCHEDULE_SIZE;
+  s->slots = malloc(SCHEDULE_SIZE * sizeof(ScheduleSlot));
+  schedule_reset(s, cfg->seed);
+  if (!s->slots ||
+      (cfg->dist == SCHED_TRACE && load_trace(s, cfg->trace_path) < 0)) {
+    int err = errno;
+    schedule_free(s);
+    errno = err;
+    return -1;
+  }
+  schedule_fill(s, SCHEDULE_SIZE);
+  return 0;
+}
+
+int schedule_init_like(Schedule *s, const Schedule *model, uint64_t seed,
+                       uint32_t size) {
+  s->cfg = model->cfg;
+  s->trace_ns = model->trace_ns;
+  s->trace_len = model->trace_len;
+  s->owns_trace = 0;
+  s->mean_ns = model->mean_ns;
+  s->size = size;
+  s->slots = malloc(size * sizeof(ScheduleSlot));
+  if (!s->slots) {
+    return -1;
+  }
+  schedule_reset(s, seed);
+  schedule_fill(s, size);
+  return 0;
+}
+
+void schedule_fill(Schedule *s, size_t max) {
+  for (size_t i = 0; i < max && s->tail - s->head < s->size; i++) {
+    s->slots[s->tail++ & (s->size - 1)] = generate(s);
+  }
+}
+
+ScheduleSlot schedule_next(Schedule *s) {
+  if (s->head == s->tail) {
+    return generate(s); // No se repuso a tiempo
+  }
+  return s->slots[s->head++ & (s->size - 1)];
+}
+
+const char *schedule_interval_name(SchedInterval dist) {
+  static const char *const names[] = {"constante", "poisson", "uniforme",
+                                      "traza"};
+  return names[dist];
+}
+
+void schedule_free(Schedule *s) {
+  if (s->owns_trace) {
+    free(s->trace_ns);
+  }
+  s->trace_ns = NULL;
+  s->trace_len = 0;
+  free(s->slots);
+  s->slots = NULL;
+}
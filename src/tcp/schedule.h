@@ -0,0 +1,90 @@
+#ifndef TCP_SCHEDULE_H
+#define TCP_SCHEDULE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Perfil de tráfico del cliente: cuándo sale cada PDU y con cuántos bytes de
+// payload. Un período fijo puede quedar en fase con otro tráfico periódico
+// del camino (y medir siempre el mismo punto de su ciclo); los intervalos
+// aleatorios lo evitan, y variar el tamaño muestra cómo depende el delay de
+// él. La agenda se genera por adelantado en un ring que se repone de a poco
+// después de cada envío: entre el deadline y el send() no se calcula nada.
+
+// Distribución de los intervalos entre envíos (media -d)
+typedef enum {
+  SCHED_CONSTANT, // Todos iguales a -d
+  SCHED_POISSON,  // Exponenciales: llegadas de Poisson
+  SCHED_UNIFORM,  // Uniformes en [d/2, 3d/2]
+  SCHED_TRACE,    // Los de un archivo, en orden y repetidos
+} SchedInterval;
+
+// Tamaños de payload, entre MIN_PAYLOAD_SIZE y MAX_PAYLOAD_SIZE
+typedef enum {
+  SCHED_SIZE_FIXED,  // Siempre el mismo
+  SCHED_SIZE_SWEEP,  // De MIN a MAX de a sweep_step bytes, y de nuevo
+  SCHED_SIZE_RANDOM, // Uniformes
+} SchedSize;
+
+typedef struct {
+  SchedInterval dist;
+  uint64_t interval_ns;   // -d: media de los intervalos
+  const char *trace_path; // SCHED_TRACE: un intervalo en ms por línea
+  SchedSize size_mode;
+  uint32_t payload;    // SCHED_SIZE_FIXED
+  uint32_t sweep_step; // SCHED_SIZE_SWEEP
+  uint64_t seed;
+} ScheduleConfig;
+
+typedef struct {
+  uint64_t offset_ns;   // Desde el inicio de la corrida
+  uint32_t interval_us; // Separación programada con el envío anterior
+  uint32_t payload;     // Bytes de payload
+} ScheduleSlot;
+
+// Slots del ring de una conexión sola (potencia de 2): a 100k PDUs/s son
+// 10 ms de agenda por adelantado. El modo de carga (-c) usa rings más chicos
+// con schedule_init_like, porque cada conexión envía mucho menos.
+#define SCHEDULE_SIZE 1024
+// Slots generados como mucho en cada reposición
+#define SCHEDULE_REFILL 16
+
+typedef struct {
+  ScheduleConfig cfg;
+  uint64_t *trace_ns; // Intervalos del archivo
+  size_t trace_len;
+  int owns_trace; // 0 si los comparte con otra agenda (schedule_init_like)
+  size_t trace_pos;
+  uint64_t mean_ns; // Media de los intervalos (la del archivo en SCHED_TRACE)
+  uint64_t rng;
+  uint64_t next_offset_ns;
+  uint32_t next_payload; // SCHED_SIZE_SWEEP
+  unsigned long generated;
+  uint32_t head, tail; // Contadores libres, como Ring de framing.h
+  uint32_t size;       // Slots del ring, potencia de 2
+  ScheduleSlot *slots;
+} Schedule;
+
+// Cargar el archivo de trazas si hace falta y llenar un ring de
+// SCHEDULE_SIZE slots. Devuelve -1 con errno si no se pudo leer el archivo o
+// reservar el ring, o con errno = EINVAL si no tiene intervalos válidos.
+int schedule_init(Schedule *s, const ScheduleConfig *cfg);
+
+// Otra agenda con la configuración de model, otra semilla y un ring de size
+// slots (potencia de 2). Comparte las trazas de model, que tiene que
+// liberarse después. Devuelve -1 con errno si no se pudo reservar el ring.
+int schedule_init_like(Schedule *s, const Schedule *model, uint64_t seed,
+                       uint32_t size);
+
+// Próximo slot de la agenda
+ScheduleSlot schedule_next(Schedule *s);
+
+// Reponer hasta max slots (sin pasarse del tamaño del ring)
+void schedule_fill(Schedule *s, size_t max);
+
+// Nombres para mostrar
+const char *schedule_interval_name(SchedInterval dist);
+
+void schedule_free(Schedule *s);
+
+#endif
@@ -0,0 +1,100 @@
+#include "seqtrack.h"
+
+#include <string.h>
+
+#include "measlog.h"
+
+void seq_tracker_init(SeqTracker *t) { memset(t, 0, sizeof(*t)); }
+
+static int seen_get(const SeqTracker *t, uint32_t seq) {
+  uint32_t bit = seq % SEQ_WINDOW;
+  return (t->seen[bit / 64] >> (bit % 64)) & 1;
+}
+
+static void seen_set(SeqTracker *t, uint32_t seq, int on) {
+  uint32_t bit = seq % SEQ_WINDOW;
+  if (on) {
+    t->seen[bit / 64] |= 1ULL << (bit % 64);
+  } else {
+    t->seen[bit / 64] &= ~(1ULL << (bit % 64));
+  }
+}
+
+static uint16_t check_sequence(SeqTracker *t, uint32_t seq) {
+  if (!t->has_prev || seq == t->expected_seq) {
+    seen_set(t, seq, 1);
+    t->expected_seq = seq + 1;
+    return 0;
+  }
+  // Diferencia con signo: sobrevive a que seq dé la vuelta
+  int32_t ahead = (int32_t)(seq - t->expected_seq);
+  if (ahead > 0) {
+    // Las salteadas salen de la ventana como no recibidas
+    if (ahead >= SEQ_WINDOW) {
+      memset(t->seen, 0, sizeof(t->seen));
+    } else {
+      for (uint32_t s = t->expected_seq; s != seq; s++) {
+        seen_set(t, s, 0);
+      }
+    }
+    seen_set(t, seq, 1);
+    t->missing += (unsigned long)ahead;
+    t->expected_seq = seq + 1;
+    return MEASREC_SEQ_GAP;
+  }
+  if (-ahead <= SEQ_WINDOW && seen_get(t, seq)) {
+    t->duplicates++;
+    return MEASREC_DUP;
+  }
+  // Una de las que faltaban (o tan vieja que ya no se puede saber)
+  if (-ahead <= SEQ_WINDOW) {
+    seen_set(t, seq, 1);
+  }
+  t->reordered++;
+  if (t->missing > 0) {
+    t->missing--;
+  }
+  return MEASREC_REORDER;
+}
+
+SeqSample seq_tracker_update(SeqTracker *t, uint32_t seq, uint64_t origin_us,
+                             uint64_t dest_us, uint32_t interval_us) {
+  SeqSample s;
+  memset(&s, 0, sizeof(s));
+  s.events = check_sequence(t, seq);
+  if (s.events & MEASREC_DUP) {
+    return s;
+  }
+
+  if (t->has_prev) {
+    s.has_gap = 1;
+    s.send_gap_us = (int64_t)(origin_us - t->prev_origin_us);
+    s.arrival_gap_us = (int64_t)(dest_us - t->prev_dest_us);
+    int64_t d = s.arrival_gap_us - s.send_gap_us;
+    t->jitter_us += ((double)(d < 0 ? -d : d) - t->jitter_us) / 16.0;
+
+    if (interval_us > 0) {
+      int64_t interval = interval_us;
+      if (s.send_gap_us > SEQ_STALL_FACTOR * interval) {
+        s.events |= MEASREC_SEND_STALL;
+        t->send_stalls++;
+      }
+      if (d > interval) {
+        s.events |= MEASREC_RECV_STALL;
+        t->recv_stalls++;
+      }
+      int compressed = s.arrival_gap_us < interval / SEQ_BURST_DIVISOR &&
+                       s.send_gap_us >= interval / 2;
+      if (compressed) {
+        s.events |= MEASREC_BURST;
+        t->bursts += !t->in_burst;
+      }
+      t->in_burst = compressed;
+    }
+  }
+
+  t->has_prev = 1;
+  t->prev_origin_us = origin_us;
+  t->prev_dest_us = dest_us;
+  return s;
+}
@@ -0,0 +1,61 @@
+#ifndef TCP_SEQTRACK_H
+#define TCP_SEQTRACK_H
+
+#include <stdint.h>
+
+// Seguimiento de la secuencia y los tiempos de llegada de una conexión de
+// sonda, PDU por PDU.
+//
+// Entre cada PDU y la anterior en orden de llegada:
+//   gap de envío   S = origin_i - origin_{i-1}  (reloj del cliente)
+//   gap de llegada R = dest_i - dest_{i-1}      (reloj del servidor)
+//   D = R - S  (cuánto cambió el delay; el offset entre relojes se cancela)
+// El jitter es el de RFC 3550: J += (|D| - J) / 16.
+//
+// Con el intervalo programado del cliente (V2_FLAG_INTERVAL) además se
+// marcan eventos (flags MEASREC_* del log):
+//   envío demorado:  S > SEQ_STALL_FACTOR intervalos (el cliente se trabó)
+//   llegada demorada: D > un intervalo (la red o TCP retuvieron la PDU)
+//   ráfaga:          R < intervalo / SEQ_BURST_DIVISOR con S >= medio
+//                    intervalo (PDUs retenidas que se liberan juntas)
+
+#define SEQ_STALL_FACTOR 2
+#define SEQ_BURST_DIVISOR 4
+
+// Ventana de seqs recientes (bitmap) para separar duplicadas de atrasadas.
+// En TCP nunca hay ni unas ni otras; en UDP sí.
+#define SEQ_WINDOW 1024
+
+typedef struct {
+  int has_prev;
+  uint32_t expected_seq; // Siguiente seq en orden
+  uint64_t seen[SEQ_WINDOW / 64]; // Bit seq % SEQ_WINDOW: ya recibida
+  uint64_t prev_origin_us;
+  uint64_t prev_dest_us;
+  double jitter_us;
+  int in_burst;
+  unsigned long missing;    // PDUs salteadas por la secuencia
+  unsigned long reordered;  // Llegadas con seq menor que la esperada
+  unsigned long duplicates; // seq ya recibida (dentro de la ventana)
+  unsigned long send_stalls;
+  unsigned long recv_stalls;
+  unsigned long bursts; // Rachas de llegadas pegadas
+} SeqTracker;
+
+// Resultado de una PDU
+typedef struct {
+  int has_gap; // Hay PDU anterior: los gaps son válidos
+  int64_t send_gap_us;
+  int64_t arrival_gap_us;
+  uint16_t events; // MEASREC_*
+} SeqSample;
+
+void seq_tracker_init(SeqTracker *t);
+
+// Registrar una PDU. Las duplicadas devuelven solo MEASREC_DUP, sin tocar
+// gaps ni jitter. interval_us = 0 si el cliente no lo informa (sin
+// detección de demoras ni ráfagas).
+SeqSample seq_tracker_update(SeqTracker *t, uint32_t seq, uint64_t origin_us,
+                             uint64_t dest_us, uint32_t interval_us);
+
+#endif
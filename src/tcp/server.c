@@ -1,31 +1,120 @@
 #include <arpa/inet.h>
 #include <errno.h>
-#include <inttypes.h>
+#include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "common.h"
+#include "framing.h"
+#include "measlog.h"
+#include "measring.h"
+#include "metrics.h"
+#include "persist.h"
+#include "seqtrack.h"
+#include "skew.h"
+#include "tstamp.h"
 
 #define SERVER_PORT 20252
 
-#define MIN_PAYLOAD_SIZE 500
-#define MAX_PAYLOAD_SIZE 1000
-// Tamaño mínimo de PDU: 8 bytes timestamp + 500 payload + 1 delimitador
-#define MIN_PDU_SIZE (8 + MIN_PAYLOAD_SIZE + 1)
-#define MAX_PDU_SIZE (8 + MAX_PAYLOAD_SIZE + 1)
-
-// Buffer para lecturas parciales de TCP (debe poder contener varias PDUs)
-#define RECV_BUF_SIZE 16384
+// Eventos por epoll_wait y lecturas por conexión en cada vuelta: una conexión
+// con mucho tráfico no demora a las demás más de READS_PER_EVENT recvmsg()
+#define MAX_EVENTS 256
+#define READS_PER_EVENT 4
+
+// Cada cuántos segundos imprimir las estadísticas del intervalo (-i)
+#define DEFAULT_REPORT_INTERVAL 10
+
+// Respuestas de eco pendientes de enviar por conexión; si el cliente no las
+// lee y se llena, las siguientes se descartan en vez de bloquear el loop
+#define ECHO_OUT_SIZE (32 * V2_ECHO_SIZE)
+
+// Flujos UDP: se dan de baja tras este tiempo sin datagramas. Cualquier
+// origen crea uno con un datagrama válido, así que hay un tope: pasado ese
+// número, los datagramas de orígenes nuevos se descartan y se cuentan.
+#define UDP_IDLE_TIMEOUT 10
+#define UDP_MAX_FLOWS 4096
+#define UDP_FLOW_BUCKETS 1024
+// Datagramas por vuelta del loop, como READS_PER_EVENT
+#define UDP_READS_PER_EVENT 64
+
+// Estado común de cada sonda: conexión TCP (TcpConn) o flujo UDP (UdpFlow,
+// mismo origen ip:puerto), en la lista de abiertas
+typedef struct Connection {
+  int udp;
+  uint32_t id; // Orden de aceptación, etiqueta las mediciones en el log
+  char peer[INET_ADDRSTRLEN + 6]; // "ip:puerto"
+  unsigned long measurements;
+  SkewEstimator skew; // Drift entre el reloj del cliente y el nuestro
+  SeqTracker seq;     // Secuencia, jitter y eventos de envío / llegada
+  // -k: timestamp del kernel de la última lectura. Las PDUs se procesan
+  // después de cada lectura, así que las que se completan son justo las que
+  // terminan en los bytes [tail anterior, tail) que trajo: les corresponde
+  // este timestamp (el del último segmento copiado, una cota superior para
+  // las PDUs que llegaron en segmentos anteriores de la misma lectura).
+  uint64_t kernel_rx_ts;
+  // Timestamp de usuario de la última lectura, tomado apenas vuelve
+  // recvmsg(): procesar las PDUs anteriores de la misma lectura no lo demora
+  uint64_t rx_ts;
+  struct Connection *prev, *next; // Lista de conexiones abiertas
+} Connection;
+
+// Conexión TCP: el stream necesita el ring de framing y una cola de ecos
+typedef struct {
+  Connection c; // Primero: un TcpConn * también es un Connection *
+  int fd;
+  FrameParser parser;         // Ring de recepción y framing v1 / v2
+  uint8_t out[ECHO_OUT_SIZE]; // Ecos pendientes
+  size_t out_len;
+  int want_write; // Registrado con EPOLLOUT
+} TcpConn;
+
+// Flujo UDP: cada datagrama es una PDU completa, sin ring ni cola de ecos
+typedef struct UdpFlow {
+  Connection c; // Primero, como en TcpConn
+  struct sockaddr_in addr;
+  struct UdpFlow *hnext; // Cadena del hash de flujos
+  time_t last_rx;        // Último datagrama
+} UdpFlow;
 
 // Flag para shutdown graceful
 static volatile sig_atomic_t g_running = 1;
 
+// Contadores globales. Las mediciones van por el ring al hilo de
+// persistencia (persist.h), que escribe el log y calcula el delay.
+static MeasRing ring;
+static int kernel_ts = 0; // -k: timestamps de recepción del kernel
+static unsigned long measurement_idx = 0;
+static unsigned long invalid_pdus = 0;
+static uint32_t next_conn_id = 0;
+static unsigned long open_conns = 0;
+static unsigned long max_open_conns = 0;
+static unsigned long echoes_sent = 0;
+static unsigned long echoes_dropped = 0;
+static Connection *conns = NULL;
+static UdpFlow *udp_flows[UDP_FLOW_BUCKETS];
+static unsigned long udp_open_flows = 0;
+static unsigned long udp_datagrams = 0;
+static unsigned long udp_flow_drops = 0; // Datagramas pasado UDP_MAX_FLOWS
+static unsigned long long bytes_received = 0;
+static int metrics_port = 0;
+// Contadores de SeqTracker de las conexiones ya cerradas
+static SeqTracker seq_totals;
+// Bajas que no entraron en la cola del ring; se reintentan en cada vuelta
+static uint32_t *closed_backlog = NULL;
+static size_t closed_backlog_len = 0;
+static size_t closed_backlog_cap = 0;
+
 static void signal_handler(int sig) {
   (void)sig;
   g_running = 0;
@@ -42,29 +131,606 @@ static void setup_signal_handlers(void) {
   sigaction(SIGTERM, &sa, NULL);
 }
 
+static int set_nonblocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  return (flags < 0) ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+// Un descriptor por sonda: subir el límite blando hasta el duro
+static void raise_fd_limit(void) {
+  struct rlimit rl;
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+    rl.rlim_cur = rl.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &rl) < 0) {
+      perror("setrlimit");
+    }
+  }
+}
+
+// perror() sin escribir en la terminal desde el loop de recepción: el
+// mensaje lo imprime el hilo de persistencia
+static void report_error(const char *what) {
+  meas_ring_printf(&ring, UINT32_MAX, MEASREC_STDERR, "%s: %s\n", what,
+                   strerror(errno));
+}
+
+// Reintentar las bajas pendientes, en orden, mientras haya lugar
+static void flush_closed(void) {
+  size_t done = 0;
+  while (done < closed_backlog_len &&
+         meas_ring_push_closed(&ring, closed_backlog[done]) == 0) {
+    done++;
+  }
+  closed_backlog_len -= done;
+  memmove(closed_backlog, closed_backlog + done,
+          closed_backlog_len * sizeof(uint32_t));
+}
+
+// Avisar la baja al hilo de persistencia, que libera el estado de la
+// conexión. Si su cola está llena se guarda para la próxima vuelta: perderla
+// dejaría ese estado hasta el final.
+static void queue_closed(uint32_t id) {
+  flush_closed();
+  if (closed_backlog_len == 0 && meas_ring_push_closed(&ring, id) == 0) {
+    return;
+  }
+  if (closed_backlog_len == closed_backlog_cap) {
+    size_t cap = closed_backlog_cap ? closed_backlog_cap * 2 : 256;
+    uint32_t *b = realloc(closed_backlog, cap * sizeof(uint32_t));
+    if (!b) {
+      report_error("bajas pendientes");
+      return;
+    }
+    closed_backlog = b;
+    closed_backlog_cap = cap;
+  }
+  closed_backlog[closed_backlog_len++] = id;
+}
+
+// Registrar la medición de una PDU completa con el timestamp de su lectura.
+// Lo que puede tardar (log, salida, estadísticas) queda para el hilo de
+// persistencia: acá solo se encola el registro.
+static void record_measurement(Connection *c, const ProbePdu *pdu) {
+  // Destination Timestamp
+  uint64_t dest_ts = c->rx_ts;
+  int64_t raw_delay_us = (int64_t)dest_ts - (int64_t)pdu->origin_ts;
+
+  measurement_idx++;
+  c->measurements++;
+  bytes_received += pdu->len;
+  MeasRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  rec.origin_ts = pdu->origin_ts;
+  rec.dest_ts = dest_ts;
+  rec.seq = pdu->seq;
+  rec.conn = c->id;
+  rec.size = (uint16_t)pdu->len;
+  rec.skew_corr_us = (int32_t)skew_update(&c->skew, pdu->origin_ts,
+                                          raw_delay_us);
+  rec.kernel_rx_ts = c->kernel_rx_ts;
+  SeqSample ss = seq_tracker_update(&c->seq, pdu->seq, pdu->origin_ts,
+                                    dest_ts, pdu->send_interval_us);
+  rec.flags = ss.events;
+  rec.send_interval_us = pdu->send_interval_us;
+  rec.jitter_us = (uint32_t)(c->seq.jitter_us + 0.5);
+  meas_ring_push(&ring, &rec);
+}
+
+static void set_want_write(int epfd, TcpConn *t, int want) {
+  if (t->want_write == want) {
+    return;
+  }
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | (want ? EPOLLOUT : 0);
+  ev.data.ptr = t;
+  if (epoll_ctl(epfd, EPOLL_CTL_MOD, t->fd, &ev) == 0) {
+    t->want_write = want;
+  }
+}
+
+// Enviar sin bloquear los ecos pendientes; lo que no entra en el socket
+// queda para cuando epoll avise que se puede escribir
+static void flush_output(int epfd, TcpConn *t) {
+  while (t->out_len > 0) {
+    ssize_t n = send(t->fd, t->out, t->out_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        // El error se ve en el próximo recvmsg(), que cierra la conexión
+        t->out_len = 0;
+      }
+      break;
+    }
+    t->out_len -= (size_t)n;
+    memmove(t->out, t->out + n, t->out_len);
+  }
+  set_want_write(epfd, t, t->out_len > 0);
+}
+
+// Responder una PDU con V2_FLAG_ECHO: t1 del cliente, t2 de recepción y t3
+// tomado justo antes de pasarle el eco al kernel
+static void send_echo(int epfd, TcpConn *t, const ProbePdu *pdu,
+                      uint64_t rx_ts) {
+  if (t->out_len + V2_ECHO_SIZE > sizeof(t->out)) {
+    echoes_dropped++;
+    return;
+  }
+  frame_v2_echo(t->out + t->out_len, pdu->seq, pdu->origin_ts, rx_ts,
+                current_time_micros());
+  t->out_len += V2_ECHO_SIZE;
+  echoes_sent++;
+  flush_output(epfd, t);
+}
+
+// Procesar todas las PDUs completas del ring. Devuelve -1 si se perdió el
+// framing v2 y hay que cerrar la conexión.
+static int process_frames(int epfd, TcpConn *t) {
+  Connection *c = &t->c;
+  ProbePdu pdu;
+  FrameResult r;
+  while ((r = frame_parser_next(&t->parser, &pdu)) != FRAME_NEED_MORE) {
+    if (r == FRAME_OK && (pdu.flags & V2_FLAG_ECHO_REPLY)) {
+      meas_ring_printf(&ring, c->id, MEASREC_STDERR,
+                       "WARN: [%u %s] Eco recibido del cliente, "
+                       "descartando.\n",
+                       c->id, c->peer);
+      invalid_pdus++;
+    } else if (r == FRAME_OK) {
+      record_measurement(c, &pdu);
+      if (pdu.flags & V2_FLAG_ECHO) {
+        send_echo(epfd, t, &pdu, c->rx_ts);
+      }
+    } else if (r == FRAME_INVALID) {
+      meas_ring_printf(&ring, c->id, MEASREC_STDERR,
+                       "WARN: [%u %s] PDU sin delimitador en %d bytes. "
+                       "Descartando %u bytes.\n",
+                       c->id, c->peer, V1_MAX_PDU_SIZE, pdu.len);
+      invalid_pdus++;
+    } else {
+      meas_ring_printf(&ring, c->id, MEASREC_STDERR,
+                       "ERROR: [%u %s] Header v2 inválido.\n", c->id,
+                       c->peer);
+      invalid_pdus++;
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static uint32_t udp_flow_hash(const struct sockaddr_in *addr) {
+  uint32_t h = addr->sin_addr.s_addr * 2654435761u ^ addr->sin_port;
+  return (h ^ (h >> 16)) % UDP_FLOW_BUCKETS;
+}
+
+static void udp_flow_unlink(UdpFlow *f) {
+  UdpFlow **pp = &udp_flows[udp_flow_hash(&f->addr)];
+  while (*pp != f) {
+    pp = &(*pp)->hnext;
+  }
+  *pp = f->hnext;
+  udp_open_flows--;
+}
+
+// Dar de baja la conexión. El resumen lo imprime el hilo de persistencia,
+// que con la baja olvida su estado.
+static void close_connection(int epfd, Connection *c, const char *reason) {
+  char version[8] = "";
+  if (!c->udp) {
+    snprintf(version, sizeof(version), ", v%d",
+             (int)((TcpConn *)c)->parser.version);
+  }
+  const SeqTracker *t = &c->seq;
+  meas_ring_printf(&ring, c->id, 0,
+                   "%s %u (%s%s) %s: %lu mediciones, skew %.3f ppm en "
+                   "%.1f s\n"
+                   "  jitter %.1f us, %lu faltantes, %lu fuera de orden, %lu "
+                   "duplicadas, %lu envíos y %lu llegadas demorados, %lu "
+                   "ráfagas\n",
+                   c->udp ? "Flujo UDP" : "Conexión", c->id, c->peer, version,
+                   reason, c->measurements, skew_ppm(&c->skew),
+                   skew_span_us(&c->skew) / 1e6, t->jitter_us, t->missing,
+                   t->reordered, t->duplicates, t->send_stalls,
+                   t->recv_stalls, t->bursts);
+  queue_closed(c->id);
+  seq_totals.missing += t->missing;
+  seq_totals.reordered += t->reordered;
+  seq_totals.duplicates += t->duplicates;
+  seq_totals.send_stalls += t->send_stalls;
+  seq_totals.recv_stalls += t->recv_stalls;
+  seq_totals.bursts += t->bursts;
+  if (c->udp) {
+    udp_flow_unlink((UdpFlow *)c);
+  } else {
+    TcpConn *t = (TcpConn *)c;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, t->fd, NULL);
+    close(t->fd);
+  }
+  if (c->prev) {
+    c->prev->next = c->next;
+  } else {
+    conns = c->next;
+  }
+  if (c->next) {
+    c->next->prev = c->prev;
+  }
+  skew_free(&c->skew);
+  free(c); // El TcpConn o UdpFlow entero
+  open_conns--;
+}
+
+// Leer lo disponible (sin bloquear y con tope por vuelta) directamente en el
+// ring de la conexión y procesarlo. Con -k cada lectura trae además el
+// timestamp de recepción del kernel.
+static void handle_readable(int epfd, TcpConn *t) {
+  Connection *c = &t->c;
+  for (int r = 0; r < READS_PER_EVENT; r++) {
+    struct iovec iov[2];
+    char control[TSTAMP_CONTROL_SIZE];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = (size_t)frame_parser_iov(&t->parser, iov);
+    if (kernel_ts) {
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+    }
+    ssize_t n = recvmsg(t->fd, &msg, 0);
+    c->rx_ts = current_time_micros();
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return;
+      }
+      report_error("recvmsg");
+      close_connection(epfd, c, "con error");
+      return;
+    }
+    if (n == 0) {
+      close_connection(epfd, c, "cerrada por el cliente");
+      return;
+    }
+    if (kernel_ts) {
+      c->kernel_rx_ts = tstamp_rx_from_msg(&msg);
+    }
+    frame_parser_commit(&t->parser, (size_t)n);
+    if (process_frames(epfd, t) < 0) {
+      close_connection(epfd, c, "cerrada por framing inválido");
+      return;
+    }
+  }
+}
+
+// Inicializar la parte común de una conexión TCP o flujo UDP, registrar su
+// alta en el log y agregarla a la lista
+static void open_connection(Connection *c, int udp,
+                            const struct sockaddr_in *addr) {
+  c->udp = udp;
+  c->id = next_conn_id++;
+  c->measurements = 0;
+  c->kernel_rx_ts = 0;
+  c->rx_ts = 0;
+  skew_init(&c->skew);
+  seq_tracker_init(&c->seq);
+  char ip[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &addr->sin_addr, ip, sizeof(ip));
+  snprintf(c->peer, sizeof(c->peer), "%s:%d", ip, ntohs(addr->sin_port));
+
+  // Registro de alta para que owd_export pueda mostrar ip:puerto
+  MeasRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  rec.dest_ts = current_time_micros();
+  rec.seq = ntohl(addr->sin_addr.s_addr);
+  rec.conn = c->id;
+  rec.size = ntohs(addr->sin_port);
+  rec.flags = MEASREC_CONN | (c->udp ? MEASREC_UDP : 0);
+  meas_ring_push(&ring, &rec);
+
+  c->prev = NULL;
+  c->next = conns;
+  if (conns) {
+    conns->prev = c;
+  }
+  conns = c;
+  open_conns++;
+  if (open_conns > max_open_conns) {
+    max_open_conns = open_conns;
+  }
+  meas_ring_printf(&ring, c->id, 0, "%s %u desde %s (abiertas: %lu)\n",
+                   c->udp ? "Flujo UDP" : "Conexión", c->id, c->peer,
+                   open_conns);
+}
+
+// Aceptar todas las conexiones pendientes
+static void handle_accept(int epfd, int listen_fd) {
+  while (1) {
+    struct sockaddr_in client_addr;
+    socklen_t client_len = sizeof(client_addr);
+    int fd = accept(listen_fd, (struct sockaddr *)&client_addr, &client_len);
+    if (fd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        report_error("accept");
+      }
+      return;
+    }
+
+    TcpConn *t = malloc(sizeof(TcpConn));
+    if (!t || set_nonblocking(fd) < 0) {
+      report_error("nueva conexión");
+      free(t);
+      close(fd);
+      continue;
+    }
+    // Los ecos son segmentos chicos: que Nagle no los retenga
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    if (kernel_ts && tstamp_enable_rx(fd) < 0) {
+      report_error("setsockopt SO_TIMESTAMPING");
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = t;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      report_error("epoll_ctl");
+      free(t);
+      close(fd);
+      continue;
+    }
+    t->fd = fd;
+    frame_parser_init(&t->parser);
+    t->out_len = 0;
+    t->want_write = 0;
+    open_connection(&t->c, 0, &client_addr);
+  }
+}
+
+// Responder un eco por UDP: un datagrama, sin cola (si no entra se descarta)
+static void send_udp_echo(int udp_fd, UdpFlow *f, const ProbePdu *pdu,
+                          uint64_t rx_ts) {
+  uint8_t out[V2_ECHO_SIZE];
+  frame_v2_echo(out, pdu->seq, pdu->origin_ts, rx_ts, current_time_micros());
+  if (sendto(udp_fd, out, sizeof(out), MSG_DONTWAIT,
+             (const struct sockaddr *)&f->addr, sizeof(f->addr)) < 0) {
+    echoes_dropped++;
+    return;
+  }
+  echoes_sent++;
+}
+
+// Flujo UDP del origen, creándolo con el primer datagrama válido. NULL si
+// no hay memoria o ya hay UDP_MAX_FLOWS abiertos.
+static UdpFlow *udp_flow(const struct sockaddr_in *addr) {
+  uint32_t h = udp_flow_hash(addr);
+  for (UdpFlow *f = udp_flows[h]; f; f = f->hnext) {
+    if (f->addr.sin_addr.s_addr == addr->sin_addr.s_addr &&
+        f->addr.sin_port == addr->sin_port) {
+      return f;
+    }
+  }
+  if (udp_open_flows >= UDP_MAX_FLOWS) {
+    udp_flow_drops++;
+    return NULL;
+  }
+  UdpFlow *f = malloc(sizeof(UdpFlow));
+  if (!f) {
+    report_error("nuevo flujo UDP");
+    return NULL;
+  }
+  f->addr = *addr;
+  f->last_rx = time(NULL);
+  f->hnext = udp_flows[h];
+  udp_flows[h] = f;
+  udp_open_flows++;
+  open_connection(&f->c, 1, addr);
+  return f;
+}
+
+// Leer los datagramas pendientes: cada uno es una PDU v2 completa, así que
+// no hay ring ni framing que recuperar, y una pérdida no demora a las
+// siguientes
+static void handle_udp(int udp_fd) {
+  for (int r = 0; r < UDP_READS_PER_EVENT; r++) {
+    uint8_t buf[V2_MAX_PDU_SIZE + 1]; // +1: detectar datagramas de más
+    struct iovec iov = {.iov_base = buf, .iov_len = sizeof(buf)};
+    char control[TSTAMP_CONTROL_SIZE];
+    struct sockaddr_in addr;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &addr;
+    msg.msg_namelen = sizeof(addr);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (kernel_ts) {
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+    }
+    ssize_t n = recvmsg(udp_fd, &msg, MSG_DONTWAIT);
+    uint64_t rx_ts = current_time_micros();
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        report_error("recvmsg UDP");
+      }
+      return;
+    }
+    udp_datagrams++;
+
+    ProbePdu pdu;
+    if (frame_v2_datagram(buf, (size_t)n, &pdu) != FRAME_OK ||
+        (pdu.flags & V2_FLAG_ECHO_REPLY)) {
+      invalid_pdus++;
+      continue;
+    }
+    UdpFlow *f = udp_flow(&addr);
+    if (!f) {
+      continue;
+    }
+    f->c.kernel_rx_ts = kernel_ts ? tstamp_rx_from_msg(&msg) : 0;
+    f->c.rx_ts = rx_ts;
+    f->last_rx = time(NULL);
+    record_measurement(&f->c, &pdu);
+    if (pdu.flags & V2_FLAG_ECHO) {
+      send_udp_echo(udp_fd, f, &pdu, rx_ts);
+    }
+  }
+}
+
+// Dar de baja los flujos UDP sin datagramas en UDP_IDLE_TIMEOUT segundos
+static void expire_udp_flows(int epfd, time_t now) {
+  Connection *c = conns;
+  while (c) {
+    Connection *next = c->next;
+    if (c->udp && now - ((UdpFlow *)c)->last_rx >= UDP_IDLE_TIMEOUT) {
+      close_connection(epfd, c, "inactivo");
+    }
+    c = next;
+  }
+}
+
+// Socket UDP en el mismo puerto para las sondas UDP. Devuelve -1 con errno.
+static int open_udp_socket(void) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(SERVER_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      set_nonblocking(fd) < 0) {
+    int err = errno;
+    close(fd);
+    errno = err;
+    return -1;
+  }
+  // Sin control de flujo, una ráfaga que no entra en el buffer se pierde:
+  // pedir más (el kernel lo limita a rmem_max)
+  int rcvbuf = 4 << 20;
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+  if (kernel_ts && tstamp_enable_rx(fd) < 0) {
+    perror("setsockopt SO_TIMESTAMPING");
+  }
+  return fd;
+}
+
+// Armar la foto de los contadores de recepción; el delay y el log los
+// publica el hilo de persistencia
+static void publish_metrics(void) {
+  MetricsSnapshot *m = metrics_begin();
+  m->timestamp_ms = current_time_micros() / 1000;
+  m->pdus_valid = measurement_idx;
+  m->pdus_invalid = invalid_pdus;
+  m->bytes = bytes_received;
+  m->udp_datagrams = udp_datagrams;
+  m->udp_flow_drops = udp_flow_drops;
+  m->echoes_sent = echoes_sent;
+  m->echoes_dropped = echoes_dropped;
+  m->conns_accepted = next_conn_id;
+  m->conns_open = open_conns;
+  m->ring_overruns = ring.overruns;
+
+  // Las cerradas ya están en seq_totals
+  m->missing = seq_totals.missing;
+  m->reordered = seq_totals.reordered;
+  m->duplicates = seq_totals.duplicates;
+  m->nconns = 0;
+  for (Connection *c = conns; c; c = c->next) {
+    m->missing += c->seq.missing;
+    m->reordered += c->seq.reordered;
+    m->duplicates += c->seq.duplicates;
+    if (m->nconns == METRICS_MAX_CONNS) {
+      continue;
+    }
+    MetricsConn *mc = &m->conns[m->nconns++];
+    mc->id = c->id;
+    snprintf(mc->peer, sizeof(mc->peer), "%s", c->peer);
+    mc->udp = c->udp;
+    mc->measurements = c->measurements;
+    mc->jitter_us = c->seq.jitter_us;
+    mc->skew_ppm = skew_ppm(&c->skew);
+    mc->missing = c->seq.missing;
+    mc->reordered = c->seq.reordered;
+    mc->duplicates = c->seq.duplicates;
+  }
+  metrics_publish();
+}
+
+static void print_usage(const char *progname) {
+  fprintf(stderr, "Uso: %s [archivo_log] [-q] [-i <seg>] [-k] [-m <puerto>]\n",
+          progname);
+  fprintf(stderr, "\nOpciones:\n");
+  fprintf(stderr, "  -q          No imprimir cada medición (solo el log)\n");
+  fprintf(stderr,
+          "  -i <seg>    Estadísticas de delay cada <seg> segundos "
+          "(default %d, 0 = solo al final)\n",
+          DEFAULT_REPORT_INTERVAL);
+  fprintf(stderr, "  -k          Registrar también el timestamp de recepción "
+                  "del kernel\n");
+  fprintf(stderr, "  -m <puerto> Servir métricas de Prometheus en "
+                  "http://127.0.0.1:<puerto>/metrics\n");
+  fprintf(stderr, "\nEl log es binario; owd_export lo convierte a CSV.\n");
+}
+
 int main(int argc, char *argv[]) {
-  const char *csv_filename = "one_way_delay.csv";
-  if (argc >= 2) {
-    csv_filename = argv[1];
+  const char *log_filename = "one_way_delay.owd";
+  PersistOptions popts = {0, DEFAULT_REPORT_INTERVAL, 0};
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-q") == 0) {
+      popts.quiet = 1;
+    } else if (strcmp(argv[i], "-k") == 0) {
+      kernel_ts = 1;
+    } else if (strcmp(argv[i], "-i") == 0) {
+      char *endptr;
+      popts.report_interval =
+          (i + 1 < argc) ? strtol(argv[++i], &endptr, 10) : -1;
+      if (popts.report_interval < 0 || *endptr != '\0') {
+        fprintf(stderr, "ERROR: -i debe ser un entero >= 0\n");
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+    } else if (strcmp(argv[i], "-m") == 0) {
+      char *endptr;
+      long port = (i + 1 < argc) ? strtol(argv[++i], &endptr, 10) : -1;
+      if (port < 1 || port > 65535 || *endptr != '\0') {
+        fprintf(stderr, "ERROR: -m debe ser un puerto entre 1 y 65535\n");
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+      metrics_port = (int)port;
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr, "ERROR: Parámetro desconocido: %s\n", argv[i]);
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    } else {
+      log_filename = argv[i];
+    }
   }
 
   setup_signal_handlers();
+  raise_fd_limit();
+  popts.metrics = metrics_port != 0;
+  meas_ring_init(&ring);
 
-  FILE *csv = fopen(csv_filename, "w");
-  if (!csv) {
-    perror("fopen CSV");
+  if (persist_open(log_filename) < 0) {
+    perror("log de mediciones");
     return EXIT_FAILURE;
   }
 
-  // Header CSV para análisis posterior (mediciones en microsegundos)
-  fprintf(csv, "measurement,one_way_delay_us\n");
-  fflush(csv);
-
   // Crear socket TCP
   int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
   if (listen_fd < 0) {
     perror("socket");
-    fclose(csv);
+    persist_stop();
     return EXIT_FAILURE;
   }
 
@@ -74,7 +740,7 @@ int main(int argc, char *argv[]) {
       0) {
     perror("setsockopt SO_REUSEADDR");
     close(listen_fd);
-    fclose(csv);
+    persist_stop();
     return EXIT_FAILURE;
   }
 
@@ -88,148 +754,165 @@ int main(int argc, char *argv[]) {
   if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
     perror("bind");
     close(listen_fd);
-    fclose(csv);
+    persist_stop();
     return EXIT_FAILURE;
   }
 
-  if (listen(listen_fd, 1) < 0) {
+  if (listen(listen_fd, SOMAXCONN) < 0 || set_nonblocking(listen_fd) < 0) {
     perror("listen");
     close(listen_fd);
-    fclose(csv);
+    persist_stop();
     return EXIT_FAILURE;
   }
 
-  printf("Servidor TCP escuchando en puerto %d\n", SERVER_PORT);
-  printf("Logueando one-way delay en: %s\n", csv_filename);
-  printf("Presione Ctrl+C para terminar.\n\n");
+  int epfd = epoll_create1(0);
+  if (epfd < 0) {
+    perror("epoll_create1");
+    close(listen_fd);
+    persist_stop();
+    return EXIT_FAILURE;
+  }
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL; // NULL = socket de escucha
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev) < 0) {
+    perror("epoll_ctl");
+    close(epfd);
+    close(listen_fd);
+    persist_stop();
+    return EXIT_FAILURE;
+  }
 
-  // Aceptar un único cliente
-  struct sockaddr_in client_addr;
-  socklen_t client_len = sizeof(client_addr);
-  int conn_fd = accept(listen_fd, (struct sockaddr *)&client_addr, &client_len);
-  if (conn_fd < 0) {
-    if (errno == EINTR && !g_running) {
-      printf("\nServidor interrumpido antes de recibir conexión.\n");
-    } else {
-      perror("accept");
+  // Sondas UDP en el mismo puerto
+  static int udp_marker;
+  int udp_fd = open_udp_socket();
+  ev.data.ptr = &udp_marker;
+  if (udp_fd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, udp_fd, &ev) < 0) {
+    perror("socket UDP");
+    if (udp_fd >= 0) {
+      close(udp_fd);
     }
+    close(epfd);
     close(listen_fd);
-    fclose(csv);
-    return (errno == EINTR) ? EXIT_SUCCESS : EXIT_FAILURE;
+    persist_stop();
+    return EXIT_FAILURE;
   }
 
-  char client_ip[INET_ADDRSTRLEN];
-  inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, sizeof(client_ip));
-  printf("Cliente conectado desde %s:%d\n", client_ip,
-         ntohs(client_addr.sin_port));
+  if (metrics_port && metrics_start(metrics_port) < 0) {
+    perror("métricas");
+    close(udp_fd);
+    close(epfd);
+    close(listen_fd);
+    persist_stop();
+    return EXIT_FAILURE;
+  }
 
-  uint8_t recv_buf[RECV_BUF_SIZE];
-  size_t recv_len = 0;
-  int measurement_idx = 0;
-  int invalid_pdus = 0;
+  if (persist_start(&ring, &popts) < 0) {
+    perror("hilo de persistencia");
+    metrics_stop();
+    close(udp_fd);
+    close(epfd);
+    close(listen_fd);
+    persist_stop();
+    return EXIT_FAILURE;
+  }
 
-  while (g_running) {
-    // Verificar si hay espacio en el buffer
-    if (recv_len >= sizeof(recv_buf)) {
-      // Buffer lleno sin delimitador encontrado: error de protocolo
-      fprintf(stderr, "ERROR: Buffer lleno sin encontrar delimitador. "
-                      "Posible corrupción de protocolo. Limpiando buffer.\n");
-      recv_len = 0;
-      invalid_pdus++;
-      continue;
-    }
+  printf("Servidor TCP y UDP escuchando en puerto %d\n", SERVER_PORT);
+  if (metrics_port) {
+    printf("Métricas en http://127.0.0.1:%d/metrics\n", metrics_port);
+  }
+  printf("Logueando one-way delay en: %s\n", log_filename);
+  printf("Presione Ctrl+C para terminar.\n\n");
 
-    // Leer del socket TCP (pueden llegar PDUs parciales o múltiples juntas)
-    ssize_t n =
-        recv(conn_fd, recv_buf + recv_len, sizeof(recv_buf) - recv_len, 0);
+  // Loop principal: todas las sondas en un solo epoll, sin bloquear en
+  // ninguna conexión en particular
+  struct epoll_event events[MAX_EVENTS];
+  time_t last_tick = time(NULL);
+  while (g_running) {
+    int n = epoll_wait(epfd, events, MAX_EVENTS, 1000);
     if (n < 0) {
       if (errno == EINTR) {
-        continue; // Reintentar si fue interrumpido por señal
+        continue;
       }
-      perror("recv");
-      break;
-    }
-    if (n == 0) {
-      printf("Cliente cerró la conexión.\n");
+      perror("epoll_wait");
       break;
     }
 
-    recv_len += (size_t)n;
-
-    // Procesar todas las PDUs completas que haya en el buffer
-    while (recv_len > 0) {
-      // Buscar el delimitador '|' dentro del buffer, pero ignorar cualquier '|'
-      // que aparezca antes de MIN_PDU_SIZE (sería un byte '|' dentro del
-      // timestamp)
-      size_t delim_pos;
-      int found = 0;
-      // Empezar la búsqueda desde MIN_PDU_SIZE - 1 (posición mínima válida para
-      // '|')
-      size_t search_start = (MIN_PDU_SIZE > 0) ? (MIN_PDU_SIZE - 1) : 0;
-      for (delim_pos = search_start; delim_pos < recv_len; delim_pos++) {
-        if (recv_buf[delim_pos] == '|') {
-          found = 1;
-          break;
-        }
-      }
-
-      if (!found) {
-        // No hay PDU completa aún, esperar más datos
-        break;
-      }
-
-      size_t pdu_len = delim_pos + 1; // Incluye el delimitador
-
-      // Validar tamaño máximo
-      if (pdu_len > MAX_PDU_SIZE) {
-        fprintf(stderr,
-                "WARN: PDU demasiado larga (%zu bytes, máximo %d). "
-                "Descartando.\n",
-                pdu_len, MAX_PDU_SIZE);
-        invalid_pdus++;
-        size_t remaining = recv_len - pdu_len;
-        if (remaining > 0) {
-          memmove(recv_buf, recv_buf + pdu_len, remaining);
-        }
-        recv_len = remaining;
+    for (int i = 0; i < n; i++) {
+      TcpConn *t = events[i].data.ptr;
+      if (!t) {
+        handle_accept(epfd, listen_fd);
         continue;
       }
+      if (events[i].data.ptr == &udp_marker) {
+        handle_udp(udp_fd);
+        continue;
+      }
+      if (events[i].events & EPOLLOUT) {
+        flush_output(epfd, t);
+      }
+      if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+        handle_readable(epfd, t); // Puede cerrar y liberar t
+      }
+    }
+    if (closed_backlog_len > 0) {
+      flush_closed();
+    }
 
-      // Extraer Origin Timestamp de los primeros 8 bytes (network byte order)
-      uint64_t origin_ts_net;
-      memcpy(&origin_ts_net, recv_buf, sizeof(origin_ts_net));
-      uint64_t origin_ts = ntoh64(origin_ts_net);
-
-      // 2. Tomar Destination Timestamp (ya lo haces bien)
-      uint64_t dest_ts = current_time_micros();
-
-      int64_t raw_delay_us = (int64_t)dest_ts - (int64_t)origin_ts;
-
-      measurement_idx++;
-      // Loguear en CSV (segundos)
-      fprintf(csv, "%d,%.6f\n", measurement_idx, raw_delay_us / 1000000.0);
-      fflush(csv);
-
-      printf("Medición %d: delay = %" PRId64 " us (%.3f ms)\n", measurement_idx,
-             raw_delay_us, raw_delay_us / 1000.0);
-
-      // Mover el resto de bytes para la próxima PDU
-      size_t remaining = recv_len - pdu_len;
-      if (remaining > 0) {
-        memmove(recv_buf, recv_buf + pdu_len, remaining);
+    time_t now = time(NULL);
+    if (now != last_tick) {
+      expire_udp_flows(epfd, now);
+      if (metrics_port) {
+        publish_metrics();
       }
-      recv_len = remaining;
+      last_tick = now;
     }
   }
+  metrics_stop();
+
+  // Cerrar las conexiones que quedan (imprime el skew de cada una)
+  unsigned long open_at_exit = open_conns;
+  while (conns) {
+    const char *reason =
+        conns->udp ? "abierto al terminar" : "abierta al terminar";
+    close_connection(epfd, conns, reason);
+  }
+  // Ya no se encola nada: el hilo vacía el ring y cierra el log. Las bajas
+  // que no entraron las libera igual el resumen.
+  persist_stop();
+  free(closed_backlog);
 
   // Estadísticas finales
   printf("\n=== Estadísticas del servidor ===\n");
-  printf("PDUs válidas recibidas: %d\n", measurement_idx);
-  printf("PDUs inválidas/descartadas: %d\n", invalid_pdus);
-
-  close(conn_fd);
+  printf("Conexiones y flujos UDP: %u (máximo simultáneos: %lu, abiertos: "
+         "%lu)\n",
+         next_conn_id, max_open_conns, open_at_exit);
+  printf("Datagramas UDP recibidos: %lu\n", udp_datagrams);
+  if (udp_flow_drops > 0) {
+    printf("Datagramas UDP descartados (más de %d flujos): %lu\n",
+           UDP_MAX_FLOWS, udp_flow_drops);
+  }
+  printf("PDUs válidas recibidas: %lu\n", measurement_idx);
+  printf("PDUs inválidas/descartadas: %lu\n", invalid_pdus);
+  if (echoes_sent || echoes_dropped) {
+    printf("Ecos enviados: %lu (descartados por cola llena: %lu)\n",
+           echoes_sent, echoes_dropped);
+  }
+  printf("Mediciones descartadas con el ring lleno: %lu\n", ring.overruns);
+  if (ring.msg_overruns) {
+    printf("Mensajes descartados con la cola llena: %lu\n",
+           ring.msg_overruns);
+  }
+  persist_print_summary(kernel_ts);
+  printf("PDUs faltantes: %lu, fuera de orden: %lu, duplicadas: %lu\n",
+         seq_totals.missing, seq_totals.reordered, seq_totals.duplicates);
+  printf("Envíos demorados: %lu, llegadas demoradas: %lu, ráfagas: %lu\n",
+         seq_totals.send_stalls, seq_totals.recv_stalls, seq_totals.bursts);
+
+  close(epfd);
+  close(udp_fd);
   close(listen_fd);
-  fclose(csv);
 
   printf("Servidor TCP finalizado.\n");
   return EXIT_SUCCESS;
@@ -0,0 +1,89 @@
+#include "skew.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+void skew_init(SkewEstimator *s) { memset(s, 0, sizeof(*s)); }
+
+void skew_free(SkewEstimator *s) {
+  free(s->hull);
+  s->hull = NULL;
+  s->len = s->cap = 0;
+}
+
+// > 0 si a -> b -> c dobla a la izquierda (b queda en la envolvente
+// inferior). En long double: con corridas largas el producto no entra
+// holgado en un int64.
+static long double cross(const SkewPoint *a, const SkewPoint *b,
+                         const SkewPoint *c) {
+  return (long double)(b->x - a->x) * (long double)(c->y - a->y) -
+         (long double)(b->y - a->y) * (long double)(c->x - a->x);
+}
+
+static int push(SkewEstimator *s, SkewPoint p) {
+  // Mismo x que el último vértice: solo importa el delay menor
+  if (s->len > 0 && s->hull[s->len - 1].x == p.x) {
+    if (p.y >= s->hull[s->len - 1].y) {
+      return 0;
+    }
+    s->len--;
+  }
+  while (s->len >= 2 &&
+         cross(&s->hull[s->len - 2], &s->hull[s->len - 1], &p) <= 0) {
+    s->len--;
+  }
+
+  if (s->len == SKEW_HULL_MAX) {
+    uint32_t drop = SKEW_HULL_MAX / 2;
+    memmove(s->hull, s->hull + drop, (s->len - drop) * sizeof(SkewPoint));
+    s->len -= drop;
+    s->edge = s->edge > drop ? s->edge - drop : 0;
+  }
+  if (s->len == s->cap) {
+    uint32_t cap = s->cap ? s->cap * 2 : 16;
+    SkewPoint *hull = realloc(s->hull, cap * sizeof(SkewPoint));
+    if (!hull) {
+      return -1;
+    }
+    s->hull = hull;
+    s->cap = cap;
+  }
+  s->hull[s->len++] = p;
+  return 0;
+}
+
+int64_t skew_update(SkewEstimator *s, uint64_t origin_us, int64_t delay_us) {
+  if (s->count == 0) {
+    s->origin_us = origin_us;
+  }
+  SkewPoint p = {(int64_t)(origin_us - s->origin_us), delay_us};
+
+  // Timestamps que retroceden (reloj del cliente ajustado) no se usan para
+  // la envolvente, que necesita x no decrecientes
+  if (s->len == 0 || p.x >= s->hull[s->len - 1].x) {
+    if (push(s, p) == 0) {
+      s->count++;
+      s->sum_x += p.x;
+    }
+  }
+
+  if (s->len >= 2) {
+    if (s->edge > s->len - 2) {
+      s->edge = s->len - 2;
+    }
+    // La media de x solo crece: la arista óptima solo avanza
+    long double mean_x = s->sum_x / (long double)s->count;
+    while (s->edge + 2 < s->len && s->hull[s->edge + 1].x < mean_x) {
+      s->edge++;
+    }
+    const SkewPoint *a = &s->hull[s->edge];
+    const SkewPoint *b = &s->hull[s->edge + 1];
+    s->slope = (double)(b->y - a->y) / (double)(b->x - a->x);
+  }
+  return (int64_t)llround(s->slope * (double)p.x);
+}
+
+int64_t skew_span_us(const SkewEstimator *s) {
+  return s->len > 0 ? s->hull[s->len - 1].x : 0;
+}
@@ -0,0 +1,52 @@
+#ifndef TCP_SKEW_H
+#define TCP_SKEW_H
+
+#include <stdint.h>
+
+// Estimación online del skew (drift) entre el reloj del cliente y el del
+// servidor a partir de los puntos (origin_ts, delay) de una conexión.
+//
+// Los delays con cola quedan por encima del delay mínimo, que crece o baja
+// linealmente con el drift. La recta que queda por debajo de todos los
+// puntos minimizando la suma de distancias verticales (el programa lineal de
+// Moon et al.) pasa siempre por una arista de la envolvente convexa
+// inferior: la que contiene a la media de los x. La envolvente se mantiene
+// con la cadena monótona de Andrew (los x llegan ordenados) y un índice a
+// la arista óptima que solo avanza, así que cada muestra cuesta O(1)
+// amortizado.
+
+// Tope de vértices de la envolvente. Con delays reales crece como log n; si
+// se llega al tope se descartan los vértices más viejos.
+#define SKEW_HULL_MAX 4096
+
+typedef struct {
+  int64_t x; // origin_ts - origen de la conexión, en microsegundos
+  int64_t y; // Delay crudo en microsegundos
+} SkewPoint;
+
+typedef struct {
+  SkewPoint *hull;
+  uint32_t len;
+  uint32_t cap;
+  uint32_t edge; // Arista óptima: hull[edge] - hull[edge + 1]
+  uint64_t origin_us;
+  uint64_t count;
+  long double sum_x;
+  double slope; // Skew estimado (us de delay por us); 0 sin estimación
+} SkewEstimator;
+
+void skew_init(SkewEstimator *s);
+void skew_free(SkewEstimator *s);
+
+// Agregar una muestra y devolver la corrección a restarle al delay crudo
+// con la estimación actual: slope * (origin_ts - origen)
+int64_t skew_update(SkewEstimator *s, uint64_t origin_us, int64_t delay_us);
+
+static inline double skew_ppm(const SkewEstimator *s) {
+  return s->slope * 1e6;
+}
+
+// Microsegundos cubiertos por las muestras
+int64_t skew_span_us(const SkewEstimator *s);
+
+#endif
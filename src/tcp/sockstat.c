@@ -0,0 +1,119 @@
+#include "sockstat.h"
+
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include <linux/sockios.h>
+#include <linux/tcp.h>
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+int sockstat_init(SockStats *s, const char *path) {
+  memset(s, 0, sizeof(*s));
+  delay_stats_init(&s->send_us);
+  if (path) {
+    s->log = fopen(path, "w");
+    if (!s->log) {
+      return -1;
+    }
+    fprintf(s->log, "seq,origin_ts_us,size,send_ns,outq_bytes,notsent_bytes,"
+                    "srtt_us,rttvar_us,snd_cwnd,snd_ssthresh,unacked,lost,"
+                    "total_retrans,ca_state,sndbuf_limited_us\n");
+  }
+  return 0;
+}
+
+void sockstat_before_send(SockStats *s, int fd) {
+  int outq = 0, notsent = 0;
+  ioctl(fd, SIOCOUTQ, &outq);
+  ioctl(fd, SIOCOUTQNSD, &notsent);
+  s->outq = (uint32_t)outq;
+  s->notsent = (uint32_t)notsent;
+  s->send_start_ns = now_ns();
+}
+
+void sockstat_after_send(SockStats *s, int fd, uint32_t seq,
+                         uint64_t origin_ts, size_t len) {
+  uint64_t send_ns = now_ns() - s->send_start_ns;
+  delay_stats_record(&s->send_us, (int64_t)(send_ns / 1000));
+  if (send_ns > SOCKSTAT_SLOW_NS) {
+    s->slow_sends++;
+  }
+  s->samples++;
+  s->outq_sum += s->outq;
+  s->notsent_sum += s->notsent;
+  if (s->outq > s->outq_max) {
+    s->outq_max = s->outq;
+  }
+  if (s->notsent > s->notsent_max) {
+    s->notsent_max = s->notsent;
+  }
+
+  // Un kernel viejo devuelve una struct más corta: lo que falta queda en 0
+  struct tcp_info ti;
+  socklen_t ti_len = sizeof(ti);
+  memset(&ti, 0, sizeof(ti));
+  if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &ti, &ti_len) < 0) {
+    s->info_errors++;
+  } else {
+    SockTcpInfo *i = &s->last;
+    i->srtt_us = ti.tcpi_rtt;
+    i->rttvar_us = ti.tcpi_rttvar;
+    i->snd_cwnd = ti.tcpi_snd_cwnd;
+    i->snd_ssthresh = ti.tcpi_snd_ssthresh;
+    i->unacked = ti.tcpi_unacked;
+    i->lost = ti.tcpi_lost;
+    i->total_retrans = ti.tcpi_total_retrans;
+    i->ca_state = ti.tcpi_ca_state;
+    i->sndbuf_limited_us = ti.tcpi_sndbuf_limited;
+  }
+
+  if (s->log) {
+    const SockTcpInfo *i = &s->last;
+    fprintf(s->log,
+            "%u,%llu,%zu,%llu,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%llu\n", seq,
+            (unsigned long long)origin_ts, len, (unsigned long long)send_ns,
+            s->outq, s->notsent, i->srtt_us, i->rttvar_us, i->snd_cwnd,
+            i->snd_ssthresh, i->unacked, i->lost, i->total_retrans,
+            i->ca_state, (unsigned long long)i->sndbuf_limited_us);
+  }
+}
+
+void sockstat_print(const SockStats *s) {
+  printf("\n=== Socket de envío ===\n");
+  delay_stats_print(&s->send_us, stdout, "Duración de send(): ");
+  printf("send() de más de %llu ms: %lu de %lu\n",
+         (unsigned long long)(SOCKSTAT_SLOW_NS / 1000000), s->slow_sends,
+         s->samples);
+  if (s->samples > 0) {
+    printf("Cola antes de cada send(): media %.0f bytes (%.0f sin enviar), "
+           "máx %u bytes (%u sin enviar)\n",
+           (double)s->outq_sum / (double)s->samples,
+           (double)s->notsent_sum / (double)s->samples, s->outq_max,
+           s->notsent_max);
+  }
+  const SockTcpInfo *i = &s->last;
+  printf("TCP_INFO al final: srtt %.3f ms, rttvar %.3f ms, cwnd %u, "
+         "ssthresh %u, retransmisiones %u\n",
+         i->srtt_us / 1000.0, i->rttvar_us / 1000.0, i->snd_cwnd,
+         i->snd_ssthresh, i->total_retrans);
+  printf("Tiempo limitado por el buffer de envío: %.3f s\n",
+         i->sndbuf_limited_us / 1e6);
+  if (s->info_errors) {
+    printf("Errores de getsockopt(TCP_INFO): %lu\n", s->info_errors);
+  }
+}
+
+void sockstat_close(SockStats *s) {
+  if (s->log) {
+    fclose(s->log);
+    s->log = NULL;
+  }
+}
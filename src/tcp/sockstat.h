@@ -0,0 +1,66 @@
+#ifndef TCP_SOCKSTAT_H
+#define TCP_SOCKSTAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "delay_stats.h"
+
+// Contrapresión del lado del cliente (-i). Con pérdida en el camino la
+// ventana de TCP se achica, el buffer de envío se llena y send() bloquea:
+// el origin timestamp ya se tomó, así que ese tiempo en el socket termina
+// sumado al delay medido y no se distingue del de la red. Por cada PDU se
+// mide cuánto tardó el send(), cuánto había en la cola de envío justo antes
+// (SIOCOUTQ: sin enviar + sin ACK; SIOCOUTQNSD: sin enviar) y el TCP_INFO
+// después del envío. El CSV lleva seq y origin_ts_us, las mismas columnas
+// del log del servidor, para unir las dos series por PDU.
+
+// Un send() más lento que esto se cuenta como bloqueado
+#define SOCKSTAT_SLOW_NS 1000000ULL
+
+// Lo que interesa de struct tcp_info (que con _POSIX_C_SOURCE no se puede
+// incluir junto con <netinet/tcp.h>)
+typedef struct {
+  uint32_t srtt_us;
+  uint32_t rttvar_us;
+  uint32_t snd_cwnd; // Segmentos
+  uint32_t snd_ssthresh;
+  uint32_t unacked; // Segmentos en vuelo
+  uint32_t lost;
+  uint32_t total_retrans;
+  uint8_t ca_state;         // 0 open, 1 disorder, 2 cwr, 3 recovery, 4 loss
+  uint64_t sndbuf_limited_us; // Acumulado, limitado por el buffer de envío
+} SockTcpInfo;
+
+typedef struct {
+  FILE *log; // CSV por PDU (NULL = sin log)
+  uint64_t send_start_ns;
+  uint32_t outq;    // Antes del send() en curso
+  uint32_t notsent; // Ídem, solo lo no enviado
+  unsigned long samples;
+  unsigned long slow_sends; // Más de SOCKSTAT_SLOW_NS
+  unsigned long info_errors;
+  uint64_t outq_sum;
+  uint32_t outq_max;
+  uint64_t notsent_sum;
+  uint32_t notsent_max;
+  DelayStats send_us; // Duración de cada send()
+  SockTcpInfo last;
+} SockStats;
+
+// Abrir el log (path puede ser NULL). Devuelve -1 con errno.
+int sockstat_init(SockStats *s, const char *path);
+
+// Justo antes del send(): cola de envío y hora de inicio
+void sockstat_before_send(SockStats *s, int fd);
+
+// Justo después: duración del send(), TCP_INFO y la fila del CSV
+void sockstat_after_send(SockStats *s, int fd, uint32_t seq,
+                         uint64_t origin_ts, size_t len);
+
+void sockstat_print(const SockStats *s);
+
+void sockstat_close(SockStats *s);
+
+#endif
@@ -0,0 +1,187 @@
+#include "tstamp.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <time.h>
+
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+
+// glibc no lo expone con _POSIX_C_SOURCE; el kernel lo define igual
+#ifndef SCM_TIMESTAMPING
+#define SCM_TIMESTAMPING SO_TIMESTAMPING
+#endif
+
+static const char *const tx_type_names[TSTAMP_TX_TYPES] = {"software", "sched",
+                                                           "ack"};
+
+int tstamp_enable_rx(int fd) {
+  int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+  return setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+}
+
+int tstamp_enable_tx(int fd) {
+  // TSONLY: la cola de errores trae solo el timestamp, no una copia del
+  // segmento
+  int flags = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_TX_SCHED |
+              SOF_TIMESTAMPING_TX_ACK | SOF_TIMESTAMPING_SOFTWARE |
+              SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+  return setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+}
+
+static uint64_t timespec_micros(const struct timespec *ts) {
+  return (uint64_t)ts->tv_sec * 1000000 + (uint64_t)ts->tv_nsec / 1000;
+}
+
+uint64_t tstamp_rx_from_msg(struct msghdr *msg) {
+  for (struct cmsghdr *cm = CMSG_FIRSTHDR(msg); cm;
+       cm = CMSG_NXTHDR(msg, cm)) {
+    if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPING) {
+      struct scm_timestamping tss;
+      memcpy(&tss, CMSG_DATA(cm), sizeof(tss));
+      return timespec_micros(&tss.ts[0]);
+    }
+  }
+  return 0;
+}
+
+int tx_tracker_init(TxTracker *t, const char *path) {
+  memset(t, 0, sizeof(*t));
+  for (int i = 0; i < TSTAMP_TX_TYPES; i++) {
+    delay_stats_init(&t->lag[i]);
+  }
+  if (path) {
+    t->log = fopen(path, "w");
+    if (!t->log) {
+      return -1;
+    }
+    fprintf(t->log, "seq,tipo,user_ts_us,kernel_ts_us,lag_us\n");
+  }
+  return 0;
+}
+
+void tx_tracker_sent(TxTracker *t, uint64_t user_ts, size_t len) {
+  t->bytes += len;
+  t->end[t->sent % TX_TRACK_SIZE] = t->bytes;
+  t->user_ts[t->sent % TX_TRACK_SIZE] = user_ts;
+  t->sent++;
+}
+
+// PDU que contiene el byte key (offset de 32 bits del kernel), o -1 si ya
+// salió de la ventana. La ventana deja un lugar libre para conservar el fin
+// de la PDU anterior a la más vieja.
+static int64_t find_pdu(const TxTracker *t, uint32_t key) {
+  if (t->bytes == 0) {
+    return -1;
+  }
+  uint64_t back = (uint32_t)((uint32_t)(t->bytes - 1) - key);
+  if (back >= t->bytes) {
+    return -1;
+  }
+  uint64_t off = t->bytes - 1 - back;
+
+  uint32_t lo =
+      t->sent > TX_TRACK_SIZE - 1 ? t->sent - (TX_TRACK_SIZE - 1) : 0;
+  if (lo > 0 && off < t->end[(lo - 1) % TX_TRACK_SIZE]) {
+    return -1;
+  }
+  // Primera PDU que termina después de off
+  uint32_t hi = t->sent - 1;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (t->end[mid % TX_TRACK_SIZE] > off) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return lo;
+}
+
+static void handle_tx_stamp(TxTracker *t, uint32_t key, uint32_t type,
+                            uint64_t kernel_ts) {
+  int64_t seq = find_pdu(t, key);
+  if (seq < 0 || type >= TSTAMP_TX_TYPES) {
+    t->unmatched++;
+    return;
+  }
+  t->stamps++;
+  uint64_t user_ts = t->user_ts[seq % TX_TRACK_SIZE];
+  int64_t lag = (int64_t)kernel_ts - (int64_t)user_ts;
+  delay_stats_record(&t->lag[type], lag);
+  if (type == TSTAMP_TX_ACK && t->end[seq % TX_TRACK_SIZE] > t->acked) {
+    t->acked = t->end[seq % TX_TRACK_SIZE];
+  }
+  if (t->log) {
+    fprintf(t->log, "%lld,%s,%llu,%llu,%lld\n", (long long)seq,
+            tx_type_names[type], (unsigned long long)user_ts,
+            (unsigned long long)kernel_ts, (long long)lag);
+  }
+}
+
+int tx_tracker_poll(TxTracker *t, int fd) {
+  while (1) {
+    char control[TSTAMP_CONTROL_SIZE];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return 0;
+      }
+      perror("recvmsg MSG_ERRQUEUE");
+      return -1;
+    }
+
+    // Cada mensaje trae el timestamp y, aparte, el tipo y la clave
+    uint64_t kernel_ts = 0;
+    const struct sock_extended_err *serr = NULL;
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm;
+         cm = CMSG_NXTHDR(&msg, cm)) {
+      if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPING) {
+        struct scm_timestamping tss;
+        memcpy(&tss, CMSG_DATA(cm), sizeof(tss));
+        kernel_ts = timespec_micros(&tss.ts[0]);
+      } else if ((cm->cmsg_level == IPPROTO_IP &&
+                  cm->cmsg_type == IP_RECVERR) ||
+                 (cm->cmsg_level == IPPROTO_IPV6 &&
+                  cm->cmsg_type == IPV6_RECVERR)) {
+        serr = (const struct sock_extended_err *)CMSG_DATA(cm);
+      }
+    }
+    if (serr && serr->ee_origin == SO_EE_ORIGIN_TIMESTAMPING && kernel_ts) {
+      handle_tx_stamp(t, serr->ee_data, serr->ee_info, kernel_ts);
+    }
+  }
+}
+
+void tx_tracker_print(const TxTracker *t) {
+  static const char *const labels[TSTAMP_TX_TYPES] = {
+      "Usuario → driver: ", "Usuario → qdisc:  ", "Usuario → ACK:    "};
+
+  printf("\n=== Timestamps de transmisión del kernel ===\n");
+  printf("Timestamps: %lu (%lu fuera de la ventana de %d PDUs)\n", t->stamps,
+         t->unmatched, TX_TRACK_SIZE - 1);
+  // El kernel marca un solo send() por segmento: los que Nagle junta en uno
+  // se quedan con el timestamp del último
+  printf("PDUs con timestamp de ACK: %llu de %u\n",
+         (unsigned long long)t->lag[TSTAMP_TX_ACK].count, t->sent);
+  // En el orden en que ocurren
+  static const int order[TSTAMP_TX_TYPES] = {TSTAMP_TX_SCHED,
+                                             TSTAMP_TX_SOFTWARE, TSTAMP_TX_ACK};
+  for (int i = 0; i < TSTAMP_TX_TYPES; i++) {
+    delay_stats_print(&t->lag[order[i]], stdout, labels[order[i]]);
+  }
+}
+
+void tx_tracker_close(TxTracker *t) {
+  if (t->log) {
+    fclose(t->log);
+    t->log = NULL;
+  }
+}
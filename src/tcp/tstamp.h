@@ -0,0 +1,68 @@
+#ifndef TCP_TSTAMP_H
+#define TCP_TSTAMP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/socket.h>
+
+#include "delay_stats.h"
+
+// Timestamps de software del kernel con SO_TIMESTAMPING (CLOCK_REALTIME, el
+// mismo reloj que current_time_micros(), así se pueden restar).
+//
+// Recepción: cada recvmsg() trae en un SCM_TIMESTAMPING la hora en que el
+// kernel recibió el último segmento que se copió en esa lectura.
+//
+// Transmisión: el kernel encola en la cola de errores del socket un
+// timestamp por send() al pasar el segmento a la qdisc (sched), al driver
+// (software) y al llegar el ACK que lo cubre. Con OPT_ID cada uno trae como
+// clave el offset en el stream del último byte de ese send(), contando desde
+// que se habilitó; TxTracker lo traduce a la PDU que contiene ese byte.
+
+// Espacio para los mensajes de control de un recvmsg() con timestamps
+#define TSTAMP_CONTROL_SIZE 256
+
+// Tipos de timestamp de transmisión (orden de SCM_TSTAMP_* del kernel)
+enum { TSTAMP_TX_SOFTWARE, TSTAMP_TX_SCHED, TSTAMP_TX_ACK, TSTAMP_TX_TYPES };
+
+// PDUs enviadas que se recuerdan esperando sus timestamps
+#define TX_TRACK_SIZE 4096
+
+// Habilitar timestamps de recepción en un socket. Devuelve -1 con errno.
+int tstamp_enable_rx(int fd);
+
+// Habilitar timestamps de transmisión. Llamar antes del primer envío: los
+// offsets se cuentan desde acá. Devuelve -1 con errno.
+int tstamp_enable_tx(int fd);
+
+// Timestamp de recepción (us) de los mensajes de control, 0 si no hay
+uint64_t tstamp_rx_from_msg(struct msghdr *msg);
+
+typedef struct {
+  FILE *log;                      // CSV por timestamp (NULL = sin log)
+  uint64_t end[TX_TRACK_SIZE];    // Offset siguiente al último byte de la PDU
+  uint64_t user_ts[TX_TRACK_SIZE]; // Origin timestamp que llevó la PDU
+  uint32_t sent;                  // PDUs registradas
+  uint64_t bytes;                 // Bytes enviados desde tstamp_enable_tx
+  uint64_t acked;                 // Offset hasta el que llegaron ACKs
+  unsigned long stamps;
+  unsigned long unmatched; // Claves fuera de la ventana de PDUs recordadas
+  DelayStats lag[TSTAMP_TX_TYPES]; // Kernel - usuario por tipo, en us
+} TxTracker;
+
+// Abrir el log (path puede ser NULL). Devuelve -1 con errno.
+int tx_tracker_init(TxTracker *t, const char *path);
+
+// Registrar una PDU de len bytes recién enviada con su origin timestamp
+void tx_tracker_sent(TxTracker *t, uint64_t user_ts, size_t len);
+
+// Leer sin bloquear los timestamps de la cola de errores. Devuelve -1 si
+// hubo un error.
+int tx_tracker_poll(TxTracker *t, int fd);
+
+void tx_tracker_print(const TxTracker *t);
+
+void tx_tracker_close(TxTracker *t);
+
+#endif
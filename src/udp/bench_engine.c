@@ -0,0 +1,166 @@
+// Benchmark de throughput del engine del protocolo (libtpd), sin sockets.
+//
+// Un TpdClient y un TpdConn de servidor se pasan los datagramas en memoria:
+// HELLO, y por cada archivo WRQ, N DATA de MAX_DATA_SIZE bytes y FIN. Mide
+// cuántos intercambios PDU -> ACK por segundo procesan las dos máquinas de
+// estado, es decir el techo del protocolo cuando la red y el disco no cuentan.
+// Opcionalmente descarta uno de cada K PDUs para ejercitar las
+// retransmisiones y los duplicados.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "protocol.h"
+#include "tpd.h"
+
+#define BENCH_TIMEOUT_NS 1000000ULL
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+  TpdClient client;
+  TpdConn conn;
+  uint64_t clock_ns; // Reloj simulado
+  unsigned long loss_every;
+  unsigned long sent;
+  unsigned long dropped;
+  unsigned long exchanges;
+  unsigned long long bytes_written; // Payload entregado a la "aplicación"
+} Bench;
+
+// Servidor mínimo: acepta todo y solo cuenta el payload
+static void server_step(Bench *b, const TpdDatagram *pdu, TpdDatagram *out) {
+  TpdEvent ev;
+  tpd_server_input(&b->conn, pdu->buf, pdu->len, &ev, out);
+  if (ev.type == TPD_EV_NONE) {
+    return;
+  }
+  if (ev.type == TPD_EV_DATA && !ev.duplicate) {
+    b->bytes_written += ev.len;
+  }
+  tpd_server_accept(&b->conn, &ev, out);
+}
+
+// Llevar el intercambio en vuelo hasta el final, con pérdidas simuladas
+static int run(Bench *b) {
+  while (1) {
+    const TpdDatagram *pdu = tpd_client_transmit(&b->client);
+    if (!pdu) {
+      // Se "perdió" algo: avanzar el reloj hasta el deadline
+      b->clock_ns = tpd_client_deadline(&b->client);
+      if (tpd_client_timeout(&b->client, b->clock_ns) == TPD_FAILED) {
+        return -1;
+      }
+      continue;
+    }
+
+    b->sent++;
+    if (b->loss_every && b->sent % b->loss_every == 0) {
+      b->dropped++;
+      continue;
+    }
+
+    TpdDatagram reply;
+    server_step(b, pdu, &reply);
+    if (reply.len == 0) {
+      continue;
+    }
+    b->sent++;
+    if (b->loss_every && b->sent % b->loss_every == 0) {
+      b->dropped++;
+      continue;
+    }
+
+    TpdResult r = tpd_client_input(&b->client, reply.buf, reply.len);
+    if (r == TPD_DONE) {
+      b->exchanges++;
+      return 0;
+    }
+    if (r != TPD_PENDING) {
+      return -1;
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  unsigned long files = 1000;
+  unsigned long pdus_per_file = 1000;
+  unsigned long loss_every = 0;
+  if (argc >= 2) {
+    files = strtoul(argv[1], NULL, 10);
+  }
+  if (argc >= 3) {
+    pdus_per_file = strtoul(argv[2], NULL, 10);
+  }
+  if (argc >= 4) {
+    loss_every = strtoul(argv[3], NULL, 10);
+  }
+  if (files == 0 || pdus_per_file == 0 || loss_every == 1) {
+    fprintf(stderr,
+            "Uso: %s [archivos] [DATA por archivo] [perder 1 de cada K]\n",
+            argv[0]);
+    return 1;
+  }
+
+  printf("=== Benchmark del engine (libtpd) ===\n");
+  printf("%lu archivos x %lu DATA de %d bytes%s", files, pdus_per_file,
+         MAX_DATA_SIZE, loss_every ? "" : "\n");
+  if (loss_every) {
+    printf(", pérdida de 1 cada %lu datagramas\n", loss_every);
+  }
+  printf("sizeof(TpdClient) = %zu bytes, sizeof(TpdConn) = %zu bytes\n",
+         sizeof(TpdClient), sizeof(TpdConn));
+
+  static Bench b;
+  tpd_client_init(&b.client, BENCH_TIMEOUT_NS, MAX_RETRIES * 100);
+  tpd_conn_init(&b.conn);
+  b.loss_every = loss_every;
+
+  uint8_t payload[MAX_DATA_SIZE];
+  memset(payload, 0xA5, sizeof(payload));
+
+  double t0 = now_sec();
+  if (tpd_client_hello(&b.client, "bench", b.clock_ns) < 0 || run(&b) < 0) {
+    fprintf(stderr, "HELLO falló\n");
+    return 1;
+  }
+  for (unsigned long f = 0; f < files; f++) {
+    if (tpd_client_wrq(&b.client, "bench.bin", 0, b.clock_ns) < 0 ||
+        run(&b) < 0) {
+      fprintf(stderr, "WRQ %lu falló\n", f);
+      return 1;
+    }
+    for (unsigned long i = 0; i < pdus_per_file; i++) {
+      if (tpd_client_data(&b.client, payload, sizeof(payload), b.clock_ns) <
+              0 ||
+          run(&b) < 0) {
+        fprintf(stderr, "DATA %lu/%lu falló\n", f, i);
+        return 1;
+      }
+    }
+    if (tpd_client_fin(&b.client, b.clock_ns) < 0 || run(&b) < 0) {
+      fprintf(stderr, "FIN %lu falló\n", f);
+      return 1;
+    }
+  }
+  double t1 = now_sec();
+
+  double secs = t1 - t0;
+  unsigned long long expected =
+      (unsigned long long)files * pdus_per_file * MAX_DATA_SIZE;
+  printf("\nIntercambios:     %lu (%.1f ns c/u)\n", b.exchanges,
+         secs * 1e9 / b.exchanges);
+  printf("Datagramas:       %lu (%lu descartados)\n", b.sent, b.dropped);
+  printf("Throughput:       %.2f M intercambios/s, %.1f MB/s de payload\n",
+         b.exchanges / secs / 1e6, b.bytes_written / secs / 1e6);
+  printf("Payload entregado: %llu de %llu bytes %s\n", b.bytes_written,
+         expected, b.bytes_written == expected ? "(OK)" : "(ERROR)");
+  return b.bytes_written == expected ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+// Benchmark de memoria por sesión del pool de sesiones del servidor UDP.
+//
+// Crea N sesiones con direcciones distintas y reporta: bytes reservados por
+// el pool, RSS real, costo de creación y de búsqueda. Como referencia muestra
+// lo que costaba el esquema anterior (arreglo estático de ClientSession con
+// filename[256] y un FILE* con su buffer de stdio).
+
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "protocol.h"
+#include "session.h"
+
+// Layout de la sesión antes del pool (solo para comparar tamaños)
+typedef struct {
+  struct sockaddr_in addr;
+  ClientState state;
+  uint8_t expected_seq;
+  char filename[256];
+  FILE *file;
+  time_t last_activity;
+  int active;
+  size_t bytes_received;
+  uint8_t last_ack_seq;
+  int has_last_ack;
+} LegacySession;
+
+static double now_sec(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// RSS actual en bytes (Linux, /proc/self/statm)
+static size_t current_rss(void) {
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (!f) {
+    return 0;
+  }
+  unsigned long size = 0, resident = 0;
+  if (fscanf(f, "%lu %lu", &size, &resident) != 2) {
+    resident = 0;
+  }
+  fclose(f);
+  return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+static void make_addr(uint32_t i, struct sockaddr_in *addr) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  // 10.x.y.z con 16 puertos por IP, como muchos clientes detrás de NAT
+  addr->sin_addr.s_addr = htonl(0x0A000000u + (i >> 4));
+  addr->sin_port = htons((uint16_t)(40000 + (i & 15)));
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t n = 100000;
+  if (argc >= 2) {
+    n = (uint32_t)strtoul(argv[1], NULL, 10);
+  }
+  if (n == 0 || n > MAX_CLIENTS) {
+    fprintf(stderr, "Uso: %s [sesiones (1-%d)]\n", argv[0], MAX_CLIENTS);
+    return 1;
+  }
+
+  printf("=== Benchmark de sesiones UDP (%u sesiones) ===\n", n);
+  printf("sizeof(SessionHot)  = %zu bytes\n", sizeof(SessionHot));
+  printf("sizeof(SessionCold) = %zu bytes\n", sizeof(SessionCold));
+  printf("Esquema anterior    = %zu bytes (+ %zu de FILE y %d de buffer "
+         "stdio por archivo abierto)\n",
+         sizeof(LegacySession), sizeof(FILE), BUFSIZ);
+
+  SessionPool pool;
+  if (session_pool_init(&pool, MAX_CLIENTS) < 0) {
+    return 1;
+  }
+
+  size_t rss_before = current_rss();
+  double t0 = now_sec();
+  for (uint32_t i = 0; i < n; i++) {
+    struct sockaddr_in addr;
+    make_addr(i, &addr);
+    if (session_create(&pool, &addr) == SESSION_NONE) {
+      fprintf(stderr, "session_create falló en %u\n", i);
+      return 1;
+    }
+  }
+  double t1 = now_sec();
+  size_t rss_after = current_rss();
+
+  // Búsquedas en orden pseudoaleatorio (LCG) para no favorecer la caché
+  uint32_t found = 0;
+  uint32_t x = 12345;
+  const uint32_t lookups = n * 10;
+  double t2 = now_sec();
+  for (uint32_t i = 0; i < lookups; i++) {
+    x = x * 1103515245u + 12345u;
+    struct sockaddr_in addr;
+    make_addr(x % n, &addr);
+    found += session_lookup(&pool, &addr) != SESSION_NONE;
+  }
+  double t3 = now_sec();
+
+  size_t pool_bytes = session_pool_memory(&pool);
+  size_t legacy_bytes = (size_t)n * sizeof(LegacySession);
+
+  printf("\nMemoria del pool:   %zu bytes (%.1f bytes/sesión)\n", pool_bytes,
+         (double)pool_bytes / n);
+  printf("RSS incremental:    %zu bytes (%.1f bytes/sesión)\n",
+         rss_after - rss_before, (double)(rss_after - rss_before) / n);
+  printf("Esquema anterior:   %zu bytes (%.1f bytes/sesión, sin contar "
+         "buffers de stdio)\n",
+         legacy_bytes, (double)legacy_bytes / n);
+  printf("Creación:           %.1f ns/sesión\n", (t1 - t0) * 1e9 / n);
+  printf("Búsqueda:           %.1f ns/lookup (%u/%u encontradas)\n",
+         (t3 - t2) * 1e9 / lookups, found, lookups);
+
+  double t4 = now_sec();
+  for (uint32_t i = 0; i < n; i++) {
+    struct sockaddr_in addr;
+    make_addr(i, &addr);
+    session_release(&pool, session_lookup(&pool, &addr));
+  }
+  double t5 = now_sec();
+  printf("Liberación:         %.1f ns/sesión (activas: %u)\n",
+         (t5 - t4) * 1e9 / n, pool.active_count);
+
+  session_pool_destroy(&pool);
+  return 0;
+}
@@ -0,0 +1,108 @@
+#include "cdc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define READ_BUF_SIZE (256 * 1024)
+
+static uint64_t gear[256];
+static int gear_ready = 0;
+
+// Tabla gear determinística (splitmix64): los cortes tienen que ser los mismos
+// en cada ejecución, si no dos subidas del mismo archivo no compartirían chunks
+static void gear_init(void) {
+  uint64_t x = 0x5450445f43444321ULL;
+  for (int i = 0; i < 256; i++) {
+    x += 0x9E3779B97F4A7C15ULL;
+    uint64_t z = x;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    gear[i] = z ^ (z >> 31);
+  }
+  gear_ready = 1;
+}
+
+static int push_chunk(CdcChunk **chunks, size_t *count, size_t *capacity,
+                      uint64_t offset, uint32_t length, Sha256Ctx *sha) {
+  if (*count == *capacity) {
+    size_t new_cap = *capacity ? *capacity * 2 : 256;
+    CdcChunk *tmp = realloc(*chunks, new_cap * sizeof(CdcChunk));
+    if (!tmp) {
+      perror("realloc chunks");
+      return -1;
+    }
+    *chunks = tmp;
+    *capacity = new_cap;
+  }
+
+  CdcChunk *c = &(*chunks)[(*count)++];
+  c->offset = offset;
+  c->length = length;
+  sha256_final(sha, c->digest);
+  sha256_init(sha);
+  return 0;
+}
+
+int cdc_chunk_file(FILE *file, CdcChunk **chunks, size_t *count) {
+  if (!gear_ready) {
+    gear_init();
+  }
+
+  uint8_t *buf = malloc(READ_BUF_SIZE);
+  if (!buf) {
+    perror("malloc");
+    return -1;
+  }
+
+  *chunks = NULL;
+  *count = 0;
+  size_t capacity = 0;
+
+  Sha256Ctx sha;
+  sha256_init(&sha);
+  uint64_t hash = 0;
+  uint64_t offset = 0; // Inicio del chunk en curso
+  uint32_t length = 0; // Bytes acumulados del chunk en curso
+  size_t n;
+
+  while ((n = fread(buf, 1, READ_BUF_SIZE, file)) > 0) {
+    size_t start = 0;
+    for (size_t i = 0; i < n; i++) {
+      hash = (hash << 1) + gear[buf[i]];
+      length++;
+
+      // Corte cuando los bits altos del hash son cero (o al llegar al máximo)
+      if ((length >= CDC_MIN_CHUNK && (hash >> (64 - CDC_AVG_BITS)) == 0) ||
+          length >= CDC_MAX_CHUNK) {
+        sha256_update(&sha, buf + start, i + 1 - start);
+        if (push_chunk(chunks, count, &capacity, offset, length, &sha) < 0) {
+          goto fail;
+        }
+        offset += length;
+        length = 0;
+        hash = 0;
+        start = i + 1;
+      }
+    }
+    sha256_update(&sha, buf + start, n - start);
+  }
+
+  if (ferror(file)) {
+    perror("fread");
+    goto fail;
+  }
+  if (length > 0 &&
+      push_chunk(chunks, count, &capacity, offset, length, &sha) < 0) {
+    goto fail;
+  }
+
+  free(buf);
+  return 0;
+
+fail:
+  free(buf);
+  free(*chunks);
+  *chunks = NULL;
+  *count = 0;
+  return -1;
+}
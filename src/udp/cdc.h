@@ -0,0 +1,28 @@
+#ifndef UDP_CDC_H
+#define UDP_CDC_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "protocol.h"
+#include "sha256.h"
+
+// Chunking definido por contenido (CDC) con un rolling hash "gear": el corte
+// depende solo de los últimos 64 bytes, así que insertar o borrar bytes en un
+// archivo solo cambia los chunks vecinos a la modificación.
+
+#define CDC_MIN_CHUNK 2048
+#define CDC_AVG_BITS 13 // Tamaño medio ~ CDC_MIN_CHUNK + 2^13
+#define CDC_MAX_CHUNK MAX_CHUNK_SIZE
+
+typedef struct {
+  uint64_t offset;
+  uint32_t length;
+  uint8_t digest[SHA256_DIGEST_SIZE];
+} CdcChunk;
+
+// Partir el archivo completo (desde la posición actual) en chunks. El arreglo
+// devuelto en *chunks se libera con free(). Retorna 0 o -1 ante error.
+int cdc_chunk_file(FILE *file, CdcChunk **chunks, size_t *count);
+
+#endif // UDP_CDC_H
@@ -1,6 +1,8 @@
 #include <arpa/inet.h>
 #include <asm-generic/errno-base.h>
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <poll.h>
 #include <stdint.h>
@@ -8,16 +10,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "cdc.h"
 #include "protocol.h"
+#include "tpd.h"
 
-long long current_time_ms() {
+// Engine del protocolo: arma los PDUs, lleva los seq y decide cuándo
+// retransmitir. Acá solo se hace el I/O.
+static TpdClient engine;
+
+static uint64_t current_time_ns(void) {
   struct timespec ts;
   clock_gettime(CLOCK_MONOTONIC, &ts);
-  return (ts.tv_sec * 1000LL) + (ts.tv_nsec / 1000000LL);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
 }
 
 static int addr_equal(const struct sockaddr_in *a,
@@ -26,109 +35,84 @@ static int addr_equal(const struct sockaddr_in *a,
          a->sin_addr.s_addr == b->sin_addr.s_addr;
 }
 
-static int send_pdu_with_retry(int sockfd, struct sockaddr_in *server_addr,
-                               uint8_t type, uint8_t seq_num,
-                               const uint8_t *data, size_t data_len,
-                               uint8_t expected_ack_seq) {
-  uint8_t buffer[MAX_PDU_SIZE];
+// Llevar el intercambio en vuelo del engine hasta el final: enviar el PDU,
+// esperar con poll() hasta el deadline y retransmitir cuando vence. La
+// respuesta (HAVE o mensaje de error) queda en engine.reply.
+// Retorna 0 si llegó la respuesta esperada, -2 si el servidor respondió con
+// un error (ACK con payload) y -1 ante timeout o error local
+static int run_exchange(int sockfd, struct sockaddr_in *server_addr) {
   uint8_t recv_buffer[MAX_PDU_SIZE];
-  ssize_t pdu_size = 2 + (ssize_t)data_len;
-  int retries = 0;
-
-  // Construir PDU
-  buffer[0] = type;
-  buffer[1] = seq_num;
-  if (data_len > 0) {
-    memcpy(buffer + 2, data, data_len);
-  }
-
-  while (retries < MAX_RETRIES) {
-
-    // 1. ENVIAR PDU
-    sendto(sockfd, buffer, pdu_size, 0, (struct sockaddr *)server_addr,
-           sizeof(*server_addr));
-
-    // 2. CALCULAR EL TIEMPO LÍMITE (DEADLINE)
-    long long start_time = current_time_ms();
-    long long deadline = start_time + TIMEOUT_MS;
-
-    while (1) {
-      long long now = current_time_ms();
-      int time_left = (int)(deadline - now);
-
-      // A. Verificamos si se acabó el tiempo REAL
-      if (time_left <= 0) {
-        printf("Timeout real alcanzado (retransmitiendo...)\n");
-        break;
-      }
-
-      // B. Preparamos la estructura poll
-      struct pollfd pfd;
-      pfd.fd = sockfd;     // El socket que miramos
-      pfd.events = POLLIN; // Nos interesa si hay datos para LEER
 
-      // C. Esperamos solo el tiempo que nos queda (time_left)
-      int rc = poll(&pfd, 1, time_left);
+  while (1) {
+    // 1. ENVIAR (o retransmitir) el PDU si el engine lo pide
+    const TpdDatagram *pdu = tpd_client_transmit(&engine);
+    if (pdu) {
+      sendto(sockfd, pdu->buf, pdu->len, 0, (struct sockaddr *)server_addr,
+             sizeof(*server_addr));
+    }
 
-      if (rc < 0) {
-        if (errno == EINTR)
-          continue; // Nos interrumpieron, seguimos intentando
-        perror("poll error");
+    // 2. TIEMPO RESTANTE hasta el deadline de retransmisión
+    uint64_t now = current_time_ns();
+    uint64_t deadline = tpd_client_deadline(&engine);
+    if (now >= deadline) {
+      if (tpd_client_timeout(&engine, now) == TPD_FAILED) {
+        printf("Máximo de reintentos alcanzado\n");
         return -1;
       }
+      printf("Timeout real alcanzado (retransmitiendo...)\n");
+      continue;
+    }
+    int time_left = (int)((deadline - now + 999999) / 1000000);
+
+    // 3. ESPERAR solo el tiempo que queda
+    struct pollfd pfd;
+    pfd.fd = sockfd;
+    pfd.events = POLLIN;
+
+    int rc = poll(&pfd, 1, time_left);
+    if (rc < 0) {
+      if (errno == EINTR)
+        continue; // Nos interrumpieron, seguimos intentando
+      perror("poll error");
+      return -1;
+    }
+    if (rc == 0 || !(pfd.revents & POLLIN)) {
+      continue; // Vuelve arriba y el deadline decide
+    }
 
-      if (rc == 0) {
-        // Poll retornó 0, significa Timeout del poll.
-        // El bucle volverá arriba, calculará time_left <= 0 y saldrá.
-        continue;
-      }
-
-      // D. Si rc > 0, ¡HAY DATOS!
-      if (pfd.revents & POLLIN) {
-
-        struct sockaddr_in from_addr;
-        socklen_t from_len = sizeof(from_addr);
-
-        // Como poll avisó, recvfrom es instantáneo
-        ssize_t recv_len = recvfrom(sockfd, recv_buffer, MAX_PDU_SIZE, 0,
-                                    (struct sockaddr *)&from_addr, &from_len);
-
-        // --- VALIDACIONES (Stop & Wait estricto) ---
-
-        // 1. Validar origen (Ignorar paquetes de intrusos)
-        if (!addr_equal(&from_addr, server_addr)) {
-          printf("Ignorando paquete de IP desconocida\n");
-          continue;
-        }
+    struct sockaddr_in from_addr;
+    socklen_t from_len = sizeof(from_addr);
+    ssize_t recv_len = recvfrom(sockfd, recv_buffer, MAX_PDU_SIZE, 0,
+                                (struct sockaddr *)&from_addr, &from_len);
+    if (recv_len < 0) {
+      continue;
+    }
 
-        // 2. Validar tamaño mínimo
-        if (recv_len < 2)
-          continue; // Muy corto, basura
-
-        // 3. Validar ACK correcto
-        if (recv_buffer[0] == TYPE_ACK && recv_buffer[1] == expected_ack_seq) {
-          if (recv_len > 2) {
-            // El servidor mandó ACK pero con payload -> Es un ERROR lógico
-            // (ej. credenciales mal)
-            printf("Error reportado por servidor: %.*s\n", (int)(recv_len - 2),
-                   recv_buffer + 2);
-            return -1; // Retornamos error para abortar
-          }
-          return 0; // Éxito limpio
-        }
+    // Ignorar paquetes de intrusos
+    if (!addr_equal(&from_addr, server_addr)) {
+      printf("Ignorando paquete de IP desconocida\n");
+      continue;
+    }
 
-        // Si llegamos acá, es un ACK duplicado o incorrecto.
-        // Lo ignoramos y el bucle sigue consumiendo el tiempo restante.
-        printf("Ignorando ACK incorrecto (Seq recibida: %d)\n", recv_buffer[1]);
+    // 4. El engine valida tipo y seq (Stop & Wait estricto)
+    switch (tpd_client_input(&engine, recv_buffer, (size_t)recv_len)) {
+    case TPD_DONE:
+      return 0;
+    case TPD_REJECTED:
+      // El servidor mandó ACK pero con payload -> Es un ERROR lógico
+      // (ej. credenciales mal)
+      printf("Error reportado por servidor: %.*s\n", (int)engine.reply_len,
+             engine.reply);
+      return -2; // Error lógico: el llamador decide si abortar
+    default:
+      // ACK duplicado o incorrecto: seguimos esperando
+      if (recv_len >= 2) {
+        printf("Ignorando ACK incorrecto (Seq recibida: %d)\n",
+               recv_buffer[1]);
       }
+      break;
     }
-
-    // Si salimos del while(1) fue por timeout
-    retries++;
   }
-
-  printf("Máximo de reintentos alcanzado\n");
-  return -1;
 }
 
 // Fase 1: Autenticación
@@ -143,8 +127,8 @@ static int phase_hello(int sockfd, struct sockaddr_in *server_addr,
             MAX_DATA_SIZE);
     return -1;
   }
-  if (send_pdu_with_retry(sockfd, server_addr, TYPE_HELLO, 0,
-                          (const uint8_t *)credentials, cred_len, 0) < 0) {
+  if (tpd_client_hello(&engine, credentials, current_time_ns()) < 0 ||
+      run_exchange(sockfd, server_addr) < 0) {
     fprintf(stderr, "Error en fase de autenticación\n");
     return -1;
   }
@@ -155,7 +139,7 @@ static int phase_hello(int sockfd, struct sockaddr_in *server_addr,
 
 // Fase 2: Write Request
 static int phase_wrq(int sockfd, struct sockaddr_in *server_addr,
-                     const char *filename) {
+                     const char *filename, uint8_t flags) {
   printf("\n=== FASE 2: WRITE REQUEST ===\n");
 
   size_t filename_len = strlen(filename);
@@ -166,14 +150,12 @@ static int phase_wrq(int sockfd, struct sockaddr_in *server_addr,
     return -1;
   }
 
-  // Enviar filename con null terminator
-  uint8_t buffer[12]; // 10 chars + null + margen
-  strcpy((char *)buffer, filename);
-
-  if (send_pdu_with_retry(sockfd, server_addr, TYPE_WRQ, 1, buffer,
-                          filename_len + 1, 1) < 0) {
+  // Enviar filename con null terminator (y los flags, si hay)
+  tpd_client_wrq(&engine, filename, flags, current_time_ns());
+  int rc = run_exchange(sockfd, server_addr);
+  if (rc < 0) {
     fprintf(stderr, "Error en fase de Write Request\n");
-    return -1;
+    return rc; // -2: rechazado por el servidor, la sesión sigue válida
   }
 
   printf("Write Request aceptado\n");
@@ -186,9 +168,7 @@ static int phase_data_transfer(int sockfd, struct sockaddr_in *server_addr,
   printf("\n=== FASE 3: TRANSFERENCIA DE DATOS ===\n");
 
   uint8_t buffer[MAX_DATA_SIZE];
-  uint8_t seq_num = 0;
   size_t total_sent = 0;
-  uint8_t last_seq_sent = 0;
 
   while (1) {
     size_t bytes_read = fread(buffer, 1, MAX_DATA_SIZE, file);
@@ -197,13 +177,13 @@ static int phase_data_transfer(int sockfd, struct sockaddr_in *server_addr,
       if (feof(file)) {
         if (total_sent == 0) {
           // Archivo vacío: enviar un DATA vacío
-          printf("Archivo vacío, enviando DATA vacío con Seq=%d\n", seq_num);
-          if (send_pdu_with_retry(sockfd, server_addr, TYPE_DATA, seq_num, NULL,
-                                  0, seq_num) < 0) {
+          printf("Archivo vacío, enviando DATA vacío con Seq=%d\n",
+                 engine.next_seq);
+          if (tpd_client_data(&engine, NULL, 0, current_time_ns()) < 0 ||
+              run_exchange(sockfd, server_addr) < 0) {
             fprintf(stderr, "Error enviando DATA vacío\n");
             return -1;
           }
-          last_seq_sent = seq_num;
         }
         printf("Archivo completamente leído\n");
         break;
@@ -215,32 +195,142 @@ static int phase_data_transfer(int sockfd, struct sockaddr_in *server_addr,
       continue;
     }
 
-    printf("Enviando DATA chunk: %zu bytes con Seq=%d\n", bytes_read, seq_num);
+    printf("Enviando DATA chunk: %zu bytes con Seq=%d\n", bytes_read,
+           engine.next_seq);
 
-    if (send_pdu_with_retry(sockfd, server_addr, TYPE_DATA, seq_num, buffer,
-                            bytes_read, seq_num) < 0) {
+    // El engine alterna el seq (0 <-> 1) con cada DATA confirmado
+    if (tpd_client_data(&engine, buffer, bytes_read, current_time_ns()) < 0 ||
+        run_exchange(sockfd, server_addr) < 0) {
       fprintf(stderr, "Error enviando datos\n");
       return -1;
     }
 
     total_sent += bytes_read;
-    last_seq_sent = seq_num;
-    seq_num = 1 - seq_num; // Alternar 0 <-> 1
   }
 
   printf("Total enviado: %zu bytes\n", total_sent);
-  return last_seq_sent;
+  return 0;
+}
+
+// Fase 3 (modo deduplicación): manifest de chunks y envío de los faltantes
+static int phase_dedup_transfer(int sockfd, struct sockaddr_in *server_addr,
+                                FILE *file) {
+  printf("\n=== FASE 3: TRANSFERENCIA DEDUPLICADA ===\n");
+
+  CdcChunk *chunks = NULL;
+  size_t count = 0;
+  if (cdc_chunk_file(file, &chunks, &count) < 0) {
+    fprintf(stderr, "Error calculando chunks\n");
+    return -1;
+  }
+
+  // 1 = el servidor no lo tiene y hay que mandarlo
+  uint8_t *needed = calloc(count ? count : 1, 1);
+  if (!needed) {
+    perror("calloc");
+    free(chunks);
+    return -1;
+  }
+
+  int result = -1;
+  uint8_t pdu[MAX_DATA_SIZE];
+  const uint8_t *reply = engine.reply;
+  uint64_t total_bytes = 0;
+  uint64_t sent_bytes = 0;
+  size_t sent_chunks = 0;
+
+  // 1. Manifest: hasta MANIFEST_MAX_ENTRIES chunks por PDU. Un archivo vacío
+  // manda un único MANIFEST sin entradas.
+  size_t next = 0;
+  do {
+    size_t n = count - next;
+    if (n > MANIFEST_MAX_ENTRIES) {
+      n = MANIFEST_MAX_ENTRIES;
+    }
+    pdu[0] = (next + n == count) ? MANIFEST_FLAG_LAST : 0;
+    for (size_t i = 0; i < n; i++) {
+      const CdcChunk *c = &chunks[next + i];
+      uint8_t *entry = pdu + 1 + i * MANIFEST_ENTRY_SIZE;
+      memcpy(entry, c->digest, DIGEST_SIZE);
+      entry[DIGEST_SIZE] = (uint8_t)(c->length >> 24);
+      entry[DIGEST_SIZE + 1] = (uint8_t)(c->length >> 16);
+      entry[DIGEST_SIZE + 2] = (uint8_t)(c->length >> 8);
+      entry[DIGEST_SIZE + 3] = (uint8_t)c->length;
+    }
+
+    if (tpd_client_manifest(&engine, pdu, 1 + n * MANIFEST_ENTRY_SIZE,
+                            current_time_ns()) < 0 ||
+        run_exchange(sockfd, server_addr) < 0) {
+      fprintf(stderr, "Error enviando manifest\n");
+      goto out;
+    }
+    if (engine.reply_len < 1 + (n + 7) / 8 || reply[0] != n) {
+      fprintf(stderr, "Respuesta HAVE inválida\n");
+      goto out;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      needed[next + i] = !(reply[1 + i / 8] & (1u << (i % 8)));
+    }
+    next += n;
+  } while (next < count);
+
+  // 2. DATA solo para los chunks que faltan, en orden del manifest
+  uint8_t *chunk_buf = malloc(CDC_MAX_CHUNK);
+  if (!chunk_buf) {
+    perror("malloc");
+    goto out;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    total_bytes += chunks[i].length;
+    if (!needed[i]) {
+      continue;
+    }
+
+    if (fseeko(file, (off_t)chunks[i].offset, SEEK_SET) < 0 ||
+        fread(chunk_buf, 1, chunks[i].length, file) != chunks[i].length) {
+      perror("leyendo chunk");
+      free(chunk_buf);
+      goto out;
+    }
+
+    for (uint32_t off = 0; off < chunks[i].length; off += MAX_DATA_SIZE) {
+      size_t len = chunks[i].length - off;
+      if (len > MAX_DATA_SIZE) {
+        len = MAX_DATA_SIZE;
+      }
+      if (tpd_client_data(&engine, chunk_buf + off, len,
+                          current_time_ns()) < 0 ||
+          run_exchange(sockfd, server_addr) < 0) {
+        fprintf(stderr, "Error enviando datos\n");
+        free(chunk_buf);
+        goto out;
+      }
+    }
+    sent_bytes += chunks[i].length;
+    sent_chunks++;
+  }
+  free(chunk_buf);
+
+  printf("Chunks: %zu, enviados: %zu (%llu de %llu bytes)\n", count,
+         sent_chunks, (unsigned long long)sent_bytes,
+         (unsigned long long)total_bytes);
+  result = 0;
+
+out:
+  free(needed);
+  free(chunks);
+  return result;
 }
 
 // Fase 4: Finalización
-static int phase_finalize(int sockfd, struct sockaddr_in *server_addr,
-                          uint8_t last_seq) {
+static int phase_finalize(int sockfd, struct sockaddr_in *server_addr) {
   printf("\n=== FASE 4: FINALIZACIÓN ===\n");
 
-  uint8_t next_seq = 1 - last_seq;
-
-  if (send_pdu_with_retry(sockfd, server_addr, TYPE_FIN, next_seq, NULL, 0,
-                          next_seq) < 0) {
+  // El FIN lleva el seq siguiente al último DATA / MANIFEST
+  if (tpd_client_fin(&engine, current_time_ns()) < 0 ||
+      run_exchange(sockfd, server_addr) < 0) {
     fprintf(stderr, "Error en fase de finalización\n");
     return -1;
   }
@@ -249,23 +339,258 @@ static int phase_finalize(int sockfd, struct sockaddr_in *server_addr,
   return 0;
 }
 
+// Archivo a subir dentro de un lote
+typedef struct {
+  char *path;         // Ruta local
+  const char *remote; // Nombre remoto (basename de path)
+} UploadJob;
+
+typedef struct {
+  UploadJob *items;
+  size_t count;
+  size_t capacity;
+} JobList;
+
+// Nombre remoto válido: 4-10 caracteres de [0-9A-Za-z_.-] (igual que el
+// servidor, así evitamos un WRQ que sabemos que va a ser rechazado)
+static int valid_remote_name(const char *name) {
+  size_t len = strlen(name);
+  if (len < 4 || len > 10) {
+    return 0;
+  }
+  for (size_t i = 0; i < len; i++) {
+    unsigned char c = (unsigned char)name[i];
+    if (!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') ||
+          (c >= 'a' && c <= 'z') || c == '_' || c == '-' || c == '.')) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int job_list_add(JobList *list, const char *path) {
+  if (list->count == list->capacity) {
+    size_t new_cap = list->capacity ? list->capacity * 2 : 16;
+    UploadJob *items = realloc(list->items, new_cap * sizeof(UploadJob));
+    if (!items) {
+      perror("realloc");
+      return -1;
+    }
+    list->items = items;
+    list->capacity = new_cap;
+  }
+
+  char *copy = strdup(path);
+  if (!copy) {
+    perror("strdup");
+    return -1;
+  }
+  const char *slash = strrchr(copy, '/');
+  list->items[list->count].path = copy;
+  list->items[list->count].remote = slash ? slash + 1 : copy;
+  list->count++;
+  return 0;
+}
+
+static int compare_names(const void *a, const void *b) {
+  return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+// Agregar todos los archivos regulares de un directorio (no recursivo), en
+// orden alfabético para que el lote sea reproducible
+static int job_list_add_dir(JobList *list, const char *dir_path) {
+  DIR *dir = opendir(dir_path);
+  if (!dir) {
+    perror(dir_path);
+    return -1;
+  }
+
+  char **names = NULL;
+  size_t count = 0, capacity = 0;
+  int result = 0;
+  struct dirent *entry;
+
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.') {
+      continue; // ".", ".." y ocultos
+    }
+    if (count == capacity) {
+      size_t new_cap = capacity ? capacity * 2 : 64;
+      char **tmp = realloc(names, new_cap * sizeof(char *));
+      if (!tmp) {
+        perror("realloc");
+        result = -1;
+        break;
+      }
+      names = tmp;
+      capacity = new_cap;
+    }
+    names[count] = strdup(entry->d_name);
+    if (!names[count]) {
+      perror("strdup");
+      result = -1;
+      break;
+    }
+    count++;
+  }
+  closedir(dir);
+
+  if (result == 0) {
+    qsort(names, count, sizeof(char *), compare_names);
+  }
+
+  char path[4096];
+  for (size_t i = 0; i < count; i++) {
+    if (result == 0) {
+      snprintf(path, sizeof(path), "%s/%s", dir_path, names[i]);
+      struct stat st;
+      if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+        result = job_list_add(list, path);
+      }
+    }
+    free(names[i]);
+  }
+  free(names);
+  return result;
+}
+
+// Un argumento puede ser un archivo o un directorio
+static int job_list_add_arg(JobList *list, const char *arg) {
+  struct stat st;
+  if (stat(arg, &st) < 0) {
+    perror(arg);
+    return -1;
+  }
+  if (S_ISDIR(st.st_mode)) {
+    return job_list_add_dir(list, arg);
+  }
+  return job_list_add(list, arg);
+}
+
+// El nombre remoto es solo el basename (el servidor no acepta '/'): dos
+// archivos del lote con el mismo basename se pisarían en el servidor.
+// Devuelve -1 si hay alguno repetido.
+static int job_list_check_names(const JobList *list) {
+  const char **names = malloc(list->count * sizeof(char *));
+  if (!names) {
+    perror("malloc");
+    return -1;
+  }
+  for (size_t i = 0; i < list->count; i++) {
+    names[i] = list->items[i].remote;
+  }
+  qsort(names, list->count, sizeof(char *), compare_names);
+
+  int result = 0;
+  for (size_t i = 1; i < list->count; i++) {
+    if (strcmp(names[i - 1], names[i]) == 0 &&
+        (i == 1 || strcmp(names[i - 2], names[i]) != 0)) {
+      fprintf(stderr, "ERROR: Más de un archivo del lote se llama '%s' en el "
+                      "servidor:\n",
+              names[i]);
+      for (size_t j = 0; j < list->count; j++) {
+        if (strcmp(list->items[j].remote, names[i]) == 0) {
+          fprintf(stderr, "  %s\n", list->items[j].path);
+        }
+      }
+      result = -1;
+    }
+  }
+  free(names);
+  return result;
+}
+
+static void job_list_free(JobList *list) {
+  for (size_t i = 0; i < list->count; i++) {
+    free(list->items[i].path);
+  }
+  free(list->items);
+}
+
+// Abrir un archivo y pedirle al kernel que lo precargue. Se llama para el
+// archivo siguiente mientras el actual está en vuelo, así la lectura del disco
+// se solapa con los RTT del Stop&Wait.
+static FILE *open_with_readahead(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    perror(path);
+    return NULL;
+  }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+
+  FILE *file = fdopen(fd, "rb");
+  if (!file) {
+    perror("fdopen");
+    close(fd);
+  }
+  return file;
+}
+
 int main(int argc, char *argv[]) {
-  if (argc != 4) {
-    fprintf(stderr, "Uso: %s <server_ip> <filename> <credencial>\n", argv[0]);
+  // Separar opciones de argumentos posicionales
+  int dedup = 0;
+  int npos = 0;
+  char **pos = malloc((size_t)argc * sizeof(char *));
+  if (!pos) {
+    perror("malloc");
+    return 1;
+  }
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-D") == 0) {
+      dedup = 1;
+    } else {
+      pos[npos++] = argv[i];
+    }
+  }
+
+  if (npos < 3) {
+    fprintf(stderr,
+            "Uso: %s [-D] <server_ip> <archivo|directorio> <credencial> "
+            "[archivo|directorio ...]\n",
+            argv[0]);
     fprintf(stderr, "Ejemplo: %s 127.0.0.1 test.bin test_credential\n",
             argv[0]);
+    fprintf(stderr, "         %s 127.0.0.1 datos/ test_credential b.bin\n",
+            argv[0]);
+    fprintf(stderr, "\nOpciones:\n");
+    fprintf(stderr, "  -D          Deduplicación: solo viajan los chunks que "
+                    "el servidor no tiene\n");
+    free(pos);
     return 1;
   }
 
-  const char *server_ip = argv[1];
-  const char *filename_local = argv[2];
-  const char *credentials = argv[3];
-  const char *filename_remoto = filename_local;
+  const char *server_ip = pos[0];
+  const char *credentials = pos[2];
+
+  // Armar la lista de archivos del lote
+  JobList jobs = {0};
+  for (int i = 1; i < npos; i++) {
+    if (i == 2) {
+      continue; // La credencial
+    }
+    if (job_list_add_arg(&jobs, pos[i]) < 0) {
+      free(pos);
+      job_list_free(&jobs);
+      return 1;
+    }
+  }
+  free(pos);
+  if (jobs.count == 0) {
+    fprintf(stderr, "No hay archivos para enviar\n");
+    job_list_free(&jobs);
+    return 1;
+  }
+  if (job_list_check_names(&jobs) < 0) {
+    job_list_free(&jobs);
+    return 1;
+  }
 
   // Crear socket UDP
   int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
   if (sockfd < 0) {
     perror("socket");
+    job_list_free(&jobs);
     return 1;
   }
 
@@ -278,53 +603,102 @@ int main(int argc, char *argv[]) {
   if (inet_pton(AF_INET, server_ip, &server_addr.sin_addr) <= 0) {
     perror("inet_pton");
     close(sockfd);
+    job_list_free(&jobs);
     return 1;
   }
 
-  printf("Conectando a %s:%d\n", server_ip, SERVER_PORT);
+  printf("Conectando a %s:%d (%zu archivo%s)\n", server_ip, SERVER_PORT,
+         jobs.count, jobs.count == 1 ? "" : "s");
 
   // Ejecutar protocolo
   int result = 0;
+  size_t files_ok = 0;
+  size_t files_failed = 0;
   FILE *file = NULL;
+  FILE *next_file = NULL;
+
+  tpd_client_init(&engine, TIMEOUT_MS * 1000000ULL, MAX_RETRIES);
 
-  // Fase 1: HELLO
+  // Fase 1: HELLO (una sola vez para todo el lote)
   if (phase_hello(sockfd, &server_addr, credentials) < 0) {
     result = 1;
     goto cleanup;
   }
 
-  // Fase 2: WRQ
-  if (phase_wrq(sockfd, &server_addr, filename_remoto) < 0) {
-    result = 1;
-    goto cleanup;
-  }
+  next_file = open_with_readahead(jobs.items[0].path);
 
-  // Abrir archivo
-  file = fopen(filename_local, "rb");
-  if (!file) {
-    perror("fopen");
-    result = 1;
-    goto cleanup;
-  }
+  for (size_t i = 0; i < jobs.count; i++) {
+    const UploadJob *job = &jobs.items[i];
+    file = next_file;
+    next_file = NULL;
 
-  // Fase 3: DATA
-  int last_seq = phase_data_transfer(sockfd, &server_addr, file);
-  if (last_seq < 0) {
-    result = 1;
-    goto cleanup;
+    printf("\n--- Archivo %zu/%zu: %s -> '%s' ---\n", i + 1, jobs.count,
+           job->path, job->remote);
+
+    if (!file || !valid_remote_name(job->remote)) {
+      if (file) {
+        fprintf(stderr, "Nombre remoto inválido '%s' (4-10 caracteres "
+                        "[0-9A-Za-z_.-]), se omite\n",
+                job->remote);
+      }
+      files_failed++;
+      goto next;
+    }
+
+    // Fase 2: WRQ (tras un FIN el servidor vuelve a aceptar WRQ)
+    int rc = phase_wrq(sockfd, &server_addr, job->remote,
+                       dedup ? WRQ_FLAG_DEDUP : 0);
+    if (rc == -2) {
+      files_failed++;
+      goto next;
+    }
+    if (rc < 0) {
+      result = 1;
+      goto cleanup;
+    }
+
+    // Precargar el siguiente archivo mientras este está en vuelo
+    if (i + 1 < jobs.count) {
+      next_file = open_with_readahead(jobs.items[i + 1].path);
+    }
+
+    // Fase 3: DATA (completo o solo los chunks que faltan)
+    int rc_data = dedup ? phase_dedup_transfer(sockfd, &server_addr, file)
+                        : phase_data_transfer(sockfd, &server_addr, file);
+    if (rc_data < 0) {
+      result = 1;
+      goto cleanup;
+    }
+
+    // Fase 4: FIN
+    if (phase_finalize(sockfd, &server_addr) < 0) {
+      result = 1;
+      goto cleanup;
+    }
+    files_ok++;
+
+  next:
+    if (file) {
+      fclose(file);
+      file = NULL;
+    }
+    if (!next_file && i + 1 < jobs.count) {
+      next_file = open_with_readahead(jobs.items[i + 1].path);
+    }
   }
 
-  // Fase 4: FIN
-  if (phase_finalize(sockfd, &server_addr, (uint8_t)last_seq) < 0) {
+  if (files_failed > 0) {
     result = 1;
-    goto cleanup;
   }
-
-  printf("\n✓ Transferencia completada exitosamente\n");
+  printf("\n%s Lote finalizado: %zu enviados, %zu con error\n",
+         files_failed == 0 ? "✓" : "✗", files_ok, files_failed);
 
 cleanup:
   close(sockfd);
   if (file)
     fclose(file);
+  if (next_file)
+    fclose(next_file);
+  job_list_free(&jobs);
   return result;
 }
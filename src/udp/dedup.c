@@ -0,0 +1,311 @@
+#include "dedup.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define COPY_BUF_SIZE (64 * 1024)
+
+// Ruta del chunk en el almacén
+static void chunk_path(const uint8_t *digest, char *out, size_t out_len) {
+  char hex[2 * DIGEST_SIZE + 1];
+  sha256_hex(digest, hex);
+  snprintf(out, out_len, "%s/%.2s/%s", CHUNK_STORE_DIR, hex, hex);
+}
+
+static int chunk_exists(const uint8_t *digest) {
+  char path[128];
+  chunk_path(digest, path, sizeof(path));
+  return access(path, F_OK) == 0;
+}
+
+int dedup_store_init(void) {
+  if (mkdir(CHUNK_STORE_DIR, 0755) < 0 && errno != EEXIST) {
+    perror("mkdir " CHUNK_STORE_DIR);
+    return -1;
+  }
+  return 0;
+}
+
+DedupState *dedup_new(void) {
+  DedupState *d = calloc(1, sizeof(DedupState));
+  if (!d) {
+    perror("calloc dedup");
+    return NULL;
+  }
+  d->tmp_fd = -1;
+  return d;
+}
+
+void dedup_free(DedupState *d) {
+  if (!d) {
+    return;
+  }
+  if (d->tmp_fd >= 0) {
+    close(d->tmp_fd);
+    unlink(d->tmp_path);
+  }
+  free(d->entries);
+  free(d->missing);
+  free(d->pending_slots);
+  free(d);
+}
+
+static uint64_t digest_key(const uint8_t *digest) {
+  uint64_t key;
+  memcpy(&key, digest, sizeof(key));
+  return key;
+}
+
+// Buscar un digest entre los chunks pendientes de este archivo
+static int pending_contains(const DedupState *d, const uint8_t *digest) {
+  if (d->pending_slot_count == 0) {
+    return 0;
+  }
+  size_t mask = d->pending_slot_count - 1;
+  size_t slot = (size_t)digest_key(digest) & mask;
+  while (d->pending_slots[slot] != 0) {
+    const ManifestEntry *e = &d->entries[d->pending_slots[slot] - 1];
+    if (memcmp(e->digest, digest, DIGEST_SIZE) == 0) {
+      return 1;
+    }
+    slot = (slot + 1) & mask;
+  }
+  return 0;
+}
+
+static void pending_insert_slot(uint32_t *slots, size_t slot_count,
+                                const ManifestEntry *entries, uint32_t idx) {
+  size_t mask = slot_count - 1;
+  size_t slot = (size_t)digest_key(entries[idx].digest) & mask;
+  while (slots[slot] != 0) {
+    slot = (slot + 1) & mask;
+  }
+  slots[slot] = idx + 1;
+}
+
+// Registrar el chunk idx como faltante (factor de carga <= 1/2)
+static int add_missing(DedupState *d, uint32_t idx) {
+  if ((d->missing_count + 1) * 2 > d->pending_slot_count) {
+    size_t new_count = d->pending_slot_count ? d->pending_slot_count * 2 : 64;
+    uint32_t *slots = calloc(new_count, sizeof(uint32_t));
+    if (!slots) {
+      return -1;
+    }
+    for (size_t i = 0; i < d->missing_count; i++) {
+      pending_insert_slot(slots, new_count, d->entries, d->missing[i]);
+    }
+    free(d->pending_slots);
+    d->pending_slots = slots;
+    d->pending_slot_count = new_count;
+  }
+
+  if (d->missing_count == d->missing_capacity) {
+    size_t new_cap = d->missing_capacity ? d->missing_capacity * 2 : 64;
+    uint32_t *tmp = realloc(d->missing, new_cap * sizeof(uint32_t));
+    if (!tmp) {
+      return -1;
+    }
+    d->missing = tmp;
+    d->missing_capacity = new_cap;
+  }
+
+  d->missing[d->missing_count++] = idx;
+  pending_insert_slot(d->pending_slots, d->pending_slot_count, d->entries,
+                      idx);
+  return 0;
+}
+
+int dedup_manifest(DedupState *d, const uint8_t *payload, size_t len,
+                   const char **err) {
+  if (d->manifest_done) {
+    *err = "Manifest already complete";
+    return -1;
+  }
+  if (len < 1 || (len - 1) % MANIFEST_ENTRY_SIZE != 0) {
+    *err = "Malformed manifest";
+    return -1;
+  }
+
+  uint8_t flags = payload[0];
+  size_t n = (len - 1) / MANIFEST_ENTRY_SIZE;
+  if (d->count + n > DEDUP_MAX_ENTRIES) {
+    *err = "Manifest too large";
+    return -1;
+  }
+
+  if (d->count + n > d->capacity) {
+    size_t new_cap = d->capacity ? d->capacity * 2 : 256;
+    while (new_cap < d->count + n) {
+      new_cap *= 2;
+    }
+    ManifestEntry *tmp = realloc(d->entries, new_cap * sizeof(ManifestEntry));
+    if (!tmp) {
+      *err = "Server error";
+      return -1;
+    }
+    d->entries = tmp;
+    d->capacity = new_cap;
+  }
+
+  memset(d->last_have, 0, sizeof(d->last_have));
+  d->last_have[0] = (uint8_t)n;
+  d->last_have_len = 1 + (n + 7) / 8;
+
+  for (size_t i = 0; i < n; i++) {
+    const uint8_t *raw = payload + 1 + i * MANIFEST_ENTRY_SIZE;
+    ManifestEntry *e = &d->entries[d->count];
+    memcpy(e->digest, raw, DIGEST_SIZE);
+    e->length = ((uint32_t)raw[DIGEST_SIZE] << 24) |
+                ((uint32_t)raw[DIGEST_SIZE + 1] << 16) |
+                ((uint32_t)raw[DIGEST_SIZE + 2] << 8) |
+                (uint32_t)raw[DIGEST_SIZE + 3];
+    if (e->length == 0 || e->length > MAX_CHUNK_SIZE) {
+      *err = "Invalid chunk length";
+      return -1;
+    }
+
+    // Ya está en el almacén o va a llegar antes en este mismo archivo
+    if (pending_contains(d, e->digest) || chunk_exists(e->digest)) {
+      d->last_have[1 + i / 8] |= (uint8_t)(1u << (i % 8));
+    } else if (add_missing(d, (uint32_t)d->count) < 0) {
+      *err = "Server error";
+      return -1;
+    }
+    d->bytes_total += e->length;
+    d->count++;
+  }
+
+  if (flags & MANIFEST_FLAG_LAST) {
+    d->manifest_done = 1;
+  }
+  return 0;
+}
+
+// Verificar el chunk recibido y moverlo al almacén
+static int finish_chunk(DedupState *d, const ManifestEntry *e,
+                        const char **err) {
+  uint8_t digest[DIGEST_SIZE];
+  sha256_final(&d->sha, digest);
+  close(d->tmp_fd);
+  d->tmp_fd = -1;
+
+  if (memcmp(digest, e->digest, DIGEST_SIZE) != 0) {
+    unlink(d->tmp_path);
+    *err = "Chunk digest mismatch";
+    return -1;
+  }
+
+  char path[128];
+  chunk_path(e->digest, path, sizeof(path));
+  char *slash = strrchr(path, '/');
+  *slash = '\0';
+  if (mkdir(path, 0755) < 0 && errno != EEXIST) {
+    perror("mkdir chunk dir");
+    unlink(d->tmp_path);
+    *err = "Server error";
+    return -1;
+  }
+  *slash = '/';
+
+  if (rename(d->tmp_path, path) < 0) {
+    perror("rename chunk");
+    unlink(d->tmp_path);
+    *err = "Server error";
+    return -1;
+  }
+
+  d->next_missing++;
+  d->chunk_filled = 0;
+  return 0;
+}
+
+int dedup_data(DedupState *d, const uint8_t *data, size_t len,
+               const char **err) {
+  if (!d->manifest_done) {
+    *err = "DATA before manifest";
+    return -1;
+  }
+  if (d->next_missing >= d->missing_count) {
+    *err = "Unexpected chunk data";
+    return -1;
+  }
+
+  const ManifestEntry *e = &d->entries[d->missing[d->next_missing]];
+  if (len == 0 || d->chunk_filled + len > e->length) {
+    *err = "Chunk data overflow";
+    return -1;
+  }
+
+  if (d->tmp_fd < 0) {
+    snprintf(d->tmp_path, sizeof(d->tmp_path), "%s/tmp-XXXXXX",
+             CHUNK_STORE_DIR);
+    d->tmp_fd = mkstemp(d->tmp_path);
+    if (d->tmp_fd < 0) {
+      perror("mkstemp");
+      *err = "Server error";
+      return -1;
+    }
+    sha256_init(&d->sha);
+  }
+
+  ssize_t written = write(d->tmp_fd, data, len);
+  if (written < 0 || (size_t)written != len) {
+    perror("write chunk");
+    *err = "Server error";
+    return -1;
+  }
+  sha256_update(&d->sha, data, len);
+  d->chunk_filled += (uint32_t)len;
+  d->bytes_received += len;
+
+  if (d->chunk_filled == e->length) {
+    return finish_chunk(d, e, err);
+  }
+  return 0;
+}
+
+int dedup_complete(const DedupState *d) {
+  return d->manifest_done && d->next_missing == d->missing_count;
+}
+
+int dedup_assemble(const DedupState *d, int out_fd, const char **err) {
+  static uint8_t buf[COPY_BUF_SIZE];
+
+  for (size_t i = 0; i < d->count; i++) {
+    const ManifestEntry *e = &d->entries[i];
+    char path[128];
+    chunk_path(e->digest, path, sizeof(path));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+      perror(path);
+      *err = "Missing chunk in store";
+      return -1;
+    }
+
+    size_t copied = 0;
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+      ssize_t w = write(out_fd, buf, (size_t)n);
+      if (w != n) {
+        perror("write");
+        close(fd);
+        *err = "Server error";
+        return -1;
+      }
+      copied += (size_t)n;
+    }
+    close(fd);
+
+    if (n < 0 || copied != e->length) {
+      *err = "Corrupt chunk in store";
+      return -1;
+    }
+  }
+  return 0;
+}
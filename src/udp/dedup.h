@@ -0,0 +1,81 @@
+#ifndef UDP_DEDUP_H
+#define UDP_DEDUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "protocol.h"
+#include "sha256.h"
+
+// Lado servidor de la transferencia deduplicada.
+//
+// Los chunks se guardan en un almacén direccionado por contenido:
+//   uploads/.chunks/<2 primeros hex>/<sha256 en hex>
+// El cliente manda el manifest (digest + largo de cada chunk), el servidor
+// contesta cuáles ya tiene y por DATA solo llegan los que faltan, en el orden
+// del manifest. Al recibir el FIN el archivo final se arma concatenando los
+// chunks del almacén.
+
+#define CHUNK_STORE_DIR "uploads/.chunks"
+#define DEDUP_MAX_ENTRIES (1u << 24) // Tope del manifest por archivo
+
+typedef struct {
+  uint8_t digest[DIGEST_SIZE];
+  uint32_t length;
+} ManifestEntry;
+
+typedef struct DedupState {
+  ManifestEntry *entries; // Manifest completo, en orden del archivo
+  size_t count;
+  size_t capacity;
+
+  uint32_t *missing; // Índices (en entries) de los chunks que deben llegar
+  size_t missing_count;
+  size_t missing_capacity;
+  size_t next_missing; // Chunk faltante que se está recibiendo
+
+  // Hash set de digests pendientes (índice en entries + 1, 0 = vacío), para
+  // que un chunk repetido dentro del mismo archivo viaje una sola vez
+  uint32_t *pending_slots;
+  size_t pending_slot_count;
+
+  int manifest_done;
+
+  // Chunk en recepción: se escribe a un temporal y se verifica el digest
+  // antes de moverlo al almacén
+  int tmp_fd;
+  char tmp_path[64];
+  uint32_t chunk_filled;
+  Sha256Ctx sha;
+
+  // Última respuesta HAVE, para reenviarla ante un MANIFEST duplicado
+  uint8_t last_have[HAVE_PAYLOAD_SIZE];
+  size_t last_have_len;
+  int last_reply_have; // La última respuesta de la sesión fue un HAVE
+
+  uint64_t bytes_total;    // Tamaño del archivo según el manifest
+  uint64_t bytes_received; // Bytes que viajaron por DATA
+} DedupState;
+
+// Crear el directorio del almacén (uploads/ debe existir)
+int dedup_store_init(void);
+
+DedupState *dedup_new(void);
+void dedup_free(DedupState *d);
+
+// Procesar el payload de un MANIFEST y armar la respuesta HAVE en
+// d->last_have. Retorna 0, o -1 con *err apuntando al motivo.
+int dedup_manifest(DedupState *d, const uint8_t *payload, size_t len,
+                   const char **err);
+
+// Escribir el payload de un DATA en el chunk faltante en curso
+int dedup_data(DedupState *d, const uint8_t *data, size_t len,
+               const char **err);
+
+// 1 si el manifest terminó y llegaron todos los chunks faltantes
+int dedup_complete(const DedupState *d);
+
+// Armar el archivo final en out_fd a partir del almacén
+int dedup_assemble(const DedupState *d, int out_fd, const char **err);
+
+#endif // UDP_DEDUP_H
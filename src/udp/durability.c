@@ -0,0 +1,320 @@
+#define _GNU_SOURCE // sync_file_range
+
+#include "durability.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+static uint64_t monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void durability_init(Durability *d, DurabilityMode mode, long window_us) {
+  memset(d, 0, sizeof(*d));
+  d->mode = mode;
+  d->window_ns = (uint64_t)window_us * 1000ULL;
+  d->dir_fd = -1;
+  d->event_fd = -1;
+  latency_hist_init(&d->latency);
+}
+
+int durability_parse_mode(const char *s, DurabilityMode *mode) {
+  if (strcmp(s, "none") == 0) {
+    *mode = DURABILITY_NONE;
+  } else if (strcmp(s, "fin") == 0) {
+    *mode = DURABILITY_FSYNC;
+  } else if (strcmp(s, "group") == 0) {
+    *mode = DURABILITY_GROUP;
+  } else {
+    return -1;
+  }
+  return 0;
+}
+
+const char *durability_mode_name(DurabilityMode mode) {
+  switch (mode) {
+  case DURABILITY_FSYNC:
+    return "fin";
+  case DURABILITY_GROUP:
+    return "group";
+  default:
+    return "none";
+  }
+}
+
+// fsync del directorio: sin esto un archivo recién creado puede desaparecer
+// aunque sus datos estén en disco. Se abre a demanda porque uploads/ se crea
+// con el primer WRQ.
+static int sync_dir(Durability *d) {
+  if (d->dir_fd < 0) {
+    d->dir_fd = open(DURABILITY_DIR, O_RDONLY | O_DIRECTORY);
+    if (d->dir_fd < 0) {
+      return errno;
+    }
+  }
+  return fsync(d->dir_fd) < 0 ? errno : 0;
+}
+
+static void record_latency(Durability *d, const struct timespec *rx_ts) {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  int64_t ns = (int64_t)(now.tv_sec - rx_ts->tv_sec) * 1000000000LL +
+               (now.tv_nsec - rx_ts->tv_nsec);
+  latency_hist_record(&d->latency, ns > 0 ? (uint64_t)ns : 0);
+}
+
+static void record_batch(Durability *d, size_t n) {
+  int bucket = 0;
+  while (bucket < COMMIT_BATCH_BUCKETS - 1 && ((size_t)2 << bucket) <= n) {
+    bucket++;
+  }
+  d->batch_sizes[bucket]++;
+  d->batches++;
+  if (n > d->max_batch) {
+    d->max_batch = n;
+  }
+}
+
+// Sincronizar un lote: lanzar el writeback de todos los archivos antes de
+// esperar a ninguno (así el dispositivo recibe el lote completo de una vez),
+// un fdatasync por archivo y un solo fsync del directorio para todas las
+// entradas. Corre sin el lock.
+static void sync_batch(Durability *d, PendingCommit *batch) {
+  for (PendingCommit *c = batch; c; c = c->next) {
+    sync_file_range(c->fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+  }
+  int ok = 0;
+  for (PendingCommit *c = batch; c; c = c->next) {
+    c->err = fdatasync(c->fd) < 0 ? errno : 0;
+    ok |= c->err == 0;
+  }
+  int dir_err = ok ? sync_dir(d) : 0;
+  for (PendingCommit *c = batch; c; c = c->next) {
+    if (!c->err) {
+      c->err = dir_err;
+    }
+  }
+}
+
+// Sacar de la cola hasta max commits, en orden. Con lock tomado.
+static PendingCommit *take_batch(Durability *d, size_t max, size_t *n) {
+  PendingCommit *batch = d->queue;
+  PendingCommit *last = NULL;
+  *n = 0;
+  for (PendingCommit *c = d->queue; c && *n < max; c = c->next) {
+    last = c;
+    (*n)++;
+  }
+  d->queue = last->next;
+  if (!d->queue) {
+    d->queue_tail = NULL;
+  }
+  d->queued -= *n;
+  last->next = NULL;
+  return batch;
+}
+
+// Hilo de commit: espera FIN, arma el lote (en group, los que lleguen dentro
+// de la ventana del primero) y lo sincroniza mientras el loop sigue
+// recibiendo. Los FIN que llegan durante un sync forman el lote siguiente.
+static void *commit_main(void *arg) {
+  Durability *d = arg;
+  pthread_mutex_lock(&d->lock);
+  while (1) {
+    while (!d->queue && !d->stopping) {
+      pthread_cond_wait(&d->wake, &d->lock);
+    }
+    if (!d->queue) {
+      break; // stopping y nada pendiente
+    }
+
+    size_t max = 1;
+    if (d->mode == DURABILITY_GROUP) {
+      max = COMMIT_MAX_BATCH;
+      uint64_t deadline_ns = d->queue->queued_ns + d->window_ns;
+      struct timespec ts;
+      ts.tv_sec = (time_t)(deadline_ns / 1000000000ULL);
+      ts.tv_nsec = (long)(deadline_ns % 1000000000ULL);
+      while (d->queued < COMMIT_MAX_BATCH && !d->stopping) {
+        if (pthread_cond_timedwait(&d->wake, &d->lock, &ts) == ETIMEDOUT) {
+          break;
+        }
+      }
+    }
+    size_t n;
+    PendingCommit *batch = take_batch(d, max, &n);
+    pthread_mutex_unlock(&d->lock);
+
+    sync_batch(d, batch);
+
+    pthread_mutex_lock(&d->lock);
+    record_batch(d, n);
+    for (PendingCommit *c = batch; c; c = c->next) {
+      if (c->err) {
+        d->errors++;
+      } else {
+        d->files++;
+        record_latency(d, &c->rx_ts);
+      }
+    }
+    if (d->done_tail) {
+      d->done_tail->next = batch;
+    } else {
+      d->done = batch;
+    }
+    PendingCommit *tail = batch;
+    while (tail->next) {
+      tail = tail->next;
+    }
+    d->done_tail = tail;
+    __atomic_store_n(&d->done_ready, 1, __ATOMIC_RELEASE);
+    uint64_t one = 1;
+    if (write(d->event_fd, &one, sizeof(one)) < 0) {
+      // Nada: el contador solo puede estar lleno si ya hay aviso pendiente
+    }
+  }
+  pthread_mutex_unlock(&d->lock);
+  return NULL;
+}
+
+int durability_start(Durability *d) {
+  if (d->mode == DURABILITY_NONE) {
+    return 0;
+  }
+  d->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (d->event_fd < 0) {
+    return -1;
+  }
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&d->wake, &attr);
+  pthread_condattr_destroy(&attr);
+  pthread_mutex_init(&d->lock, NULL);
+
+  // Las señales (Ctrl+C, SIGUSR1) las atiende el loop
+  sigset_t all, old;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  int err = pthread_create(&d->thread, NULL, commit_main, d);
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  if (err) {
+    errno = err;
+    return -1;
+  }
+  d->started = 1;
+  return 0;
+}
+
+int durability_submit(Durability *d, int fd, uint8_t seq_num,
+                      const struct sockaddr_in *addr,
+                      const struct timespec *rx_ts) {
+  PendingCommit *commit = malloc(sizeof(PendingCommit));
+  if (!commit) {
+    return -1;
+  }
+  commit->fd = fd;
+  commit->seq_num = seq_num;
+  commit->addr = *addr;
+  commit->rx_ts = *rx_ts;
+  commit->queued_ns = monotonic_ns();
+  commit->err = 0;
+  commit->next = NULL;
+
+  pthread_mutex_lock(&d->lock);
+  if (d->queue_tail) {
+    d->queue_tail->next = commit;
+  } else {
+    d->queue = commit;
+  }
+  d->queue_tail = commit;
+  d->queued++;
+  pthread_cond_signal(&d->wake);
+  pthread_mutex_unlock(&d->lock);
+  return 0;
+}
+
+void durability_complete(Durability *d, CommitDoneFn done) {
+  uint64_t count;
+  if (read(d->event_fd, &count, sizeof(count)) < 0) {
+    // EAGAIN: el aviso ya se consumió, igual se mira la cola
+  }
+  pthread_mutex_lock(&d->lock);
+  PendingCommit *list = d->done;
+  d->done = NULL;
+  d->done_tail = NULL;
+  __atomic_store_n(&d->done_ready, 0, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&d->lock);
+
+  while (list) {
+    PendingCommit *next = list->next;
+    done(list, list->err);
+    free(list);
+    list = next;
+  }
+}
+
+void durability_close(Durability *d, CommitDoneFn done) {
+  if (d->started) {
+    pthread_mutex_lock(&d->lock);
+    d->stopping = 1;
+    pthread_cond_signal(&d->wake);
+    pthread_mutex_unlock(&d->lock);
+    pthread_join(d->thread, NULL);
+    d->started = 0;
+    durability_complete(d, done);
+    pthread_cond_destroy(&d->wake);
+    pthread_mutex_destroy(&d->lock);
+  }
+  if (d->event_fd >= 0) {
+    close(d->event_fd);
+    d->event_fd = -1;
+  }
+  if (d->dir_fd >= 0) {
+    close(d->dir_fd);
+    d->dir_fd = -1;
+  }
+}
+
+void durability_print(Durability *d, FILE *out) {
+  if (d->mode == DURABILITY_NONE) {
+    return;
+  }
+  if (d->started) {
+    pthread_mutex_lock(&d->lock);
+  }
+
+  fprintf(out, "\n=== Durabilidad (%s) ===\n", durability_mode_name(d->mode));
+  fprintf(out, "Archivos en disco: %llu, errores de sync: %llu\n", d->files,
+          d->errors);
+  if (d->batches > 0) {
+    fprintf(out, "Lotes: %llu, archivos por lote: media %.2f, máx %zu\n",
+            d->batches, (double)(d->files + d->errors) / (double)d->batches,
+            d->max_batch);
+    for (int b = 0; b < COMMIT_BATCH_BUCKETS; b++) {
+      if (d->batch_sizes[b] == 0) {
+        continue;
+      }
+      unsigned lo = 1u << b;
+      if (b == COMMIT_BATCH_BUCKETS - 1) {
+        fprintf(out, "  >= %-9u %llu\n", lo, d->batch_sizes[b]);
+      } else if (lo == 1) {
+        fprintf(out, "  %-12u %llu\n", lo, d->batch_sizes[b]);
+      } else {
+        fprintf(out, "  %4u-%-7u %llu\n", lo, 2 * lo - 1, d->batch_sizes[b]);
+      }
+    }
+  }
+  latency_hist_print(&d->latency, out,
+                     "Latencia de commit (recepción del FIN -> disco)");
+  if (d->started) {
+    pthread_mutex_unlock(&d->lock);
+  }
+}
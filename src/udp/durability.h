@@ -0,0 +1,117 @@
+#ifndef UDP_DURABILITY_H
+#define UDP_DURABILITY_H
+
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "latency.h"
+
+// Política de durabilidad de los archivos recibidos: qué garantiza el ACK del
+// FIN.
+//
+//   none   El ACK sale apenas se cierra el archivo (puede quedar en la page
+//          cache y perderse ante un corte de luz).
+//   fin    fdatasync() del archivo y fsync() de uploads/ antes de cada ACK.
+//   group  Group commit: los FIN que llegan dentro de una ventana se
+//          sincronizan juntos (writeback lanzado para todos, después un
+//          fdatasync por archivo y un solo fsync del directorio) y recién
+//          entonces se mandan sus ACK.
+//
+// Los sync los hace un hilo de commit: el loop de recepción le entrega cada
+// FIN y sigue recibiendo y despachando mientras el disco trabaja. Los FIN ya
+// en disco vuelven por una cola; un eventfd (que el loop agrega a su poll)
+// avisa que hay, y el loop manda sus ACK con durability_complete.
+
+typedef enum {
+  DURABILITY_NONE = 0,
+  DURABILITY_FSYNC,
+  DURABILITY_GROUP,
+} DurabilityMode;
+
+#define DURABILITY_DIR "uploads"
+#define DURABILITY_DEFAULT_WINDOW_US 2000
+#define COMMIT_MAX_BATCH 128
+#define COMMIT_BATCH_BUCKETS 8 // Tamaños de lote 1, 2-3, 4-7, ..., >= 128
+
+// FIN cuyo ACK espera a que el archivo quede en disco
+typedef struct PendingCommit {
+  int fd;
+  uint8_t seq_num;
+  struct sockaddr_in addr;
+  struct timespec rx_ts; // Recepción del FIN (kernel, CLOCK_REALTIME)
+  uint64_t queued_ns;    // CLOCK_MONOTONIC de la entrega al hilo
+  int err;               // Resultado del sync: 0 o errno
+  struct PendingCommit *next;
+} PendingCommit;
+
+typedef struct {
+  DurabilityMode mode;
+  uint64_t window_ns;
+  int dir_fd; // uploads/, para que las entradas nuevas sobrevivan (del hilo)
+
+  // Todo lo que sigue, salvo event_fd, se toca con lock tomado
+  pthread_t thread;
+  int started;
+  int stopping; // Sincronizar lo encolado y terminar
+  pthread_mutex_t lock;
+  pthread_cond_t wake; // Hay FIN nuevos o stopping (CLOCK_MONOTONIC)
+  PendingCommit *queue, *queue_tail; // Esperando sync, en orden
+  size_t queued;
+  PendingCommit *done, *done_tail; // Ya sincronizados, esperando su ACK
+  int done_ready;                  // Hay en done (se lee sin lock)
+  int event_fd;                    // Avisa al loop que hay en done
+
+  // Estadísticas
+  unsigned long long files;
+  unsigned long long batches;
+  unsigned long long errors;
+  size_t max_batch;
+  unsigned long long batch_sizes[COMMIT_BATCH_BUCKETS];
+  LatencyHist latency; // Recepción del FIN -> datos en disco
+} Durability;
+
+// Se llama una vez por archivo, desde durability_complete, con err = 0 si
+// quedó en disco o el errno de la falla. El commit se libera al volver.
+typedef void (*CommitDoneFn)(PendingCommit *commit, int err);
+
+void durability_init(Durability *d, DurabilityMode mode, long window_us);
+
+// Arrancar el hilo de commit (nada en modo none). Retorna -1 con errno.
+int durability_start(Durability *d);
+
+// Sincronizar lo pendiente, terminar el hilo, confirmar lo que quedó (done)
+// y liberar todo
+void durability_close(Durability *d, CommitDoneFn done);
+
+// Parsear "none", "fin" o "group". Retorna -1 si no es un modo válido.
+int durability_parse_mode(const char *s, DurabilityMode *mode);
+const char *durability_mode_name(DurabilityMode mode);
+
+// Modos fin y group: entregar al hilo el FIN del archivo fd, que pasa a ser
+// suyo hasta done. Retorna -1 con errno si no hay memoria.
+int durability_submit(Durability *d, int fd, uint8_t seq_num,
+                      const struct sockaddr_in *addr,
+                      const struct timespec *rx_ts);
+
+// Descriptor para el poll() del loop: legible cuando hay FIN ya en disco.
+// -1 en modo none.
+static inline int durability_event_fd(const Durability *d) {
+  return d->event_fd;
+}
+
+// Hay FIN ya en disco esperando su ACK (para no depender del poll() cuando
+// el loop está ocupado)
+static inline int durability_has_done(Durability *d) {
+  return __atomic_load_n(&d->done_ready, __ATOMIC_ACQUIRE);
+}
+
+// Llamar a done con cada FIN ya en disco, en el hilo del loop
+void durability_complete(Durability *d, CommitDoneFn done);
+
+void durability_print(Durability *d, FILE *out);
+
+#endif // UDP_DURABILITY_H
@@ -0,0 +1,120 @@
+#include "latency.h"
+
+#include <string.h>
+
+static int bucket_index(uint64_t ns) {
+  if (ns < LATENCY_LINEAR) {
+    return (int)ns;
+  }
+  int msb = 63 - __builtin_clzll(ns);
+  int sub =
+      (int)(ns >> (msb - LATENCY_SUB_BITS)) & ((1 << LATENCY_SUB_BITS) - 1);
+  return LATENCY_LINEAR +
+         (msb - LATENCY_SUB_BITS - 1) * (1 << LATENCY_SUB_BITS) + sub;
+}
+
+// Cota superior (inclusive) de los valores que caen en el bucket
+static uint64_t bucket_upper(int b) {
+  if (b < LATENCY_LINEAR) {
+    return (uint64_t)b;
+  }
+  int rel = b - LATENCY_LINEAR;
+  int msb = rel / (1 << LATENCY_SUB_BITS) + LATENCY_SUB_BITS + 1;
+  uint64_t sub = (uint64_t)(rel % (1 << LATENCY_SUB_BITS));
+  uint64_t width = 1ULL << (msb - LATENCY_SUB_BITS);
+  return (((1ULL << LATENCY_SUB_BITS) + sub) << (msb - LATENCY_SUB_BITS)) +
+         width - 1;
+}
+
+void latency_hist_init(LatencyHist *h) {
+  memset(h, 0, sizeof(*h));
+  h->min_ns = UINT64_MAX;
+}
+
+void latency_hist_record(LatencyHist *h, uint64_t ns) {
+  h->counts[bucket_index(ns)]++;
+  h->total++;
+  h->sum_ns += ns;
+  if (ns < h->min_ns) {
+    h->min_ns = ns;
+  }
+  if (ns > h->max_ns) {
+    h->max_ns = ns;
+  }
+}
+
+void latency_hist_merge(LatencyHist *dst, const LatencyHist *src) {
+  for (int b = 0; b < LATENCY_BUCKETS; b++) {
+    dst->counts[b] += src->counts[b];
+  }
+  dst->total += src->total;
+  dst->sum_ns += src->sum_ns;
+  if (src->min_ns < dst->min_ns) {
+    dst->min_ns = src->min_ns;
+  }
+  if (src->max_ns > dst->max_ns) {
+    dst->max_ns = src->max_ns;
+  }
+}
+
+uint64_t latency_hist_percentile(const LatencyHist *h, double q) {
+  if (h->total == 0) {
+    return 0;
+  }
+  uint64_t target = (uint64_t)(q * (double)h->total);
+  if (target >= h->total) {
+    target = h->total - 1;
+  }
+
+  uint64_t seen = 0;
+  for (int b = 0; b < LATENCY_BUCKETS; b++) {
+    seen += h->counts[b];
+    if (seen > target) {
+      uint64_t upper = bucket_upper(b);
+      return upper < h->max_ns ? upper : h->max_ns;
+    }
+  }
+  return h->max_ns;
+}
+
+void latency_hist_print(const LatencyHist *h, FILE *out, const char *title) {
+  fprintf(out, "\n=== %s ===\n", title);
+  if (h->total == 0) {
+    fprintf(out, "Sin muestras\n");
+    return;
+  }
+
+  fprintf(out, "Muestras: %llu\n", (unsigned long long)h->total);
+  fprintf(out, "Media: %.2f us  Mín: %.2f us  Máx: %.2f us\n",
+          (double)h->sum_ns / h->total / 1000.0, h->min_ns / 1000.0,
+          h->max_ns / 1000.0);
+  fprintf(out, "p50: %.2f us  p90: %.2f us  p99: %.2f us  p99.9: %.2f us\n",
+          latency_hist_percentile(h, 0.50) / 1000.0,
+          latency_hist_percentile(h, 0.90) / 1000.0,
+          latency_hist_percentile(h, 0.99) / 1000.0,
+          latency_hist_percentile(h, 0.999) / 1000.0);
+
+  // Distribución por octavas: [2^k, 2^(k+1)) ns
+  uint64_t octave[64] = {0};
+  for (int b = 0; b < LATENCY_BUCKETS; b++) {
+    if (h->counts[b] == 0) {
+      continue;
+    }
+    uint64_t upper = bucket_upper(b);
+    octave[upper ? 63 - __builtin_clzll(upper) : 0] += h->counts[b];
+  }
+
+  for (int k = 0; k < 64; k++) {
+    if (octave[k] == 0) {
+      continue;
+    }
+    double pct = 100.0 * (double)octave[k] / (double)h->total;
+    int bar = (int)(pct / 2.0 + 0.5);
+    fprintf(out, "  [%10.2f, %10.2f) us %10llu %6.2f%% ", (1ULL << k) / 1000.0,
+            (2ULL << k) / 1000.0, (unsigned long long)octave[k], pct);
+    for (int i = 0; i < bar; i++) {
+      fputc('#', out);
+    }
+    fputc('\n', out);
+  }
+}
@@ -0,0 +1,36 @@
+#ifndef UDP_LATENCY_H
+#define UDP_LATENCY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Histograma log-lineal de latencias en nanosegundos: 8 sub-buckets por
+// potencia de 2 (error relativo < 12.5%), memoria fija sin importar cuántas
+// muestras se registren.
+
+#define LATENCY_SUB_BITS 3
+#define LATENCY_LINEAR (2 << LATENCY_SUB_BITS) // Valores chicos: exactos
+#define LATENCY_BUCKETS                                                        \
+  (LATENCY_LINEAR + (64 - LATENCY_SUB_BITS - 1) * (1 << LATENCY_SUB_BITS))
+
+typedef struct {
+  uint64_t counts[LATENCY_BUCKETS];
+  uint64_t total;
+  uint64_t sum_ns;
+  uint64_t min_ns;
+  uint64_t max_ns;
+} LatencyHist;
+
+void latency_hist_init(LatencyHist *h);
+void latency_hist_record(LatencyHist *h, uint64_t ns);
+
+// Sumar src en dst (histogramas de distintos hilos)
+void latency_hist_merge(LatencyHist *dst, const LatencyHist *src);
+
+// Valor (cota superior del bucket) por debajo del cual cae la fracción q
+uint64_t latency_hist_percentile(const LatencyHist *h, double q);
+
+// Resumen (n, media, percentiles) y distribución agrupada por octavas
+void latency_hist_print(const LatencyHist *h, FILE *out, const char *title);
+
+#endif // UDP_LATENCY_H
@@ -0,0 +1,644 @@
+// Generador de carga para el servidor UDP: N sesiones independientes (cada
+// una con su socket y su puerto de origen) manejadas por unos pocos hilos,
+// cada hilo con un loop epoll + timerfd sobre el engine de libtpd.
+//
+// Cada sesión hace HELLO y sube uno o más archivos sintéticos. Al final se
+// reporta el goodput agregado, la latencia del handshake (HELLO -> ACK) y la
+// distribución del tiempo de cada transferencia (WRQ -> ACK del FIN).
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "latency.h"
+#include "protocol.h"
+#include "tpd.h"
+
+#define DEFAULT_SESSIONS 100
+#define DEFAULT_THREADS 4
+#define DEFAULT_FILE_SIZE (64 * 1024)
+#define DEFAULT_FILES 1
+#define EPOLL_BATCH 256
+#define TIMER_TAG UINT32_MAX // data.u32 del timerfd en epoll
+
+typedef enum {
+  PHASE_HELLO = 0,
+  PHASE_WRQ,
+  PHASE_DATA,
+  PHASE_FIN,
+  PHASE_DONE,
+  PHASE_FAILED,
+} Phase;
+
+typedef struct {
+  TpdClient client;
+  int fd;
+  Phase phase;
+  uint32_t id; // Global, para los nombres de sus archivos
+  char filename[MAX_FILENAME_LEN + 1]; // Archivo en curso
+  unsigned files_left;
+  uint64_t offset; // Bytes confirmados del archivo en curso
+  uint64_t hello_start_ns;
+  uint64_t file_start_ns;
+} LoadSession;
+
+// Deadline de retransmisión pendiente. Como todos los timeouts son iguales,
+// los deadlines se generan en orden y alcanza con una cola FIFO; las entradas
+// de intercambios ya terminados se descartan al salir (borrado perezoso).
+typedef struct {
+  uint64_t deadline_ns;
+  uint32_t session;
+} TimerEntry;
+
+typedef struct {
+  TimerEntry *items;
+  size_t head;
+  size_t count;
+  size_t capacity; // Potencia de 2
+} TimerQueue;
+
+typedef struct {
+  pthread_t thread;
+  int index;
+  LoadSession *sessions;
+  uint32_t first_id; // Id global de la primera sesión (para el filename)
+  uint32_t count;
+  uint32_t active;
+  uint32_t opened;       // Sesiones ya iniciadas (rampa)
+  uint64_t next_open_ns; // Cuándo iniciar la siguiente (0 = ya todas)
+  uint64_t open_interval_ns;
+
+  int epfd;
+  int timerfd;
+  uint64_t armed_ns; // Deadline programado en el timerfd (0 = desarmado)
+  TimerQueue timers;
+
+  // Resultados
+  LatencyHist handshake;
+  LatencyHist completion;
+  unsigned long long goodput_bytes;
+  unsigned long long datagrams_sent;
+  unsigned long long retransmissions;
+  unsigned long files_ok;
+  unsigned long sessions_ok;
+  unsigned long sessions_failed;
+} Worker;
+
+typedef struct {
+  struct sockaddr_in server;
+  const char *credential;
+  uint32_t sessions;
+  int threads;
+  uint64_t file_size;
+  unsigned files;
+  long ramp; // Sesiones nuevas por segundo (0 = todas juntas)
+} LoadOptions;
+
+static LoadOptions opts;
+static uint8_t payload[MAX_DATA_SIZE]; // Contenido sintético, solo lectura
+
+static uint64_t monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int timer_push(TimerQueue *q, uint64_t deadline_ns, uint32_t session) {
+  if (q->count == q->capacity) {
+    size_t new_cap = q->capacity ? q->capacity * 2 : 1024;
+    TimerEntry *items = malloc(new_cap * sizeof(TimerEntry));
+    if (!items) {
+      return -1;
+    }
+    for (size_t i = 0; i < q->count; i++) {
+      items[i] = q->items[(q->head + i) & (q->capacity - 1)];
+    }
+    free(q->items);
+    q->items = items;
+    q->head = 0;
+    q->capacity = new_cap;
+  }
+  TimerEntry *e = &q->items[(q->head + q->count) & (q->capacity - 1)];
+  e->deadline_ns = deadline_ns;
+  e->session = session;
+  q->count++;
+  return 0;
+}
+
+// Programar el timerfd para el deadline (o apertura de sesión) más próximo
+static void arm_timer(Worker *w) {
+  uint64_t next = w->timers.count ? w->timers.items[w->timers.head].deadline_ns
+                                  : 0;
+  if (w->next_open_ns && (next == 0 || w->next_open_ns < next)) {
+    next = w->next_open_ns;
+  }
+  if (next == w->armed_ns) {
+    return;
+  }
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = (time_t)(next / 1000000000ULL);
+  its.it_value.tv_nsec = (long)(next % 1000000000ULL);
+  if (timerfd_settime(w->timerfd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+    perror("timerfd_settime");
+  }
+  w->armed_ns = next;
+}
+
+// Enviar lo que el engine tenga pendiente y registrar el deadline
+static void flush_session(Worker *w, uint32_t i) {
+  LoadSession *s = &w->sessions[i];
+  const TpdDatagram *pdu = tpd_client_transmit(&s->client);
+  if (!pdu) {
+    return;
+  }
+  // EAGAIN / ENOBUFS: se trata como una pérdida, la retransmisión lo cubre
+  if (send(s->fd, pdu->buf, pdu->len, 0) >= 0) {
+    w->datagrams_sent++;
+  }
+  if (timer_push(&w->timers, tpd_client_deadline(&s->client), i) < 0) {
+    perror("malloc timers");
+  }
+}
+
+static void finish_session(Worker *w, uint32_t i, Phase phase) {
+  LoadSession *s = &w->sessions[i];
+  s->phase = phase;
+  if (phase == PHASE_DONE) {
+    w->sessions_ok++;
+  } else {
+    w->sessions_failed++;
+  }
+  epoll_ctl(w->epfd, EPOLL_CTL_DEL, s->fd, NULL);
+  close(s->fd);
+  s->fd = -1;
+  w->active--;
+}
+
+// Siguiente bloque del archivo sintético (un DATA vacío si el archivo es 0)
+static void send_next_data(LoadSession *s, uint64_t now) {
+  uint64_t left = opts.file_size - s->offset;
+  size_t len = left < MAX_DATA_SIZE ? (size_t)left : MAX_DATA_SIZE;
+  s->phase = PHASE_DATA;
+  tpd_client_data(&s->client, payload, len, now);
+}
+
+// Nombre remoto del archivo file de la sesión: 'l', la sesión en 5 dígitos
+// y el archivo en 4, en base 36. En decimal, -n y -f máximos no entran en
+// MAX_FILENAME_LEN, y cada archivo necesita su propio nombre: si no, cada
+// uno pisa al anterior en el servidor.
+static void file_name(char out[MAX_FILENAME_LEN + 1], uint32_t session,
+                      unsigned file) {
+  static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+  out[0] = 'l';
+  for (int k = 5; k >= 1; k--) {
+    out[k] = digits[session % 36];
+    session /= 36;
+  }
+  for (int k = 9; k >= 6; k--) {
+    out[k] = digits[file % 36];
+    file /= 36;
+  }
+  out[10] = '\0';
+}
+
+static void start_file(LoadSession *s, uint64_t now) {
+  file_name(s->filename, s->id, opts.files - s->files_left);
+  s->phase = PHASE_WRQ;
+  s->offset = 0;
+  s->file_start_ns = now;
+  tpd_client_wrq(&s->client, s->filename, 0, now);
+}
+
+// Respuesta esperada del intercambio en vuelo: avanzar la sesión
+static void advance(Worker *w, uint32_t i, uint64_t now) {
+  LoadSession *s = &w->sessions[i];
+
+  switch (s->phase) {
+  case PHASE_HELLO:
+    latency_hist_record(&w->handshake, now - s->hello_start_ns);
+    start_file(s, now);
+    break;
+  case PHASE_WRQ:
+    send_next_data(s, now);
+    break;
+  case PHASE_DATA: {
+    uint64_t left = opts.file_size - s->offset;
+    s->offset += left < MAX_DATA_SIZE ? left : MAX_DATA_SIZE;
+    if (s->offset < opts.file_size) {
+      send_next_data(s, now);
+    } else {
+      s->phase = PHASE_FIN;
+      tpd_client_fin(&s->client, now);
+    }
+    break;
+  }
+  case PHASE_FIN:
+    latency_hist_record(&w->completion, now - s->file_start_ns);
+    w->goodput_bytes += opts.file_size;
+    w->files_ok++;
+    if (--s->files_left > 0) {
+      start_file(s, now);
+    } else {
+      finish_session(w, i, PHASE_DONE);
+      return;
+    }
+    break;
+  default:
+    return;
+  }
+  flush_session(w, i);
+}
+
+static void on_readable(Worker *w, uint32_t i) {
+  LoadSession *s = &w->sessions[i];
+  uint8_t buf[MAX_PDU_SIZE];
+
+  while (s->fd >= 0) {
+    ssize_t n = recv(s->fd, buf, sizeof(buf), 0);
+    if (n < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR &&
+          errno != ECONNREFUSED) {
+        perror("recv");
+      }
+      return;
+    }
+
+    TpdResult r = tpd_client_input(&s->client, buf, (size_t)n);
+    if (r == TPD_DONE) {
+      advance(w, i, monotonic_ns());
+    } else if (r == TPD_REJECTED) {
+      fprintf(stderr, "Sesión %s rechazada: %.*s\n", s->filename,
+              (int)s->client.reply_len, s->client.reply);
+      finish_session(w, i, PHASE_FAILED);
+    }
+  }
+}
+
+static int open_session(Worker *w, uint32_t i, uint64_t now);
+
+// Iniciar las sesiones cuyo turno en la rampa ya llegó
+static void open_due_sessions(Worker *w, uint64_t now) {
+  while (w->opened < w->count &&
+         (w->open_interval_ns == 0 || w->next_open_ns <= now)) {
+    uint32_t i = w->opened++;
+    if (open_session(w, i, monotonic_ns()) < 0) {
+      w->sessions[i].phase = PHASE_FAILED;
+      w->sessions_failed++;
+    }
+    w->next_open_ns += w->open_interval_ns;
+  }
+  if (w->opened == w->count) {
+    w->next_open_ns = 0;
+  }
+}
+
+static void on_timer(Worker *w) {
+  uint64_t expirations;
+  if (read(w->timerfd, &expirations, sizeof(expirations)) < 0 &&
+      errno != EAGAIN) {
+    perror("read timerfd");
+  }
+  w->armed_ns = 0;
+
+  uint64_t now = monotonic_ns();
+  open_due_sessions(w, now);
+
+  TimerQueue *q = &w->timers;
+  while (q->count > 0 && q->items[q->head].deadline_ns <= now) {
+    TimerEntry e = q->items[q->head];
+    q->head = (q->head + 1) & (q->capacity - 1);
+    q->count--;
+
+    LoadSession *s = &w->sessions[e.session];
+    if (s->fd < 0 || tpd_client_deadline(&s->client) != e.deadline_ns) {
+      continue; // Intercambio ya terminado
+    }
+    if (tpd_client_timeout(&s->client, now) == TPD_FAILED) {
+      fprintf(stderr, "Sesión %s: máximo de reintentos alcanzado\n",
+              s->filename);
+      finish_session(w, e.session, PHASE_FAILED);
+      continue;
+    }
+    w->retransmissions++;
+    flush_session(w, e.session);
+  }
+}
+
+static int open_session(Worker *w, uint32_t i, uint64_t now) {
+  LoadSession *s = &w->sessions[i];
+  memset(s, 0, sizeof(*s));
+  tpd_client_init(&s->client, TIMEOUT_MS * 1000000ULL, MAX_RETRIES);
+  s->id = w->first_id + i;
+  file_name(s->filename, s->id, 0);
+  s->files_left = opts.files;
+
+  // connect(): el kernel asigna un puerto propio y filtra otros orígenes
+  s->fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (s->fd < 0) {
+    perror("socket");
+    return -1;
+  }
+  if (fcntl(s->fd, F_SETFL, O_NONBLOCK) < 0 ||
+      connect(s->fd, (struct sockaddr *)&opts.server, sizeof(opts.server)) <
+          0) {
+    perror("connect");
+    close(s->fd);
+    s->fd = -1;
+    return -1;
+  }
+
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.u32 = i;
+  if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, s->fd, &ev) < 0) {
+    perror("epoll_ctl");
+    close(s->fd);
+    s->fd = -1;
+    return -1;
+  }
+
+  w->active++;
+  s->phase = PHASE_HELLO;
+  s->hello_start_ns = now;
+  tpd_client_hello(&s->client, opts.credential, now);
+  flush_session(w, i);
+  return 0;
+}
+
+static void *worker_main(void *arg) {
+  Worker *w = arg;
+
+  // Con rampa, cada hilo abre sus sesiones escalonadas (intercaladas con las
+  // de los otros hilos)
+  uint64_t start = monotonic_ns();
+  w->next_open_ns = start + (uint64_t)w->index * w->open_interval_ns /
+                                (uint64_t)opts.threads;
+  open_due_sessions(w, start);
+  arm_timer(w);
+
+  struct epoll_event events[EPOLL_BATCH];
+  while (w->active > 0 || w->opened < w->count) {
+    int n = epoll_wait(w->epfd, events, EPOLL_BATCH, -1);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("epoll_wait");
+      break;
+    }
+    for (int k = 0; k < n; k++) {
+      if (events[k].data.u32 == TIMER_TAG) {
+        on_timer(w);
+      } else {
+        on_readable(w, events[k].data.u32);
+      }
+    }
+    arm_timer(w);
+  }
+  return NULL;
+}
+
+static int worker_init(Worker *w, int index, uint32_t first_id,
+                       uint32_t count) {
+  memset(w, 0, sizeof(*w));
+  w->index = index;
+  w->first_id = first_id;
+  w->count = count;
+  if (opts.ramp > 0) {
+    w->open_interval_ns = 1000000000ULL * (uint64_t)opts.threads /
+                          (uint64_t)opts.ramp;
+  }
+  latency_hist_init(&w->handshake);
+  latency_hist_init(&w->completion);
+
+  w->sessions = calloc(count ? count : 1, sizeof(LoadSession));
+  w->epfd = epoll_create1(0);
+  w->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+  if (!w->sessions || w->epfd < 0 || w->timerfd < 0) {
+    perror("worker_init");
+    return -1;
+  }
+
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.u32 = TIMER_TAG;
+  if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->timerfd, &ev) < 0) {
+    perror("epoll_ctl timerfd");
+    return -1;
+  }
+  return 0;
+}
+
+static void worker_free(Worker *w) {
+  free(w->sessions);
+  free(w->timers.items);
+  if (w->epfd >= 0) {
+    close(w->epfd);
+  }
+  if (w->timerfd >= 0) {
+    close(w->timerfd);
+  }
+}
+
+// Un socket por sesión: subir el límite de descriptores hasta el máximo
+static int raise_fd_limit(uint32_t needed) {
+  struct rlimit rl;
+  if (getrlimit(RLIMIT_NOFILE, &rl) < 0) {
+    perror("getrlimit");
+    return -1;
+  }
+  if (rl.rlim_cur < needed) {
+    rl.rlim_cur = rl.rlim_max < needed ? rl.rlim_max : needed;
+    if (setrlimit(RLIMIT_NOFILE, &rl) < 0) {
+      perror("setrlimit");
+    }
+  }
+  if (rl.rlim_cur < needed) {
+    fprintf(stderr,
+            "ERROR: se necesitan %u descriptores y el límite es %lu "
+            "(ulimit -n)\n",
+            needed, (unsigned long)rl.rlim_cur);
+    return -1;
+  }
+  return 0;
+}
+
+static void print_usage(const char *progname) {
+  fprintf(stderr,
+          "Uso: %s <server_ip> <credencial> [-n <sesiones>] [-t <hilos>] "
+          "[-s <bytes>] [-f <archivos>] [-r <sesiones/s>]\n",
+          progname);
+  fprintf(stderr, "\nOpciones:\n");
+  fprintf(stderr, "  -n <n>      Sesiones concurrentes (default %d)\n",
+          DEFAULT_SESSIONS);
+  fprintf(stderr, "  -t <n>      Hilos, cada uno con su epoll (default %d)\n",
+          DEFAULT_THREADS);
+  fprintf(stderr, "  -s <bytes>  Tamaño de cada archivo (default %d)\n",
+          DEFAULT_FILE_SIZE);
+  fprintf(stderr, "  -f <n>      Archivos por sesión (default %d)\n",
+          DEFAULT_FILES);
+  fprintf(stderr, "  -r <n>      Rampa: iniciar n sesiones por segundo "
+                  "(default: todas juntas)\n");
+  fprintf(stderr, "\nEjemplo: %s 127.0.0.1 test_credential -n 2000 -t 4\n",
+          progname);
+}
+
+static int parse_args(int argc, char *argv[]) {
+  if (argc < 3) {
+    return -1;
+  }
+
+  memset(&opts.server, 0, sizeof(opts.server));
+  opts.server.sin_family = AF_INET;
+  opts.server.sin_port = htons(SERVER_PORT);
+  if (inet_pton(AF_INET, argv[1], &opts.server.sin_addr) <= 0) {
+    fprintf(stderr, "ERROR: Dirección inválida: %s\n", argv[1]);
+    return -1;
+  }
+  opts.credential = argv[2];
+  if (strlen(opts.credential) == 0 || strlen(opts.credential) > MAX_DATA_SIZE) {
+    fprintf(stderr, "ERROR: Credencial inválida\n");
+    return -1;
+  }
+  opts.sessions = DEFAULT_SESSIONS;
+  opts.threads = DEFAULT_THREADS;
+  opts.file_size = DEFAULT_FILE_SIZE;
+  opts.files = DEFAULT_FILES;
+
+  int i = 3;
+  while (i < argc) {
+    if (i + 1 >= argc) {
+      fprintf(stderr, "ERROR: %s requiere un valor\n", argv[i]);
+      return -1;
+    }
+    char *endptr;
+    long long val = strtoll(argv[i + 1], &endptr, 10);
+    if (*endptr != '\0' || val < 0) {
+      fprintf(stderr, "ERROR: %s debe ser un entero no negativo\n", argv[i]);
+      return -1;
+    }
+    if (strcmp(argv[i], "-n") == 0 && val >= 1 && val <= 9999999) {
+      opts.sessions = (uint32_t)val;
+    } else if (strcmp(argv[i], "-t") == 0 && val >= 1 && val <= 256) {
+      opts.threads = (int)val;
+    } else if (strcmp(argv[i], "-s") == 0) {
+      opts.file_size = (uint64_t)val;
+    } else if (strcmp(argv[i], "-f") == 0 && val >= 1 && val <= 1000000) {
+      opts.files = (unsigned)val;
+    } else if (strcmp(argv[i], "-r") == 0 && val >= 1) {
+      opts.ramp = (long)val;
+    } else {
+      fprintf(stderr, "ERROR: Parámetro desconocido o fuera de rango: %s %s\n",
+              argv[i], argv[i + 1]);
+      return -1;
+    }
+    i += 2;
+  }
+  if ((uint32_t)opts.threads > opts.sessions) {
+    opts.threads = (int)opts.sessions;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (parse_args(argc, argv) < 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  if (raise_fd_limit(opts.sessions + 2 * (uint32_t)opts.threads + 16) < 0) {
+    return 1;
+  }
+
+  // Contenido pseudoaleatorio (LCG) para que no comprima ni deduplique
+  uint32_t x = 0x2545F491u;
+  for (size_t i = 0; i < sizeof(payload); i++) {
+    x = x * 1103515245u + 12345u;
+    payload[i] = (uint8_t)(x >> 24);
+  }
+
+  Worker *workers = calloc((size_t)opts.threads, sizeof(Worker));
+  if (!workers) {
+    perror("calloc");
+    return 1;
+  }
+
+  printf("Generando carga: %u sesiones en %d hilos, %u archivo%s de %llu "
+         "bytes por sesión\n",
+         opts.sessions, opts.threads, opts.files, opts.files == 1 ? "" : "s",
+         (unsigned long long)opts.file_size);
+
+  // Repartir las sesiones en partes iguales
+  uint32_t first = 0;
+  int result = 0;
+  for (int t = 0; t < opts.threads; t++) {
+    uint32_t count = opts.sessions / (uint32_t)opts.threads +
+                     ((uint32_t)t < opts.sessions % (uint32_t)opts.threads);
+    if (worker_init(&workers[t], t, first, count) < 0) {
+      return 1;
+    }
+    first += count;
+  }
+
+  uint64_t t0 = monotonic_ns();
+  for (int t = 0; t < opts.threads; t++) {
+    if (pthread_create(&workers[t].thread, NULL, worker_main, &workers[t]) !=
+        0) {
+      perror("pthread_create");
+      return 1;
+    }
+  }
+
+  LatencyHist handshake, completion;
+  latency_hist_init(&handshake);
+  latency_hist_init(&completion);
+  unsigned long long goodput = 0, sent = 0, retrans = 0;
+  unsigned long files_ok = 0, ok = 0, failed = 0;
+
+  for (int t = 0; t < opts.threads; t++) {
+    Worker *w = &workers[t];
+    pthread_join(w->thread, NULL);
+    latency_hist_merge(&handshake, &w->handshake);
+    latency_hist_merge(&completion, &w->completion);
+    goodput += w->goodput_bytes;
+    sent += w->datagrams_sent;
+    retrans += w->retransmissions;
+    files_ok += w->files_ok;
+    ok += w->sessions_ok;
+    failed += w->sessions_failed;
+    worker_free(w);
+  }
+  double secs = (monotonic_ns() - t0) / 1e9;
+  free(workers);
+
+  printf("\n=== Resultado ===\n");
+  printf("Sesiones: %lu completas, %lu con error\n", ok, failed);
+  printf("Archivos: %lu, %llu bytes en %.3f s\n", files_ok, goodput, secs);
+  printf("Goodput agregado: %.2f MB/s (%.1f archivos/s)\n", goodput / secs / 1e6,
+         files_ok / secs);
+  printf("Datagramas enviados: %llu, retransmisiones: %llu (%.2f%%)\n", sent,
+         retrans, sent ? 100.0 * retrans / sent : 0.0);
+
+  latency_hist_print(&handshake, stdout, "Handshake (HELLO -> ACK)");
+  latency_hist_print(&completion, stdout,
+                     "Transferencia por archivo (WRQ -> ACK del FIN)");
+
+  if (failed > 0) {
+    result = 1;
+  }
+  return result;
+}
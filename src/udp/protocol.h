@@ -11,6 +11,9 @@
 #define MAX_DATA_SIZE 1024
 #define MAX_PDU_SIZE (2 + MAX_DATA_SIZE)
 
+// Tamaño máximo de un chunk en modo deduplicación
+#define MAX_CHUNK_SIZE 65536
+
 // Tiempo de espera y reintentos (lado cliente)
 #define TIMEOUT_SEC 3
 #define MAX_RETRIES 15
@@ -21,6 +24,19 @@
 #define TYPE_DATA 3
 #define TYPE_ACK 4
 #define TYPE_FIN 5
+#define TYPE_MANIFEST 6 // Lista de chunks (modo deduplicación)
+#define TYPE_HAVE 7     // Respuesta a MANIFEST: qué chunks ya tiene el server
+
+// Flags opcionales del WRQ (byte siguiente al '\0' del filename)
+#define WRQ_FLAG_DEDUP 0x01
+
+// MANIFEST: [flags][entrada]...  entrada = digest SHA-256 + largo (uint32 BE)
+// HAVE:     [cantidad][bitmap]   bit i = 1 -> el servidor ya tiene el chunk i
+#define MANIFEST_FLAG_LAST 0x01
+#define DIGEST_SIZE 32
+#define MANIFEST_ENTRY_SIZE (DIGEST_SIZE + 4)
+#define MANIFEST_MAX_ENTRIES ((MAX_DATA_SIZE - 1) / MANIFEST_ENTRY_SIZE)
+#define HAVE_PAYLOAD_SIZE (1 + (MANIFEST_MAX_ENTRIES + 7) / 8)
 
 // Estados del cliente/servidor (compartidos conceptualmente)
 typedef enum {
@@ -39,8 +55,8 @@ typedef struct {
 } PDU;
 
 #define TIMEOUT_MS (TIMEOUT_SEC * 1000L)
-#define MAX_CLIENTS 10    // Definir según necesidad
-#define CLIENT_TIMEOUT 60 // Timeout de inactividad en segundos
+#define MAX_CLIENTS (1 << 20) // Tope del pool de sesiones (crece a demanda)
+#define CLIENT_TIMEOUT 60     // Timeout de inactividad en segundos
 #define MAX_CREDENTIALS 100
 
 #endif // UDP_PROTOCOL_H
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef UDP_RATELIMIT_H
+#define UDP_RATELIMIT_H
+
+#include <stdint.h>
+
+// Token bucket en bytes: se recarga a `rate` bytes/s hasta `burst` bytes
+
+typedef struct {
+  double tokens;
+  uint64_t last_ns; // 0 = nunca usado (arranca lleno)
+} TokenBucket;
+
+// Recargar hasta now_ns y ver si hay saldo para `cost` bytes, sin
+// consumirlos: se cobran con token_bucket_take cuando el paquete pasa todos
+// los controles. Retorna 1 si alcanza, 0 si se descarta.
+static inline int token_bucket_check(TokenBucket *b, double rate,
+                                     double burst, uint64_t now_ns,
+                                     uint32_t cost) {
+  if (b->last_ns == 0) {
+    b->tokens = burst;
+  } else if (now_ns > b->last_ns) {
+    b->tokens += rate * (double)(now_ns - b->last_ns) / 1e9;
+    if (b->tokens > burst) {
+      b->tokens = burst;
+    }
+  }
+  b->last_ns = now_ns;
+
+  return b->tokens >= (double)cost;
+}
+
+static inline void token_bucket_take(TokenBucket *b, uint32_t cost) {
+  b->tokens -= (double)cost;
+}
+
+#endif // UDP_RATELIMIT_H
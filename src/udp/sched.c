@@ -0,0 +1,183 @@
+#include "sched.h"
+
+#include <string.h>
+
+#define MAP_SIZE (2 * SCHED_SLOTS)
+#define MAP_MASK (MAP_SIZE - 1)
+
+static uint32_t flow_hash(uint32_t ip, uint16_t port) {
+  uint64_t key = ((uint64_t)ip << 16) | port;
+  key *= 0x9E3779B97F4A7C15ULL;
+  return (uint32_t)(key >> 32) & MAP_MASK;
+}
+
+void sched_init(Scheduler *s) {
+  memset(s->map, 0, sizeof(s->map));
+  for (uint16_t i = 0; i < SCHED_SLOTS; i++) {
+    s->packets[i].next = (i + 1 < SCHED_SLOTS) ? i + 1 : SCHED_NONE;
+    s->flows[i].next_active = (i + 1 < SCHED_SLOTS) ? i + 1 : SCHED_NONE;
+  }
+  s->free_packet = 0;
+  s->free_flow = 0;
+  s->active_head = SCHED_NONE;
+  s->active_tail = SCHED_NONE;
+  s->head_served = 0;
+  s->queued = 0;
+}
+
+SchedPacket *sched_alloc(Scheduler *s) {
+  if (s->free_packet == SCHED_NONE) {
+    return NULL;
+  }
+  SchedPacket *pkt = &s->packets[s->free_packet];
+  s->free_packet = pkt->next;
+  pkt->next = SCHED_NONE;
+  return pkt;
+}
+
+void sched_free(Scheduler *s, SchedPacket *pkt) {
+  pkt->next = s->free_packet;
+  s->free_packet = (uint16_t)(pkt - s->packets);
+}
+
+// Buscar el slot del mapa para una dirección (ocupado por ella o vacío)
+static uint32_t map_find(const Scheduler *s, uint32_t ip, uint16_t port) {
+  uint32_t slot = flow_hash(ip, port);
+  while (s->map[slot] != 0) {
+    const SchedFlow *f = &s->flows[s->map[slot] - 1];
+    if (f->ip == ip && f->port == port) {
+      break;
+    }
+    slot = (slot + 1) & MAP_MASK;
+  }
+  return slot;
+}
+
+// Borrado con corrimiento hacia atrás (linear probing sin tombstones)
+static void map_remove(Scheduler *s, uint32_t slot) {
+  s->map[slot] = 0;
+  uint32_t j = slot;
+  while (1) {
+    j = (j + 1) & MAP_MASK;
+    if (s->map[j] == 0) {
+      return;
+    }
+    const SchedFlow *f = &s->flows[s->map[j] - 1];
+    uint32_t home = flow_hash(f->ip, f->port);
+    // ¿home está cíclicamente en (slot, j]? Entonces no se puede mover
+    int stays = (slot <= j) ? (home > slot && home <= j)
+                            : (home > slot || home <= j);
+    if (!stays) {
+      s->map[slot] = s->map[j];
+      s->map[j] = 0;
+      slot = j;
+    }
+  }
+}
+
+int sched_enqueue(Scheduler *s, SchedPacket *pkt) {
+  uint32_t ip = pkt->addr.sin_addr.s_addr;
+  uint16_t port = pkt->addr.sin_port;
+  uint32_t slot = map_find(s, ip, port);
+  SchedFlow *f;
+
+  if (s->map[slot] != 0) {
+    f = &s->flows[s->map[slot] - 1];
+    if (f->queued >= SCHED_FLOW_QUEUE) {
+      return -1;
+    }
+  } else {
+    // Flujo nuevo: hay tantos flujos como slots, nunca se agotan antes
+    uint16_t idx = s->free_flow;
+    f = &s->flows[idx];
+    s->free_flow = f->next_active;
+
+    f->ip = ip;
+    f->port = port;
+    f->head = SCHED_NONE;
+    f->tail = SCHED_NONE;
+    f->queued = 0;
+    f->deficit = 0;
+    f->next_active = SCHED_NONE;
+    s->map[slot] = idx + 1;
+
+    // Al final de la ronda
+    if (s->active_tail == SCHED_NONE) {
+      s->active_head = idx;
+    } else {
+      s->flows[s->active_tail].next_active = idx;
+    }
+    s->active_tail = idx;
+  }
+
+  uint16_t pidx = (uint16_t)(pkt - s->packets);
+  pkt->next = SCHED_NONE;
+  if (f->tail == SCHED_NONE) {
+    f->head = pidx;
+  } else {
+    s->packets[f->tail].next = pidx;
+  }
+  f->tail = pidx;
+  f->queued++;
+  s->queued++;
+  return 0;
+}
+
+// Sacar el flujo de la cabeza de la ronda (y del mapa si quedó vacío)
+static void pop_head_flow(Scheduler *s, int requeue) {
+  uint16_t idx = s->active_head;
+  SchedFlow *f = &s->flows[idx];
+
+  s->active_head = f->next_active;
+  if (s->active_head == SCHED_NONE) {
+    s->active_tail = SCHED_NONE;
+  }
+  s->head_served = 0;
+
+  if (requeue) {
+    f->next_active = SCHED_NONE;
+    if (s->active_tail == SCHED_NONE) {
+      s->active_head = idx;
+    } else {
+      s->flows[s->active_tail].next_active = idx;
+    }
+    s->active_tail = idx;
+    return;
+  }
+
+  map_remove(s, map_find(s, f->ip, f->port));
+  f->next_active = s->free_flow;
+  s->free_flow = idx;
+}
+
+SchedPacket *sched_next(Scheduler *s) {
+  while (s->active_head != SCHED_NONE) {
+    SchedFlow *f = &s->flows[s->active_head];
+
+    if (!s->head_served) {
+      f->deficit += SCHED_QUANTUM;
+      s->head_served = 1;
+    }
+
+    if (f->queued > 0 && s->packets[f->head].len <= f->deficit) {
+      SchedPacket *pkt = &s->packets[f->head];
+      f->head = pkt->next;
+      if (f->head == SCHED_NONE) {
+        f->tail = SCHED_NONE;
+      }
+      f->queued--;
+      s->queued--;
+      f->deficit -= pkt->len;
+
+      // Flujo vacío: sale de la ronda y pierde el déficit acumulado
+      if (f->queued == 0) {
+        pop_head_flow(s, 0);
+      }
+      return pkt;
+    }
+
+    // Terminó su turno: al final de la ronda
+    pop_head_flow(s, 1);
+  }
+  return NULL;
+}
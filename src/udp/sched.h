@@ -0,0 +1,72 @@
+#ifndef UDP_SCHED_H
+#define UDP_SCHED_H
+
+#include <netinet/in.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "protocol.h"
+
+// Scheduler deficit-round-robin entre la recepción y el despacho de PDUs.
+//
+// Los datagramas se reciben directamente en slots del scheduler y se encolan
+// por flujo (dirección del cliente). El despacho alterna entre flujos con un
+// quantum de MAX_PDU_SIZE bytes, así un cliente que manda ráfagas no demora
+// los ACK de los demás. Memoria fija: SCHED_SLOTS datagramas en total y como
+// mucho SCHED_FLOW_QUEUE por flujo.
+
+#define SCHED_SLOTS 512
+#define SCHED_FLOW_QUEUE 32
+#define SCHED_QUANTUM MAX_PDU_SIZE
+#define SCHED_NONE UINT16_MAX
+
+typedef struct {
+  struct sockaddr_in addr;
+  struct timespec rx_ts; // Timestamp de recepción del kernel
+  uint16_t len;
+  uint16_t next; // Siguiente en la cola del flujo / lista libre
+  uint8_t data[MAX_PDU_SIZE];
+} SchedPacket;
+
+typedef struct {
+  uint32_t ip; // Network byte order
+  uint16_t port;
+  uint16_t head; // Cola de paquetes del flujo
+  uint16_t tail;
+  uint16_t queued;
+  uint16_t next_active; // Siguiente en la ronda / lista libre
+  int32_t deficit;
+} SchedFlow;
+
+typedef struct {
+  SchedPacket packets[SCHED_SLOTS];
+  SchedFlow flows[SCHED_SLOTS];
+  uint16_t map[2 * SCHED_SLOTS]; // Dirección -> flujo + 1 (0 = vacío)
+
+  uint16_t free_packet;
+  uint16_t free_flow;
+  uint16_t active_head; // Ronda de flujos con paquetes encolados
+  uint16_t active_tail;
+  int head_served; // El flujo a la cabeza ya recibió su quantum
+  uint32_t queued;
+} Scheduler;
+
+void sched_init(Scheduler *s);
+
+// Slot libre para recibir un datagrama, NULL si están todos ocupados
+SchedPacket *sched_alloc(Scheduler *s);
+
+// Devolver un slot (descartado o ya despachado)
+void sched_free(Scheduler *s, SchedPacket *pkt);
+
+// Encolar en el flujo de pkt->addr. Retorna -1 (y no toma el slot) si la
+// cola del flujo está llena.
+int sched_enqueue(Scheduler *s, SchedPacket *pkt);
+
+// Próximo paquete según DRR, NULL si no hay. El llamador lo libera con
+// sched_free después de procesarlo.
+SchedPacket *sched_next(Scheduler *s);
+
+static inline uint32_t sched_pending(const Scheduler *s) { return s->queued; }
+
+#endif // UDP_SCHED_H
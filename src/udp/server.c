@@ -1,7 +1,12 @@
+#define _GNU_SOURCE // sched_setaffinity / CPU_SET
+
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <netinet/in.h>
 #include <poll.h>
+#include <sched.h>
+#include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,28 +18,104 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "dedup.h"
+#include "durability.h"
+#include "latency.h"
 #include "protocol.h"
+#include "ratelimit.h"
+#include "sched.h"
+#include "session.h"
+#include "tpd.h"
+
+// Ráfaga de los token buckets: RATE_BURST_MS de tráfico a la tasa
+// configurada, y nunca menos de unos pocos PDUs completos
+#define RATE_BURST_MS 100
+#define RATE_MIN_BURST (4 * MAX_PDU_SIZE)
 
-// Estructura para mantener estado de cada cliente
+// Cuántos datagramas se reciben / despachan por vuelta del loop principal
+#define RX_BATCH 64
+#define DISPATCH_BUDGET 64
+
+// Opciones de línea de comandos
 typedef struct {
-  struct sockaddr_in addr;
-  ClientState state;
-  uint8_t expected_seq;
-  char filename[256];
-  FILE *file;
-  time_t last_activity;
-  int active;
-  size_t bytes_received;
-  uint8_t last_ack_seq;
-  int has_last_ack;
-} ClientSession;
+  const char *credentials_file;
+  long spin_us; // Presupuesto de busy-poll antes de bloquear (0 = solo poll)
+  int cpu;      // CPU a la que se fija el proceso (-1 = sin fijar)
+  long session_rate; // Bytes/s por sesión (0 = sin límite)
+  long tenant_rate;  // Bytes/s por credencial (0 = sin límite)
+  DurabilityMode durability;
+  long commit_window_us; // Ventana del group commit
+} ServerOptions;
+
+// Contadores por credencial (tenant)
+typedef struct {
+  unsigned long long packets;         // PDUs admitidos
+  unsigned long long bytes;           // Bytes admitidos
+  unsigned long long dropped_session; // Descartados por límite de sesión
+  unsigned long long dropped_tenant;  // Descartados por límite de credencial
+  unsigned long long dropped_queue;   // Descartados por cola del flujo llena
+} TenantStats;
 
 // Lista de credenciales válidas
 static char valid_credentials[MAX_CREDENTIALS][256];
 static int num_credentials = 0;
 
-// Pool de sesiones de clientes
-static ClientSession clients[MAX_CLIENTS];
+// Pool de sesiones de clientes (crece por slabs hasta MAX_CLIENTS)
+static SessionPool sessions;
+
+// Flag para shutdown graceful
+static volatile sig_atomic_t g_running = 1;
+
+// SIGUSR1: volcar los contadores por tenant sin detener el servidor
+static volatile sig_atomic_t g_dump_stats = 0;
+
+// Scheduler DRR entre recepción y despacho, y límites por credencial
+static Scheduler scheduler;
+static TokenBucket tenant_buckets[MAX_CREDENTIALS];
+static TenantStats tenant_stats[MAX_CREDENTIALS];
+static TenantStats anon_stats; // Direcciones sin sesión autenticada
+
+// Timestamp de recepción (kernel, CLOCK_REALTIME) del PDU en proceso y
+// latencia recepción -> sendto de cada ACK
+static struct timespec current_rx_ts;
+static int current_rx_valid = 0;
+static LatencyHist ack_latency;
+
+// Qué garantiza el ACK del FIN (y lote abierto del group commit)
+static Durability durability;
+static int g_sockfd = -1;
+
+static void signal_handler(int sig) {
+  if (sig == SIGUSR1) {
+    g_dump_stats = 1;
+    return;
+  }
+  g_running = 0;
+}
+
+static void setup_signal_handlers(void) {
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = signal_handler;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = 0;
+
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  sigaction(SIGUSR1, &sa, NULL);
+}
+
+static int64_t timespec_diff_ns(const struct timespec *end,
+                                const struct timespec *start) {
+  return (int64_t)(end->tv_sec - start->tv_sec) * 1000000000LL +
+         (end->tv_nsec - start->tv_nsec);
+}
+
+static uint64_t monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
 
 // Cargar credenciales desde archivo
 static int load_credentials(const char *filename) {
@@ -60,351 +141,708 @@ static int load_credentials(const char *filename) {
   return 0;
 }
 
-// Verificar si una credencial es válida
-static int is_valid_credential(const char *cred) {
+// Buscar una credencial: su índice (tenant) o -1 si no es válida
+static int find_credential(const char *cred) {
   for (int i = 0; i < num_credentials; i++) {
     if (strcmp(valid_credentials[i], cred) == 0) {
-      return 1;
+      return i;
     }
   }
-  return 0;
-}
-
-// Comparar direcciones de socket
-static int addr_equal(struct sockaddr_in *a, struct sockaddr_in *b) {
-  return (a->sin_addr.s_addr == b->sin_addr.s_addr &&
-          a->sin_port == b->sin_port);
+  return -1;
 }
 
 // Encontrar o crear sesión de cliente
-static ClientSession *find_or_create_session(struct sockaddr_in *addr) {
+static SessionId find_or_create_session(struct sockaddr_in *addr) {
   time_t now = time(NULL);
-  ClientSession *free_slot = NULL;
 
   // Buscar sesión existente
-  for (int i = 0; i < MAX_CLIENTS; i++) {
-    if (clients[i].active && addr_equal(&clients[i].addr, addr)) {
-      clients[i].last_activity = now;
-      return &clients[i];
-    }
-    if (!clients[i].active && !free_slot) {
-      free_slot = &clients[i];
-    }
+  SessionId id = session_lookup(&sessions, addr);
+  if (id != SESSION_NONE) {
+    session_hot(&sessions, id)->last_activity = now;
+    return id;
   }
 
   // Crear nueva sesión si hay espacio
-  if (free_slot) {
-    memset(free_slot, 0, sizeof(ClientSession));
-    free_slot->addr = *addr;
-    free_slot->state = STATE_IDLE;
-    free_slot->expected_seq = 0;
-    free_slot->last_activity = now;
-    free_slot->active = 1;
-    free_slot->file = NULL;
-
-    char ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &addr->sin_addr, ip, sizeof(ip));
-    printf("Nueva sesión para %s:%d\n", ip, ntohs(addr->sin_port));
-
-    return free_slot;
+  id = session_create(&sessions, addr);
+  if (id == SESSION_NONE) {
+    return SESSION_NONE; // No hay espacio
   }
+  SessionHot *session = session_hot(&sessions, id);
+  tpd_conn_init(&session->conn);
+  session->last_activity = now;
+
+  char ip[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &addr->sin_addr, ip, sizeof(ip));
+  printf("Nueva sesión para %s:%d\n", ip, ntohs(addr->sin_port));
 
-  return NULL; // No hay espacio
+  return id;
 }
 
 // Liberar recursos de una sesión
-static void cleanup_session(ClientSession *session) {
-  if (session->file) {
-    fclose(session->file);
-    session->file = NULL;
+static void cleanup_session(SessionId id) {
+  SessionHot *session = session_hot(&sessions, id);
+  SessionCold *meta = session_cold(&sessions, id);
+
+  if (session->fd >= 0) {
+    close(session->fd);
+    session->fd = -1;
   }
+  dedup_free(meta->dedup);
+  meta->dedup = NULL;
 
+  struct sockaddr_in addr;
+  session_addr(session, &addr);
   char ip[INET_ADDRSTRLEN];
-  inet_ntop(AF_INET, &session->addr.sin_addr, ip, sizeof(ip));
-  printf("Sesión liberada para %s:%d (bytes recibidos: %zu)\n", ip,
-         ntohs(session->addr.sin_port), session->bytes_received);
+  inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+  printf("Sesión liberada para %s:%d (archivos completados: %d, bytes "
+         "recibidos: %zu)\n",
+         ip, ntohs(addr.sin_port), meta->files_completed,
+         meta->total_bytes + meta->bytes_received);
 
-  session->active = 0;
+  session_release(&sessions, id);
 }
 
-// Limpiar sesiones inactivas
+// Limpiar sesiones inactivas. Recorre todo el slab (O(capacidad)), así que
+// corre como mucho una vez por segundo aunque se la llame en cada vuelta
+// del loop.
 static void cleanup_inactive_sessions(void) {
+  static time_t last_cleanup;
   time_t now = time(NULL);
+  if (now == last_cleanup) {
+    return;
+  }
+  last_cleanup = now;
+
+  uint32_t capacity = session_pool_capacity(&sessions);
 
-  for (int i = 0; i < MAX_CLIENTS; i++) {
-    if (clients[i].active &&
-        (now - clients[i].last_activity) > CLIENT_TIMEOUT) {
+  for (SessionId id = 0; id < capacity; id++) {
+    SessionHot *session = session_hot(&sessions, id);
+    if (session->active && (now - session->last_activity) > CLIENT_TIMEOUT) {
       printf("Timeout de sesión\n");
-      cleanup_session(&clients[i]);
+      cleanup_session(id);
     }
   }
 }
 
-// Enviar ACK
-static void send_ack(int sockfd, struct sockaddr_in *addr, uint8_t seq_num,
-                     const char *error_msg) {
-  uint8_t buffer[MAX_PDU_SIZE];
-  size_t pdu_size = 2;
-
-  buffer[0] = TYPE_ACK;
-  buffer[1] = seq_num;
-
-  if (error_msg) {
-    size_t msg_len = strlen(error_msg);
-    if (msg_len > MAX_DATA_SIZE) {
-      msg_len = MAX_DATA_SIZE;
-    }
-    memcpy(buffer + 2, error_msg, msg_len);
-    pdu_size += msg_len;
+// Enviar la respuesta armada por el engine (si hay) y registrar su latencia
+static void send_datagram(int sockfd, struct sockaddr_in *addr,
+                          const TpdDatagram *out) {
+  if (out->len == 0) {
+    return;
   }
 
-  ssize_t sent = sendto(sockfd, buffer, pdu_size, 0, (struct sockaddr *)addr,
-                        sizeof(*addr));
+  ssize_t sent = sendto(sockfd, out->buf, out->len, 0,
+                        (struct sockaddr *)addr, sizeof(*addr));
   if (sent < 0) {
-    perror("sendto ACK");
+    perror("sendto");
+  } else if (current_rx_valid) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    int64_t ns = timespec_diff_ns(&now, &current_rx_ts);
+    latency_hist_record(&ack_latency, ns > 0 ? (uint64_t)ns : 0);
   }
 
-  char ip[INET_ADDRSTRLEN];
-  inet_ntop(AF_INET, &addr->sin_addr, ip, sizeof(ip));
-  printf("ACK enviado a %s:%d - Seq=%d%s%s, DataLen=%zu\n", ip,
-         ntohs(addr->sin_port), seq_num, error_msg ? " Error: " : "",
-         error_msg ? error_msg : "", pdu_size - 2);
+  if (out->buf[0] == TYPE_ACK) {
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr->sin_addr, ip, sizeof(ip));
+    int err_len = (int)out->len - 2;
+    printf("ACK enviado a %s:%d - Seq=%d%s%.*s, DataLen=%d\n", ip,
+           ntohs(addr->sin_port), out->buf[1], err_len ? " Error: " : "",
+           err_len, (const char *)out->buf + 2, err_len);
+  }
 }
 
-// Manejar PDU HELLO
-static void handle_hello(int sockfd, struct sockaddr_in *addr, uint8_t *data,
-                         size_t data_len, uint8_t seq_num) {
-  ClientSession *session = find_or_create_session(addr);
-  if (!session) {
-    printf("Sin espacio para nuevos clientes\n");
-    return;
+// Un WRQ tras un FIN confirmado reutiliza la sesión para el siguiente archivo
+static void start_next_file(SessionId id) {
+  SessionCold *meta = session_cold(&sessions, id);
+  printf("Nuevo WRQ tras completar '%s', sesión reutilizada\n",
+         meta->filename);
+  meta->total_bytes += meta->bytes_received;
+  meta->bytes_received = 0;
+  meta->filename[0] = '\0';
+  dedup_free(meta->dedup);
+  meta->dedup = NULL;
+}
+
+// HELLO: validar credenciales
+static void handle_hello(SessionId id, const TpdEvent *ev, TpdDatagram *out) {
+  SessionHot *session = session_hot(&sessions, id);
+
+  char credentials[256];
+  size_t cred_len = (ev->len < 255) ? ev->len : 255;
+  if (cred_len > 0) {
+    memcpy(credentials, ev->data, cred_len);
   }
+  credentials[cred_len] = '\0';
+
+  printf("Autenticación recibida: '%s'\n", credentials);
 
-  // Validar sequence number
-  if (seq_num != 0) {
-    printf("HELLO con Seq != 0, descartando\n");
+  int tenant = find_credential(credentials);
+  if (tenant < 0) {
+    tpd_server_reject(ev->seq_num, "Invalid credentials", out);
+    cleanup_session(id);
     return;
   }
 
-  // Si la sesión no está en IDLE, tratamos como posible retransmisión
-  if (session->state != STATE_IDLE) {
-    if (session->has_last_ack && session->last_ack_seq == 0) {
-      printf("HELLO duplicado, reenviando ACK\n");
-      send_ack(sockfd, addr, 0, NULL);
+  // Autenticación exitosa
+  session->tenant = (uint16_t)tenant;
+  tpd_server_accept(&session->conn, ev, out);
+}
+
+// WRQ: abrir el archivo destino (el engine ya validó el filename)
+static void handle_wrq(SessionId id, const TpdEvent *ev, TpdDatagram *out) {
+  SessionHot *session = session_hot(&sessions, id);
+  SessionCold *meta = session_cold(&sessions, id);
+
+  printf("Solicitud de escritura: '%s'%s\n", ev->filename,
+         (ev->flags & WRQ_FLAG_DEDUP) ? " (deduplicada)" : "");
+
+  if (ev->duplicate) {
+    // Posible WRQ duplicado: comprobar que el filename coincide
+    if (strcmp(meta->filename, ev->filename) == 0) {
+      printf("WRQ duplicado para '%s', reenviando ACK\n", ev->filename);
+      tpd_server_accept(&session->conn, ev, out);
     } else {
-      printf("HELLO recibido en estado incorrecto, descartando\n");
+      tpd_server_reject(ev->seq_num, "Filename mismatch", out);
     }
     return;
   }
 
-  // Solo aquí extraemos / mostramos credenciales porque el estado es válido
-  char credentials[256];
-  size_t cred_len = (data_len < 255) ? data_len : 255;
-  memcpy(credentials, data, cred_len);
-  credentials[cred_len] = '\0';
+  // Abrir archivo dentro de uploads/ para mantener todo ordenado
+  if (mkdir("uploads", 0755) < 0 && errno != EEXIST) {
+    perror("mkdir uploads");
+    tpd_server_reject(ev->seq_num, "Server error", out);
+    return;
+  }
 
-  printf("Autenticación recibida: '%s'\n", credentials);
+  char filepath[512];
+  snprintf(filepath, sizeof(filepath), "uploads/%s", ev->filename);
+  session->fd = open(filepath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
 
-  // Validar credenciales
-  if (!is_valid_credential(credentials)) {
-    send_ack(sockfd, addr, 0, "Invalid credentials");
-    cleanup_session(session);
+  if (session->fd < 0) {
+    tpd_server_reject(ev->seq_num, "Cannot create file", out);
     return;
   }
 
-  // Autenticación exitosa
-  session->state = STATE_AUTHENTICATED;
-  session->expected_seq = 1; // Siguiente debe ser WRQ con seq=1
-  session->last_ack_seq = 0;
-  session->has_last_ack = 1;
-  send_ack(sockfd, addr, 0, NULL);
+  if (ev->flags & WRQ_FLAG_DEDUP) {
+    if (dedup_store_init() < 0 || !(meta->dedup = dedup_new())) {
+      close(session->fd);
+      session->fd = -1;
+      tpd_server_reject(ev->seq_num, "Server error", out);
+      return;
+    }
+  }
+
+  strcpy(meta->filename, ev->filename);
+  tpd_server_accept(&session->conn, ev, out);
 }
 
-// Manejar PDU WRQ
-static void handle_wrq(int sockfd, struct sockaddr_in *addr, uint8_t *data,
-                       size_t data_len, uint8_t seq_num) {
-  ClientSession *session = find_or_create_session(addr);
-  if (!session) {
+// DATA: escribir el payload (o alimentar el chunk faltante en curso)
+static void handle_data(SessionId id, const TpdEvent *ev, TpdDatagram *out) {
+  SessionHot *session = session_hot(&sessions, id);
+  SessionCold *meta = session_cold(&sessions, id);
+
+  if (meta->dedup) {
+    const char *err = NULL;
+    if (dedup_data(meta->dedup, ev->data, ev->len, &err) < 0) {
+      printf("Error en DATA deduplicado: %s\n", err);
+      tpd_server_reject(ev->seq_num, err, out);
+      cleanup_session(id);
+      return;
+    }
+    meta->dedup->last_reply_have = 0;
+  } else if (ev->len > 0) {
+    ssize_t written = write(session->fd, ev->data, ev->len);
+    if (written < 0 || (size_t)written != ev->len) {
+      printf("Error escribiendo archivo\n");
+      cleanup_session(id);
+      return;
+    }
+    meta->bytes_received += ev->len;
+  }
+
+  tpd_server_accept(&session->conn, ev, out);
+}
+
+// MANIFEST (modo deduplicación): responder con HAVE
+static void handle_manifest(SessionId id, const TpdEvent *ev,
+                            TpdDatagram *out) {
+  SessionHot *session = session_hot(&sessions, id);
+  DedupState *dedup = session_cold(&sessions, id)->dedup;
+
+  if (!dedup) {
+    printf("MANIFEST sin WRQ deduplicado previo, descartando\n");
     return;
   }
 
-  // Validar sequence number
-  if (seq_num != 1) {
-    printf("WRQ con Seq != 1, descartando\n");
+  if (ev->duplicate) {
+    // Duplicado: reenviar el mismo HAVE
+    if (dedup->last_reply_have) {
+      printf("MANIFEST duplicado (Seq=%d), reenviando HAVE\n", ev->seq_num);
+      tpd_server_reply(&session->conn, ev, TYPE_HAVE, dedup->last_have,
+                       dedup->last_have_len, out);
+    }
     return;
   }
 
-  // Extraer filename (máx 10 caracteres + null terminator)
-  char filename[12]; // 10 chars + null + margen
-  size_t fn_len = 0;
+  const char *err = NULL;
+  if (dedup_manifest(dedup, ev->data, ev->len, &err) < 0) {
+    printf("MANIFEST inválido: %s\n", err);
+    tpd_server_reject(ev->seq_num, err, out);
+    cleanup_session(id);
+    return;
+  }
 
-  // Buscar el null terminator y copiar
-  for (size_t i = 0; i < data_len && i < sizeof(filename) - 1; i++) {
-    if (data[i] == '\0') {
-      break;
-    }
-    filename[i] = (char)data[i];
-    fn_len = i + 1;
+  tpd_server_reply(&session->conn, ev, TYPE_HAVE, dedup->last_have,
+                   dedup->last_have_len, out);
+  printf("HAVE enviado - Seq=%d, chunks en manifest: %zu, faltantes: %zu%s\n",
+         ev->seq_num, dedup->count, dedup->missing_count,
+         dedup->manifest_done ? " (manifest completo)" : "");
+  dedup->last_reply_have = 1;
+}
+
+// El archivo del FIN ya está en disco (o falló el sync): cerrarlo y mandar el
+// ACK que quedó esperando, o un error
+static void commit_done(PendingCommit *commit, int err) {
+  close(commit->fd);
+  commit->fd = -1;
+
+  // La sesión pudo expirar mientras tanto: el archivo igual quedó en disco
+  SessionId id = session_lookup(&sessions, &commit->addr);
+  if (id == SESSION_NONE) {
+    return;
+  }
+  SessionHot *session = session_hot(&sessions, id);
+  TpdDatagram out;
+  if (!tpd_server_commit(&session->conn, commit->seq_num, &out)) {
+    return;
   }
-  filename[fn_len] = '\0';
 
-  printf("Solicitud de escritura: '%s'\n", filename);
+  SessionCold *meta = session_cold(&sessions, id);
+  if (err) {
+    printf("Error sincronizando '%s': %s\n", meta->filename, strerror(err));
+    tpd_server_reject(commit->seq_num, "Sync failed", &out);
+    cleanup_session(id);
+  } else {
+    meta->files_completed++;
+  }
 
-  if (session->state == STATE_AUTHENTICATED) {
-    // Validar longitud (4-10 caracteres)
-    if (fn_len < 4 || fn_len > 10) {
-      send_ack(sockfd, addr, 1, "Filename length must be 4-10 chars");
-      return;
-    }
+  // La latencia del ACK se mide desde la recepción del FIN
+  current_rx_ts = commit->rx_ts;
+  current_rx_valid = 1;
+  send_datagram(g_sockfd, &commit->addr, &out);
+  current_rx_valid = 0;
+}
 
-    // Validar caracteres ASCII permitidos
-    for (size_t j = 0; j < fn_len; j++) {
-      unsigned char c = (unsigned char)filename[j];
-      if (!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') ||
-            (c >= 'a' && c <= 'z') || c == '_' || c == '-' || c == '.')) {
-        send_ack(sockfd, addr, 1, "Invalid filename characters");
-        return;
-      }
+// FIN: cerrar el archivo y confirmarlo según la política de durabilidad
+static void handle_fin(SessionId id, struct sockaddr_in *addr,
+                       const TpdEvent *ev, TpdDatagram *out) {
+  SessionHot *session = session_hot(&sessions, id);
+  SessionCold *meta = session_cold(&sessions, id);
+
+  // Deduplicada: armar el archivo desde el almacén de chunks
+  if (meta->dedup) {
+    const char *err = NULL;
+    if (!dedup_complete(meta->dedup)) {
+      err = "Incomplete dedup transfer";
+    } else {
+      dedup_assemble(meta->dedup, session->fd, &err);
     }
+    if (err) {
+      printf("Error armando '%s': %s\n", meta->filename, err);
+      tpd_server_reject(ev->seq_num, err, out);
+      cleanup_session(id);
+      return;
+    }
+    meta->bytes_received = meta->dedup->bytes_total;
+    printf("Deduplicación: %zu chunks, %zu recibidos (%llu de %llu "
+           "bytes viajaron por la red)\n",
+           meta->dedup->count, meta->dedup->missing_count,
+           (unsigned long long)meta->dedup->bytes_received,
+           (unsigned long long)meta->dedup->bytes_total);
+    dedup_free(meta->dedup);
+    meta->dedup = NULL;
+  }
 
-    // Abrir archivo dentro de uploads/ para mantener todo ordenado
-    if (mkdir("uploads", 0755) < 0 && errno != EEXIST) {
-      perror("mkdir uploads");
-      send_ack(sockfd, addr, 1, "Server error");
+  printf("Finalización recibida: '%s', total: %zu bytes\n", meta->filename,
+         meta->bytes_received);
+
+  int fd = session->fd;
+  session->fd = -1;
+
+  // fin / group: el sync lo hace el hilo de commit y el ACK sale en
+  // commit_done, sin frenar el loop. Mientras tanto los FIN duplicados se
+  // ignoran.
+  if (durability.mode != DURABILITY_NONE && fd >= 0) {
+    if (durability_submit(&durability, fd, ev->seq_num, addr,
+                          &current_rx_ts) < 0) {
+      perror("durability_submit");
+      close(fd);
+      tpd_server_reject(ev->seq_num, "Sync failed", out);
+      cleanup_session(id);
       return;
     }
+    tpd_server_defer(&session->conn, ev);
+    return;
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
 
-    char filepath[512];
-    snprintf(filepath, sizeof(filepath), "uploads/%s", filename);
-    session->file = fopen(filepath, "wb");
+  // ACK final
+  tpd_server_accept(&session->conn, ev, out);
+  meta->files_completed++;
+}
 
-    if (!session->file) {
-      send_ack(sockfd, addr, 1, "Cannot create file");
-      return;
+static void print_usage(const char *progname) {
+  fprintf(stderr,
+          "Uso: %s <credentials_file> [-b <spin_us>] [-c <cpu>] "
+          "[-r <bytes/s>] [-R <bytes/s>]\n"
+          "          [-s none|fin|group] [-w <us>]\n",
+          progname);
+  fprintf(stderr, "\nOpciones:\n");
+  fprintf(stderr, "  -b <us>     Modo baja latencia: busy-poll hasta <us> "
+                  "microsegundos sin\n"
+                  "              datos antes de volver a bloquear en poll()\n");
+  fprintf(stderr, "  -c <cpu>    Fijar el proceso a la CPU indicada\n");
+  fprintf(stderr, "  -r <B/s>    Límite de tráfico por sesión\n");
+  fprintf(stderr, "  -R <B/s>    Límite de tráfico por credencial (todas sus "
+                  "sesiones)\n");
+  fprintf(stderr, "  -s <modo>   Durabilidad antes del ACK del FIN: none "
+                  "(default), fin\n"
+                  "              (fdatasync por archivo) o group (group "
+                  "commit)\n");
+  fprintf(stderr, "  -w <us>     Ventana del group commit (default %d)\n",
+          DURABILITY_DEFAULT_WINDOW_US);
+}
+
+static int parse_args(int argc, char *argv[], ServerOptions *opts) {
+  if (argc < 2) {
+    return -1;
+  }
+
+  opts->credentials_file = argv[1];
+  opts->spin_us = 0;
+  opts->cpu = -1;
+  opts->session_rate = 0;
+  opts->tenant_rate = 0;
+  opts->durability = DURABILITY_NONE;
+  opts->commit_window_us = DURABILITY_DEFAULT_WINDOW_US;
+
+  int i = 2;
+  while (i < argc) {
+    if (i + 1 >= argc) {
+      fprintf(stderr, "ERROR: %s requiere un valor\n", argv[i]);
+      return -1;
+    }
+    if (strcmp(argv[i], "-s") == 0) {
+      if (durability_parse_mode(argv[i + 1], &opts->durability) < 0) {
+        fprintf(stderr, "ERROR: -s debe ser none, fin o group\n");
+        return -1;
+      }
+      i += 2;
+      continue;
     }
 
-    strcpy(session->filename, filename);
-    session->state = STATE_READY_TO_TRANSFER;
-    session->expected_seq = 0; // Primer DATA debe tener seq=0
-    session->has_last_ack = 1;
-    session->last_ack_seq = 1;
-    send_ack(sockfd, addr, 1, NULL);
+    char *endptr;
+    long val = strtol(argv[i + 1], &endptr, 10);
+    if (strcmp(argv[i], "-b") == 0) {
+      if (*endptr != '\0' || val <= 0 || val > 1000000) {
+        fprintf(stderr, "ERROR: -b debe ser un entero entre 1 y 1000000\n");
+        return -1;
+      }
+      opts->spin_us = val;
+    } else if (strcmp(argv[i], "-c") == 0) {
+      if (*endptr != '\0' || val < 0 || val >= CPU_SETSIZE) {
+        fprintf(stderr, "ERROR: -c debe ser un número de CPU válido\n");
+        return -1;
+      }
+      opts->cpu = (int)val;
+    } else if (strcmp(argv[i], "-w") == 0) {
+      if (*endptr != '\0' || val <= 0 || val > 1000000) {
+        fprintf(stderr, "ERROR: -w debe ser un entero entre 1 y 1000000\n");
+        return -1;
+      }
+      opts->commit_window_us = val;
+    } else if (strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "-R") == 0) {
+      if (*endptr != '\0' || val <= 0) {
+        fprintf(stderr, "ERROR: %s debe ser un entero positivo (bytes/s)\n",
+                argv[i]);
+        return -1;
+      }
+      if (argv[i][1] == 'r') {
+        opts->session_rate = val;
+      } else {
+        opts->tenant_rate = val;
+      }
+    } else {
+      fprintf(stderr, "ERROR: Parámetro desconocido: %s\n", argv[i]);
+      return -1;
+    }
+    i += 2;
+  }
+  return 0;
+}
 
-  } else if (session->state == STATE_READY_TO_TRANSFER ||
-             session->state == STATE_TRANSFERRING) {
-    // Posible WRQ duplicado: comprobar que el filename coincide
-    if (strcmp(session->filename, filename) == 0) {
-      printf("WRQ duplicado para '%s', reenviando ACK\n", filename);
-      send_ack(sockfd, addr, 1, NULL);
+// Configurar el modo baja latencia: afinidad de CPU y busy-poll del driver
+// (SO_BUSY_POLL / SO_PREFER_BUSY_POLL) si el kernel lo soporta. Ninguna falla
+// es fatal: el spin en user space funciona igual sin ellas.
+static void setup_low_latency(int sockfd, const ServerOptions *opts) {
+  if (opts->cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(opts->cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+      perror("sched_setaffinity");
     } else {
-      send_ack(sockfd, addr, 1, "Filename mismatch");
+      printf("Proceso fijado a la CPU %d\n", opts->cpu);
     }
-  } else {
-    printf("WRQ en estado incorrecto, descartando\n");
   }
+
+  if (opts->spin_us <= 0) {
+    return;
+  }
+
+#ifdef SO_BUSY_POLL
+  int busy_poll = (int)opts->spin_us;
+  if (setsockopt(sockfd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll,
+                 sizeof(busy_poll)) < 0) {
+    perror("setsockopt SO_BUSY_POLL (se sigue con spin en user space)");
+  }
+#endif
+#ifdef SO_PREFER_BUSY_POLL
+  int prefer = 1;
+  if (setsockopt(sockfd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer,
+                 sizeof(prefer)) < 0) {
+    perror("setsockopt SO_PREFER_BUSY_POLL");
+  }
+#endif
+#if !defined(SO_BUSY_POLL) && !defined(SO_PREFER_BUSY_POLL)
+  (void)sockfd;
+#endif
+
+  printf("Modo baja latencia: busy-poll de %ld us antes de bloquear\n",
+         opts->spin_us);
+}
+
+// Recibir un PDU con su timestamp de recepción del kernel (SO_TIMESTAMPNS).
+// Si el kernel no lo entrega se usa la hora actual.
+static ssize_t recv_pdu(int sockfd, uint8_t *buffer, struct sockaddr_in *addr,
+                        struct timespec *rx_ts, int flags) {
+  struct iovec iov = {.iov_base = buffer, .iov_len = MAX_PDU_SIZE};
+  union {
+    char buf[CMSG_SPACE(sizeof(struct timespec))];
+    struct cmsghdr align;
+  } control;
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_name = addr;
+  msg.msg_namelen = sizeof(*addr);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  ssize_t n = recvmsg(sockfd, &msg, flags);
+  if (n < 0) {
+    return n;
+  }
+
+  int have_ts = 0;
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+      memcpy(rx_ts, CMSG_DATA(cmsg), sizeof(*rx_ts));
+      have_ts = 1;
+    }
+  }
+  if (!have_ts) {
+    clock_gettime(CLOCK_REALTIME, rx_ts);
+  }
+  return n;
 }
 
-// Manejar PDU DATA
-static void handle_data(int sockfd, struct sockaddr_in *addr, uint8_t *data,
-                        size_t data_len, uint8_t seq_num) {
-  ClientSession *session = find_or_create_session(addr);
-  if (!session) {
+// Procesar un PDU recibido: el engine decide qué es según el estado de la
+// sesión y acá se hace el I/O (credenciales, archivos, durabilidad)
+static void dispatch_pdu(int sockfd, struct sockaddr_in *client_addr,
+                         uint8_t *buffer, ssize_t recv_len) {
+  if (recv_len < 2) {
+    printf("PDU demasiado corta, descartando\n");
     return;
   }
 
-  // Validar estado
-  if (session->state != STATE_READY_TO_TRANSFER &&
-      session->state != STATE_TRANSFERRING) {
-    printf("DATA sin WRQ previo, descartando\n");
+  SessionId id = find_or_create_session(client_addr);
+  if (id == SESSION_NONE) {
+    printf("Sin espacio para nuevos clientes\n");
     return;
   }
+  SessionHot *session = session_hot(&sessions, id);
+
+  TpdEvent ev;
+  TpdDatagram out;
+  tpd_server_input(&session->conn, buffer, (size_t)recv_len, &ev, &out);
+
+  if (ev.restart) {
+    start_next_file(id);
+  }
+  if (ev.note) {
+    printf("%s (Seq=%d)\n", ev.note, ev.seq_num);
+  }
+
+  switch (ev.type) {
+  case TPD_EV_HELLO:
+    handle_hello(id, &ev, &out);
+    break;
+  case TPD_EV_WRQ:
+    handle_wrq(id, &ev, &out);
+    break;
+  case TPD_EV_DATA:
+    handle_data(id, &ev, &out);
+    break;
+  case TPD_EV_MANIFEST:
+    handle_manifest(id, &ev, &out);
+    break;
+  case TPD_EV_FIN:
+    handle_fin(id, client_addr, &ev, &out);
+    break;
+  case TPD_EV_NONE:
+    break;
+  }
+
+  send_datagram(sockfd, client_addr, &out);
+}
+
+static double rate_burst(long rate) {
+  double burst = (double)rate * RATE_BURST_MS / 1000.0;
+  return burst < RATE_MIN_BURST ? RATE_MIN_BURST : burst;
+}
+
+// Control de admisión de un datagrama recién recibido: token buckets de la
+// sesión y de su credencial, y lugar en la cola de su flujo. Lo que excede el
+// presupuesto se descarta acá, antes de cualquier escritura a disco. Los
+// buckets se cobran solo si el paquete se encola: un descarte no gasta el
+// saldo de los demás controles.
+static void admit_packet(SchedPacket *pkt, const ServerOptions *opts,
+                         uint64_t now_ns) {
+  TenantStats *stats = &anon_stats;
+  TokenBucket *session_bucket = NULL;
+  TokenBucket *tenant_bucket = NULL;
+  SessionId id = session_lookup(&sessions, &pkt->addr);
+
+  if (id != SESSION_NONE) {
+    uint16_t tenant = session_hot(&sessions, id)->tenant;
+    if (tenant != SESSION_NO_TENANT) {
+      stats = &tenant_stats[tenant];
+    }
 
-  // Validar sequence number
-  if (seq_num == session->expected_seq) {
-    // Escribir datos nuevos
-    if (data_len > 0) {
-      size_t written = fwrite(data, 1, data_len, session->file);
-      if (written != data_len) {
-        printf("Error escribiendo archivo\n");
-        cleanup_session(session);
+    if (opts->session_rate > 0) {
+      session_bucket = &session_cold(&sessions, id)->bucket;
+      if (!token_bucket_check(session_bucket, (double)opts->session_rate,
+                              rate_burst(opts->session_rate), now_ns,
+                              pkt->len)) {
+        stats->dropped_session++;
+        sched_free(&scheduler, pkt);
         return;
       }
-      session->bytes_received += written;
     }
 
-    // Enviar ACK para nuevo DATA
-    send_ack(sockfd, addr, seq_num, NULL);
-
-    // Actualizar estado y último ACK
-    session->state = STATE_TRANSFERRING;
-    session->expected_seq = 1 - seq_num; // Alternar 0 <-> 1
-    session->last_ack_seq = seq_num;
-    session->has_last_ack = 1;
-  } else {
-    // Seq incorrecto: puede ser duplicado o error
-    printf("Seq incorrecto: recibido=%d, esperado=%d\n", seq_num,
-           session->expected_seq);
-
-    // Si coincide con el último ACK, es un duplicado (retransmisión del
-    // cliente)
-    if (session->has_last_ack && seq_num == session->last_ack_seq) {
-      printf("DATA duplicado (Seq=%d), reenviando ACK\n", seq_num);
-      send_ack(sockfd, addr, session->last_ack_seq, NULL);
+    if (opts->tenant_rate > 0 && tenant != SESSION_NO_TENANT) {
+      tenant_bucket = &tenant_buckets[tenant];
+      if (!token_bucket_check(tenant_bucket, (double)opts->tenant_rate,
+                              rate_burst(opts->tenant_rate), now_ns,
+                              pkt->len)) {
+        stats->dropped_tenant++;
+        sched_free(&scheduler, pkt);
+        return;
+      }
     }
   }
-}
 
-// Manejar PDU FIN (sin payload, solo type + seq_num)
-static void handle_fin(int sockfd, struct sockaddr_in *addr, uint8_t seq_num) {
-  ClientSession *session = find_or_create_session(addr);
-  if (!session) {
+  // sched_enqueue no toca nada si la cola está llena
+  if (sched_enqueue(&scheduler, pkt) < 0) {
+    stats->dropped_queue++;
+    sched_free(&scheduler, pkt);
     return;
   }
+  if (session_bucket) {
+    token_bucket_take(session_bucket, pkt->len);
+  }
+  if (tenant_bucket) {
+    token_bucket_take(tenant_bucket, pkt->len);
+  }
+  stats->packets++;
+  stats->bytes += pkt->len;
+}
 
-  if (session->state == STATE_TRANSFERRING) {
-    // Validar sequence number (debe ser el siguiente esperado)
-    if (seq_num != session->expected_seq) {
-      printf("FIN con Seq incorrecto: recibido=%d, esperado=%d\n", seq_num,
-             session->expected_seq);
-      return;
+// Recibir un datagrama en un slot del scheduler y pasarlo por la admisión.
+// Retorna 1 si se recibió algo, 0 si no había (o no hay slots libres) y -1
+// ante un error del socket.
+static int receive_one(int sockfd, const ServerOptions *opts, int flags) {
+  SchedPacket *pkt = sched_alloc(&scheduler);
+  if (!pkt) {
+    return 0;
+  }
+
+  ssize_t n = recv_pdu(sockfd, pkt->data, &pkt->addr, &pkt->rx_ts, flags);
+  if (n < 0) {
+    sched_free(&scheduler, pkt);
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      return 0;
     }
+    perror("recvmsg");
+    return -1;
+  }
 
-    printf("Finalización recibida: '%s', total: %zu bytes\n", session->filename,
-           session->bytes_received);
+  pkt->len = (uint16_t)n;
+  admit_packet(pkt, opts, monotonic_ns());
+  return 1;
+}
 
-    // Cerrar archivo y enviar ACK final
-    if (session->file) {
-      fclose(session->file);
-      session->file = NULL;
-    }
-    send_ack(sockfd, addr, seq_num, NULL);
-    session->state = STATE_COMPLETED;
-    session->last_ack_seq = seq_num;
-    session->has_last_ack = 1;
-
-  } else if (session->state == STATE_COMPLETED) {
-    // FIN duplicado: reenviar ACK si el seq coincide
-    if (session->has_last_ack && seq_num == session->last_ack_seq) {
-      printf("FIN duplicado para '%s', reenviando ACK\n", session->filename);
-      send_ack(sockfd, addr, seq_num, NULL);
+static void print_tenant_row(const char *name, const TenantStats *t) {
+  printf("%-20s %10llu %12llu %10llu %10llu %10llu\n", name, t->packets,
+         t->bytes, t->dropped_session, t->dropped_tenant, t->dropped_queue);
+}
+
+// Contadores de throttling por credencial
+static void print_tenant_stats(void) {
+  printf("\n=== Tráfico por credencial ===\n");
+  printf("%-20s %10s %12s %10s %10s %10s\n", "Credencial", "PDUs", "Bytes",
+         "Desc.ses", "Desc.cred", "Desc.cola");
+  for (int i = 0; i < num_credentials; i++) {
+    const TenantStats *t = &tenant_stats[i];
+    if (t->packets || t->dropped_session || t->dropped_tenant ||
+        t->dropped_queue) {
+      print_tenant_row(valid_credentials[i], t);
     }
-  } else {
-    printf("FIN en estado incorrecto (%d), descartando\n", session->state);
   }
+  print_tenant_row("(sin autenticar)", &anon_stats);
+  fflush(stdout);
 }
 
 int main(int argc, char *argv[]) {
-  if (argc != 2) {
-    fprintf(stderr, "Uso: %s <credentials_file>\n", argv[0]);
+  ServerOptions opts;
+  if (parse_args(argc, argv, &opts) < 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  setup_signal_handlers();
+  latency_hist_init(&ack_latency);
+  durability_init(&durability, opts.durability, opts.commit_window_us);
+  if (durability_start(&durability) < 0) {
+    perror("durability_start");
     return 1;
   }
 
   // Cargar credenciales
-  if (load_credentials(argv[1]) < 0) {
+  if (load_credentials(opts.credentials_file) < 0) {
+    return 1;
+  }
+  // Inicializar pool de clientes (los slabs se reservan a demanda)
+  if (session_pool_init(&sessions, MAX_CLIENTS) < 0) {
     return 1;
   }
-  // Inicializar pool de clientes
-  memset(clients, 0, sizeof(clients));
 
   // Crear socket UDP
   int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
@@ -421,6 +859,13 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
+  // Timestamps de recepción del kernel para medir el turnaround de los ACK
+  int timestamp = 1;
+  if (setsockopt(sockfd, SOL_SOCKET, SO_TIMESTAMPNS, &timestamp,
+                 sizeof(timestamp)) < 0) {
+    perror("setsockopt SO_TIMESTAMPNS");
+  }
+
   // Vincular a puerto
   struct sockaddr_in server_addr;
   memset(&server_addr, 0, sizeof(server_addr));
@@ -433,89 +878,151 @@ int main(int argc, char *argv[]) {
     close(sockfd);
     return 1;
   }
+  g_sockfd = sockfd;
+
+  setup_low_latency(sockfd, &opts);
+  if (opts.session_rate > 0 || opts.tenant_rate > 0) {
+    printf("Límites de tráfico: sesión %ld B/s, credencial %ld B/s "
+           "(0 = sin límite)\n",
+           opts.session_rate, opts.tenant_rate);
+  }
+  if (opts.durability == DURABILITY_GROUP) {
+    printf("Durabilidad: group commit, ventana de %ld us\n",
+           opts.commit_window_us);
+  } else {
+    printf("Durabilidad: %s\n", durability_mode_name(opts.durability));
+  }
 
   printf("Servidor escuchando en puerto %d\n", SERVER_PORT);
   printf("Máximo de clientes concurrentes: %d\n", MAX_CLIENTS);
 
-  // Loop principal
-  uint8_t buffer[MAX_PDU_SIZE];
+  // Loop principal: recibir en lote hacia el scheduler y despachar en DRR
+  sched_init(&scheduler);
+  unsigned long long spin_hits = 0;      // PDUs obtenidos girando
+  unsigned long long spin_fallbacks = 0; // Presupuesto agotado -> poll()
 
-  while (1) {
+  while (g_running) {
     cleanup_inactive_sessions();
 
-    struct sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
-
-    struct pollfd pfd;
-    pfd.fd = sockfd;
-    pfd.events = POLLIN;
-
-    // Esperar hasta 1000ms (1 segundo)
-    int ret = poll(&pfd, 1, 1000);
-
-    if (ret < 0) {
-      if (errno == EINTR)
-        continue;
-      perror("poll");
-      break;
+    if (g_dump_stats) {
+      g_dump_stats = 0;
+      print_tenant_stats();
+      durability_print(&durability, stdout);
     }
 
-    if (ret == 0) {
-      // Timeout del poll: No llegó nada, volvemos arriba a limpiar sesiones
-      continue;
+    // ACK de los FIN que el hilo de commit ya dejó en disco
+    if (durability_has_done(&durability)) {
+      durability_complete(&durability, commit_done);
     }
 
-    if (pfd.revents & POLLIN) {
-      // Ahora sí, recvfrom es seguro y no bloqueará
-      ssize_t recv_len = recvfrom(sockfd, buffer, MAX_PDU_SIZE, 0,
-                                  (struct sockaddr *)&client_addr, &client_len);
+    // Sin nada encolado: esperar el próximo datagrama
+    if (sched_pending(&scheduler) == 0) {
+      int got = 0;
+
+      // Modo baja latencia: girar con recvmsg no bloqueante
+      if (opts.spin_us > 0) {
+        struct timespec start, cur;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int64_t budget_ns = opts.spin_us * 1000LL;
+
+        do {
+          got = receive_one(sockfd, &opts, MSG_DONTWAIT);
+          if (got != 0) {
+            break;
+          }
+          clock_gettime(CLOCK_MONOTONIC, &cur);
+        } while (g_running && timespec_diff_ns(&cur, &start) < budget_ns);
+
+        if (got < 0) {
+          break;
+        }
+        if (got > 0) {
+          spin_hits++;
+        } else {
+          spin_fallbacks++;
+        }
+      }
 
-      if (recv_len < 0) {
-        if (errno == EINTR)
+      if (got == 0) {
+        // El socket y el aviso del hilo de commit (fd -1 en modo none, que
+        // poll() ignora)
+        struct pollfd pfd[2];
+        pfd[0].fd = sockfd;
+        pfd[0].events = POLLIN;
+        pfd[1].fd = durability_event_fd(&durability);
+        pfd[1].events = POLLIN;
+
+        // Esperar hasta 1000ms (1 segundo)
+        int ret = poll(pfd, 2, 1000);
+
+        if (ret < 0) {
+          if (errno == EINTR)
+            continue;
+          perror("poll");
+          break;
+        }
+
+        if (ret == 0) {
+          // Timeout del poll: No llegó nada, volvemos arriba a limpiar
           continue;
-        perror("recvfrom");
-        break;
+        }
+        if (pfd[1].revents & POLLIN) {
+          durability_complete(&durability, commit_done);
+        }
+        if (!pfd[0].revents) {
+          continue;
+        }
       }
+    }
 
-      if (recv_len < 2) {
-        printf("PDU demasiado corta, descartando\n");
-        continue;
+    // Vaciar el socket (sin bloquear) hacia las colas por flujo
+    int rx_error = 0;
+    for (int i = 0; i < RX_BATCH; i++) {
+      int got = receive_one(sockfd, &opts, MSG_DONTWAIT);
+      if (got <= 0) {
+        rx_error = got < 0;
+        break;
       }
+    }
+    if (rx_error) {
+      break;
+    }
 
-      // Extraer campos
-      uint8_t type = buffer[0];
-      uint8_t seq_num = buffer[1];
-      uint8_t *data = (recv_len > 2) ? &buffer[2] : NULL;
-      size_t data_len = (recv_len > 2) ? (size_t)(recv_len - 2) : 0;
-
-      // Procesar según tipo
-      switch (type) {
-      case TYPE_HELLO:
-        handle_hello(sockfd, &client_addr, data, data_len, seq_num);
-        break;
-      case TYPE_WRQ:
-        handle_wrq(sockfd, &client_addr, data, data_len, seq_num);
-        break;
-      case TYPE_DATA:
-        handle_data(sockfd, &client_addr, data, data_len, seq_num);
-        break;
-      case TYPE_FIN:
-        handle_fin(sockfd, &client_addr, seq_num);
-        break;
-      default:
-        printf("Tipo de PDU desconocido: %d\n", type);
+    // Despachar en orden deficit-round-robin entre flujos
+    for (int i = 0; i < DISPATCH_BUDGET; i++) {
+      SchedPacket *pkt = sched_next(&scheduler);
+      if (!pkt) {
         break;
       }
+      current_rx_ts = pkt->rx_ts;
+      current_rx_valid = 1;
+      dispatch_pdu(sockfd, &pkt->addr, pkt->data, pkt->len);
+      current_rx_valid = 0;
+      sched_free(&scheduler, pkt);
     }
   }
 
-  // Cleanup (solo se ejecuta si salimos del loop por error)
-  for (int i = 0; i < MAX_CLIENTS; i++) {
-    if (clients[i].active) {
-      cleanup_session(&clients[i]);
+  // Cleanup: los FIN pendientes se sincronizan y confirman antes de cerrar
+  durability_close(&durability, commit_done);
+  uint32_t capacity = session_pool_capacity(&sessions);
+  for (SessionId id = 0; id < capacity; id++) {
+    if (session_hot(&sessions, id)->active) {
+      cleanup_session(id);
     }
   }
+  session_pool_destroy(&sessions);
+
+  latency_hist_print(&ack_latency, stdout,
+                     opts.spin_us > 0
+                         ? "Latencia de ACK (recepción -> envío), busy-poll"
+                         : "Latencia de ACK (recepción -> envío), poll()");
+  if (opts.spin_us > 0) {
+    printf("PDUs recibidos girando: %llu, caídas a poll(): %llu\n", spin_hits,
+           spin_fallbacks);
+  }
+  print_tenant_stats();
+  durability_print(&durability, stdout);
 
   close(sockfd);
   return 0;
-}
\ No newline at end of file
+}
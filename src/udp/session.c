@@ -0,0 +1,194 @@
+#include "session.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_BUCKETS 1024
+
+static uint32_t addr_hash(uint32_t ip, uint16_t port) {
+  // Hash multiplicativo (Fibonacci) sobre ip:puerto
+  uint64_t key = ((uint64_t)ip << 16) | port;
+  key *= 0x9E3779B97F4A7C15ULL;
+  return (uint32_t)(key >> 32);
+}
+
+int session_pool_init(SessionPool *pool, uint32_t max_sessions) {
+  memset(pool, 0, sizeof(*pool));
+  pool->max_sessions = max_sessions;
+  pool->free_head = SESSION_NONE;
+
+  pool->num_buckets = INITIAL_BUCKETS;
+  pool->buckets = malloc(pool->num_buckets * sizeof(uint32_t));
+  if (!pool->buckets) {
+    perror("malloc buckets");
+    return -1;
+  }
+  for (uint32_t i = 0; i < pool->num_buckets; i++) {
+    pool->buckets[i] = SESSION_NONE;
+  }
+  return 0;
+}
+
+void session_pool_destroy(SessionPool *pool) {
+  for (uint32_t i = 0; i < pool->num_slabs; i++) {
+    free(pool->hot_slabs[i]);
+    free(pool->cold_slabs[i]);
+  }
+  free(pool->hot_slabs);
+  free(pool->cold_slabs);
+  free(pool->buckets);
+  memset(pool, 0, sizeof(*pool));
+}
+
+// Reservar un slab nuevo y encadenar sus entradas a la lista libre
+static int grow_pool(SessionPool *pool) {
+  if (session_pool_capacity(pool) >= pool->max_sessions) {
+    return -1;
+  }
+
+  if (pool->num_slabs == pool->slab_capacity) {
+    uint32_t new_cap = pool->slab_capacity ? pool->slab_capacity * 2 : 4;
+    SessionHot **hot = realloc(pool->hot_slabs, new_cap * sizeof(*hot));
+    if (!hot) {
+      return -1;
+    }
+    pool->hot_slabs = hot;
+    SessionCold **cold = realloc(pool->cold_slabs, new_cap * sizeof(*cold));
+    if (!cold) {
+      return -1;
+    }
+    pool->cold_slabs = cold;
+    pool->slab_capacity = new_cap;
+  }
+
+  SessionHot *hot = calloc(SESSION_SLAB_SIZE, sizeof(SessionHot));
+  SessionCold *cold = calloc(SESSION_SLAB_SIZE, sizeof(SessionCold));
+  if (!hot || !cold) {
+    free(hot);
+    free(cold);
+    return -1;
+  }
+
+  uint32_t base = pool->num_slabs << SESSION_SLAB_SHIFT;
+  pool->hot_slabs[pool->num_slabs] = hot;
+  pool->cold_slabs[pool->num_slabs] = cold;
+  pool->num_slabs++;
+
+  // En orden inverso para que los índices bajos se usen primero
+  for (uint32_t i = SESSION_SLAB_SIZE; i-- > 0;) {
+    hot[i].fd = -1;
+    hot[i].next = pool->free_head;
+    pool->free_head = base + i;
+  }
+  return 0;
+}
+
+// Duplicar el hash cuando el factor de carga llega a 1
+static void grow_buckets(SessionPool *pool) {
+  uint32_t new_count = pool->num_buckets * 2;
+  uint32_t *buckets = malloc(new_count * sizeof(uint32_t));
+  if (!buckets) {
+    return; // Seguimos con cadenas más largas
+  }
+  for (uint32_t i = 0; i < new_count; i++) {
+    buckets[i] = SESSION_NONE;
+  }
+
+  for (uint32_t b = 0; b < pool->num_buckets; b++) {
+    uint32_t id = pool->buckets[b];
+    while (id != SESSION_NONE) {
+      SessionHot *hot = session_hot(pool, id);
+      uint32_t next = hot->next;
+      uint32_t nb = addr_hash(hot->ip, hot->port) & (new_count - 1);
+      hot->next = buckets[nb];
+      buckets[nb] = id;
+      id = next;
+    }
+  }
+
+  free(pool->buckets);
+  pool->buckets = buckets;
+  pool->num_buckets = new_count;
+}
+
+SessionId session_lookup(const SessionPool *pool,
+                         const struct sockaddr_in *addr) {
+  uint32_t ip = addr->sin_addr.s_addr;
+  uint16_t port = addr->sin_port;
+  uint32_t id = pool->buckets[addr_hash(ip, port) & (pool->num_buckets - 1)];
+
+  while (id != SESSION_NONE) {
+    const SessionHot *hot = session_hot(pool, id);
+    if (hot->ip == ip && hot->port == port) {
+      return id;
+    }
+    id = hot->next;
+  }
+  return SESSION_NONE;
+}
+
+SessionId session_create(SessionPool *pool, const struct sockaddr_in *addr) {
+  if (pool->free_head == SESSION_NONE && grow_pool(pool) < 0) {
+    return SESSION_NONE;
+  }
+  if (pool->active_count >= pool->num_buckets) {
+    grow_buckets(pool);
+  }
+
+  SessionId id = pool->free_head;
+  SessionHot *hot = session_hot(pool, id);
+  pool->free_head = hot->next;
+
+  memset(hot, 0, sizeof(*hot));
+  memset(session_cold(pool, id), 0, sizeof(SessionCold));
+  hot->ip = addr->sin_addr.s_addr;
+  hot->port = addr->sin_port;
+  hot->fd = -1;
+  hot->tenant = SESSION_NO_TENANT;
+  hot->active = 1;
+
+  uint32_t b = addr_hash(hot->ip, hot->port) & (pool->num_buckets - 1);
+  hot->next = pool->buckets[b];
+  pool->buckets[b] = id;
+  pool->active_count++;
+  return id;
+}
+
+void session_release(SessionPool *pool, SessionId id) {
+  SessionHot *hot = session_hot(pool, id);
+  if (!hot->active) {
+    return;
+  }
+
+  // Sacar de la cadena del hash
+  uint32_t *link =
+      &pool->buckets[addr_hash(hot->ip, hot->port) & (pool->num_buckets - 1)];
+  while (*link != SESSION_NONE && *link != id) {
+    link = &session_hot(pool, *link)->next;
+  }
+  if (*link == id) {
+    *link = hot->next;
+  }
+
+  hot->active = 0;
+  hot->fd = -1;
+  hot->next = pool->free_head;
+  pool->free_head = id;
+  pool->active_count--;
+}
+
+void session_addr(const SessionHot *hot, struct sockaddr_in *addr) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_addr.s_addr = hot->ip;
+  addr->sin_port = hot->port;
+}
+
+size_t session_pool_memory(const SessionPool *pool) {
+  return (size_t)pool->num_slabs * SESSION_SLAB_SIZE *
+             (sizeof(SessionHot) + sizeof(SessionCold)) +
+         (size_t)pool->slab_capacity *
+             (sizeof(SessionHot *) + sizeof(SessionCold *)) +
+         (size_t)pool->num_buckets * sizeof(uint32_t);
+}
@@ -0,0 +1,101 @@
+#ifndef UDP_SESSION_H
+#define UDP_SESSION_H
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "ratelimit.h"
+#include "tpd.h"
+
+// Pool de sesiones del servidor UDP.
+//
+// Las sesiones se guardan en slabs de SESSION_SLAB_SIZE entradas que se
+// reservan a demanda (hasta el máximo configurado), así el servidor no paga
+// memoria por sesiones que nunca existieron. Cada sesión está partida en dos:
+//   - SessionHot: lo que se toca en cada PDU (dirección, estado, seq, fd),
+//     compacto para que entren varias sesiones por línea de caché.
+//   - SessionCold: metadatos que solo se usan en WRQ/FIN/limpieza.
+// Una sesión se identifica por su índice (SessionId), estable mientras viva.
+
+#define SESSION_SLAB_SHIFT 10
+#define SESSION_SLAB_SIZE (1u << SESSION_SLAB_SHIFT)
+#define SESSION_NONE UINT32_MAX
+#define SESSION_NO_TENANT UINT16_MAX
+
+typedef uint32_t SessionId;
+
+typedef struct {
+  uint32_t ip;   // Network byte order
+  uint16_t port; // Network byte order
+  TpdConn conn;  // Estado del protocolo (state, seq, último ACK)
+  uint8_t active;
+  int fd;                // Archivo en escritura, -1 si no hay
+  uint32_t next;         // Siguiente en el bucket del hash / lista libre
+  uint16_t tenant;       // Índice de la credencial autenticada
+  int64_t last_activity; // time(NULL) del último PDU
+} SessionHot;
+
+struct DedupState;
+
+typedef struct {
+  char filename[MAX_FILENAME_LEN + 1];
+  size_t bytes_received; // Del archivo en curso
+  size_t total_bytes;    // Acumulado de los archivos completados
+  int files_completed;
+  struct DedupState *dedup; // Solo en transferencias deduplicadas
+  TokenBucket bucket;       // Límite por sesión (solo se toca con -r)
+} SessionCold;
+
+typedef struct {
+  SessionHot **hot_slabs;
+  SessionCold **cold_slabs;
+  uint32_t num_slabs;
+  uint32_t slab_capacity; // Entradas del arreglo de punteros a slabs
+
+  uint32_t *buckets; // Hash dirección -> primer SessionId de la cadena
+  uint32_t num_buckets;
+
+  uint32_t free_head; // Lista de sesiones libres (enlazada por hot.next)
+  uint32_t active_count;
+  uint32_t max_sessions;
+} SessionPool;
+
+int session_pool_init(SessionPool *pool, uint32_t max_sessions);
+void session_pool_destroy(SessionPool *pool);
+
+// Buscar la sesión de una dirección, SESSION_NONE si no existe
+SessionId session_lookup(const SessionPool *pool,
+                         const struct sockaddr_in *addr);
+
+// Crear una sesión nueva (la dirección no debe tener una activa).
+// Retorna SESSION_NONE si se alcanzó el máximo o no hay memoria.
+SessionId session_create(SessionPool *pool, const struct sockaddr_in *addr);
+
+// Devolver la sesión al pool (no cierra el fd)
+void session_release(SessionPool *pool, SessionId id);
+
+// Cantidad de índices válidos para recorrer el pool (activos o no)
+static inline uint32_t session_pool_capacity(const SessionPool *pool) {
+  return pool->num_slabs << SESSION_SLAB_SHIFT;
+}
+
+static inline SessionHot *session_hot(const SessionPool *pool, SessionId id) {
+  return &pool->hot_slabs[id >> SESSION_SLAB_SHIFT]
+                         [id & (SESSION_SLAB_SIZE - 1)];
+}
+
+static inline SessionCold *session_cold(const SessionPool *pool,
+                                        SessionId id) {
+  return &pool->cold_slabs[id >> SESSION_SLAB_SHIFT]
+                          [id & (SESSION_SLAB_SIZE - 1)];
+}
+
+// Reconstruir la sockaddr_in de una sesión
+void session_addr(const SessionHot *hot, struct sockaddr_in *addr);
+
+// Bytes reservados por el pool (slabs + hash + tabla de slabs)
+size_t session_pool_memory(const SessionPool *pool);
+
+#endif // UDP_SESSION_H
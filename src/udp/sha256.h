@@ -0,0 +1,25 @@
+#ifndef UDP_SHA256_H
+#define UDP_SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// SHA-256 (FIPS 180-4), usado como identificador de contenido de los chunks
+
+#define SHA256_DIGEST_SIZE 32
+
+typedef struct {
+  uint32_t state[8];
+  uint64_t bit_len;
+  uint8_t block[64];
+  size_t block_len;
+} Sha256Ctx;
+
+void sha256_init(Sha256Ctx *ctx);
+void sha256_update(Sha256Ctx *ctx, const uint8_t *data, size_t len);
+void sha256_final(Sha256Ctx *ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+// Representación hexadecimal (out debe tener 2 * 32 + 1 bytes)
+void sha256_hex(const uint8_t digest[SHA256_DIGEST_SIZE], char *out);
+
+#endif // UDP_SHA256_H
@@ -0,0 +1,146 @@
+#ifndef UDP_TPD_H
+#define UDP_TPD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "protocol.h"
+
+// libtpd: máquinas de estado del protocolo Stop&Wait sin I/O.
+//
+// Ninguna función toca sockets, archivos ni relojes: la aplicación les pasa
+// los datagramas recibidos y la hora (en ns, de cualquier reloj monótono) y
+// recibe datagramas para enviar, el próximo deadline de retransmisión y los
+// eventos del protocolo (credencial, filename, payload a escribir, FIN). Así
+// cada aplicación puede manejar muchas transferencias desde su propio event
+// loop (poll, epoll, timerfd...).
+
+// Largo máximo de nombre de archivo remoto (ver validación del WRQ)
+#define MAX_FILENAME_LEN 10
+
+// Datagrama listo para enviar (len = 0: nada que enviar)
+typedef struct {
+  uint8_t buf[MAX_PDU_SIZE];
+  size_t len;
+} TpdDatagram;
+
+// ---------------------------------------------------------------------------
+// Cliente: un intercambio (PDU -> ACK/HAVE) en vuelo a la vez
+// ---------------------------------------------------------------------------
+
+typedef enum {
+  TPD_PENDING = 0, // Sigue esperando (datagrama ignorado o retransmisión)
+  TPD_DONE,        // Llegó la respuesta esperada (payload en reply)
+  TPD_REJECTED,    // El servidor respondió con error (mensaje en reply)
+  TPD_FAILED,      // Se agotaron los reintentos
+} TpdResult;
+
+typedef struct {
+  uint64_t timeout_ns;
+  int max_retries;
+
+  uint8_t next_seq; // Seq del próximo WRQ / DATA / MANIFEST / FIN
+  uint8_t reply_type;
+  int busy;          // Hay un intercambio en vuelo
+  int must_transmit; // El PDU todavía no salió (o hay que retransmitirlo)
+  int retries;
+  uint64_t deadline_ns;
+
+  TpdDatagram pdu; // Último PDU enviado
+  uint8_t reply[MAX_DATA_SIZE];
+  size_t reply_len;
+} TpdClient;
+
+void tpd_client_init(TpdClient *c, uint64_t timeout_ns, int max_retries);
+
+// Iniciar un intercambio. Retornan -1 si ya hay uno en vuelo o los
+// argumentos no entran en un PDU.
+int tpd_client_hello(TpdClient *c, const char *cred, uint64_t now_ns);
+int tpd_client_wrq(TpdClient *c, const char *filename, uint8_t flags,
+                   uint64_t now_ns);
+int tpd_client_data(TpdClient *c, const uint8_t *data, size_t len,
+                    uint64_t now_ns);
+int tpd_client_manifest(TpdClient *c, const uint8_t *data, size_t len,
+                        uint64_t now_ns);
+int tpd_client_fin(TpdClient *c, uint64_t now_ns);
+
+// Datagrama a enviar ahora, NULL si no hay
+const TpdDatagram *tpd_client_transmit(TpdClient *c);
+
+// Deadline de retransmisión, 0 si no hay intercambio en vuelo
+static inline uint64_t tpd_client_deadline(const TpdClient *c) {
+  return c->busy ? c->deadline_ns : 0;
+}
+
+// Vencido el deadline: programa la retransmisión o falla
+TpdResult tpd_client_timeout(TpdClient *c, uint64_t now_ns);
+
+// Datagrama recibido del servidor (el llamador ya validó el origen)
+TpdResult tpd_client_input(TpdClient *c, const uint8_t *pdu, size_t len);
+
+// ---------------------------------------------------------------------------
+// Servidor: estado por sesión (4 bytes, embebible en la sesión del server)
+// ---------------------------------------------------------------------------
+
+typedef struct {
+  uint8_t state; // ClientState
+  uint8_t expected_seq;
+  uint8_t last_ack_seq;
+  uint8_t has_last_ack; // 0 también mientras el ACK del FIN está diferido
+} TpdConn;
+
+typedef enum {
+  TPD_EV_NONE = 0, // Nada para la aplicación (puede haber respuesta en out)
+  TPD_EV_HELLO,    // data = credencial
+  TPD_EV_WRQ,      // filename / flags; restart = viene de un archivo completo
+  TPD_EV_DATA,     // data = payload a escribir
+  TPD_EV_MANIFEST, // data = manifest (modo deduplicación)
+  TPD_EV_FIN,
+} TpdEventType;
+
+typedef struct {
+  TpdEventType type;
+  uint8_t seq_num;
+  int duplicate; // Retransmisión de un PDU ya confirmado
+  int restart;
+  const uint8_t *data;
+  size_t len;
+  char filename[MAX_FILENAME_LEN + 2];
+  uint8_t flags;
+  const char *note; // Descarte o duplicado resuelto por el engine, o NULL
+} TpdEvent;
+
+static inline void tpd_conn_init(TpdConn *conn) {
+  conn->state = STATE_IDLE;
+  conn->expected_seq = 0;
+  conn->last_ack_seq = 0;
+  conn->has_last_ack = 0;
+}
+
+// Procesar un datagrama del cliente. Los duplicados y descartes se resuelven
+// acá (con una nota en ev->note y, si corresponde, el ACK repetido en out);
+// el resto se entrega como evento y la aplicación contesta con
+// tpd_server_accept, tpd_server_reply, tpd_server_reject o tpd_server_defer.
+void tpd_server_input(TpdConn *conn, const uint8_t *pdu, size_t len,
+                      TpdEvent *ev, TpdDatagram *out);
+
+// Aceptar el evento: ACK y avance del estado (un duplicado solo repite el
+// ACK)
+void tpd_server_accept(TpdConn *conn, const TpdEvent *ev, TpdDatagram *out);
+
+// Como accept pero respondiendo con otro tipo y payload (HAVE al MANIFEST)
+void tpd_server_reply(TpdConn *conn, const TpdEvent *ev, uint8_t type,
+                      const uint8_t *payload, size_t len, TpdDatagram *out);
+
+// Rechazar el PDU con seq seq_num: ACK con el mensaje de error, el estado no
+// cambia (la aplicación suele liberar la sesión)
+void tpd_server_reject(uint8_t seq_num, const char *msg, TpdDatagram *out);
+
+// FIN aceptado pero con el ACK diferido (durabilidad). Los FIN repetidos se
+// ignoran hasta tpd_server_commit.
+void tpd_server_defer(TpdConn *conn, const TpdEvent *ev);
+
+// Confirmar un FIN diferido. Retorna 1 (y el ACK en out) si seguía pendiente.
+int tpd_server_commit(TpdConn *conn, uint8_t seq_num, TpdDatagram *out);
+
+#endif // UDP_TPD_H
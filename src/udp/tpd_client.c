@@ -0,0 +1,135 @@
+#include "tpd.h"
+
+#include <string.h>
+
+void tpd_client_init(TpdClient *c, uint64_t timeout_ns, int max_retries) {
+  memset(c, 0, sizeof(*c));
+  c->timeout_ns = timeout_ns;
+  c->max_retries = max_retries;
+}
+
+// Armar el PDU y programar su envío
+static int start_exchange(TpdClient *c, uint8_t type, uint8_t seq_num,
+                          const uint8_t *data, size_t len, uint8_t reply_type,
+                          uint64_t now_ns) {
+  if (c->busy || len > MAX_DATA_SIZE) {
+    return -1;
+  }
+
+  c->pdu.buf[0] = type;
+  c->pdu.buf[1] = seq_num;
+  if (len > 0) {
+    memcpy(c->pdu.buf + 2, data, len);
+  }
+  c->pdu.len = 2 + len;
+
+  c->reply_type = reply_type;
+  c->reply_len = 0;
+  c->busy = 1;
+  c->must_transmit = 1;
+  c->retries = 0;
+  c->deadline_ns = now_ns + c->timeout_ns;
+  return 0;
+}
+
+int tpd_client_hello(TpdClient *c, const char *cred, uint64_t now_ns) {
+  size_t len = strlen(cred);
+  if (len == 0) {
+    return -1;
+  }
+  return start_exchange(c, TYPE_HELLO, 0, (const uint8_t *)cred, len,
+                        TYPE_ACK, now_ns);
+}
+
+int tpd_client_wrq(TpdClient *c, const char *filename, uint8_t flags,
+                   uint64_t now_ns) {
+  uint8_t buf[MAX_FILENAME_LEN + 2]; // filename + '\0' + flags
+  size_t len = strlen(filename);
+  if (len > MAX_FILENAME_LEN) {
+    return -1;
+  }
+
+  memcpy(buf, filename, len + 1);
+  len++;
+  if (flags) {
+    buf[len++] = flags;
+  }
+  // Después del HELLO va con seq=1; después de un FIN, con el seq opuesto al
+  // del FIN, así un ACK del FIN demorado o duplicado no confirma el WRQ
+  return start_exchange(c, TYPE_WRQ, c->next_seq, buf, len, TYPE_ACK, now_ns);
+}
+
+int tpd_client_data(TpdClient *c, const uint8_t *data, size_t len,
+                    uint64_t now_ns) {
+  return start_exchange(c, TYPE_DATA, c->next_seq, data, len, TYPE_ACK,
+                        now_ns);
+}
+
+int tpd_client_manifest(TpdClient *c, const uint8_t *data, size_t len,
+                        uint64_t now_ns) {
+  return start_exchange(c, TYPE_MANIFEST, c->next_seq, data, len, TYPE_HAVE,
+                        now_ns);
+}
+
+int tpd_client_fin(TpdClient *c, uint64_t now_ns) {
+  return start_exchange(c, TYPE_FIN, c->next_seq, NULL, 0, TYPE_ACK, now_ns);
+}
+
+const TpdDatagram *tpd_client_transmit(TpdClient *c) {
+  if (!c->must_transmit) {
+    return NULL;
+  }
+  c->must_transmit = 0;
+  return &c->pdu;
+}
+
+TpdResult tpd_client_timeout(TpdClient *c, uint64_t now_ns) {
+  if (!c->busy || now_ns < c->deadline_ns) {
+    return TPD_PENDING;
+  }
+
+  c->retries++;
+  if (c->retries >= c->max_retries) {
+    c->busy = 0;
+    return TPD_FAILED;
+  }
+  c->must_transmit = 1;
+  c->deadline_ns = now_ns + c->timeout_ns;
+  return TPD_PENDING;
+}
+
+TpdResult tpd_client_input(TpdClient *c, const uint8_t *pdu, size_t len) {
+  if (!c->busy || len < 2) {
+    return TPD_PENDING;
+  }
+
+  uint8_t type = pdu[0];
+  uint8_t seq_num = pdu[1];
+  if (seq_num != c->pdu.buf[1]) {
+    return TPD_PENDING; // ACK duplicado o de otro intercambio
+  }
+
+  // Respuesta esperada con payload (HAVE) o ACK limpio
+  if ((type == c->reply_type && type != TYPE_ACK) ||
+      (type == TYPE_ACK && c->reply_type == TYPE_ACK && len == 2)) {
+    c->reply_len = len - 2;
+    memcpy(c->reply, pdu + 2, c->reply_len);
+    c->busy = 0;
+    c->must_transmit = 0;
+
+    // Tras cada intercambio confirmado el seq alterna 0 <-> 1: dos
+    // intercambios seguidos nunca esperan el mismo ACK
+    c->next_seq = 1 - seq_num;
+    return TPD_DONE;
+  }
+
+  // ACK con payload: error lógico reportado por el servidor
+  if (type == TYPE_ACK && len > 2) {
+    c->reply_len = len - 2;
+    memcpy(c->reply, pdu + 2, c->reply_len);
+    c->busy = 0;
+    c->must_transmit = 0;
+    return TPD_REJECTED;
+  }
+  return TPD_PENDING;
+}
@@ -0,0 +1,266 @@
+#include "tpd.h"
+
+#include <string.h>
+
+static void build(TpdDatagram *out, uint8_t type, uint8_t seq_num,
+                  const uint8_t *payload, size_t len) {
+  if (len > MAX_DATA_SIZE) {
+    len = MAX_DATA_SIZE;
+  }
+  out->buf[0] = type;
+  out->buf[1] = seq_num;
+  if (len > 0) {
+    memcpy(out->buf + 2, payload, len);
+  }
+  out->len = 2 + len;
+}
+
+static void note(TpdEvent *ev, const char *msg) {
+  ev->type = TPD_EV_NONE;
+  ev->note = msg;
+}
+
+// Duplicado de un PDU ya confirmado: repetir el mismo ACK
+static void resend_ack(TpdEvent *ev, TpdDatagram *out, const char *msg) {
+  build(out, TYPE_ACK, ev->seq_num, NULL, 0);
+  note(ev, msg);
+}
+
+static int in_transfer(const TpdConn *conn) {
+  return conn->state == STATE_READY_TO_TRANSFER ||
+         conn->state == STATE_TRANSFERRING;
+}
+
+static void input_hello(TpdConn *conn, TpdEvent *ev, TpdDatagram *out) {
+  if (ev->seq_num != 0) {
+    note(ev, "HELLO con Seq != 0, descartando");
+    return;
+  }
+
+  // Si la sesión no está en IDLE, tratamos como posible retransmisión
+  if (conn->state != STATE_IDLE) {
+    if (conn->has_last_ack && conn->last_ack_seq == 0) {
+      resend_ack(ev, out, "HELLO duplicado, reenviando ACK");
+    } else {
+      note(ev, "HELLO recibido en estado incorrecto, descartando");
+    }
+    return;
+  }
+  ev->type = TPD_EV_HELLO;
+}
+
+// Filename válido: 4-10 caracteres de [0-9A-Za-z_.-]
+static const char *check_filename(const char *filename) {
+  size_t len = strlen(filename);
+  if (len < 4 || len > MAX_FILENAME_LEN) {
+    return "Filename length must be 4-10 chars";
+  }
+  for (size_t j = 0; j < len; j++) {
+    unsigned char c = (unsigned char)filename[j];
+    if (!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') ||
+          (c >= 'a' && c <= 'z') || c == '_' || c == '-' || c == '.')) {
+      return "Invalid filename characters";
+    }
+  }
+  return NULL;
+}
+
+static void input_wrq(TpdConn *conn, TpdEvent *ev, TpdDatagram *out) {
+  // Extraer filename (máx 10 caracteres + null terminator)
+  size_t fn_len = 0;
+  for (size_t i = 0; i < ev->len && i < sizeof(ev->filename) - 1; i++) {
+    if (ev->data[i] == '\0') {
+      break;
+    }
+    ev->filename[i] = (char)ev->data[i];
+    fn_len = i + 1;
+  }
+  ev->filename[fn_len] = '\0';
+
+  // Flags opcionales después del '\0' (clientes viejos no los mandan)
+  if (fn_len + 1 < ev->len) {
+    ev->flags = ev->data[fn_len + 1];
+  }
+
+  // Tras un FIN confirmado la sesión sigue autenticada: un nuevo WRQ abre el
+  // siguiente archivo del lote sin repetir el HELLO. Llega con el seq opuesto
+  // al del FIN (los clientes anteriores mandan siempre 1).
+  if (conn->state == STATE_COMPLETED) {
+    if (!conn->has_last_ack) {
+      note(ev, "WRQ con el commit del archivo anterior pendiente, "
+               "descartando");
+      return;
+    }
+    if (ev->seq_num != 1 && ev->seq_num != 1 - conn->last_ack_seq) {
+      note(ev, "WRQ con Seq incorrecto, descartando");
+      return;
+    }
+    conn->state = STATE_AUTHENTICATED;
+    conn->expected_seq = ev->seq_num; // Si se rechaza, el reintento igual
+    ev->restart = 1;
+  } else if (conn->state == STATE_AUTHENTICATED &&
+             ev->seq_num != conn->expected_seq) {
+    note(ev, "WRQ con Seq incorrecto, descartando");
+    return;
+  }
+
+  if (conn->state == STATE_AUTHENTICATED) {
+    const char *err = check_filename(ev->filename);
+    if (err) {
+      tpd_server_reject(ev->seq_num, err, out);
+      return;
+    }
+    ev->type = TPD_EV_WRQ;
+  } else if (in_transfer(conn)) {
+    // Posible WRQ duplicado: la aplicación compara el filename
+    ev->type = TPD_EV_WRQ;
+    ev->duplicate = 1;
+  } else {
+    note(ev, "WRQ en estado incorrecto, descartando");
+  }
+}
+
+static void input_data(TpdConn *conn, TpdEvent *ev, TpdDatagram *out) {
+  if (!in_transfer(conn)) {
+    note(ev, "DATA sin WRQ previo, descartando");
+    return;
+  }
+  if (ev->seq_num == conn->expected_seq) {
+    ev->type = TPD_EV_DATA;
+    return;
+  }
+
+  // Si coincide con el último ACK es una retransmisión del cliente
+  if (conn->has_last_ack && ev->seq_num == conn->last_ack_seq) {
+    resend_ack(ev, out, "DATA duplicado, reenviando ACK");
+  } else {
+    note(ev, "DATA con Seq incorrecto, descartando");
+  }
+}
+
+static void input_manifest(TpdConn *conn, TpdEvent *ev) {
+  if (!in_transfer(conn)) {
+    note(ev, "MANIFEST sin WRQ previo, descartando");
+    return;
+  }
+  if (ev->seq_num == conn->expected_seq) {
+    ev->type = TPD_EV_MANIFEST;
+  } else if (conn->has_last_ack && ev->seq_num == conn->last_ack_seq) {
+    // Duplicado: la aplicación reenvía el mismo HAVE
+    ev->type = TPD_EV_MANIFEST;
+    ev->duplicate = 1;
+  } else {
+    note(ev, "MANIFEST con Seq incorrecto, descartando");
+  }
+}
+
+static void input_fin(TpdConn *conn, TpdEvent *ev, TpdDatagram *out) {
+  if (conn->state == STATE_TRANSFERRING) {
+    if (ev->seq_num != conn->expected_seq) {
+      note(ev, "FIN con Seq incorrecto, descartando");
+      return;
+    }
+    ev->type = TPD_EV_FIN;
+  } else if (conn->state == STATE_COMPLETED) {
+    // FIN duplicado: reenviar ACK si el seq coincide (y no está diferido)
+    if (conn->has_last_ack && ev->seq_num == conn->last_ack_seq) {
+      resend_ack(ev, out, "FIN duplicado, reenviando ACK");
+    } else {
+      note(ev, "FIN duplicado con el commit pendiente, descartando");
+    }
+  } else {
+    note(ev, "FIN en estado incorrecto, descartando");
+  }
+}
+
+void tpd_server_input(TpdConn *conn, const uint8_t *pdu, size_t len,
+                      TpdEvent *ev, TpdDatagram *out) {
+  memset(ev, 0, sizeof(*ev));
+  out->len = 0;
+
+  if (len < 2) {
+    note(ev, "PDU demasiado corta, descartando");
+    return;
+  }
+  ev->seq_num = pdu[1];
+  ev->data = (len > 2) ? pdu + 2 : NULL;
+  ev->len = len - 2;
+
+  switch (pdu[0]) {
+  case TYPE_HELLO:
+    input_hello(conn, ev, out);
+    break;
+  case TYPE_WRQ:
+    input_wrq(conn, ev, out);
+    break;
+  case TYPE_DATA:
+    input_data(conn, ev, out);
+    break;
+  case TYPE_MANIFEST:
+    input_manifest(conn, ev);
+    break;
+  case TYPE_FIN:
+    input_fin(conn, ev, out);
+    break;
+  default:
+    note(ev, "Tipo de PDU desconocido, descartando");
+    break;
+  }
+}
+
+// Transición de estado al confirmar un evento nuevo
+static void advance(TpdConn *conn, const TpdEvent *ev) {
+  switch (ev->type) {
+  case TPD_EV_HELLO:
+    conn->state = STATE_AUTHENTICATED;
+    conn->expected_seq = 1; // Siguiente debe ser WRQ con seq=1
+    break;
+  case TPD_EV_WRQ:
+    conn->state = STATE_READY_TO_TRANSFER;
+    conn->expected_seq = 1 - ev->seq_num; // Primer DATA: el seq opuesto
+    break;
+  case TPD_EV_DATA:
+  case TPD_EV_MANIFEST:
+    conn->state = STATE_TRANSFERRING;
+    conn->expected_seq = 1 - ev->seq_num; // Alternar 0 <-> 1
+    break;
+  case TPD_EV_FIN:
+    conn->state = STATE_COMPLETED;
+    break;
+  default:
+    return;
+  }
+  conn->last_ack_seq = ev->seq_num;
+  conn->has_last_ack = 1;
+}
+
+void tpd_server_accept(TpdConn *conn, const TpdEvent *ev, TpdDatagram *out) {
+  tpd_server_reply(conn, ev, TYPE_ACK, NULL, 0, out);
+}
+
+void tpd_server_reply(TpdConn *conn, const TpdEvent *ev, uint8_t type,
+                      const uint8_t *payload, size_t len, TpdDatagram *out) {
+  if (!ev->duplicate) {
+    advance(conn, ev);
+  }
+  build(out, type, ev->seq_num, payload, len);
+}
+
+void tpd_server_reject(uint8_t seq_num, const char *msg, TpdDatagram *out) {
+  build(out, TYPE_ACK, seq_num, (const uint8_t *)msg, strlen(msg));
+}
+
+void tpd_server_defer(TpdConn *conn, const TpdEvent *ev) {
+  advance(conn, ev);
+  conn->has_last_ack = 0;
+}
+
+int tpd_server_commit(TpdConn *conn, uint8_t seq_num, TpdDatagram *out) {
+  if (conn->state != STATE_COMPLETED || conn->has_last_ack ||
+      conn->last_ack_seq != seq_num) {
+    return 0;
+  }
+  conn->has_last_ack = 1;
+  build(out, TYPE_ACK, seq_num, NULL, 0);
+  return 1;
+}
@@ -0,0 +1,139 @@
+// Pruebas de libtpd: como el engine no hace I/O, cliente y servidor se
+// conectan pasándose los datagramas a mano y se puede perder, duplicar o
+// demorar cualquiera.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/udp/tpd.h"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: falló: %s\n", __FILE__, __LINE__, #cond);       \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+static TpdClient client;
+static TpdConn conn;
+static uint64_t now_ns = 1;
+
+// Entregar el PDU en vuelo del cliente al servidor, que acepta cualquier
+// evento (como la aplicación con todo en orden). out queda con la respuesta.
+static TpdEventType deliver(TpdDatagram *out) {
+  const TpdDatagram *pdu = tpd_client_transmit(&client);
+  if (!pdu) {
+    pdu = &client.pdu; // Retransmisión
+  }
+  TpdEvent ev;
+  tpd_server_input(&conn, pdu->buf, pdu->len, &ev, out);
+  if (ev.type != TPD_EV_NONE) {
+    tpd_server_accept(&conn, &ev, out);
+  }
+  return ev.type;
+}
+
+// Intercambio completo sin pérdidas. Devuelve el ACK para poder repetirlo.
+static TpdDatagram exchange(void) {
+  TpdDatagram ack;
+  deliver(&ack);
+  CHECK(ack.len > 0);
+  CHECK(tpd_client_input(&client, ack.buf, ack.len) == TPD_DONE);
+  return ack;
+}
+
+static void start_session(void) {
+  tpd_client_init(&client, 1000, 3);
+  tpd_conn_init(&conn);
+  CHECK(tpd_client_hello(&client, "cred", now_ns) == 0);
+  exchange();
+}
+
+// Un archivo de un DATA: WRQ, DATA, FIN. Devuelve el ACK del FIN.
+static TpdDatagram upload_one(const char *name) {
+  static const uint8_t payload[] = "hola";
+  CHECK(tpd_client_wrq(&client, name, 0, now_ns) == 0);
+  exchange();
+  CHECK(tpd_client_data(&client, payload, sizeof(payload), now_ns) == 0);
+  exchange();
+  CHECK(tpd_client_fin(&client, now_ns) == 0);
+  TpdDatagram ack = exchange();
+  CHECK(conn.state == STATE_COMPLETED);
+  return ack;
+}
+
+// El ACK del FIN llega de nuevo (demorado o duplicado) mientras el WRQ del
+// archivo siguiente se perdió: no tiene que confirmar el WRQ
+static void test_stale_fin_ack(void) {
+  start_session();
+  // Dos veces: después de recuperarse la sesión sigue alternando
+  for (int file = 0; file < 2; file++) {
+    TpdDatagram fin_ack = upload_one(file == 0 ? "uno.bin" : "dos.bin");
+
+    CHECK(tpd_client_wrq(&client, "tres.bin", 0, now_ns) == 0);
+    CHECK(tpd_client_transmit(&client) != NULL); // Se pierde
+    CHECK(tpd_client_input(&client, fin_ack.buf, fin_ack.len) ==
+          TPD_PENDING);
+    CHECK(conn.state == STATE_COMPLETED);
+
+    // La retransmisión del WRQ abre el archivo y el DATA se acepta
+    now_ns += 1000;
+    CHECK(tpd_client_timeout(&client, now_ns) == TPD_PENDING);
+    TpdDatagram ack;
+    CHECK(deliver(&ack) == TPD_EV_WRQ);
+    CHECK(tpd_client_input(&client, ack.buf, ack.len) == TPD_DONE);
+    CHECK(tpd_client_data(&client, (const uint8_t *)"x", 1, now_ns) == 0);
+    CHECK(deliver(&ack) == TPD_EV_DATA);
+    CHECK(tpd_client_input(&client, ack.buf, ack.len) == TPD_DONE);
+    CHECK(tpd_client_fin(&client, now_ns) == 0);
+    exchange();
+  }
+}
+
+// Un cliente anterior manda el WRQ siempre con seq=1, también después de un
+// FIN con seq=1
+static void test_old_client_wrq(void) {
+  start_session();
+  upload_one("uno.bin");
+  CHECK(conn.last_ack_seq == 1);
+
+  const uint8_t wrq[] = {TYPE_WRQ, 1, 'd', 'o', 's', '.', 'b', 'i', 'n', 0};
+  TpdEvent ev;
+  TpdDatagram out;
+  tpd_server_input(&conn, wrq, sizeof(wrq), &ev, &out);
+  CHECK(ev.type == TPD_EV_WRQ && ev.restart);
+  tpd_server_accept(&conn, &ev, &out);
+  CHECK(out.len == 2 && out.buf[1] == 1);
+  CHECK(conn.expected_seq == 0);
+}
+
+// Un WRQ rechazado después de un FIN: el siguiente WRQ va con el mismo seq
+// y el servidor lo acepta
+static void test_rejected_wrq(void) {
+  start_session();
+  upload_one("uno.bin");
+
+  TpdDatagram ack;
+  CHECK(tpd_client_wrq(&client, "a/b", 0, now_ns) == 0);
+  CHECK(deliver(&ack) == TPD_EV_NONE);
+  CHECK(tpd_client_input(&client, ack.buf, ack.len) == TPD_REJECTED);
+
+  CHECK(tpd_client_wrq(&client, "dos.bin", 0, now_ns) == 0);
+  CHECK(deliver(&ack) == TPD_EV_WRQ);
+  CHECK(tpd_client_input(&client, ack.buf, ack.len) == TPD_DONE);
+}
+
+int main(void) {
+  test_stale_fin_ack();
+  test_old_client_wrq();
+  test_rejected_wrq();
+  if (failures > 0) {
+    fprintf(stderr, "test_tpd: %d fallas\n", failures);
+    return 1;
+  }
+  printf("test_tpd: OK\n");
+  return 0;
+}